@@ -0,0 +1,526 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <glib-unix.h>
+#include <gtk/gtk.h>
+#include "remmina_file.h"
+#include "remmina_main.h"
+#include "remmina_public.h"
+#include "remmina_ssh.h"
+#include "remmina_bench.h"
+
+/*-----------------------------------------------------------------------------*
+*                           Profiles                                          *
+*-----------------------------------------------------------------------------*/
+#define REMMINA_BENCH_PROFILES 500
+
+static gpointer remmina_bench_file_load_setup(void)
+{
+	GPtrArray *files;
+	GKeyFile *gkeyfile;
+	gchar *filename;
+	gchar *value;
+	gint i;
+
+	files = g_ptr_array_new_with_free_func(g_free);
+	for (i = 0; i < REMMINA_BENCH_PROFILES; i++) {
+		gkeyfile = g_key_file_new();
+		value = g_strdup_printf("Server %d", i);
+		g_key_file_set_string(gkeyfile, "remmina", "name", value);
+		g_free(value);
+		value = g_strdup_printf("Group %d", i % 20);
+		g_key_file_set_string(gkeyfile, "remmina", "group", value);
+		g_free(value);
+		value = g_strdup_printf("host-%04d.example.com:3389", i);
+		g_key_file_set_string(gkeyfile, "remmina", "server", value);
+		g_free(value);
+		g_key_file_set_string(gkeyfile, "remmina", "protocol", "RDP");
+		g_key_file_set_string(gkeyfile, "remmina", "username", "administrator");
+		g_key_file_set_string(gkeyfile, "remmina", "domain", "EXAMPLE");
+		g_key_file_set_string(gkeyfile, "remmina", "labels", i % 2 ? "prod,web" : "test,db");
+		g_key_file_set_string(gkeyfile, "remmina", "resolution_mode", "2");
+		g_key_file_set_string(gkeyfile, "remmina", "resolution_width", "1920");
+		g_key_file_set_string(gkeyfile, "remmina", "resolution_height", "1080");
+		g_key_file_set_string(gkeyfile, "remmina", "colordepth", "99");
+		g_key_file_set_string(gkeyfile, "remmina", "quality", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "sound", "off");
+		g_key_file_set_string(gkeyfile, "remmina", "security", "");
+		g_key_file_set_string(gkeyfile, "remmina", "gateway_server", "");
+		g_key_file_set_string(gkeyfile, "remmina", "ssh_tunnel_enabled", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "ssh_tunnel_server", "");
+		g_key_file_set_string(gkeyfile, "remmina", "ssh_tunnel_auth", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "sharefolder", "");
+		g_key_file_set_string(gkeyfile, "remmina", "shareprinter", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "disableclipboard", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "viewmode", "1");
+		g_key_file_set_string(gkeyfile, "remmina", "scale", "2");
+		g_key_file_set_string(gkeyfile, "remmina", "window_width", "1280");
+		g_key_file_set_string(gkeyfile, "remmina", "window_height", "800");
+		g_key_file_set_string(gkeyfile, "remmina", "window_maximize", "0");
+		g_key_file_set_string(gkeyfile, "remmina", "notes_text", "Synthetic profile written by remmina-bench");
+		value = g_strdup_printf("profile-%04d.remmina", i);
+		filename = g_build_filename(remmina_bench_get_tmpdir(), value, NULL);
+		g_free(value);
+		g_key_file_save_to_file(gkeyfile, filename, NULL);
+		g_key_file_free(gkeyfile);
+		g_ptr_array_add(files, filename);
+	}
+	return files;
+}
+
+static guint64 remmina_bench_file_load_run(gpointer data)
+{
+	GPtrArray *files = data;
+	RemminaFile *remminafile;
+	guint i;
+
+	for (i = 0; i < files->len; i++) {
+		remminafile = remmina_file_load(g_ptr_array_index(files, i));
+		remmina_file_free(remminafile);
+	}
+	return files->len;
+}
+
+static void remmina_bench_file_load_teardown(gpointer data)
+{
+	g_ptr_array_free(data, TRUE);
+}
+
+/*-----------------------------------------------------------------------------*
+*                           Main window search                                *
+*-----------------------------------------------------------------------------*/
+#define REMMINA_BENCH_ROWS 5000
+
+static gpointer remmina_bench_filter_setup(void)
+{
+	GtkListStore *store;
+	GtkTreeIter iter;
+	gchar *name, *group, *server, *date, *filename;
+	gint i;
+
+	store = gtk_list_store_new(N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+				   G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+	for (i = 0; i < REMMINA_BENCH_ROWS; i++) {
+		name = g_strdup_printf("Server %d", i);
+		group = g_strdup_printf("Group %d", i % 20);
+		server = g_strdup_printf("host-%04d.example.com:3389", i);
+		date = g_strdup_printf("2023-05-%02d - 10:%02d:00", i % 28 + 1, i % 60);
+		filename = g_strdup_printf("/tmp/profile-%04d.remmina", i);
+		gtk_list_store_insert_with_values(store, &iter, -1,
+						  PROTOCOL_COLUMN, "org.remmina.Remmina-rdp-symbolic",
+						  NAME_COLUMN, name,
+						  GROUP_COLUMN, group,
+						  SERVER_COLUMN, server,
+						  PLUGIN_COLUMN, "RDP",
+						  DATE_COLUMN, date,
+						  FILENAME_COLUMN, filename,
+						  LABELS_COLUMN, i % 2 ? "prod,web" : "test,db",
+						  NOTES_COLUMN, "",
+						  STATUS_COLUMN, "",
+						  -1);
+		g_free(name);
+		g_free(group);
+		g_free(server);
+		g_free(date);
+		g_free(filename);
+	}
+	return store;
+}
+
+static guint64 remmina_bench_filter_rows(GtkTreeModel *model, const gchar *text)
+{
+	GtkTreeIter iter;
+	guint64 rows = 0;
+
+	if (gtk_tree_model_get_iter_first(model, &iter)) {
+		do {
+			remmina_main_filter_row(model, &iter, text);
+			rows++;
+		} while (gtk_tree_model_iter_next(model, &iter));
+	}
+	return rows;
+}
+
+static guint64 remmina_bench_filter_run(gpointer data)
+{
+	return remmina_bench_filter_rows(GTK_TREE_MODEL(data), "host-012");
+}
+
+static guint64 remmina_bench_filter_labels_run(gpointer data)
+{
+	return remmina_bench_filter_rows(GTK_TREE_MODEL(data), "prod,web");
+}
+
+static void remmina_bench_filter_teardown(gpointer data)
+{
+	g_object_unref(data);
+}
+
+#ifdef HAVE_LIBSSH
+/*-----------------------------------------------------------------------------*
+*                           SSH tunnel relay                                  *
+*-----------------------------------------------------------------------------*/
+/* The socket side of the tunnel copy loop: remmina_ssh_tunnel_buffer_fill()
+ * and remmina_ssh_tunnel_buffer_flush() move the data between a producer
+ * and a consumer socket through a tunnel ring buffer, driven by poll(). */
+#define REMMINA_BENCH_TUNNEL_BYTES (64 * 1024 * 1024)
+#define REMMINA_BENCH_TUNNEL_BUFFER (1024 * 1024)
+#define REMMINA_BENCH_TUNNEL_CHUNK (32 * 1024)
+
+typedef struct {
+	gint				in[2];  /* producer -> in[1], relay <- in[0] */
+	gint				out[2]; /* relay -> out[0], consumer <- out[1] */
+	RemminaSSHTunnelBuffer *	buffer;
+} RemminaBenchTunnel;
+
+static gpointer remmina_bench_tunnel_producer(gpointer data)
+{
+	RemminaBenchTunnel *t = data;
+	guchar chunk[REMMINA_BENCH_TUNNEL_CHUNK];
+	gsize sent = 0;
+	gssize n;
+
+	remmina_bench_fill_random(chunk, sizeof(chunk), 1);
+	while (sent < REMMINA_BENCH_TUNNEL_BYTES) {
+		n = write(t->in[1], chunk, MIN(sizeof(chunk), REMMINA_BENCH_TUNNEL_BYTES - sent));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		sent += n;
+	}
+	return NULL;
+}
+
+static gpointer remmina_bench_tunnel_consumer(gpointer data)
+{
+	RemminaBenchTunnel *t = data;
+	guchar chunk[REMMINA_BENCH_TUNNEL_CHUNK];
+	gsize received = 0;
+	gssize n;
+
+	while (received < REMMINA_BENCH_TUNNEL_BYTES) {
+		n = read(t->out[1], chunk, sizeof(chunk));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		received += n;
+	}
+	return NULL;
+}
+
+static gpointer remmina_bench_tunnel_setup(void)
+{
+	RemminaBenchTunnel *t;
+
+	t = g_new0(RemminaBenchTunnel, 1);
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, t->in) != 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, t->out) != 0)
+		g_error("socketpair: %s", g_strerror(errno));
+	g_unix_set_fd_nonblocking(t->in[0], TRUE, NULL);
+	g_unix_set_fd_nonblocking(t->out[0], TRUE, NULL);
+	t->buffer = remmina_ssh_tunnel_buffer_new(REMMINA_BENCH_TUNNEL_BUFFER);
+	return t;
+}
+
+static guint64 remmina_bench_tunnel_run(gpointer data)
+{
+	RemminaBenchTunnel *t = data;
+	GThread *producer, *consumer;
+	struct pollfd pfd[2];
+	gsize received = 0, sent = 0;
+	gsize avail;
+
+	producer = g_thread_new("bench-producer", remmina_bench_tunnel_producer, t);
+	consumer = g_thread_new("bench-consumer", remmina_bench_tunnel_consumer, t);
+
+	while (sent < REMMINA_BENCH_TUNNEL_BYTES) {
+		remmina_ssh_tunnel_buffer_tail(t->buffer, &avail);
+		pfd[0].fd = t->in[0];
+		pfd[0].events = (received < REMMINA_BENCH_TUNNEL_BYTES && avail > 0) ? POLLIN : 0;
+		remmina_ssh_tunnel_buffer_head(t->buffer, &avail);
+		pfd[1].fd = t->out[0];
+		pfd[1].events = avail > 0 ? POLLOUT : 0;
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		/* The same socket side as the tunnel channels, only the SSH channel is replaced by a socket */
+		if ((pfd[0].revents & POLLIN) && !remmina_ssh_tunnel_buffer_fill(t->buffer, t->in[0], &received))
+			break;
+		if ((pfd[1].revents & POLLOUT) && !remmina_ssh_tunnel_buffer_flush(t->buffer, t->out[0], &sent))
+			break;
+	}
+
+	g_thread_join(producer);
+	g_thread_join(consumer);
+	return sent;
+}
+
+static void remmina_bench_tunnel_teardown(gpointer data)
+{
+	RemminaBenchTunnel *t = data;
+
+	close(t->in[0]);
+	close(t->in[1]);
+	close(t->out[0]);
+	close(t->out[1]);
+	remmina_ssh_tunnel_buffer_free(t->buffer);
+	g_free(t);
+}
+
+/*-----------------------------------------------------------------------------*
+*                           SSH shell and X11 relay                           *
+*-----------------------------------------------------------------------------*/
+/* The shell and X11 forwarding relay of the SSH plugin against a real sshd,
+ * only when REMMINA_BENCH_SSH_SERVER=host:port names one. The current user
+ * logs in with the SSH agent or the default keys. The X11 case also needs
+ * "X11Forwarding yes", xauth and bash on the server. */
+#define REMMINA_BENCH_SSH_BYTES (64 * 1024 * 1024)
+#define REMMINA_BENCH_SSH_TIMEOUT 10000
+/* Local display numbers tried for the fake X server */
+#define REMMINA_BENCH_SSH_DISPLAY_MIN 90
+#define REMMINA_BENCH_SSH_DISPLAY_MAX 189
+
+typedef struct {
+	RemminaFile *		remminafile;
+	RemminaSSHShell *	shell;
+	gint			term[2];        /* shell->slave -> term[0], the terminal reads term[1] */
+	gint			x11_listen;
+} RemminaBenchSSH;
+
+/* Read what the relay delivers until the expected amount or a stall */
+static gsize remmina_bench_ssh_drain(gint fd, gsize expected)
+{
+	guchar chunk[REMMINA_BENCH_TUNNEL_CHUNK];
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	gsize received = 0;
+	gssize n;
+
+	while (received < expected) {
+		if (poll(&pfd, 1, REMMINA_BENCH_SSH_TIMEOUT) <= 0)
+			break;
+		n = read(fd, chunk, MIN(sizeof(chunk), expected - received));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		received += n;
+	}
+	return received;
+}
+
+static gpointer remmina_bench_ssh_terminal(gpointer data)
+{
+	RemminaBenchSSH *b = data;
+
+	return GSIZE_TO_POINTER(remmina_bench_ssh_drain(b->term[1], REMMINA_BENCH_SSH_BYTES));
+}
+
+/* The local X display: takes the forwarded connection, then acknowledges the
+ * data so that the remote command knows it can exit */
+static gpointer remmina_bench_ssh_display(gpointer data)
+{
+	RemminaBenchSSH *b = data;
+	struct pollfd pfd = { b->x11_listen, POLLIN, 0 };
+	gsize received;
+	gint sock;
+
+	if (poll(&pfd, 1, REMMINA_BENCH_SSH_TIMEOUT) <= 0 || (sock = accept(b->x11_listen, NULL, NULL)) < 0)
+		return GSIZE_TO_POINTER(0);
+	received = remmina_bench_ssh_drain(sock, REMMINA_BENCH_SSH_BYTES);
+	if (write(sock, "", 1) != 1)
+		received = 0;
+	close(sock);
+	return GSIZE_TO_POINTER(received);
+}
+
+static gpointer remmina_bench_ssh_setup(void)
+{
+	const gchar *server = g_getenv("REMMINA_BENCH_SSH_SERVER");
+	RemminaBenchSSH *b;
+	RemminaSSH *ssh;
+
+	b = g_new0(RemminaBenchSSH, 1);
+	b->x11_listen = -1;
+	b->remminafile = remmina_file_new();
+	remmina_file_set_string(b->remminafile, "server", server);
+	remmina_file_set_string(b->remminafile, "username", g_get_user_name());
+	b->shell = remmina_ssh_shell_new_from_file(b->remminafile);
+	ssh = REMMINA_SSH(b->shell);
+	remmina_public_get_server_port(server, 22, &ssh->tunnel_entrance_host, &ssh->tunnel_entrance_port);
+	if (!remmina_ssh_init_session(ssh))
+		g_error("%s: %s", server, ssh->error);
+	if (ssh_userauth_publickey_auto(ssh->session, NULL, NULL) != SSH_AUTH_SUCCESS)
+		g_error("%s: %s", server, ssh_get_error(ssh->session));
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, b->term) != 0)
+		g_error("socketpair: %s", g_strerror(errno));
+	b->shell->slave = b->term[0];
+	return b;
+}
+
+static gpointer remmina_bench_ssh_x11_setup(void)
+{
+	RemminaBenchSSH *b;
+	struct sockaddr_in sin = { 0 };
+	gchar *display;
+	gint n;
+
+	b = remmina_bench_ssh_setup();
+	b->x11_listen = socket(AF_INET, SOCK_STREAM, 0);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for (n = REMMINA_BENCH_SSH_DISPLAY_MIN; n <= REMMINA_BENCH_SSH_DISPLAY_MAX; n++) {
+		sin.sin_port = htons(6000 + n);
+		if (bind(b->x11_listen, (struct sockaddr *)&sin, sizeof(sin)) == 0)
+			break;
+	}
+	if (n > REMMINA_BENCH_SSH_DISPLAY_MAX || listen(b->x11_listen, 1) != 0)
+		g_error("No free local X display between :%d and :%d", REMMINA_BENCH_SSH_DISPLAY_MIN, REMMINA_BENCH_SSH_DISPLAY_MAX);
+	/* Where remmina_ssh_x11_open_request_cb() connects the forwarded channels */
+	display = g_strdup_printf("127.0.0.1:%d", n);
+	g_setenv("DISPLAY", display, TRUE);
+	g_free(display);
+	return b;
+}
+
+/* Open the session channel with a pty, as the SSH plugin does, run command
+ * on it and relay until it exits */
+static void remmina_bench_ssh_relay(RemminaBenchSSH *b, const gchar *command, gboolean x11)
+{
+	RemminaSSHShell *shell = b->shell;
+	ssh_channel channel;
+
+	pthread_mutex_lock(&REMMINA_SSH(shell)->ssh_mutex);
+	channel = ssh_channel_new(REMMINA_SSH(shell)->session);
+	if (!channel || ssh_channel_open_session(channel) != SSH_OK ||
+	    ssh_channel_request_pty(channel) != SSH_OK ||
+	    (x11 && !remmina_ssh_shell_request_x11(shell, channel)) ||
+	    ssh_channel_request_exec(channel, command) != SSH_OK)
+		g_error("%s", ssh_get_error(REMMINA_SSH(shell)->session));
+	shell->channel = channel;
+	pthread_mutex_unlock(&REMMINA_SSH(shell)->ssh_mutex);
+
+	remmina_ssh_shell_relay(shell);
+
+	shell->channel = NULL;
+	ssh_channel_close(channel);
+	ssh_channel_free(channel);
+}
+
+static guint64 remmina_bench_ssh_shell_run(gpointer data)
+{
+	RemminaBenchSSH *b = data;
+	GThread *terminal;
+	gchar *command;
+	gsize received;
+
+	terminal = g_thread_new("bench-terminal", remmina_bench_ssh_terminal, b);
+	command = g_strdup_printf("head -c %d /dev/zero", REMMINA_BENCH_SSH_BYTES);
+	remmina_bench_ssh_relay(b, command, FALSE);
+	g_free(command);
+	received = GPOINTER_TO_SIZE(g_thread_join(terminal));
+	if (received != REMMINA_BENCH_SSH_BYTES)
+		g_error("The shell relay delivered %" G_GSIZE_FORMAT " bytes out of %d", received, REMMINA_BENCH_SSH_BYTES);
+	return received;
+}
+
+static guint64 remmina_bench_ssh_x11_run(gpointer data)
+{
+	RemminaBenchSSH *b = data;
+	GThread *display;
+	gchar *command;
+	gsize received;
+
+	display = g_thread_new("bench-display", remmina_bench_ssh_display, b);
+	/* The forwarded display is localhost:N on the server, reached through
+	 * TCP port 6000 + N. The remote side waits for the acknowledgement,
+	 * so that the session does not end with X11 data still in flight. */
+	command = g_strdup_printf("bash -c 'd=${DISPLAY#*:}; d=${d%%.*}; exec 3<>/dev/tcp/127.0.0.1/$((6000 + d)) && "
+				  "head -c %d /dev/zero >&3 && head -c 1 <&3 >/dev/null'", REMMINA_BENCH_SSH_BYTES);
+	remmina_bench_ssh_relay(b, command, TRUE);
+	g_free(command);
+	received = GPOINTER_TO_SIZE(g_thread_join(display));
+	if (received != REMMINA_BENCH_SSH_BYTES)
+		g_error("The X11 relay delivered %" G_GSIZE_FORMAT " bytes out of %d", received, REMMINA_BENCH_SSH_BYTES);
+	return received;
+}
+
+static void remmina_bench_ssh_teardown(gpointer data)
+{
+	RemminaBenchSSH *b = data;
+
+	if (b->x11_listen >= 0)
+		close(b->x11_listen);
+	/* remmina_ssh_shell_free() closes shell->slave */
+	close(b->term[1]);
+	remmina_ssh_shell_free(b->shell);
+	remmina_file_free(b->remminafile);
+	g_free(b);
+}
+
+static const RemminaBenchCase remmina_bench_ssh_cases[] =
+{
+	{ "ssh_shell_relay", "bytes", remmina_bench_ssh_setup,	   remmina_bench_ssh_shell_run, remmina_bench_ssh_teardown },
+	{ "ssh_x11_relay",   "bytes", remmina_bench_ssh_x11_setup, remmina_bench_ssh_x11_run,	remmina_bench_ssh_teardown },
+};
+#endif
+
+static const RemminaBenchCase remmina_bench_core_cases[] =
+{
+	{ "file_load",		  "profiles", remmina_bench_file_load_setup, remmina_bench_file_load_run,     remmina_bench_file_load_teardown },
+	{ "main_filter",	  "rows",     remmina_bench_filter_setup,    remmina_bench_filter_run,	      remmina_bench_filter_teardown    },
+	{ "main_filter_labels",	  "rows",     remmina_bench_filter_setup,    remmina_bench_filter_labels_run, remmina_bench_filter_teardown    },
+#ifdef HAVE_LIBSSH
+	{ "ssh_tunnel_relay",	  "bytes",    remmina_bench_tunnel_setup,    remmina_bench_tunnel_run,	      remmina_bench_tunnel_teardown    },
+#endif
+};
+
+void remmina_bench_core_register(void)
+{
+	remmina_bench_register(remmina_bench_core_cases, G_N_ELEMENTS(remmina_bench_core_cases));
+#ifdef HAVE_LIBSSH
+	if (g_getenv("REMMINA_BENCH_SSH_SERVER"))
+		remmina_bench_register(remmina_bench_ssh_cases, G_N_ELEMENTS(remmina_bench_ssh_cases));
+#endif
+}
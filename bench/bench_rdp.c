@@ -0,0 +1,192 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+#include "rdp/rdp_utils.h"
+#include "remmina_bench.h"
+
+/*-----------------------------------------------------------------------------*
+*                           Clipboard text                                    *
+*-----------------------------------------------------------------------------*/
+#define REMMINA_BENCH_RDP_TEXT (1024 * 1024)
+
+typedef struct {
+	gchar * text;           /* UTF-8, \n line endings */
+	gsize	text_size;
+	guchar *crlf;           /* The same with \r\n line endings */
+	gsize	crlf_size;
+	guchar *utf16;          /* The same as sent to the server */
+	gsize	utf16_size;
+	guchar *scratch;
+} RemminaBenchRdpText;
+
+static gpointer remmina_bench_rdp_text_setup(void)
+{
+	static const gchar *lines[] = {
+		"The quick brown fox jumps over the lazy dog\n",
+		"Pchnąć w tę łódź jeża lub ośm skrzyń fig\n",
+		"Zwölf Boxkämpfer jagen Viktor quer über den großen Sylter Deich\n",
+		"いろはにほへと ちりぬるを わかよたれそ つねならむ\n",
+		"\n",
+	};
+	RemminaBenchRdpText *t;
+	GString *s;
+	gint i = 0;
+
+	s = g_string_sized_new(REMMINA_BENCH_RDP_TEXT + 128);
+	while (s->len < REMMINA_BENCH_RDP_TEXT)
+		g_string_append(s, lines[i++ % G_N_ELEMENTS(lines)]);
+
+	t = g_new0(RemminaBenchRdpText, 1);
+	t->text_size = s->len;
+	t->text = g_string_free(s, FALSE);
+	t->crlf_size = t->text_size;
+	t->crlf = remmina_rdp_utils_lf2crlf((const guchar *)t->text, &t->crlf_size);
+	t->utf16 = remmina_rdp_utils_text_to_utf16(t->text, &t->utf16_size);
+	t->scratch = g_malloc(t->crlf_size);
+	return t;
+}
+
+static guint64 remmina_bench_rdp_lf2crlf_run(gpointer data)
+{
+	RemminaBenchRdpText *t = data;
+	gsize size = t->text_size;
+
+	free(remmina_rdp_utils_lf2crlf((const guchar *)t->text, &size));
+	return t->text_size;
+}
+
+static guint64 remmina_bench_rdp_crlf2lf_run(gpointer data)
+{
+	RemminaBenchRdpText *t = data;
+	gsize size = t->crlf_size;
+
+	/* Works in place, so start from a fresh copy each time */
+	memcpy(t->scratch, t->crlf, size);
+	remmina_rdp_utils_crlf2lf(t->scratch, &size);
+	return t->crlf_size;
+}
+
+static guint64 remmina_bench_rdp_to_utf16_run(gpointer data)
+{
+	RemminaBenchRdpText *t = data;
+	gsize size;
+
+	free(remmina_rdp_utils_text_to_utf16(t->text, &size));
+	return t->text_size;
+}
+
+static guint64 remmina_bench_rdp_from_utf16_run(gpointer data)
+{
+	RemminaBenchRdpText *t = data;
+	gsize size = t->utf16_size;
+
+	g_free(remmina_rdp_utils_utf16_to_text(t->utf16, &size));
+	return t->utf16_size;
+}
+
+static void remmina_bench_rdp_text_teardown(gpointer data)
+{
+	RemminaBenchRdpText *t = data;
+
+	g_free(t->text);
+	free(t->crlf);
+	free(t->utf16);
+	g_free(t->scratch);
+	g_free(t);
+}
+
+/*-----------------------------------------------------------------------------*
+*                           Damaged regions                                   *
+*-----------------------------------------------------------------------------*/
+/* What remmina_rdp_event_update_regions() does with the rectangles of a
+ * busy full HD update: scale each one to the widget size and merge it in
+ * the area to redraw. */
+#define REMMINA_BENCH_RDP_WIDTH 1920
+#define REMMINA_BENCH_RDP_HEIGHT 1080
+#define REMMINA_BENCH_RDP_TILE 64
+#define REMMINA_BENCH_RDP_RECTS 4000
+
+static guint64 remmina_bench_rdp_regions(gint scale_width, gint scale_height)
+{
+	cairo_region_t *region;
+	cairo_rectangle_int_t rect;
+	gint x, y, w, h, i;
+
+	region = cairo_region_create();
+	for (i = 0; i < REMMINA_BENCH_RDP_RECTS; i++) {
+		/* Scattered tiles, some of them overlapping */
+		x = (i * 7 * REMMINA_BENCH_RDP_TILE / 3) % (REMMINA_BENCH_RDP_WIDTH - REMMINA_BENCH_RDP_TILE);
+		y = (i * 13 * REMMINA_BENCH_RDP_TILE / 5) % (REMMINA_BENCH_RDP_HEIGHT - REMMINA_BENCH_RDP_TILE);
+		w = REMMINA_BENCH_RDP_TILE;
+		h = REMMINA_BENCH_RDP_TILE;
+		remmina_rdp_utils_scale_area(REMMINA_BENCH_RDP_WIDTH, REMMINA_BENCH_RDP_HEIGHT, scale_width, scale_height,
+					     &x, &y, &w, &h);
+		rect.x = x;
+		rect.y = y;
+		rect.width = w;
+		rect.height = h;
+		cairo_region_union_rectangle(region, &rect);
+	}
+	cairo_region_destroy(region);
+	return REMMINA_BENCH_RDP_RECTS;
+}
+
+static guint64 remmina_bench_rdp_regions_run(gpointer data)
+{
+	return remmina_bench_rdp_regions(REMMINA_BENCH_RDP_WIDTH, REMMINA_BENCH_RDP_HEIGHT);
+}
+
+static guint64 remmina_bench_rdp_regions_scaled_run(gpointer data)
+{
+	return remmina_bench_rdp_regions(1280, 720);
+}
+
+static const RemminaBenchCase remmina_bench_rdp_cases[] =
+{
+	{ "rdp_lf2crlf",		"bytes", remmina_bench_rdp_text_setup, remmina_bench_rdp_lf2crlf_run,	     remmina_bench_rdp_text_teardown },
+	{ "rdp_crlf2lf",		"bytes", remmina_bench_rdp_text_setup, remmina_bench_rdp_crlf2lf_run,	     remmina_bench_rdp_text_teardown },
+	{ "rdp_text_to_utf16",		"bytes", remmina_bench_rdp_text_setup, remmina_bench_rdp_to_utf16_run,	     remmina_bench_rdp_text_teardown },
+	{ "rdp_utf16_to_text",		"bytes", remmina_bench_rdp_text_setup, remmina_bench_rdp_from_utf16_run,     remmina_bench_rdp_text_teardown },
+	{ "rdp_update_regions",		"rects", NULL,			       remmina_bench_rdp_regions_run,	     NULL			     },
+	{ "rdp_update_regions_scaled",	"rects", NULL,			       remmina_bench_rdp_regions_scaled_run, NULL			     },
+};
+
+void remmina_bench_rdp_register(void)
+{
+	remmina_bench_register(remmina_bench_rdp_cases, G_N_ELEMENTS(remmina_bench_rdp_cases));
+}
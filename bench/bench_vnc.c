@@ -0,0 +1,336 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cairo.h>
+#include "vnc/vnc_capture.h"
+#include "vnc/vnc_pixels.h"
+#include "remmina_bench.h"
+
+/* A full HD framebuffer update converted to the cairo surface format */
+#define REMMINA_BENCH_VNC_WIDTH 1920
+#define REMMINA_BENCH_VNC_HEIGHT 1080
+
+typedef struct {
+	rfbPixelFormat	format;
+	guchar *	src;
+	guchar *	dest;
+} RemminaBenchVnc;
+
+static RemminaBenchVnc *remmina_bench_vnc_new(gint bpp, gint depth, gint rmax, gint gmax, gint bmax,
+					      gint rshift, gint gshift, gint bshift)
+{
+	RemminaBenchVnc *v;
+
+	v = g_new0(RemminaBenchVnc, 1);
+	v->format.bitsPerPixel = bpp;
+	v->format.depth = depth;
+	v->format.trueColour = TRUE;
+	v->format.redMax = rmax;
+	v->format.greenMax = gmax;
+	v->format.blueMax = bmax;
+	v->format.redShift = rshift;
+	v->format.greenShift = gshift;
+	v->format.blueShift = bshift;
+	v->src = g_malloc(REMMINA_BENCH_VNC_WIDTH * REMMINA_BENCH_VNC_HEIGHT * bpp / 8);
+	remmina_bench_fill_random(v->src, REMMINA_BENCH_VNC_WIDTH * REMMINA_BENCH_VNC_HEIGHT * bpp / 8, 2);
+	v->dest = g_malloc(REMMINA_BENCH_VNC_WIDTH * REMMINA_BENCH_VNC_HEIGHT * 4);
+	return v;
+}
+
+static gpointer remmina_bench_vnc_32_setup(void)
+{
+	return remmina_bench_vnc_new(32, 24, 255, 255, 255, 16, 8, 0);
+}
+
+static gpointer remmina_bench_vnc_16_setup(void)
+{
+	return remmina_bench_vnc_new(16, 16, 31, 63, 31, 11, 5, 0);
+}
+
+static gpointer remmina_bench_vnc_8_setup(void)
+{
+	/* BGR233, what libvncclient uses for the 8 bpp quality settings */
+	return remmina_bench_vnc_new(8, 8, 7, 7, 3, 0, 3, 6);
+}
+
+static guint64 remmina_bench_vnc_fill_run(gpointer data)
+{
+	RemminaBenchVnc *v = data;
+
+	remmina_plugin_vnc_pixels_fill(&v->format, v->dest, REMMINA_BENCH_VNC_WIDTH * 4,
+				       v->src, REMMINA_BENCH_VNC_WIDTH * v->format.bitsPerPixel / 8, NULL,
+				       REMMINA_BENCH_VNC_WIDTH, REMMINA_BENCH_VNC_HEIGHT);
+	return REMMINA_BENCH_VNC_WIDTH * REMMINA_BENCH_VNC_HEIGHT;
+}
+
+static void remmina_bench_vnc_teardown(gpointer data)
+{
+	RemminaBenchVnc *v = data;
+
+	g_free(v->src);
+	g_free(v->dest);
+	g_free(v);
+}
+
+/* Replay of a .vnccap file made with "capture_traffic": libvncclient decodes
+ * the whole stream, every rectangle is converted as the plugin does and the
+ * area updated by each FramebufferUpdate is painted on an offscreen surface,
+ * standing in for the GTK drawing. The CPU time of each stage is reported. */
+typedef struct {
+	gchar *			filename;
+	guchar *		frame_buffer;
+	cairo_surface_t *	rgb_buffer;
+	cairo_surface_t *	screen;
+	gint			damage_x1, damage_y1, damage_x2, damage_y2;
+	guint64			frames;
+	/* Thread CPU time of the last run, in nanoseconds */
+	gint64			cpu_decode;
+	gint64			cpu_convert;
+	gint64			cpu_render;
+} RemminaBenchVncReplay;
+
+static gint64 remmina_bench_vnc_thread_cpu(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static void remmina_bench_vnc_replay_reset_damage(RemminaBenchVncReplay *r)
+{
+	r->damage_x1 = G_MAXINT;
+	r->damage_y1 = G_MAXINT;
+	r->damage_x2 = 0;
+	r->damage_y2 = 0;
+}
+
+static rfbBool remmina_bench_vnc_replay_allocfb(rfbClient *cl)
+{
+	RemminaBenchVncReplay *r = rfbClientGetClientData(cl, NULL);
+
+	r->frame_buffer = g_realloc(r->frame_buffer, cl->width * cl->height * cl->format.bitsPerPixel / 8);
+	if (r->rgb_buffer)
+		cairo_surface_destroy(r->rgb_buffer);
+	if (r->screen)
+		cairo_surface_destroy(r->screen);
+	r->rgb_buffer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, cl->width, cl->height);
+	r->screen = cairo_image_surface_create(CAIRO_FORMAT_RGB24, cl->width, cl->height);
+	remmina_bench_vnc_replay_reset_damage(r);
+	cl->frameBuffer = r->frame_buffer;
+	return TRUE;
+}
+
+static void remmina_bench_vnc_replay_updatefb(rfbClient *cl, int x, int y, int w, int h)
+{
+	RemminaBenchVncReplay *r = rfbClientGetClientData(cl, NULL);
+	gint bytesPerPixel = cl->format.bitsPerPixel / 8;
+	gint rowstride;
+	gint64 cpu;
+
+	if (w < 1 || h < 1)
+		return;
+	cpu = remmina_bench_vnc_thread_cpu();
+	r->damage_x1 = MIN(r->damage_x1, x);
+	r->damage_y1 = MIN(r->damage_y1, y);
+	r->damage_x2 = MAX(r->damage_x2, x + w);
+	r->damage_y2 = MAX(r->damage_y2, y + h);
+	rowstride = cairo_image_surface_get_stride(r->rgb_buffer);
+	cairo_surface_flush(r->rgb_buffer);
+	remmina_plugin_vnc_pixels_fill(&cl->format, cairo_image_surface_get_data(r->rgb_buffer) + y * rowstride + x * 4,
+				       rowstride, r->frame_buffer + (y * cl->width + x) * bytesPerPixel, cl->width * bytesPerPixel, NULL,
+				       w, h);
+	cairo_surface_mark_dirty(r->rgb_buffer);
+	r->cpu_convert += remmina_bench_vnc_thread_cpu() - cpu;
+}
+
+static void remmina_bench_vnc_replay_finished(rfbClient *cl)
+{
+	RemminaBenchVncReplay *r = rfbClientGetClientData(cl, NULL);
+	gint64 cpu;
+	cairo_t *cr;
+
+	r->frames++;
+	if (r->damage_x2 <= r->damage_x1 || r->damage_y2 <= r->damage_y1)
+		return;
+
+	/* What the plugin on_draw does with the queued area, unscaled */
+	cpu = remmina_bench_vnc_thread_cpu();
+	cr = cairo_create(r->screen);
+	cairo_rectangle(cr, r->damage_x1, r->damage_y1, r->damage_x2 - r->damage_x1, r->damage_y2 - r->damage_y1);
+	cairo_set_source_surface(cr, r->rgb_buffer, 0, 0);
+	cairo_fill(cr);
+	cairo_destroy(cr);
+	cairo_surface_flush(r->screen);
+	r->cpu_render += remmina_bench_vnc_thread_cpu() - cpu;
+	remmina_bench_vnc_replay_reset_damage(r);
+}
+
+/* The answers go nowhere, the capture holds the server verdict */
+static char *remmina_bench_vnc_replay_password(rfbClient *cl)
+{
+	return strdup("");
+}
+
+static rfbCredential *remmina_bench_vnc_replay_credential(rfbClient *cl, int credentialType)
+{
+	rfbCredential *cred;
+
+	if (credentialType != rfbCredentialTypeUser)
+		return NULL;
+	cred = g_new0(rfbCredential, 1);
+	cred->userCredential.username = strdup("");
+	cred->userCredential.password = strdup("");
+	return cred;
+}
+
+static gpointer remmina_bench_vnc_replay_setup(void)
+{
+	RemminaBenchVncReplay *r;
+
+	rfbEnableClientLogging = FALSE;
+	r = g_new0(RemminaBenchVncReplay, 1);
+	r->filename = g_strdup(g_getenv("REMMINA_BENCH_VNC_CAPTURE"));
+	return r;
+}
+
+static guint64 remmina_bench_vnc_replay_run(gpointer data)
+{
+	RemminaBenchVncReplay *r = data;
+	RemminaVncCapture *capture;
+	rfbClient *cl;
+	GError *error = NULL;
+	gint colordepth, quality, sock = -1;
+	gint64 cpu, convert, render;
+	rfbBool handled;
+
+	capture = remmina_vnc_capture_replay(r->filename, FALSE, &colordepth, &quality, &sock, &error);
+	if (!capture) {
+		g_printerr("%s\n", error->message);
+		exit(1);
+	}
+
+	/* rfbGetClient() arguments only matter until the format is replaced */
+	cl = rfbGetClient(8, 3, 4);
+	remmina_plugin_vnc_pixels_format(&cl->format, colordepth);
+	cl->appData.requestedDepth = colordepth;
+	cl->MallocFrameBuffer = remmina_bench_vnc_replay_allocfb;
+	cl->canHandleNewFBSize = TRUE;
+	cl->GotFrameBufferUpdate = remmina_bench_vnc_replay_updatefb;
+	cl->FinishedFrameBufferUpdate = remmina_bench_vnc_replay_finished;
+	cl->GetPassword = remmina_bench_vnc_replay_password;
+	cl->GetCredential = remmina_bench_vnc_replay_credential;
+	rfbClientSetClientData(cl, NULL, r);
+	/* Like an accepted incoming connection: rfbInitClient() does not connect */
+	cl->serverHost = strdup(r->filename);
+	cl->listenSpecified = TRUE;
+	cl->sock = sock;
+
+	r->frames = 0;
+	r->cpu_decode = 0;
+	r->cpu_convert = 0;
+	r->cpu_render = 0;
+	if (!rfbInitClient(cl, NULL, NULL)) {
+		g_printerr("%s: the RFB handshake failed\n", r->filename);
+		exit(1);
+	}
+	/* The socket is blocking, the end of the capture ends the loop.
+	 * Decoding is what HandleRFBServerMessage() spends outside the callbacks. */
+	do {
+		cpu = remmina_bench_vnc_thread_cpu();
+		convert = r->cpu_convert;
+		render = r->cpu_render;
+		handled = HandleRFBServerMessage(cl);
+		r->cpu_decode += remmina_bench_vnc_thread_cpu() - cpu - (r->cpu_convert - convert) - (r->cpu_render - render);
+	} while (handled);
+	cl->frameBuffer = NULL;
+	rfbClientCleanup(cl);
+
+	if (!remmina_vnc_capture_replay_done(capture)) {
+		g_printerr("%s could not be replayed to the end\n", r->filename);
+		exit(1);
+	}
+	remmina_vnc_capture_free(capture);
+	return r->frames;
+}
+
+/* Per stage CPU time of the last replay. The peak RSS is the whole process
+ * one, run the case alone with --filter vnc_replay to get its own. */
+static void remmina_bench_vnc_replay_metrics(gpointer data)
+{
+	RemminaBenchVncReplay *r = data;
+
+	remmina_bench_add_metric("cpu_decode_ns", r->cpu_decode);
+	remmina_bench_add_metric("cpu_convert_ns", r->cpu_convert);
+	remmina_bench_add_metric("cpu_render_ns", r->cpu_render);
+	remmina_bench_add_metric("peak_rss_kib", remmina_bench_get_peak_rss());
+}
+
+static void remmina_bench_vnc_replay_teardown(gpointer data)
+{
+	RemminaBenchVncReplay *r = data;
+
+	g_free(r->filename);
+	g_free(r->frame_buffer);
+	if (r->rgb_buffer)
+		cairo_surface_destroy(r->rgb_buffer);
+	if (r->screen)
+		cairo_surface_destroy(r->screen);
+	g_free(r);
+}
+
+static const RemminaBenchCase remmina_bench_vnc_replay_case =
+{
+	"vnc_replay", "frames", remmina_bench_vnc_replay_setup, remmina_bench_vnc_replay_run, remmina_bench_vnc_replay_teardown,
+	remmina_bench_vnc_replay_metrics
+};
+
+static const RemminaBenchCase remmina_bench_vnc_cases[] =
+{
+	{ "vnc_fill_buffer_32bpp", "pixels", remmina_bench_vnc_32_setup, remmina_bench_vnc_fill_run, remmina_bench_vnc_teardown },
+	{ "vnc_fill_buffer_16bpp", "pixels", remmina_bench_vnc_16_setup, remmina_bench_vnc_fill_run, remmina_bench_vnc_teardown },
+	{ "vnc_fill_buffer_8bpp",  "pixels", remmina_bench_vnc_8_setup,	 remmina_bench_vnc_fill_run, remmina_bench_vnc_teardown },
+};
+
+void remmina_bench_vnc_register(void)
+{
+	remmina_bench_register(remmina_bench_vnc_cases, G_N_ELEMENTS(remmina_bench_vnc_cases));
+	/* Only with a capture to replay: REMMINA_BENCH_VNC_CAPTURE=file.vnccap */
+	if (g_getenv("REMMINA_BENCH_VNC_CAPTURE"))
+		remmina_bench_register(&remmina_bench_vnc_replay_case, 1);
+}
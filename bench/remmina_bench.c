@@ -0,0 +1,336 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include "remmina_masterthread_exec.h"
+#include "remmina_bench.h"
+
+/* Defined by remmina.c, which is not part of remmina-core */
+gboolean kioskmode;
+gboolean imode;
+gboolean disablenews;
+gboolean disablestats;
+gboolean disabletoolbar;
+gboolean fullscreen;
+gboolean extrahardening;
+gboolean disabletrayicon;
+
+#define REMMINA_BENCH_MIN_ITERATIONS 3
+
+static GArray *remmina_bench_cases;
+static gchar *remmina_bench_tmpdir;
+/* Object of the case being reported, for remmina_bench_add_metric() */
+static JsonBuilder *remmina_bench_metrics_builder;
+
+static gchar *opt_filter;
+static gdouble opt_min_time = 1.0;
+static gchar *opt_output;
+static gboolean opt_list;
+
+static GOptionEntry remmina_bench_options[] =
+{
+	{ "filter",   'f', 0, G_OPTION_ARG_STRING,   &opt_filter,   "Only run the cases whose name contains one of these comma separated words", "WORDS"	},
+	{ "min-time", 't', 0, G_OPTION_ARG_DOUBLE,   &opt_min_time, "Minimum time spent timing each case, in seconds (default 1)",		      "SECONDS" },
+	{ "output",   'o', 0, G_OPTION_ARG_FILENAME, &opt_output,   "Write the JSON results to FILE instead of the standard output",		      "FILE"	},
+	{ "list",     'l', 0, G_OPTION_ARG_NONE,     &opt_list,	    "List the cases and exit",							      NULL	},
+	{ NULL }
+};
+
+void remmina_bench_register(const RemminaBenchCase *cases, gsize n)
+{
+	g_array_append_vals(remmina_bench_cases, cases, n);
+}
+
+void remmina_bench_add_metric(const gchar *name, gint64 value)
+{
+	g_return_if_fail(remmina_bench_metrics_builder != NULL);
+
+	json_builder_set_member_name(remmina_bench_metrics_builder, name);
+	json_builder_add_int_value(remmina_bench_metrics_builder, value);
+	g_printerr("%-32s %12" G_GINT64_FORMAT " %s\n", "", value, name);
+}
+
+gint64 remmina_bench_get_peak_rss(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	/* Linux and the BSDs count in KiB */
+	return usage.ru_maxrss;
+}
+
+const gchar *remmina_bench_get_tmpdir(void)
+{
+	return remmina_bench_tmpdir;
+}
+
+void remmina_bench_fill_random(guchar *data, gsize size, guint32 seed)
+{
+	guint32 x = seed ? seed : 0x9e3779b9;
+	gsize i;
+
+	/* xorshift32, only has to be cheap and repeatable */
+	for (i = 0; i < size; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		data[i] = (guchar)x;
+	}
+}
+
+static gint64 remmina_bench_clock(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static gboolean remmina_bench_selected(const RemminaBenchCase *c)
+{
+	gchar **words;
+	gboolean selected = FALSE;
+	gint i;
+
+	if (!opt_filter || !opt_filter[0])
+		return TRUE;
+	words = g_strsplit(opt_filter, ",", -1);
+	for (i = 0; words[i] && !selected; i++)
+		selected = words[i][0] && strstr(c->name, words[i]) != NULL;
+	g_strfreev(words);
+	return selected;
+}
+
+static gint remmina_bench_compare_ns(gconstpointer a, gconstpointer b)
+{
+	gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void remmina_bench_run_case(const RemminaBenchCase *c, JsonBuilder *b)
+{
+	GArray *samples;
+	gpointer data;
+	guint64 units = 0;
+	gint64 start, t, elapsed, cpu, total;
+	gint64 min_time;
+	gint64 median;
+	guint i;
+
+	data = c->setup ? c->setup() : NULL;
+	/* Warm up caches and lazy initializations */
+	c->run(data);
+
+	samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+	min_time = (gint64)(opt_min_time * 1e9);
+	cpu = remmina_bench_clock(CLOCK_PROCESS_CPUTIME_ID);
+	start = remmina_bench_clock(CLOCK_MONOTONIC);
+	elapsed = 0;
+	while (elapsed < min_time || samples->len < REMMINA_BENCH_MIN_ITERATIONS) {
+		t = remmina_bench_clock(CLOCK_MONOTONIC);
+		units = c->run(data);
+		t = remmina_bench_clock(CLOCK_MONOTONIC) - t;
+		g_array_append_val(samples, t);
+		elapsed = remmina_bench_clock(CLOCK_MONOTONIC) - start;
+	}
+	cpu = remmina_bench_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+	total = 0;
+	for (i = 0; i < samples->len; i++)
+		total += g_array_index(samples, gint64, i);
+	g_array_sort(samples, remmina_bench_compare_ns);
+	median = g_array_index(samples, gint64, samples->len / 2);
+
+	json_builder_begin_object(b);
+	json_builder_set_member_name(b, "name");
+	json_builder_add_string_value(b, c->name);
+	json_builder_set_member_name(b, "unit");
+	json_builder_add_string_value(b, c->unit);
+	json_builder_set_member_name(b, "iterations");
+	json_builder_add_int_value(b, samples->len);
+	json_builder_set_member_name(b, "units_per_iteration");
+	json_builder_add_int_value(b, (gint64)units);
+	json_builder_set_member_name(b, "ns_min");
+	json_builder_add_int_value(b, g_array_index(samples, gint64, 0));
+	json_builder_set_member_name(b, "ns_median");
+	json_builder_add_int_value(b, median);
+	json_builder_set_member_name(b, "ns_mean");
+	json_builder_add_int_value(b, total / samples->len);
+	json_builder_set_member_name(b, "cpu_ns_per_iteration");
+	json_builder_add_int_value(b, cpu / samples->len);
+	json_builder_set_member_name(b, "units_per_second");
+	json_builder_add_double_value(b, median > 0 ? (gdouble)units * 1e9 / median : 0);
+
+	g_printerr("%-32s %12.3f ms %16.0f %s/s\n", c->name, median / 1e6,
+		   median > 0 ? (gdouble)units * 1e9 / median : 0, c->unit);
+	if (c->metrics) {
+		remmina_bench_metrics_builder = b;
+		c->metrics(data);
+		remmina_bench_metrics_builder = NULL;
+	}
+	json_builder_end_object(b);
+
+	if (c->teardown)
+		c->teardown(data);
+	g_array_free(samples, TRUE);
+}
+
+static void remmina_bench_remove_tmpdir(void)
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *path;
+
+	dir = g_dir_open(remmina_bench_tmpdir, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			path = g_build_filename(remmina_bench_tmpdir, name, NULL);
+			g_unlink(path);
+			g_free(path);
+		}
+		g_dir_close(dir);
+	}
+	g_rmdir(remmina_bench_tmpdir);
+	g_free(remmina_bench_tmpdir);
+	remmina_bench_tmpdir = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	JsonBuilder *b;
+	JsonGenerator *g;
+	JsonNode *root;
+	gchar *json;
+	gchar *timestamp;
+	GDateTime *now;
+	const RemminaBenchCase *c;
+	guint i;
+	gint ret = 0;
+
+	context = g_option_context_new("- measure the hot paths of Remmina");
+	g_option_context_add_main_entries(context, remmina_bench_options, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	/* Profiles and settings are loaded as if from the main loop thread */
+	remmina_masterthread_exec_save_main_thread_id();
+
+	remmina_bench_cases = g_array_new(FALSE, FALSE, sizeof(RemminaBenchCase));
+	remmina_bench_core_register();
+#ifdef REMMINA_BENCH_VNC
+	remmina_bench_vnc_register();
+#endif
+#ifdef REMMINA_BENCH_RDP
+	remmina_bench_rdp_register();
+#endif
+
+	if (opt_list) {
+		for (i = 0; i < remmina_bench_cases->len; i++) {
+			c = &g_array_index(remmina_bench_cases, RemminaBenchCase, i);
+			g_print("%s\n", c->name);
+		}
+		g_array_free(remmina_bench_cases, TRUE);
+		return 0;
+	}
+
+	remmina_bench_tmpdir = g_dir_make_tmp("remmina-bench-XXXXXX", &error);
+	if (!remmina_bench_tmpdir) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	now = g_date_time_new_now_utc();
+	timestamp = g_date_time_format(now, "%FT%TZ");
+	g_date_time_unref(now);
+
+	b = json_builder_new();
+	json_builder_begin_object(b);
+	json_builder_set_member_name(b, "version");
+	json_builder_add_string_value(b, VERSION);
+	json_builder_set_member_name(b, "git_revision");
+	json_builder_add_string_value(b, REMMINA_GIT_REVISION);
+	json_builder_set_member_name(b, "timestamp");
+	json_builder_add_string_value(b, timestamp);
+	json_builder_set_member_name(b, "min_time");
+	json_builder_add_double_value(b, opt_min_time);
+	json_builder_set_member_name(b, "cases");
+	json_builder_begin_array(b);
+	for (i = 0; i < remmina_bench_cases->len; i++) {
+		c = &g_array_index(remmina_bench_cases, RemminaBenchCase, i);
+		if (remmina_bench_selected(c))
+			remmina_bench_run_case(c, b);
+	}
+	json_builder_end_array(b);
+	json_builder_end_object(b);
+	g_free(timestamp);
+
+	root = json_builder_get_root(b);
+	g = json_generator_new();
+	json_generator_set_pretty(g, TRUE);
+	json_generator_set_root(g, root);
+	json = json_generator_to_data(g, NULL);
+	if (opt_output) {
+		if (!g_file_set_contents(opt_output, json, -1, &error)) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			ret = 1;
+		}
+	} else {
+		g_print("%s\n", json);
+	}
+	g_free(json);
+	g_object_unref(g);
+	json_node_unref(root);
+	g_object_unref(b);
+
+	remmina_bench_remove_tmpdir();
+	g_array_free(remmina_bench_cases, TRUE);
+	return ret;
+}
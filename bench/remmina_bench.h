@@ -0,0 +1,74 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A synthetic workload. setup() builds the input once, run() is timed over
+ * and over and returns how many units it processed, teardown() releases
+ * what setup() returned. The optional metrics() is called once after the
+ * timed runs, it adds its own results with remmina_bench_add_metric(). */
+typedef struct _RemminaBenchCase {
+	const gchar *	name;
+	/* What run() counts: "bytes", "pixels", "items"… */
+	const gchar *	unit;
+	gpointer	(*setup)(void);
+	guint64		(*run)(gpointer data);
+	void		(*teardown)(gpointer data);
+	void		(*metrics)(gpointer data);
+} RemminaBenchCase;
+
+void remmina_bench_register(const RemminaBenchCase *cases, gsize n);
+/* Only from a metrics() callback */
+void remmina_bench_add_metric(const gchar *name, gint64 value);
+/* Peak resident set size of the whole process so far, in KiB */
+gint64 remmina_bench_get_peak_rss(void);
+
+/* Scratch directory removed when the bench exits */
+const gchar *remmina_bench_get_tmpdir(void);
+/* Deterministic pseudo random bytes, so every run sees the same input */
+void remmina_bench_fill_random(guchar *data, gsize size, guint32 seed);
+
+void remmina_bench_core_register(void);
+#ifdef REMMINA_BENCH_VNC
+void remmina_bench_vnc_register(void);
+#endif
+#ifdef REMMINA_BENCH_RDP
+void remmina_bench_rdp_register(void);
+#endif
+
+G_END_DECLS
@@ -37,6 +37,7 @@
 #include "rdp_plugin.h"
 #include "rdp_cliprdr.h"
 #include "rdp_event.h"
+#include "rdp_utils.h"
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/channels.h>
@@ -95,59 +96,6 @@ void remmina_rdp_cliprdr_get_target_types(UINT32 **formats, UINT16 *size, GdkAto
 	*formats = realloc(*formats, sizeof(UINT32) * (*size));
 }
 
-static UINT8 *lf2crlf(UINT8 *data, int *size)
-{
-	TRACE_CALL(__func__);
-	UINT8 c;
-	UINT8 *outbuf;
-	UINT8 *out;
-	UINT8 *in_end;
-	UINT8 *in;
-	int out_size;
-
-	out_size = (*size) * 2 + 1;
-	outbuf = (UINT8 *)malloc(out_size);
-	out = outbuf;
-	in = data;
-	in_end = data + (*size);
-
-	while (in < in_end) {
-		c = *in++;
-		if (c == '\n') {
-			*out++ = '\r';
-			*out++ = '\n';
-		} else {
-			*out++ = c;
-		}
-	}
-
-	*out++ = 0;
-	*size = out - outbuf;
-
-	return outbuf;
-}
-
-static void crlf2lf(UINT8 *data, size_t *size)
-{
-	TRACE_CALL(__func__);
-	UINT8 c;
-	UINT8 *out;
-	UINT8 *in;
-	UINT8 *in_end;
-
-	out = data;
-	in = data;
-	in_end = data + (*size);
-
-	while (in < in_end) {
-		c = *in++;
-		if (c != '\r')
-			*out++ = c;
-	}
-
-	*size = out - data;
-}
-
 /* Never used? */
 int remmina_rdp_cliprdr_server_file_contents_request(CliprdrClientContext *context, CLIPRDR_FILE_CONTENTS_REQUEST *fileContentsRequest)
 {
@@ -473,12 +421,7 @@ static UINT remmina_rdp_cliprdr_server_format_data_response(CliprdrClientContext
 		switch (rfi->clipboard.format) {
 		case CF_UNICODETEXT:
 		{
-			output =
-			g_utf16_to_utf8((const WCHAR *)data, size / sizeof(WCHAR), NULL, NULL, NULL);
-			if (output) {
-				size = strlen(output) + 1;
-				crlf2lf(output, &size);
-			}
+			output = remmina_rdp_utils_utf16_to_text(data, &size);
 			break;
 		}
 
@@ -488,7 +431,7 @@ static UINT remmina_rdp_cliprdr_server_format_data_response(CliprdrClientContext
 			output = (gpointer)calloc(1, size + 1);
 			if (output) {
 				memcpy(output, data, size);
-				crlf2lf(output, &size);
+				remmina_rdp_utils_crlf2lf(output, &size);
 			}
 			break;
 		}
@@ -807,9 +750,6 @@ void remmina_rdp_cliprdr_get_clipboard_data(RemminaProtocolWidget *gp, RemminaPl
 	GtkClipboard *gtkClipboard;
 	UINT8 *inbuf = NULL;
 	UINT8 *outbuf = NULL;
-#if FREERDP_VERSION_MAJOR >= 3
-	WCHAR *outbuf_wchar = NULL;
-#endif
 	GdkPixbuf *image = NULL;
 	size_t size = 0;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
@@ -844,24 +784,12 @@ void remmina_rdp_cliprdr_get_clipboard_data(RemminaProtocolWidget *gp, RemminaPl
 			case CB_FORMAT_HTML:
 			{
 				size = strlen((char *)inbuf);
-				outbuf = lf2crlf(inbuf, (int *) &size);
+				outbuf = remmina_rdp_utils_lf2crlf(inbuf, &size);
 				break;
 			}
 			case CF_UNICODETEXT:
 			{
-				size = strlen((const char *)inbuf);
-				inbuf = lf2crlf(inbuf, (int *) &size);
-#if FREERDP_VERSION_MAJOR >= 3
-				size_t len = 0;
-				outbuf_wchar = ConvertUtf8NToWCharAlloc((const char *)inbuf, (size_t)size, &len);
-				size = (len + 1) * sizeof(WCHAR);
-#else
-				const int rc = (ConvertToUnicode(CP_UTF8, 0, (CHAR *)inbuf, -1, (WCHAR **)&outbuf, 0)) * sizeof(WCHAR);
-				size = 0;
-				if (rc >= 0) {
-					size = (size_t)rc;
-				}
-#endif
+				outbuf = remmina_rdp_utils_text_to_utf16((const gchar *)inbuf, &size);
 				g_free(inbuf);
 				break;
 			}
@@ -911,17 +839,7 @@ void remmina_rdp_cliprdr_get_clipboard_data(RemminaProtocolWidget *gp, RemminaPl
 	rdp_event.type = REMMINA_RDP_EVENT_TYPE_CLIPBOARD_SEND_CLIENT_FORMAT_DATA_RESPONSE;
 	rdp_event.clipboard_formatdataresponse.size = (int)MIN(size, INT32_MAX);
 
-#if FREERDP_VERSION_MAJOR >= 3
-	// For unicode, use the wchar buffer
-	if (outbuf == NULL && outbuf_wchar != NULL) {
-		rdp_event.clipboard_formatdataresponse.data = (unsigned char *)outbuf_wchar;
-	}
-	else {
-		rdp_event.clipboard_formatdataresponse.data = (unsigned char *)outbuf;
-	}
-#else
 	rdp_event.clipboard_formatdataresponse.data = (unsigned char *)outbuf;
-#endif
 
 	remmina_rdp_event_event_push(gp, &rdp_event);
 }
@@ -0,0 +1,187 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "rdp_plugin.h"
+#include "rdp_devices.h"
+
+#include <gio/gio.h>
+#ifdef HAVE_CUPS
+#include <cups/cups.h>
+#endif
+
+/**
+ * @file rdp_devices.c
+ * Enumerating the CUPS printers can take up to the whole cupsEnumDests()
+ * timeout when network printers are around, so it is done once for all the
+ * sessions on a background thread. Connections only copy the last result.
+ * The cache is refreshed when the CUPS configuration or the network changes,
+ * and anyway after RDP_DEVICES_TTL_US, for printers discovered on the network.
+ *
+ * Smartcard readers and drives are not enumerated: the profile names them.
+ */
+
+#define RDP_DEVICES_TTL_US (300 * G_USEC_PER_SEC)
+#define RDP_DEVICES_CUPS_CONF_DIR "/etc/cups"
+
+static pthread_mutex_t devices_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t devices_cond = PTHREAD_COND_INITIALIZER;
+static GPtrArray *devices_printers = NULL;
+static gint64 devices_refreshed = 0;
+static gboolean devices_stale = TRUE;
+static gboolean devices_refreshing = FALSE;
+static GFileMonitor *devices_cups_monitor = NULL;
+
+#ifdef HAVE_CUPS
+static int remmina_rdp_devices_add_printer(void *user_data, unsigned flags, cups_dest_t *dest)
+{
+	GPtrArray *printers = (GPtrArray *)user_data;
+
+	if (dest->name)
+		g_ptr_array_add(printers, g_strdup(dest->name));
+	return 1;
+}
+#endif
+
+static gpointer remmina_rdp_devices_refresh_thread(gpointer data)
+{
+	TRACE_CALL(__func__);
+	GPtrArray *printers;
+
+	printers = g_ptr_array_new_with_free_func(g_free);
+#ifdef HAVE_CUPS
+	cupsEnumDests(CUPS_DEST_FLAGS_NONE, 1000, NULL, 0, 0, remmina_rdp_devices_add_printer, printers);
+#endif
+	REMMINA_PLUGIN_DEBUG("%u local printers found", printers->len);
+
+	pthread_mutex_lock(&devices_mutex);
+	if (devices_printers)
+		g_ptr_array_unref(devices_printers);
+	devices_printers = printers;
+	devices_refreshed = g_get_monotonic_time();
+	devices_refreshing = FALSE;
+	pthread_cond_broadcast(&devices_cond);
+	pthread_mutex_unlock(&devices_mutex);
+
+	return NULL;
+}
+
+/* devices_mutex must be held */
+static void remmina_rdp_devices_refresh_locked(void)
+{
+	GThread *t;
+
+	if (devices_refreshing)
+		return;
+	devices_refreshing = TRUE;
+	devices_stale = FALSE;
+	t = g_thread_new("remmina_rdp_devices", remmina_rdp_devices_refresh_thread, NULL);
+	g_thread_unref(t);
+}
+
+static void remmina_rdp_devices_invalidate(void)
+{
+	TRACE_CALL(__func__);
+	pthread_mutex_lock(&devices_mutex);
+	devices_stale = TRUE;
+	remmina_rdp_devices_refresh_locked();
+	pthread_mutex_unlock(&devices_mutex);
+}
+
+static void remmina_rdp_devices_cups_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+					     GFileMonitorEvent event_type, gpointer user_data)
+{
+	if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT || event_type == G_FILE_MONITOR_EVENT_CREATED ||
+	    event_type == G_FILE_MONITOR_EVENT_DELETED) {
+		REMMINA_PLUGIN_DEBUG("CUPS configuration changed, refreshing printers");
+		remmina_rdp_devices_invalidate();
+	}
+}
+
+static void remmina_rdp_devices_network_changed(GNetworkMonitor *monitor, gboolean available, gpointer user_data)
+{
+	remmina_rdp_devices_invalidate();
+}
+
+/**
+ * Start the first enumeration in the background and watch for device
+ * changes. Must be called from the main thread, the notifications are
+ * delivered by the main loop.
+ */
+void remmina_rdp_devices_init(void)
+{
+	TRACE_CALL(__func__);
+
+	if (devices_cups_monitor)
+		return;
+
+#ifdef HAVE_CUPS
+	GFile *dir = g_file_new_for_path(RDP_DEVICES_CUPS_CONF_DIR);
+	devices_cups_monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(dir);
+	if (devices_cups_monitor)
+		g_signal_connect(devices_cups_monitor, "changed", G_CALLBACK(remmina_rdp_devices_cups_changed), NULL);
+	g_signal_connect(g_network_monitor_get_default(), "network-changed",
+			 G_CALLBACK(remmina_rdp_devices_network_changed), NULL);
+
+	/* Enumerate now, so the first connection finds the list ready */
+	pthread_mutex_lock(&devices_mutex);
+	remmina_rdp_devices_refresh_locked();
+	pthread_mutex_unlock(&devices_mutex);
+#endif
+}
+
+/**
+ * The printers of the last enumeration. Only the very first call waits for
+ * the enumeration, later ones get the cached list while a stale cache is
+ * refreshed in the background.
+ */
+GPtrArray *remmina_rdp_devices_get_printers(void)
+{
+	TRACE_CALL(__func__);
+	GPtrArray *printers;
+	guint i;
+
+	pthread_mutex_lock(&devices_mutex);
+	if (devices_stale || g_get_monotonic_time() - devices_refreshed > RDP_DEVICES_TTL_US)
+		remmina_rdp_devices_refresh_locked();
+	while (devices_printers == NULL)
+		pthread_cond_wait(&devices_cond, &devices_mutex);
+
+	printers = g_ptr_array_new_full(devices_printers->len, g_free);
+	for (i = 0; i < devices_printers->len; i++)
+		g_ptr_array_add(printers, g_strdup(g_ptr_array_index(devices_printers, i)));
+	pthread_mutex_unlock(&devices_mutex);
+
+	return printers;
+}
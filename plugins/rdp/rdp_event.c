@@ -39,8 +39,10 @@
 
 #include "rdp_cliprdr.h"
 #include "rdp_event.h"
+#include "rdp_graphics.h"
 #include "rdp_monitor.h"
 #include "rdp_settings.h"
+#include "rdp_utils.h"
 #include <gdk/gdkkeysyms.h>
 #ifdef GDK_WINDOWING_X11
 #include <cairo/cairo-xlib.h>
@@ -49,56 +51,109 @@
 #endif
 #include <freerdp/locale/keyboard.h>
 
-gboolean remmina_rdp_event_on_map(RemminaProtocolWidget *gp)
+/* A hidden session is refreshed every RDP_HIDDEN_REFRESH_MS, for RDP_HIDDEN_REFRESH_LEN_MS */
+#define RDP_HIDDEN_REFRESH_MS 10000
+#define RDP_HIDDEN_REFRESH_LEN_MS 1000
+
+static gboolean remmina_rdp_event_can_suppress_output(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
-	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	rdpGdi *gdi;
-
-	if (rfi == NULL)
-		return false;
-
 	RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	int do_suppress = !remmina_plugin_service->file_get_int(remminafile, "no-suppress", FALSE);
+	GtkWidget *toplevel;
+	GdkWindow *window;
 
-	if (do_suppress) {
-		gdi = ((rdpContext *)rfi)->gdi;
+	if (remmina_plugin_service->file_get_int(remminafile, "no-suppress", FALSE))
+		return FALSE;
 
-		REMMINA_PLUGIN_DEBUG("Map event received, disabling TS_SUPPRESS_OUTPUT_PDU ");
-		gdi_send_suppress_output(gdi, FALSE);
+	/* A recording wants every update, not one every RDP_HIDDEN_REFRESH_MS */
+	if (remmina_plugin_service->protocol_widget_is_recording(gp))
+		return FALSE;
+
+	toplevel = gtk_widget_get_toplevel(GTK_WIDGET(gp));
+	window = gtk_widget_get_window(toplevel);
+	if (window && gdk_window_get_fullscreen_mode(window) == GDK_FULLSCREEN_ON_ALL_MONITORS) {
+		REMMINA_PLUGIN_DEBUG("Cannot enable TS_SUPPRESS_OUTPUT_PDU when in fullscreen");
+		return FALSE;
 	}
+	return TRUE;
+}
 
-	return FALSE;
+static gboolean remmina_rdp_event_hidden_resuppress(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	rfi->hidden_resuppress_handler = 0;
+	if (rfi->hidden && rfi->connected && !rfi->is_reconnecting)
+		gdi_send_suppress_output(((rdpContext *)rfi)->gdi, TRUE);
+	return G_SOURCE_REMOVE;
 }
 
-gboolean remmina_rdp_event_on_unmap(RemminaProtocolWidget *gp)
+/* Let a hidden session update for a moment, enough for an up to date thumbnail */
+static gboolean remmina_rdp_event_hidden_refresh(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	rdpGdi *gdi;
 
-	if (rfi == NULL)
-		return false;
+	if (!rfi->connected || rfi->is_reconnecting || rfi->hidden_resuppress_handler)
+		return G_SOURCE_CONTINUE;
 
-	GtkWidget *toplevel = gtk_widget_get_toplevel(GTK_WIDGET(gp));
-	GdkWindow *window = gtk_widget_get_window(toplevel);
+	gdi_send_suppress_output(((rdpContext *)rfi)->gdi, FALSE);
+	rfi->hidden_resuppress_handler = g_timeout_add(RDP_HIDDEN_REFRESH_LEN_MS,
+						       (GSourceFunc)remmina_rdp_event_hidden_resuppress, gp);
+	return G_SOURCE_CONTINUE;
+}
 
-	if (gdk_window_get_fullscreen_mode(window) == GDK_FULLSCREEN_ON_ALL_MONITORS) {
-		REMMINA_PLUGIN_DEBUG("Unmap event received, but cannot enable TS_SUPPRESS_OUTPUT_PDU when in fullscreen");
-		return FALSE;
+static void remmina_rdp_event_stop_hidden_refresh(rfContext *rfi)
+{
+	if (rfi->hidden_refresh_handler) {
+		g_source_remove(rfi->hidden_refresh_handler);
+		rfi->hidden_refresh_handler = 0;
+	}
+	if (rfi->hidden_resuppress_handler) {
+		g_source_remove(rfi->hidden_resuppress_handler);
+		rfi->hidden_resuppress_handler = 0;
 	}
+}
 
-	RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	int do_suppress = !remmina_plugin_service->file_get_int(remminafile, "no-suppress", FALSE);
+static void remmina_rdp_event_apply_visibility(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+	rdpGdi *gdi = ((rdpContext *)rfi)->gdi;
 
-	if (do_suppress) {
-		gdi = ((rdpContext *)rfi)->gdi;
+	remmina_rdp_event_stop_hidden_refresh(rfi);
+	if (!remmina_rdp_event_can_suppress_output(gp)) {
+		/* It may have been suppressed before a recording started */
+		if (rfi->hidden)
+			gdi_send_suppress_output(gdi, FALSE);
+		return;
+	}
 
-		REMMINA_PLUGIN_DEBUG("Unmap event received, enabling TS_SUPPRESS_OUTPUT_PDU ");
+	if (rfi->hidden) {
+		REMMINA_PLUGIN_DEBUG("Session hidden, enabling TS_SUPPRESS_OUTPUT_PDU");
 		gdi_send_suppress_output(gdi, TRUE);
+		rfi->hidden_refresh_handler = g_timeout_add(RDP_HIDDEN_REFRESH_MS,
+							    (GSourceFunc)remmina_rdp_event_hidden_refresh, gp);
+	} else {
+		/* The server answers with one full screen update */
+		REMMINA_PLUGIN_DEBUG("Session visible, disabling TS_SUPPRESS_OUTPUT_PDU");
+		gdi_send_suppress_output(gdi, FALSE);
 	}
+}
 
-	return FALSE;
+void remmina_rdp_event_on_visibility(RemminaProtocolWidget *gp, gboolean visible)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	if (rfi == NULL)
+		return;
+
+	rfi->hidden = !visible;
+	/* Applied by remmina_rdp_event_connected() when not connected yet */
+	if (rfi->connected && !rfi->is_reconnecting)
+		remmina_rdp_event_apply_visibility(gp);
 }
 
 static gboolean remmina_rdp_event_on_focus_in(GtkWidget *widget, GdkEventKey *event, RemminaProtocolWidget *gp)
@@ -159,6 +214,14 @@ void remmina_rdp_event_event_push(RemminaProtocolWidget *gp, const RemminaPlugin
 		return;
 
 	if (rfi->event_queue) {
+		if (e->type == REMMINA_RDP_EVENT_TYPE_SCANCODE ||
+		    e->type == REMMINA_RDP_EVENT_TYPE_SCANCODE_UNICODE ||
+		    e->type == REMMINA_RDP_EVENT_TYPE_MOUSE) {
+			pthread_mutex_lock(&rfi->input_pending_mutex);
+			if (rfi->input_pending_since == 0)
+				rfi->input_pending_since = g_get_monotonic_time();
+			pthread_mutex_unlock(&rfi->input_pending_mutex);
+		}
 #if GLIB_CHECK_VERSION(2,67,3)
 		event = g_memdup2(e, sizeof(RemminaPluginRdpEvent));
 #else
@@ -238,7 +301,6 @@ static void remmina_rdp_event_scale_area(RemminaProtocolWidget *gp, gint *x, gin
 {
 	TRACE_CALL(__func__);
 	gint width, height;
-	gint sx, sy, sw, sh;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
 	if (!rfi || !rfi->connected || rfi->is_reconnecting || !rfi->surface)
@@ -250,33 +312,7 @@ static void remmina_rdp_event_scale_area(RemminaProtocolWidget *gp, gint *x, gin
 	if ((width == 0) || (height == 0))
 		return;
 
-	if ((rfi->scale_width == width) && (rfi->scale_height == height)) {
-		/* Same size, just copy the pixels */
-		*x = MIN(MAX(0, *x), width - 1);
-		*y = MIN(MAX(0, *y), height - 1);
-		*w = MIN(width - *x, *w);
-		*h = MIN(height - *y, *h);
-		return;
-	}
-
-	/* We have to extend the scaled region one scaled pixel, to avoid gaps */
-
-	sx = MIN(MAX(0, (*x) * rfi->scale_width / width
-		     - rfi->scale_width / width - 2), rfi->scale_width - 1);
-
-	sy = MIN(MAX(0, (*y) * rfi->scale_height / height
-		     - rfi->scale_height / height - 2), rfi->scale_height - 1);
-
-	sw = MIN(rfi->scale_width - sx, (*w) * rfi->scale_width / width
-		 + rfi->scale_width / width + 4);
-
-	sh = MIN(rfi->scale_height - sy, (*h) * rfi->scale_height / height
-		 + rfi->scale_height / height + 4);
-
-	*x = sx;
-	*y = sy;
-	*w = sw;
-	*h = sh;
+	remmina_rdp_utils_scale_area(width, height, rfi->scale_width, rfi->scale_height, x, y, w, h);
 }
 
 void remmina_rdp_event_update_regions(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *ui)
@@ -291,6 +327,7 @@ void remmina_rdp_event_update_regions(RemminaProtocolWidget *gp, RemminaPluginRd
 		w = ui->reg.ureg[i].w;
 		h = ui->reg.ureg[i].h;
 
+		remmina_plugin_service->protocol_widget_damage(gp, x, y, w, h);
 		if (rfi->scale == REMMINA_PROTOCOL_WIDGET_SCALE_MODE_SCALED)
 			remmina_rdp_event_scale_area(gp, &x, &y, &w, &h);
 
@@ -304,6 +341,7 @@ void remmina_rdp_event_update_rect(RemminaProtocolWidget *gp, gint x, gint y, gi
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
+	remmina_plugin_service->protocol_widget_damage(gp, x, y, w, h);
 	if (rfi->scale == REMMINA_PROTOCOL_WIDGET_SCALE_MODE_SCALED)
 		remmina_rdp_event_scale_area(gp, &x, &y, &w, &h);
 
@@ -562,11 +600,9 @@ static void remmina_rdp_event_reverse_translate_pos_reverse(RemminaProtocolWidge
 void remmina_rdp_mouse_jitter(RemminaProtocolWidget *gp){
 	TRACE_CALL(__func__);
 	RemminaPluginRdpEvent rdp_event = { 0 };
-	RemminaFile *remminafile;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (rfi->viewonly)
 		return;
 
 	rdp_event.type = REMMINA_RDP_EVENT_TYPE_MOUSE;
@@ -581,11 +617,9 @@ void remmina_rdp_mouse_jitter(RemminaProtocolWidget *gp){
 void remmina_rdp_idle_keypress(RemminaProtocolWidget *gp, int *keypress_opts){
 	TRACE_CALL(__func__);
 	guint keys[2] = { 0, 0 };
-	RemminaFile *remminafile;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (rfi->viewonly)
 		return;
 	
 	if (*keypress_opts == 0)
@@ -612,11 +646,9 @@ static gboolean remmina_rdp_event_on_motion(GtkWidget *widget, GdkEventMotion *e
 {
 	TRACE_CALL(__func__);
 	RemminaPluginRdpEvent rdp_event = { 0 };
-	RemminaFile *remminafile;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (!rfi || rfi->viewonly)
 		return FALSE;
 
 	rdp_event.type = REMMINA_RDP_EVENT_TYPE_MOUSE;
@@ -641,12 +673,13 @@ static gboolean remmina_rdp_event_on_button(GtkWidget *widget, GdkEventButton *e
 	gboolean extended = FALSE;
 	RemminaPluginRdpEvent rdp_event = { 0 };
 	gint primary, secondary;
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
 	RemminaFile *remminafile;
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (!rfi || rfi->viewonly)
 		return FALSE;
+	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 
 	/* We bypass 2button-press and 3button-press events */
 	if ((event->type != GDK_BUTTON_PRESS) && (event->type != GDK_BUTTON_RELEASE))
@@ -711,10 +744,9 @@ static gboolean remmina_rdp_event_on_scroll(GtkWidget *widget, GdkEventScroll *e
 	gint flag;
 	RemminaPluginRdpEvent rdp_event = { 0 };
 	float windows_delta;
-	RemminaFile *remminafile;
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (!rfi || rfi->viewonly)
 		return FALSE;
 
 	flag = 0;
@@ -808,23 +840,86 @@ static void remmina_rdp_event_init_keymap(rfContext *rfi, const gchar *strmap)
 	}
 }
 
+/* Hardware keycode to RDP scancode, the slow way */
+static DWORD remmina_rdp_event_keycode_to_scancode(rfContext *rfi, guint16 keycode)
+{
+	TRACE_CALL(__func__);
+#if FREERDP_CHECK_VERSION(3, 11, 0)
+	guint32 keyboard_type = freerdp_settings_get_uint32(rfi->clientContext.context.settings, FreeRDP_KeyboardType);
+	if (keyboard_type == 0){
+		keyboard_type = WINPR_KBD_TYPE_IBM_ENHANCED;
+	}
+#ifdef GDK_WINDOWING_X11
+	DWORD vc = GetVirtualKeyCodeFromKeycode(keycode, WINPR_KEYCODE_TYPE_XKB);
+#else
+	DWORD vc = GetVirtualKeyCodeFromKeycode(keycode, WINPR_KEYCODE_TYPE_EVDEV);
+#endif
+	const DWORD sc = GetVirtualScanCodeFromVirtualKeyCode(vc, keyboard_type);
+	return freerdp_keyboard_remap_key(rfi->remap_table, sc);
+#else
+	return freerdp_keyboard_get_rdp_scancode_from_x11_keycode(keycode);
+#endif
+}
+
+/* Apply rdp_map_keycode, which is ignored with the client keyboard mapping */
+static guint16 remmina_rdp_event_remap_keycode(rfContext *rfi, guint16 keycode)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginRdpKeymapEntry *kep;
+	guint ik;
+
+	if (rfi->use_client_keymap || !rfi->keymap)
+		return keycode;
+	for (ik = 0; ik < rfi->keymap->len; ik++) {
+		kep = &g_array_index(rfi->keymap, RemminaPluginRdpKeymapEntry, ik);
+		if (keycode == kep->orig_keycode)
+			return kep->translated_keycode;
+	}
+	return keycode;
+}
+
+static void remmina_rdp_event_build_keycode_scancodes(rfContext *rfi)
+{
+	TRACE_CALL(__func__);
+	guint keycode;
+
+	for (keycode = 0; keycode < G_N_ELEMENTS(rfi->keycode_scancodes); keycode++)
+		rfi->keycode_scancodes[keycode] =
+			remmina_rdp_event_keycode_to_scancode(rfi, remmina_rdp_event_remap_keycode(rfi, keycode));
+	rfi->keycode_scancodes_valid = TRUE;
+}
+
+static DWORD remmina_rdp_event_get_scancode(rfContext *rfi, guint16 keycode)
+{
+	TRACE_CALL(__func__);
+	if (keycode < G_N_ELEMENTS(rfi->keycode_scancodes)) {
+		if (!rfi->keycode_scancodes_valid)
+			remmina_rdp_event_build_keycode_scancodes(rfi);
+		return rfi->keycode_scancodes[keycode];
+	}
+	/* Out of the table, only possible with some evdev keycodes */
+	return remmina_rdp_event_keycode_to_scancode(rfi, remmina_rdp_event_remap_keycode(rfi, keycode));
+}
+
+static void remmina_rdp_event_on_keys_changed(GdkKeymap *keymap, RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	/* Rebuilt on the next key event */
+	if (rfi)
+		rfi->keycode_scancodes_valid = FALSE;
+}
+
 static gboolean remmina_rdp_event_on_key(GtkWidget *widget, GdkEventKey *event, RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	guint32 unicode_keyval;
-	guint16 hardware_keycode;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	RemminaPluginRdpEvent rdp_event;
-	RemminaPluginRdpKeymapEntry *kep;
-	RemminaFile *remminafile;
-	DWORD scancode = 0;
-	int ik;
-
-	if (!rfi || !rfi->connected || rfi->is_reconnecting)
-		return FALSE;
+	DWORD scancode;
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	if (remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE))
+	if (!rfi || !rfi->connected || rfi->is_reconnecting || rfi->viewonly)
 		return FALSE;
 
 #ifdef ENABLE_GTK_INSPECTOR_KEY
@@ -866,32 +961,8 @@ static gboolean remmina_rdp_event_on_key(GtkWidget *widget, GdkEventKey *event,
 		break;
 
 	default:
+		scancode = remmina_rdp_event_get_scancode(rfi, event->hardware_keycode);
 		if (!rfi->use_client_keymap) {
-			hardware_keycode = event->hardware_keycode;
-			if (rfi->keymap) {
-				for (ik = 0; ik < rfi->keymap->len; ik++) {
-					kep = &g_array_index(rfi->keymap, RemminaPluginRdpKeymapEntry, ik);
-					if (hardware_keycode == kep->orig_keycode) {
-						hardware_keycode = kep->translated_keycode;
-						break;
-					}
-				}
-			}
-#if FREERDP_CHECK_VERSION(3, 11, 0)			
-			guint32 keyboard_type = freerdp_settings_get_uint32(rfi->clientContext.context.settings, FreeRDP_KeyboardType);
-			if (keyboard_type == 0){
-				keyboard_type = WINPR_KBD_TYPE_IBM_ENHANCED;
-			}
-#ifdef GDK_WINDOWING_X11
-			DWORD vc = GetVirtualKeyCodeFromKeycode(hardware_keycode, WINPR_KEYCODE_TYPE_XKB);
-#else
-			DWORD vc = GetVirtualKeyCodeFromKeycode(hardware_keycode, WINPR_KEYCODE_TYPE_EVDEV);
-#endif
-			const DWORD sc = GetVirtualScanCodeFromVirtualKeyCode(vc, keyboard_type); 
-			DWORD scancode = freerdp_keyboard_remap_key(rfi->remap_table, sc);
-#else
-			scancode = freerdp_keyboard_get_rdp_scancode_from_x11_keycode(hardware_keycode);
-#endif
 			if (scancode) {
 				rdp_event.key_event.key_code = scancode & 0xFF;
 				rdp_event.key_event.extended = scancode & 0x100;
@@ -900,7 +971,6 @@ static gboolean remmina_rdp_event_on_key(GtkWidget *widget, GdkEventKey *event,
 				keypress_list_add(gp, rdp_event);
 			}
 		} else {
-			hardware_keycode = event->hardware_keycode;
 			unicode_keyval = gdk_keyval_to_unicode(event->keyval);
 			/* Decide when whe should send a keycode or a Unicode character.
 			 * - All non char keys (Shift, Alt, Super) should be sent as keycode
@@ -915,22 +985,6 @@ static gboolean remmina_rdp_event_on_key(GtkWidget *widget, GdkEventKey *event,
 			    unicode_keyval == 0 ||                                                      // Impossible to translate
 			    (event->state & (GDK_MOD1_MASK | GDK_CONTROL_MASK | GDK_SUPER_MASK)) != 0   // A modifier not recognized by gdk_keyval_to_unicode()
 			    ) {
-#if FREERDP_CHECK_VERSION(3, 11, 0)
-
-				guint32 keyboard_type = freerdp_settings_get_uint32(rfi->clientContext.context.settings, FreeRDP_KeyboardType);
-				if (keyboard_type == 0){
-					keyboard_type = WINPR_KBD_TYPE_IBM_ENHANCED;
-				}
-#ifdef GDK_WINDOWING_X11
-				DWORD vc = GetVirtualKeyCodeFromKeycode(hardware_keycode, WINPR_KEYCODE_TYPE_XKB);
-#else
-				DWORD vc = GetVirtualKeyCodeFromKeycode(hardware_keycode, WINPR_KEYCODE_TYPE_EVDEV);
-#endif
-				const DWORD sc = GetVirtualScanCodeFromVirtualKeyCode(vc, keyboard_type); 
-				DWORD scancode = freerdp_keyboard_remap_key(rfi->remap_table, sc);
-#else
-				scancode = freerdp_keyboard_get_rdp_scancode_from_x11_keycode(event->hardware_keycode);
-#endif
 				rdp_event.key_event.key_code = scancode & 0xFF;
 				rdp_event.key_event.extended = scancode & 0x100;
 				rdp_event.key_event.extended1 = FALSE;
@@ -1000,6 +1054,7 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	GtkClipboard *clipboard;
 	RemminaFile *remminafile;
+	pthread_mutexattr_t attr;
 
 	gboolean disable_smooth_scrolling = FALSE;
 
@@ -1038,7 +1093,14 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 	g_free(s), s = NULL;
 
 	/* Read special keymap from profile file, if exists */
-	remmina_rdp_event_init_keymap(rfi, remmina_plugin_service->pref_get_value("rdp_map_keycode"));
+	s = remmina_plugin_service->pref_get_value("rdp_map_keycode");
+	remmina_rdp_event_init_keymap(rfi, s);
+	g_free(s), s = NULL;
+	rfi->keycode_scancodes_valid = FALSE;
+	rfi->keys_changed_handler = g_signal_connect(gdk_keymap_get_for_display(gtk_widget_get_display(rfi->drawing_area)),
+						     "keys-changed", G_CALLBACK(remmina_rdp_event_on_keys_changed), gp);
+
+	rfi->viewonly = remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE);
 
 	if (rfi->use_client_keymap && rfi->keymap)
 		fprintf(stderr, "RDP profile error: you cannot define both rdp_map_hardware_keycode and have 'Use client keyboard mapping' enabled\n");
@@ -1061,17 +1123,6 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 			 G_CALLBACK(remmina_rdp_event_on_key), gp);
 	g_signal_connect(G_OBJECT(rfi->drawing_area), "focus-in-event",
 			 G_CALLBACK(remmina_rdp_event_on_focus_in), gp);
-	/** Fixme: This comment
-	 * needed for TS_SUPPRESS_OUTPUT_PDU
-	 * But it works only when we stay in the same window mode, if we switch to
-	 * fullscreen, for instance, the object reference is lost, so we loose these
-	 * events.
-	 */
-	//g_signal_connect(G_OBJECT(gtk_widget_get_toplevel(rfi->drawing_area)), "map-event",
-	// G_CALLBACK(remmina_rdp_event_on_map), gp);
-	//g_signal_connect(G_OBJECT(gtk_widget_get_toplevel(rfi->drawing_area)), "unmap-event",
-	// G_CALLBACK(remmina_rdp_event_on_unmap), gp);
-
 	if (!remmina_plugin_service->file_get_int(remminafile, "disableclipboard", FALSE)) {
 		clipboard = gtk_widget_get_clipboard(rfi->drawing_area, GDK_SELECTION_CLIPBOARD);
 		rfi->clipboard.clipboard_handler = g_signal_connect(clipboard, "owner-change", G_CALLBACK(remmina_rdp_event_on_clipboard), gp);
@@ -1081,6 +1132,13 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 	rfi->event_queue = g_async_queue_new_full(g_free);
 	rfi->ui_queue = g_async_queue_new();
 	pthread_mutex_init(&rfi->ui_queue_mutex, NULL);
+	pthread_mutex_init(&rfi->input_pending_mutex, NULL);
+	/* Paints may nest */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&rfi->paint_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	rfi->fb_damage = cairo_region_create();
 
 	if (pipe(rfi->event_pipe)) {
 		g_print("Error creating pipes.\n");
@@ -1117,6 +1175,11 @@ void remmina_rdp_event_free_event(RemminaPluginRdpUiObject *obj)
 		free(obj->nocodec.bitmap);
 		break;
 
+	case REMMINA_RDP_UI_CURSOR:
+		if (obj->cursor.type == REMMINA_RDP_POINTER_SET && obj->cursor.shape)
+			remmina_rdp_cursor_unref(obj->cursor.shape);
+		break;
+
 	default:
 		break;
 	}
@@ -1137,10 +1200,16 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 		g_signal_handler_disconnect(G_OBJECT(gtk_widget_get_clipboard(rfi->drawing_area, GDK_SELECTION_CLIPBOARD)), rfi->clipboard.clipboard_handler);
 		rfi->clipboard.clipboard_handler = 0;
 	}
+	if (rfi->keys_changed_handler) {
+		g_signal_handler_disconnect(gdk_keymap_get_for_display(gtk_widget_get_display(rfi->drawing_area)),
+					    rfi->keys_changed_handler);
+		rfi->keys_changed_handler = 0;
+	}
 	if (rfi->delayed_monitor_layout_handler) {
 		g_source_remove(rfi->delayed_monitor_layout_handler);
 		rfi->delayed_monitor_layout_handler = 0;
 	}
+	remmina_rdp_event_stop_hidden_refresh(rfi);
 	if (rfi->ui_handler) {
 		g_source_remove(rfi->ui_handler);
 		rfi->ui_handler = 0;
@@ -1152,6 +1221,12 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 		cairo_surface_destroy(rfi->surface);
 		rfi->surface = NULL;
 	}
+	if (rfi->fb_snapshot) {
+		cairo_surface_destroy(rfi->fb_snapshot);
+		rfi->fb_snapshot = NULL;
+	}
+	cairo_region_destroy(rfi->fb_damage);
+	rfi->fb_damage = NULL;
 
 	g_hash_table_destroy(rfi->object_table);
 
@@ -1165,6 +1240,8 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 	g_async_queue_unref(rfi->ui_queue);
 	rfi->ui_queue = NULL;
 	pthread_mutex_destroy(&rfi->ui_queue_mutex);
+	pthread_mutex_destroy(&rfi->input_pending_mutex);
+	pthread_mutex_destroy(&rfi->paint_mutex);
 
 	if (rfi->event_handle) {
 		CloseHandle(rfi->event_handle);
@@ -1196,6 +1273,12 @@ static void remmina_rdp_event_create_cairo_surface(rfContext *rfi)
 	stride = cairo_format_stride_for_width(rfi->cairo_format, gdi->width);
 	rfi->surface = cairo_image_surface_create_for_data((unsigned char *)gdi->primary_buffer, rfi->cairo_format, gdi->width, gdi->height, stride);
 	cairo_surface_flush(rfi->surface);
+
+	/* New primary_buffer, the next get_framebuffer copies all of it */
+	if (rfi->fb_snapshot) {
+		cairo_surface_destroy(rfi->fb_snapshot);
+		rfi->fb_snapshot = NULL;
+	}
 }
 
 void remmina_rdp_event_update_scale(RemminaProtocolWidget *gp)
@@ -1259,7 +1342,13 @@ static void remmina_rdp_event_connected(RemminaProtocolWidget *gp, RemminaPlugin
 
 	remmina_rdp_event_update_scale(gp);
 
+	/* The keyboard settings of the session are final now */
+	remmina_rdp_event_build_keycode_scancodes(rfi);
+
 	remmina_plugin_service->protocol_plugin_signal_connection_opened(gp);
+
+	if (rfi->hidden)
+		remmina_rdp_event_apply_visibility(gp);
 	const gchar *host = freerdp_settings_get_string (rfi->clientContext.context.settings, FreeRDP_ServerHostname);
 	// TRANSLATORS: the placeholder may be either an IP/FQDN or a server hostname
 	REMMINA_PLUGIN_AUDIT(_("Connected to %s via RDP"), host);
@@ -1273,44 +1362,6 @@ static void remmina_rdp_event_reconnect_progress(RemminaProtocolWidget *gp, Remm
 	gdk_window_invalidate_rect(gtk_widget_get_window(rfi->drawing_area), NULL, TRUE);
 }
 
-static BOOL remmina_rdp_event_create_cursor(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *ui)
-{
-	TRACE_CALL(__func__);
-	GdkPixbuf *pixbuf;
-	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	rdpPointer *pointer = (rdpPointer *)ui->cursor.pointer;
-	cairo_surface_t *surface;
-	UINT8 *data = malloc(pointer->width * pointer->height * 4);
-
-	if (!freerdp_image_copy_from_pointer_data(
-		    (BYTE *)data, PIXEL_FORMAT_BGRA32,
-		    pointer->width * 4, 0, 0, pointer->width, pointer->height,
-		    pointer->xorMaskData, pointer->lengthXorMask,
-		    pointer->andMaskData, pointer->lengthAndMask,
-		    pointer->xorBpp, &(ui->cursor.context->gdi->palette))) {
-		free(data);
-		return FALSE;
-	}
-
-	surface = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, pointer->width, pointer->height, cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, pointer->width));
-	cairo_surface_flush(surface);
-	pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, pointer->width, pointer->height);
-	cairo_surface_mark_dirty(surface);
-	cairo_surface_destroy(surface);
-	free(data);
-	((rfPointer *)ui->cursor.pointer)->cursor = gdk_cursor_new_from_pixbuf(rfi->display, pixbuf, pointer->xPos, pointer->yPos);
-	g_object_unref(pixbuf);
-
-	return TRUE;
-}
-
-static void remmina_rdp_event_free_cursor(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *ui)
-{
-	TRACE_CALL(__func__);
-	g_object_unref(ui->cursor.pointer->cursor);
-	ui->cursor.pointer->cursor = NULL;
-}
-
 static BOOL remmina_rdp_event_set_pointer_position(RemminaProtocolWidget *gp, gint x, gint y)
 {
 	TRACE_CALL(__func__);
@@ -1355,21 +1406,14 @@ static void remmina_rdp_event_cursor(RemminaProtocolWidget *gp, RemminaPluginRdp
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
 	switch (ui->cursor.type) {
-	case REMMINA_RDP_POINTER_NEW:
-		ui->retval = remmina_rdp_event_create_cursor(gp, ui) ? 1 : 0;
-		break;
-
-	case REMMINA_RDP_POINTER_FREE:
-		remmina_rdp_event_free_cursor(gp, ui);
-		break;
-
 	case REMMINA_RDP_POINTER_SET:
-		gdk_window_set_cursor(gtk_widget_get_window(rfi->drawing_area), ui->cursor.pointer->cursor);
+		gdk_window_set_cursor(gtk_widget_get_window(rfi->drawing_area),
+				      remmina_rdp_cursor_get(ui->cursor.shape, rfi->display));
 		ui->retval = 1;
 		break;
 
 	case REMMINA_RDP_POINTER_SETPOS:
-		ui->retval = remmina_rdp_event_set_pointer_position(gp, ui->pos.x, ui->pos.y) ? 1 : 0;
+		ui->retval = remmina_rdp_event_set_pointer_position(gp, ui->cursor.x, ui->cursor.y) ? 1 : 0;
 		break;
 
 	case REMMINA_RDP_POINTER_NULL:
@@ -1499,11 +1543,17 @@ static void remmina_rdp_event_queue_ui(RemminaProtocolWidget *gp, RemminaPluginR
 	gboolean ui_sync_save;
 	int oldcanceltype;
 
-	if (!rfi || rfi->thread_cancelled)
+	if (!rfi || rfi->thread_cancelled) {
+		/* Nobody else owns an async event, it would leak with its references */
+		if (!ui->sync)
+			remmina_rdp_event_free_event(ui);
 		return;
+	}
 
 	if (remmina_plugin_service->is_main_thread()) {
 		remmina_rdp_event_process_ui_event(gp, ui);
+		if (!ui->sync)
+			remmina_rdp_event_free_event(ui);
 		return;
 	}
 
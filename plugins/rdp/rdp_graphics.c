@@ -43,6 +43,7 @@
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/bitmap.h>
 #include <winpr/memory.h>
+#include <string.h>
 
 //#define RF_BITMAP
 //#define RF_GLYPH
@@ -54,19 +55,220 @@
 #define CONST_ARG
 #endif
 
+/* Cursor shape cache
+ *
+ * Shapes are keyed by the pointer data sent by the server, so converting a
+ * shape and building its GdkCursor happen once, however many times and in
+ * however many sessions the server sends it again. The cache holds every
+ * shape, the refcount counts the rfPointer and the queued UI events using
+ * it; unused shapes are evicted from the main thread, the only one that
+ * may release their GdkCursor.
+ */
+#define RDP_CURSOR_CACHE_MAX 256
+
+struct remmina_rdp_cursor {
+	gint		refcount;
+	guint		hash;
+	guint8 *	key;
+	gsize		keylen;
+	UINT32		width;
+	UINT32		height;
+	UINT32		xhot;
+	UINT32		yhot;
+	UINT8 *		data;   /* BGRA32, converted once */
+	GdkCursor *	cursor; /* Main thread only */
+	GdkDisplay *	display;
+};
+
+static GHashTable *rdp_cursor_cache = NULL;
+static pthread_mutex_t rdp_cursor_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static guint remmina_rdp_cursor_hash(gconstpointer v)
+{
+	return ((const RemminaRdpCursor *)v)->hash;
+}
+
+static gboolean remmina_rdp_cursor_equal(gconstpointer a, gconstpointer b)
+{
+	const RemminaRdpCursor *ca = (const RemminaRdpCursor *)a;
+	const RemminaRdpCursor *cb = (const RemminaRdpCursor *)b;
+
+	return ca->hash == cb->hash && ca->keylen == cb->keylen && memcmp(ca->key, cb->key, ca->keylen) == 0;
+}
+
+static void remmina_rdp_cursor_free(RemminaRdpCursor *shape)
+{
+	if (shape->cursor)
+		g_object_unref(shape->cursor);
+	free(shape->data);
+	g_free(shape->key);
+	g_free(shape);
+}
+
+/* Key of a pointer: geometry, both masks and, for paletted shapes, the palette */
+static void remmina_rdp_cursor_make_key(RemminaRdpCursor *shape, rdpContext *context, rdpPointer *pointer)
+{
+	UINT32 header[7];
+	gboolean paletted = pointer->xorBpp <= 8;
+	guint8 *p;
+	gsize i;
+	guint32 h = 2166136261u;
+
+	header[0] = pointer->width;
+	header[1] = pointer->height;
+	header[2] = pointer->xPos;
+	header[3] = pointer->yPos;
+	header[4] = pointer->xorBpp;
+	header[5] = pointer->lengthXorMask;
+	header[6] = pointer->lengthAndMask;
+
+	shape->keylen = sizeof(header) + pointer->lengthXorMask + pointer->lengthAndMask;
+	if (paletted)
+		shape->keylen += sizeof(context->gdi->palette);
+	shape->key = p = g_malloc(shape->keylen);
+
+	memcpy(p, header, sizeof(header));
+	p += sizeof(header);
+	if (pointer->lengthXorMask)
+		memcpy(p, pointer->xorMaskData, pointer->lengthXorMask);
+	p += pointer->lengthXorMask;
+	if (pointer->lengthAndMask)
+		memcpy(p, pointer->andMaskData, pointer->lengthAndMask);
+	p += pointer->lengthAndMask;
+	if (paletted)
+		memcpy(p, &context->gdi->palette, sizeof(context->gdi->palette));
+
+	/* FNV-1a */
+	for (i = 0; i < shape->keylen; i++) {
+		h ^= shape->key[i];
+		h *= 16777619u;
+	}
+	shape->hash = h;
+}
+
+/* Find or add the shape of pointer, returns a new reference. Any thread. */
+static RemminaRdpCursor *remmina_rdp_cursor_lookup(rdpContext *context, rdpPointer *pointer)
+{
+	TRACE_CALL(__func__);
+	RemminaRdpCursor *shape, *cached;
+
+	shape = g_new0(RemminaRdpCursor, 1);
+	remmina_rdp_cursor_make_key(shape, context, pointer);
+
+	pthread_mutex_lock(&rdp_cursor_cache_mutex);
+	if (!rdp_cursor_cache)
+		rdp_cursor_cache = g_hash_table_new(remmina_rdp_cursor_hash, remmina_rdp_cursor_equal);
+	cached = g_hash_table_lookup(rdp_cursor_cache, shape);
+	if (cached) {
+		g_atomic_int_inc(&cached->refcount);
+		pthread_mutex_unlock(&rdp_cursor_cache_mutex);
+		remmina_rdp_cursor_free(shape);
+		return cached;
+	}
+	pthread_mutex_unlock(&rdp_cursor_cache_mutex);
+
+	/* New shape: convert it out of the lock, then publish it */
+	shape->width = pointer->width;
+	shape->height = pointer->height;
+	shape->xhot = pointer->xPos;
+	shape->yhot = pointer->yPos;
+	shape->data = malloc(pointer->width * pointer->height * 4);
+	if (!shape->data || !freerdp_image_copy_from_pointer_data(
+		    shape->data, PIXEL_FORMAT_BGRA32,
+		    pointer->width * 4, 0, 0, pointer->width, pointer->height,
+		    pointer->xorMaskData, pointer->lengthXorMask,
+		    pointer->andMaskData, pointer->lengthAndMask,
+		    pointer->xorBpp, &context->gdi->palette)) {
+		remmina_rdp_cursor_free(shape);
+		return NULL;
+	}
+	shape->refcount = 1;
+
+	pthread_mutex_lock(&rdp_cursor_cache_mutex);
+	cached = g_hash_table_lookup(rdp_cursor_cache, shape);
+	if (cached) {
+		/* Another session converted it meanwhile */
+		g_atomic_int_inc(&cached->refcount);
+		pthread_mutex_unlock(&rdp_cursor_cache_mutex);
+		remmina_rdp_cursor_free(shape);
+		return cached;
+	}
+	g_hash_table_add(rdp_cursor_cache, shape);
+	pthread_mutex_unlock(&rdp_cursor_cache_mutex);
+
+	return shape;
+}
+
+RemminaRdpCursor *remmina_rdp_cursor_ref(RemminaRdpCursor *shape)
+{
+	g_atomic_int_inc(&shape->refcount);
+	return shape;
+}
+
+/* Drop a reference, the shape stays cached until evicted. Any thread. */
+void remmina_rdp_cursor_unref(RemminaRdpCursor *shape)
+{
+	g_atomic_int_add(&shape->refcount, -1);
+}
+
+/* Drop unused shapes once the cache is over its size, main thread only */
+static void remmina_rdp_cursor_evict(void)
+{
+	TRACE_CALL(__func__);
+	GHashTableIter iter;
+	RemminaRdpCursor *shape;
+
+	g_hash_table_iter_init(&iter, rdp_cursor_cache);
+	while (g_hash_table_size(rdp_cursor_cache) > RDP_CURSOR_CACHE_MAX / 2 &&
+	       g_hash_table_iter_next(&iter, (gpointer *)&shape, NULL)) {
+		if (g_atomic_int_get(&shape->refcount) == 0) {
+			g_hash_table_iter_remove(&iter);
+			remmina_rdp_cursor_free(shape);
+		}
+	}
+}
+
+/**
+ * The GdkCursor of a shape, built the first time it is shown on display.
+ * The cursor belongs to the cache. Main thread only.
+ */
+GdkCursor *remmina_rdp_cursor_get(RemminaRdpCursor *shape, GdkDisplay *display)
+{
+	TRACE_CALL(__func__);
+	cairo_surface_t *surface;
+	GdkPixbuf *pixbuf;
+
+	if (shape->cursor && shape->display == display)
+		return shape->cursor;
+	if (shape->cursor)
+		g_object_unref(shape->cursor);
+
+	surface = cairo_image_surface_create_for_data(shape->data, CAIRO_FORMAT_ARGB32, shape->width, shape->height,
+						      cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, shape->width));
+	cairo_surface_flush(surface);
+	pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, shape->width, shape->height);
+	cairo_surface_mark_dirty(surface);
+	cairo_surface_destroy(surface);
+	shape->cursor = gdk_cursor_new_from_pixbuf(display, pixbuf, shape->xhot, shape->yhot);
+	shape->display = display;
+	g_object_unref(pixbuf);
+
+	pthread_mutex_lock(&rdp_cursor_cache_mutex);
+	if (g_hash_table_size(rdp_cursor_cache) > RDP_CURSOR_CACHE_MAX)
+		remmina_rdp_cursor_evict();
+	pthread_mutex_unlock(&rdp_cursor_cache_mutex);
+
+	return shape->cursor;
+}
+
 static BOOL rf_Pointer_New(rdpContext* context, rdpPointer* pointer)
 {
 	TRACE_CALL(__func__);
-	RemminaPluginRdpUiObject* ui;
-	rfContext* rfi = (rfContext*)context;
+	rfPointer* p = (rfPointer*)pointer;
 
 	if (pointer->xorMaskData != 0) {
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
-		ui->type = REMMINA_RDP_UI_CURSOR;
-		ui->cursor.context = context;
-		ui->cursor.pointer = (rfPointer*)pointer;
-		ui->cursor.type = REMMINA_RDP_POINTER_NEW;
-		return remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui) ? TRUE : FALSE;
+		p->shape = remmina_rdp_cursor_lookup(context, pointer);
+		return p->shape ? TRUE : FALSE;
 	}
 	return FALSE;
 }
@@ -74,33 +276,32 @@ static BOOL rf_Pointer_New(rdpContext* context, rdpPointer* pointer)
 static void rf_Pointer_Free(rdpContext* context, rdpPointer* pointer)
 {
 	TRACE_CALL(__func__);
-	RemminaPluginRdpUiObject* ui;
-	rfContext* rfi = (rfContext*)context;
+	rfPointer* p = (rfPointer*)pointer;
 
-	if (G_IS_OBJECT(((rfPointer*)pointer)->cursor))
-	{
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
-		ui->type = REMMINA_RDP_UI_CURSOR;
-		ui->cursor.context = context;
-		ui->cursor.pointer = (rfPointer*)pointer;
-		ui->cursor.type = REMMINA_RDP_POINTER_FREE;
-		remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui);
+	if (p->shape) {
+		remmina_rdp_cursor_unref(p->shape);
+		p->shape = NULL;
 	}
 }
 
+/* The pointer callbacks below do not wait for the main thread */
 static BOOL rf_Pointer_Set(rdpContext* context, CONST_ARG rdpPointer* pointer)
 {
 	TRACE_CALL(__func__);
 	RemminaPluginRdpUiObject* ui;
 	rfContext* rfi = (rfContext*)context;
+	rfPointer* p = (rfPointer*)pointer;
+
+	if (!p->shape)
+		return FALSE;
 
 	ui = g_new0(RemminaPluginRdpUiObject, 1);
 	ui->type = REMMINA_RDP_UI_CURSOR;
-	ui->cursor.pointer = (rfPointer*)pointer;
+	ui->cursor.shape = remmina_rdp_cursor_ref(p->shape);
 	ui->cursor.type = REMMINA_RDP_POINTER_SET;
+	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
 
-	return remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui) ? TRUE : FALSE;
-
+	return TRUE;
 }
 
 static BOOL rf_Pointer_SetNull(rdpContext* context)
@@ -112,8 +313,9 @@ static BOOL rf_Pointer_SetNull(rdpContext* context)
 	ui = g_new0(RemminaPluginRdpUiObject, 1);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->cursor.type = REMMINA_RDP_POINTER_NULL;
+	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
 
-	return remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui) ? TRUE : FALSE;
+	return TRUE;
 }
 
 static BOOL rf_Pointer_SetDefault(rdpContext* context)
@@ -125,8 +327,9 @@ static BOOL rf_Pointer_SetDefault(rdpContext* context)
 	ui = g_new0(RemminaPluginRdpUiObject, 1);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->cursor.type = REMMINA_RDP_POINTER_DEFAULT;
+	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
 
-	return remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui) ? TRUE : FALSE;
+	return TRUE;
 }
 
 static BOOL rf_Pointer_SetPosition(rdpContext* context, UINT32 x, UINT32 y)
@@ -137,10 +340,11 @@ static BOOL rf_Pointer_SetPosition(rdpContext* context, UINT32 x, UINT32 y)
 	ui = g_new0(RemminaPluginRdpUiObject, 1);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->cursor.type = REMMINA_RDP_POINTER_SETPOS;
-	ui->pos.x = x;
-	ui->pos.y = y;
+	ui->cursor.x = x;
+	ui->cursor.y = y;
+	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
 
-	return remmina_rdp_event_queue_ui_sync_retint(rfi->protocol_widget, ui) ? TRUE : FALSE;
+	return TRUE;
 }
 
 /* Graphics Module */
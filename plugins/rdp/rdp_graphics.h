@@ -38,3 +38,7 @@
 #include "rdp_plugin.h"
 
 void rf_register_graphics(rdpGraphics *graphics);
+
+RemminaRdpCursor *remmina_rdp_cursor_ref(RemminaRdpCursor *shape);
+void remmina_rdp_cursor_unref(RemminaRdpCursor *shape);
+GdkCursor *remmina_rdp_cursor_get(RemminaRdpCursor *shape, GdkDisplay *display);
@@ -47,11 +47,17 @@
 #include "rdp_cliprdr.h"
 #include "rdp_monitor.h"
 #include "rdp_channels.h"
+#include "rdp_devices.h"
 
 #include <errno.h>
 #include <pthread.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#ifdef HAVE_NETINET_TCP_H
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
 #ifdef GDK_WINDOWING_X11
 #include <cairo/cairo-xlib.h>
 #else
@@ -247,6 +253,62 @@ static CLPARAM **remmina_rdp_CommandLineParseCommaSeparatedValues(const char *li
 /*
  * End of CommandLineParseCommaSeparatedValuesEx() compatibility and copyright
  */
+/* Size of a FastPath input PDU carrying one mouse event, before TLS */
+#define REMMINA_RDP_FASTPATH_MOUSE_PDU_SIZE 9
+/* IPv4 and TCP headers without options, spared by every segment not sent */
+#define REMMINA_RDP_TCPIP_HEADER_SIZE 40
+
+static gboolean rf_event_is_motion(RemminaPluginRdpEvent *event)
+{
+	return event->type == REMMINA_RDP_EVENT_TYPE_MOUSE && !event->mouse_event.extended &&
+	       event->mouse_event.flags == PTR_FLAGS_MOVE;
+}
+
+/* Pops the next event. In batched input mode, a run of pointer motions is
+ * reduced to its last one, the event ending the run is kept in *lookahead */
+static RemminaPluginRdpEvent *rf_event_queue_pop(rfContext *rfi, RemminaPluginRdpEvent **lookahead, gint *coalesced)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginRdpEvent *event, *next;
+
+	if (*lookahead) {
+		event = *lookahead;
+		*lookahead = NULL;
+	} else {
+		event = (RemminaPluginRdpEvent *)g_async_queue_try_pop(rfi->event_queue);
+	}
+	if (!event || rfi->input_mode != REMMINA_RDP_INPUT_MODE_BATCHED)
+		return event;
+
+	while (rf_event_is_motion(event) && (next = (RemminaPluginRdpEvent *)g_async_queue_try_pop(rfi->event_queue)) != NULL) {
+		if (!rf_event_is_motion(next)) {
+			*lookahead = next;
+			break;
+		}
+		g_free(event);
+		event = next;
+		(*coalesced)++;
+	}
+	return event;
+}
+
+/* Holds back input writes while cork is TRUE, then flushes them as few segments as possible */
+static void rf_input_cork(rfContext *rfi, gboolean cork)
+{
+	TRACE_CALL(__func__);
+	int optval = cork;
+
+	if (rfi->transport_sockfd < 0)
+		return;
+#if defined(HAVE_NETINET_TCP_H) && defined(TCP_CORK)
+	setsockopt(rfi->transport_sockfd, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
+#elif defined(HAVE_NETINET_TCP_H) && defined(TCP_NOPUSH)
+	setsockopt(rfi->transport_sockfd, IPPROTO_TCP, TCP_NOPUSH, &optval, sizeof(optval));
+#else
+	(void)optval;
+#endif
+}
+
 static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -257,6 +319,9 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 	DISPLAY_CONTROL_MONITOR_LAYOUT *dcml;
 	CLIPRDR_FORMAT_DATA_RESPONSE response = { 0 };
 	RemminaFile *remminafile;
+	RemminaPluginRdpEvent *lookahead = NULL;
+	gint sent = 0, coalesced = 0, packets_saved;
+	gboolean batched;
 
 	if (rfi->event_queue == NULL)
 		return true;
@@ -265,7 +330,13 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 
 	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 
-	while ((event = (RemminaPluginRdpEvent *)g_async_queue_try_pop(rfi->event_queue)) != NULL) {
+	/* FreeRDP writes each input event as its own FastPath PDU, batching
+	 * merges them into one TCP segment instead */
+	batched = rfi->input_mode == REMMINA_RDP_INPUT_MODE_BATCHED;
+	if (batched)
+		rf_input_cork(rfi, TRUE);
+
+	while ((event = rf_event_queue_pop(rfi, &lookahead, &coalesced)) != NULL) {
 		time(&(rfi->last_time)); //update last user interaction time
 		time(&(rfi->last_time_idle_keypress));
 		switch (event->type) {
@@ -279,6 +350,7 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 			}
 			flags |= event->key_event.up ? KBD_FLAGS_RELEASE : KBD_FLAGS_DOWN;
 			input->KeyboardEvent(input, flags, event->key_event.key_code);
+			sent++;
 			break;
 
 		case REMMINA_RDP_EVENT_TYPE_SCANCODE_UNICODE:
@@ -287,6 +359,7 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 			 */
 			flags = event->key_event.up ? KBD_FLAGS_RELEASE : KBD_FLAGS_DOWN;
 			input->UnicodeKeyboardEvent(input, flags, event->key_event.unicode_code);
+			sent++;
 			break;
 
 		case REMMINA_RDP_EVENT_TYPE_MOUSE:
@@ -296,6 +369,7 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 			else
 				input->MouseEvent(input, event->mouse_event.flags,
 						  event->mouse_event.x, event->mouse_event.y);
+			sent++;
 			break;
 
 		case REMMINA_RDP_EVENT_TYPE_CLIPBOARD_SEND_CLIENT_FORMAT_LIST:
@@ -392,6 +466,19 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 		g_free(event);
 	}
 
+	if (batched) {
+		rf_input_cork(rfi, FALSE);
+		packets_saved = coalesced;
+		if (rfi->transport_sockfd >= 0 && sent > 1)
+			packets_saved += sent - 1;
+		if (packets_saved > 0) {
+			remmina_plugin_service->protocol_widget_metrics_add(gp, REMMINA_METRICS_INPUT_PACKETS_SAVED, packets_saved);
+			remmina_plugin_service->protocol_widget_metrics_add(gp, REMMINA_METRICS_INPUT_BYTES_SAVED,
+									    coalesced * REMMINA_RDP_FASTPATH_MOUSE_PDU_SIZE +
+									    packets_saved * REMMINA_RDP_TCPIP_HEADER_SIZE);
+		}
+	}
+
 	return true;
 }
 
@@ -583,6 +670,8 @@ static BOOL rf_begin_paint(rdpContext *context)
 	if (!gdi || !gdi->primary || !gdi->primary->hdc || !gdi->primary->hdc->hwnd)
 		return FALSE;
 
+	/* Released by rf_end_paint() */
+	pthread_mutex_lock(&((rfContext *)context)->paint_mutex);
 	return TRUE;
 }
 
@@ -595,6 +684,7 @@ static BOOL rf_end_paint(rdpContext *context)
 	int i, ninvalid;
 	region *reg;
 	HGDI_RGN cinvalid;
+	gint64 pending_since;
 
 	gdi = context->gdi;
 	rfi = (rfContext *)context;
@@ -602,6 +692,20 @@ static BOOL rf_end_paint(rdpContext *context)
 	if (gdi == NULL || gdi->primary == NULL || gdi->primary->hdc == NULL || gdi->primary->hdc->hwnd == NULL)
 		return TRUE;
 
+	/* Painted area for the next get_framebuffer, then the framebuffer is consistent again */
+	if (!gdi->primary->hdc->hwnd->invalid->null) {
+		cairo_rectangle_int_t rect;
+
+		for (i = 0; i < gdi->primary->hdc->hwnd->ninvalid; i++) {
+			rect.x = gdi->primary->hdc->hwnd->cinvalid[i].x;
+			rect.y = gdi->primary->hdc->hwnd->cinvalid[i].y;
+			rect.width = gdi->primary->hdc->hwnd->cinvalid[i].w;
+			rect.height = gdi->primary->hdc->hwnd->cinvalid[i].h;
+			cairo_region_union_rectangle(rfi->fb_damage, &rect);
+		}
+	}
+	pthread_mutex_unlock(&rfi->paint_mutex);
+
 	if (gdi->primary->hdc->hwnd->invalid->null)
 		return TRUE;
 
@@ -629,6 +733,18 @@ static BOOL rf_end_paint(rdpContext *context)
 	gdi->primary->hdc->hwnd->invalid->null = TRUE;
 	gdi->primary->hdc->hwnd->ninvalid = 0;
 
+	remmina_plugin_service->protocol_widget_metrics_add(rfi->protocol_widget, REMMINA_METRICS_FRAMES, 1);
+	/* FreeRDP only counts what it sends, the socket counts both ways */
+	if (!remmina_plugin_service->protocol_widget_metrics_sample_socket(rfi->protocol_widget, rfi->transport_sockfd))
+		remmina_plugin_service->protocol_widget_metrics_add(rfi->protocol_widget, REMMINA_METRICS_BYTES_OUT,
+								    freerdp_get_transport_sent(context, TRUE));
+	pthread_mutex_lock(&rfi->input_pending_mutex);
+	pending_since = rfi->input_pending_since;
+	rfi->input_pending_since = 0;
+	pthread_mutex_unlock(&rfi->input_pending_mutex);
+	if (pending_since)
+		remmina_plugin_service->protocol_widget_metrics_add(rfi->protocol_widget, REMMINA_METRICS_INPUT_LATENCY,
+								    g_get_monotonic_time() - pending_since);
 
 	return TRUE;
 }
@@ -656,7 +772,9 @@ static BOOL rf_desktop_resize(rdpContext *context)
 
 	/* Tell libfreerdp to change its internal GDI bitmap width and height,
 	 * this will also destroy gdi->primary_buffer, making our rfi->surface invalid */
+	pthread_mutex_lock(&rfi->paint_mutex);
 	gdi_resize(((rdpContext *)rfi)->gdi, w, h);
+	pthread_mutex_unlock(&rfi->paint_mutex);
 
 	/* Call to remmina_rdp_event_update_scale(gp) on the main UI thread,
 	 * this will recreate rfi->surface from gdi->primary_buffer */
@@ -750,6 +868,9 @@ static BOOL remmina_rdp_pre_connect(freerdp *instance)
 	if (!freerdp_client_load_addins(channels, settings))
 		return FALSE;
 
+	/* Transport connect, TLS/NLA and capabilities exchange, up to post_connect */
+	remmina_plugin_service->protocol_widget_metrics_phase(((rfContext *)context)->protocol_widget, "rdp_handshake", TRUE);
+
 	return true;
 }
 
@@ -765,6 +886,8 @@ static BOOL remmina_rdp_post_connect(freerdp *instance)
 	gp = rfi->protocol_widget;
 	rfi->postconnect_error = REMMINA_POSTCONNECT_ERROR_OK;
 
+	remmina_plugin_service->protocol_widget_metrics_phase(gp, "rdp_handshake", FALSE);
+
 	rfi->attempt_interactive_authentication = FALSE; // We authenticated!
 
 	rfi->srcBpp = freerdp_settings_get_uint32(rfi->clientContext.context.settings, FreeRDP_ColorDepth);
@@ -1253,6 +1376,72 @@ static void remmina_rdp_post_disconnect(freerdp *instance)
 #endif
 }
 
+/* The TCP socket of the transport, -1 when there is none (i.e. through a gateway) */
+static int remmina_rdp_transport_socket(rfContext *rfi)
+{
+	TRACE_CALL(__func__);
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	DWORD nCount;
+	socklen_t len;
+	int fd, type;
+
+	/* Without a gateway the transport socket comes first, before the channels */
+	nCount = freerdp_get_event_handles(&rfi->clientContext.context, &handles[0], ARRAYSIZE(handles));
+	if (nCount == 0)
+		return -1;
+	fd = GetEventFileDescriptor(handles[0]);
+	len = sizeof(type);
+	if (fd < 0 || getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0 || type != SOCK_STREAM)
+		return -1;
+	return fd;
+}
+
+/* Applies the input mode to the transport socket, after each (re)connection */
+static void remmina_rdp_input_setup(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+	int fd, optval;
+
+	rfi->input_batch_deadline = 0;
+
+	fd = rfi->transport_sockfd;
+	if (fd < 0) {
+		REMMINA_PLUGIN_DEBUG("Transport socket not found, input mode %d without TCP control", rfi->input_mode);
+		return;
+	}
+
+#ifdef HAVE_NETINET_TCP_H
+	optval = rfi->input_mode != REMMINA_RDP_INPUT_MODE_NAGLE;
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) < 0)
+		REMMINA_PLUGIN_DEBUG("TCP_NODELAY not set");
+	else
+		REMMINA_PLUGIN_DEBUG("TCP_NODELAY %s", optval ? "enabled" : "disabled");
+#else
+	(void)optval;
+#endif
+}
+
+/* Whether the event queue is due. In batched input mode the events
+ * following the first one get the latency budget to join its batch */
+static gboolean rf_event_queue_ready(rfContext *rfi)
+{
+	TRACE_CALL(__func__);
+
+	if (rfi->input_batch_deadline == 0) {
+		if (WaitForSingleObject(rfi->event_handle, 0) != WAIT_OBJECT_0)
+			return FALSE;
+		if (rfi->input_mode != REMMINA_RDP_INPUT_MODE_BATCHED || rfi->input_latency_budget <= 0)
+			return TRUE;
+		rfi->input_batch_deadline = g_get_monotonic_time() + rfi->input_latency_budget;
+		return FALSE;
+	}
+	if (g_get_monotonic_time() < rfi->input_batch_deadline)
+		return FALSE;
+	rfi->input_batch_deadline = 0;
+	return TRUE;
+}
+
 static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -1261,10 +1450,17 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 	time_t cur_time, time_diff_jitter, time_diff_keypress;
+	DWORD timeout;
+	gint64 now;
 
 	int jitter_time = remmina_plugin_service->file_get_int(remminafile, "rdp_mouse_jitter", 0);
  	int keypress_time = remmina_plugin_service->file_get_int(remminafile, "rdp_idle_keypress_time", 0);
 	int keypress_opts = remmina_plugin_service->file_get_int(remminafile, "rdp_idle_keypress_combo", 0);
+
+	rfi->input_mode = remmina_plugin_service->file_get_int(remminafile, "input_mode", REMMINA_RDP_INPUT_MODE_IMMEDIATE);
+	rfi->input_latency_budget = CLAMP(remmina_plugin_service->file_get_int(remminafile, "input_latency_budget", 20), 0, 500) * 1000;
+	rfi->transport_sockfd = remmina_rdp_transport_socket(rfi);
+	remmina_rdp_input_setup(gp);
 	time(&(rfi->last_time));
 	time(&(rfi->last_time_idle_keypress));
 #if FREERDP_VERSION_MAJOR >= 3
@@ -1289,8 +1485,14 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 
 		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = {0};
 		DWORD nCount = freerdp_get_event_handles(&rfi->clientContext.context, &handles[0], ARRAYSIZE(handles));
-		if (rfi->event_handle)
+		/* While a batch waits for its deadline the pending events must not wake us up */
+		timeout = 100;
+		if (rfi->input_batch_deadline) {
+			now = g_get_monotonic_time();
+			timeout = rfi->input_batch_deadline > now ? MIN(timeout, (rfi->input_batch_deadline - now + 999) / 1000) : 0;
+		} else if (rfi->event_handle) {
 			handles[nCount++] = rfi->event_handle;
+		}
 
 		handles[nCount++] = freerdp_abort_event(&rfi->clientContext.context);
 
@@ -1299,14 +1501,14 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 			break;
 		}
 
-		status = WaitForMultipleObjects(nCount, handles, FALSE, 100);
+		status = WaitForMultipleObjects(nCount, handles, FALSE, timeout);
 
 		if (status == WAIT_FAILED) {
 			fprintf(stderr, "WaitForMultipleObjects failed with %lu\n", (unsigned long)status);
 			break;
 		}
 
-		if (rfi->event_handle && WaitForSingleObject(rfi->event_handle, 0) == WAIT_OBJECT_0) {
+		if (rfi->event_handle && rf_event_queue_ready(rfi)) {
 			if (!rf_process_event_queue(gp)) {
 				fprintf(stderr, "Could not process local keyboard/mouse event queue\n");
 				break;
@@ -1324,6 +1526,8 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 			if (rf_auto_reconnect(rfi)) {
 				/* Reset the possible reason/error which made us doing many reconnection reattempts and continue */
 				remmina_plugin_service->protocol_plugin_set_error(gp, NULL);
+				rfi->transport_sockfd = remmina_rdp_transport_socket(rfi);
+				remmina_rdp_input_setup(gp);
 				continue;
 			}
 			if (freerdp_get_last_error(&rfi->clientContext.context) == FREERDP_ERROR_SUCCESS)
@@ -1365,11 +1569,17 @@ static int remmina_rdp_load_static_channel_addin(rdpChannels *channels, rdpSetti
 	return FALSE;
 }
 
-static gchar *remmina_rdp_find_prdriver(char *smap, char *prn)
+/**
+ * Parse printer_overrides, "printer":"driver" pairs separated by ';', into
+ * a printer -> driver table. Parsing stops at the first syntax error, the
+ * pairs before it are kept. When a printer appears twice the first wins.
+ */
+static GHashTable *remmina_rdp_parse_prdrivers(const char *smap)
 {
-	char c, *p, *dr;
-	int matching;
-	size_t sz;
+	GHashTable *drivers;
+	const char *pr = NULL, *dr = NULL;
+	gchar *name;
+	char c;
 
 	enum { S_WAITPR,
 	       S_INPRINTER,
@@ -1378,91 +1588,71 @@ static gchar *remmina_rdp_find_prdriver(char *smap, char *prn)
 	       S_INDRIVER,
 	       S_WAITSEMICOLON } state = S_WAITPR;
 
-	matching = 0;
+	drivers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 	while ((c = *smap++) != 0) {
 		switch (state) {
 		case S_WAITPR:
-			if (c != '\"') return NULL;
+			if (c != '\"') return drivers;
 			state = S_INPRINTER;
-			p = prn;
-			matching = 1;
+			pr = smap;
 			break;
 		case S_INPRINTER:
-			if (matching && c == *p && *p != 0) {
-				p++;
-			} else if (c == '\"') {
-				if (*p != 0)
-					matching = 0;
+			if (c == '\"')
 				state = S_WAITCOLON;
-			} else {
-				matching = 0;
-			}
 			break;
 		case S_WAITCOLON:
 			if (c != ':')
-				return NULL;
+				return drivers;
 			state = S_WAITDRIVER;
 			break;
 		case S_WAITDRIVER:
 			if (c != '\"')
-				return NULL;
+				return drivers;
 			state = S_INDRIVER;
 			dr = smap;
 			break;
 		case S_INDRIVER:
 			if (c == '\"') {
-				if (matching)
-					goto found;
+				name = g_strndup(pr, dr - pr - 3);
+				if (!g_hash_table_contains(drivers, name))
+					g_hash_table_insert(drivers, name, g_strndup(dr, smap - dr - 1));
 				else
-					state = S_WAITSEMICOLON;
+					g_free(name);
+				state = S_WAITSEMICOLON;
 			}
 			break;
 		case S_WAITSEMICOLON:
 			if (c != ';')
-				return NULL;
+				return drivers;
 			state = S_WAITPR;
 			break;
 		}
 	}
-	return NULL;
-
-found:
-	sz = smap - dr;
-	p = (char *)malloc(sz);
-	memcpy(p, dr, sz);
-	p[sz - 1] = 0;
-	return p;
+	return drivers;
 }
 
 #ifdef HAVE_CUPS
 /**
- * Callback function used by cupsEnumDests
- *   - For each enumerated local printer tries to set the Printer Name and Driver.
- * @return 1 if there are other printers to scan or 0 when it's done.
+ * Add a local printer to the redirected devices.
+ * When drivers is not NULL only the printers it lists are shared, with their driver.
  */
-static int remmina_rdp_set_printers(void *user_data, unsigned flags, cups_dest_t *dest)
+static void remmina_rdp_add_printer(rfContext *rfi, const gchar *name, GHashTable *drivers)
 {
-	rfContext *rfi = (rfContext *)user_data;
-	RemminaProtocolWidget *gp = rfi->protocol_widget;
-
 	/** @warning printer-make-and-model is not always the same as on the Windows,
-	 * therefore it fails finding to right one and it fails to add
-	 * the printer.
-	 *
-	 * We pass NULL and we do not check for errors. The following code is
-	 * how it is supposed to work. @todo Ask CUPS mailing list for help.
-	 *
-	 * @code
-	 * const char *model = cupsGetOption("printer-make-and-model",
-	 * 		dest->num_options,
-	 * 		dest->options);
-	 * @endcode
+	 * therefore the driver name comes from printer_overrides or is a
+	 * generic one.
 	 */
+	const gchar *driver = "MS Publisher Imagesetter";
+	RDPDR_PRINTER *printer;
 
-	RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-	const gchar *s = remmina_plugin_service->file_get_string(remminafile, "printer_overrides");
+	if (drivers) {
+		driver = g_hash_table_lookup(drivers, name);
+		/* Not listed: we do not want to share that printer */
+		if (!driver)
+			return;
+		REMMINA_PLUGIN_DEBUG("Printer DriverName set to: %s", driver);
+	}
 
-	RDPDR_PRINTER *printer;
 	printer = (RDPDR_PRINTER *)calloc(1, sizeof(RDPDR_PRINTER));
 
 #if FREERDP_VERSION_MAJOR >= 3
@@ -1479,44 +1669,19 @@ static int remmina_rdp_set_printers(void *user_data, unsigned flags, cups_dest_t
 	freerdp_settings_set_bool(rfi->clientContext.context.settings, FreeRDP_RedirectPrinters, TRUE);
 	freerdp_settings_set_bool(rfi->clientContext.context.settings, FreeRDP_DeviceRedirection, TRUE);
 
-	REMMINA_PLUGIN_DEBUG("Destination: %s", dest->name);
-	if (!(pdev->Name = _strdup(dest->name))) {
+	if (!(pdev->Name = _strdup(name)) || !(printer->DriverName = _strdup(driver))) {
+		free(pdev->Name);
 		free(printer);
-		return 1;
+		return;
 	}
-
 	REMMINA_PLUGIN_DEBUG("Printer Name: %s", pdev->Name);
-
-	if (s) {
-		gchar *d = remmina_rdp_find_prdriver(strdup(s), pdev->Name);
-		if (d) {
-			printer->DriverName = strdup(d);
-			REMMINA_PLUGIN_DEBUG("Printer DriverName set to: %s", printer->DriverName);
-			g_free(d);
-		} else {
-			/**
-			 * When remmina_rdp_find_prdriver doesn't return a DriverName
-			 * it means that we don't want to share that printer
-			 *
-			 */
-			free(pdev->Name);
-			free(printer);
-			return 1;
-		}
-	} else {
-		/* We set to a default driver*/
-		printer->DriverName = _strdup("MS Publisher Imagesetter");
-	}
-
 	REMMINA_PLUGIN_DEBUG("Printer Driver: %s", printer->DriverName);
+
 	if (!freerdp_device_collection_add(rfi->clientContext.context.settings, (RDPDR_DEVICE *)printer)) {
 		free(printer->DriverName);
 		free(pdev->Name);
 		free(printer);
-		return 1;
 	}
-
-	return 1;
 }
 #endif /* HAVE_CUPS */
 
@@ -2320,10 +2485,16 @@ static gboolean remmina_rdp_main(RemminaProtocolWidget *gp)
 		const gchar *po = remmina_plugin_service->file_get_string(remminafile, "printer_overrides");
 		if (po && po[0] != 0) {
 			/* Fallback to remmina code to override print drivers */
-			if (cupsEnumDests(CUPS_DEST_FLAGS_NONE, 1000, NULL, 0, 0, remmina_rdp_set_printers, rfi))
+			GPtrArray *printers = remmina_rdp_devices_get_printers();
+			GHashTable *drivers = remmina_rdp_parse_prdrivers(po);
+			for (i = 0; i < printers->len; i++)
+				remmina_rdp_add_printer(rfi, g_ptr_array_index(printers, i), drivers);
+			if (printers->len > 0)
 				REMMINA_PLUGIN_DEBUG("All printers have been shared");
 			else
 				REMMINA_PLUGIN_DEBUG("Cannot share printers, are there any available?");
+			g_hash_table_destroy(drivers);
+			g_ptr_array_unref(printers);
 		} else {
 			/* Use libfreerdp code to map all printers */
 			CLPARAM *d[1];
@@ -2538,8 +2709,14 @@ static gboolean remmina_rdp_main(RemminaProtocolWidget *gp)
 	}
 
 	gboolean orphaned;
+	BOOL connected;
+
+	remmina_plugin_service->protocol_widget_metrics_phase(gp, "rdp_connect", TRUE);
+	connected = freerdp_connect(rfi->clientContext.context.instance);
+	remmina_plugin_service->protocol_widget_metrics_phase(gp, "rdp_handshake", FALSE);
+	remmina_plugin_service->protocol_widget_metrics_phase(gp, "rdp_connect", FALSE);
 
-	if (!freerdp_connect(rfi->clientContext.context.instance)) {
+	if (!connected) {
 		orphaned = (GET_PLUGIN_DATA(rfi->protocol_widget) == NULL);
 		if (!orphaned) {
 			UINT32 e;
@@ -2801,6 +2978,7 @@ static void remmina_rdp_init(RemminaProtocolWidget *gp)
 	rfi->user_cancelled = FALSE;
 	rfi->last_x = 0;
 	rfi->last_y = 0;
+	rfi->transport_sockfd = -1;
 
 	freerdp_register_addin_provider(freerdp_channels_load_static_addin_entry, 0);
 #if FREERDP_VERSION_MAJOR >= 3
@@ -2948,6 +3126,13 @@ static void remmina_rdp_call_feature(RemminaProtocolWidget *gp, const RemminaPro
 	case REMMINA_RDP_FEATURE_DYNRESUPDATE:
 		break;
 
+	case REMMINA_RDP_FEATURE_VIEWONLY:
+		if (rfi) {
+			RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
+			rfi->viewonly = remmina_plugin_service->file_get_int(remminafile, "viewonly", FALSE);
+		}
+		break;
+
 	case REMMINA_RDP_FEATURE_TOOL_REFRESH:
 		if (rfi)
 			gtk_widget_queue_draw_area(rfi->drawing_area, 0, 0,
@@ -2999,14 +3184,15 @@ static gboolean remmina_rdp_get_screenshot(RemminaProtocolWidget *gp, RemminaPlu
 	bitsPerPixel = GetBitsPerPixel(gdi->hdc->format);
 #endif
 
-	/** @todo we should lock FreeRDP subthread to update rfi->primary_buffer, rfi->gdi and w/h,
-	 * from here to memcpy, but… how ? */
+	/* Keep the FreeRDP thread out of gdi->primary_buffer, and its size, just for the copy */
+	pthread_mutex_lock(&rfi->paint_mutex);
 
 	szmem = gdi->width * gdi->height * bytesPerPixel;
 
 	REMMINA_PLUGIN_DEBUG("allocating %zu bytes for a full screenshot", szmem);
 	rpsd->buffer = malloc(szmem);
 	if (!rpsd->buffer) {
+		pthread_mutex_unlock(&rfi->paint_mutex);
 		REMMINA_PLUGIN_DEBUG("could not set aside %zu bytes for a full screenshot", szmem);
 		return FALSE;
 	}
@@ -3016,11 +3202,56 @@ static gboolean remmina_rdp_get_screenshot(RemminaProtocolWidget *gp, RemminaPlu
 	rpsd->bytesPerPixel = bytesPerPixel;
 
 	memcpy(rpsd->buffer, gdi->primary_buffer, szmem);
+	pthread_mutex_unlock(&rfi->paint_mutex);
 
 	/* Returning TRUE instruct also the caller to deallocate rpsd->buffer */
 	return TRUE;
 }
 
+static cairo_surface_t *remmina_rdp_get_framebuffer(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	cairo_rectangle_int_t full;
+	cairo_t *cr;
+
+	if (!rfi || !rfi->connected || rfi->is_reconnecting)
+		return NULL;
+
+	/* libfreerdp writes primary_buffer from its own thread: between two paints,
+	 * bring a private copy up to date with just the area painted since the
+	 * last call, so the FreeRDP thread is not held for a whole desktop copy */
+	pthread_mutex_lock(&rfi->paint_mutex);
+	if (!rfi->surface) {
+		pthread_mutex_unlock(&rfi->paint_mutex);
+		return NULL;
+	}
+	full.x = full.y = 0;
+	full.width = cairo_image_surface_get_width(rfi->surface);
+	full.height = cairo_image_surface_get_height(rfi->surface);
+	if (!rfi->fb_snapshot) {
+		rfi->fb_snapshot = cairo_image_surface_create(rfi->cairo_format, full.width, full.height);
+		cairo_region_union_rectangle(rfi->fb_damage, &full);
+	}
+	cairo_region_intersect_rectangle(rfi->fb_damage, &full);
+	if (!cairo_region_is_empty(rfi->fb_damage)) {
+		cairo_surface_mark_dirty(rfi->surface);
+		cr = cairo_create(rfi->fb_snapshot);
+		gdk_cairo_region(cr, rfi->fb_damage);
+		cairo_clip(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(cr, rfi->surface, 0, 0);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_region_destroy(rfi->fb_damage);
+		rfi->fb_damage = cairo_region_create();
+	}
+	pthread_mutex_unlock(&rfi->paint_mutex);
+
+	return cairo_surface_reference(rfi->fb_snapshot);
+}
+
 /* Array of key/value pairs for colour depths */
 static gpointer colordepth_list[] =
 {
@@ -3098,6 +3329,15 @@ static gpointer security_list[] =
 };
 
 /* Array of key/value pairs for mouse movement */
+/* Values of REMMINA_RDP_INPUT_MODE_* */
+static gpointer input_mode_list[] =
+{
+	"0", N_("Immediate"),
+	"1", N_("Let TCP coalesce small packets"),
+	"2", N_("Batched"),
+	NULL
+};
+
 static gpointer mouse_jitter_list[] =
 {
 	"No",	  N_("No"),
@@ -3187,6 +3427,11 @@ static gchar timeout_tooltip[] =
 	   "Adjusts the connection timeout. Use if your connection times out.\n"
 	   "The highest possible value is 600000 ms (10 minutes).\n");
 
+static gchar input_latency_budget_tooltip[] =
+	N_("Advanced setting for high latency links:\n"
+	   "In batched input mode, how long in ms input is held back to be sent\n"
+	   "together with the events following it (default: 20, at most 500).\n");
+
 static gchar network_tooltip[] =
 	N_("Performance optimisations based on the network connection type:\n"
 	   "Using auto-detection is advised.\n"
@@ -3276,6 +3521,8 @@ static const RemminaProtocolSetting remmina_rdp_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "audio-output",	    N_("Redirect local audio output"),			 TRUE,	NULL,		  audio_tooltip													 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "microphone",		    N_("Redirect local microphone"),			 TRUE,	NULL,		  microphone_tooltip												 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "timeout",		    N_("Connection timeout in ms"),			 TRUE,	NULL,		  timeout_tooltip												 },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_SELECT,	  "input_mode",		    N_("Input transmission"),				 FALSE, input_mode_list,  NULL														 },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "input_latency_budget",   N_("Input latency budget in ms"),			 TRUE,	NULL,		  input_latency_budget_tooltip											 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "gateway_server",	    N_("Remote Desktop Gateway server"),		 FALSE, NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "gateway_username",	    N_("Remote Desktop Gateway username"),		 FALSE, NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_PASSWORD, "gateway_password",	    N_("Remote Desktop Gateway password"),		 FALSE, NULL,		  NULL														 },
@@ -3313,6 +3560,7 @@ static const RemminaProtocolSetting remmina_rdp_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "shareparallel",	    N_("Share parallel ports"),				 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "sharesmartcard",	    N_("Share a smart card"),				 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "disableclipboard",	    N_("Turn off clipboard sync"),			 TRUE,	NULL,		  NULL														 },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "record_session",	    N_("Record the session to a video file"),		 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "cert_ignore",	    N_("Ignore certificate"),				 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "old-license",	    N_("Use the old license workflow"),			 TRUE,	NULL,		  N_("It disables CAL and hwId is set to 0")									 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "disablepasswordstoring", N_("Forget passwords after use"),			 TRUE,	NULL,		  NULL														 },
@@ -3373,8 +3621,10 @@ static RemminaProtocolPlugin remmina_rdp =
 	remmina_rdp_call_feature,                       // Call a feature
 	remmina_rdp_keystroke,                          // Send a keystroke
 	remmina_rdp_get_screenshot,                     // Screenshot
-	remmina_rdp_event_on_map,                       // RCW map event
-	remmina_rdp_event_on_unmap                      // RCW unmap event
+	NULL,                                           // RCW map event
+	NULL,                                           // RCW unmap event
+	remmina_rdp_event_on_visibility,                // Session visibility changed
+	remmina_rdp_get_framebuffer                     // Framebuffer for thumbnails
 };
 
 /* File plugin definition and features */
@@ -3451,6 +3701,8 @@ G_MODULE_EXPORT gboolean remmina_plugin_entry(RemminaPluginService *service)
 	if (!service->register_plugin((RemminaPlugin *)&remmina_rdp))
 		return FALSE;
 
+	remmina_rdp_devices_init();
+
 	remmina_rdpf.export_hints = _("Export connection in Windows .rdp file format");
 	remmina_rdpf.export_ext = ".rdp";
 
@@ -107,6 +107,11 @@ typedef struct rf_context rfContext;
 /* Best - DESKTOP_COMPOSITION disabled, all other enabled */
 #define DEFAULT_QUALITY_9       0x80
 
+/* "input_mode" profile setting */
+#define REMMINA_RDP_INPUT_MODE_IMMEDIATE 0      /* One TCP segment per input event, TCP_NODELAY set */
+#define REMMINA_RDP_INPUT_MODE_NAGLE     1      /* TCP_NODELAY cleared, the kernel coalesces small writes */
+#define REMMINA_RDP_INPUT_MODE_BATCHED   2      /* Input held for the latency budget, sent as one corked burst */
+
 extern RemminaPluginService *remmina_plugin_service;
 
 #define REMMINA_PLUGIN_INFO(fmt, ...) \
@@ -153,9 +158,12 @@ struct rf_clipboard {
 typedef struct rf_clipboard rfClipboard;
 
 
+/* Cursor shape shared by all the sessions, see rdp_graphics.c */
+typedef struct remmina_rdp_cursor RemminaRdpCursor;
+
 struct rf_pointer {
-	rdpPointer	pointer;
-	GdkCursor *	cursor;
+	rdpPointer		pointer;
+	RemminaRdpCursor *	shape;
 };
 typedef struct rf_pointer rfPointer;
 
@@ -246,8 +254,6 @@ typedef enum {
 } RemminaPluginRdpUiClipboardType;
 
 typedef enum {
-	REMMINA_RDP_POINTER_NEW,
-	REMMINA_RDP_POINTER_FREE,
 	REMMINA_RDP_POINTER_SET,
 	REMMINA_RDP_POINTER_NULL,
 	REMMINA_RDP_POINTER_DEFAULT,
@@ -275,9 +281,10 @@ struct remmina_plugin_rdp_ui_object {
 			gint	ninvalid;
 		} reg;
 		struct {
-			rdpContext *			context;
-			rfPointer *			pointer;
+			RemminaRdpCursor *		shape;
 			RemminaPluginRdpUiPointerType	type;
+			gint				x;
+			gint				y;
 		} cursor;
 		struct {
 			gint		left;
@@ -301,10 +308,6 @@ struct remmina_plugin_rdp_ui_object {
 		struct {
 			RemminaPluginRdpUiEeventType type;
 		} event;
-		struct {
-			gint	x;
-			gint	y;
-		} pos;
 	};
 	/* We can also return values here, usually integers*/
 	int	retval;
@@ -340,6 +343,11 @@ struct rf_context {
 
 	gboolean		connected;
 	gboolean		is_reconnecting;
+	/* Time of the oldest input event not yet followed by a frame, for the
+	 * input latency metric. 0 when there is none. Set by the main thread and
+	 * consumed by the FreeRDP thread, under input_pending_mutex. */
+	gint64			input_pending_since;
+	pthread_mutex_t		input_pending_mutex;
 	gboolean		stop_reconnecting_requested;
 	/* orphaned: rf_context has still one or more libfreerdp thread active,
 	 * but no longer maintained by an open RemminaProtocolWidget/tab.
@@ -356,6 +364,10 @@ struct rf_context {
 	gdouble			scale_x;
 	gdouble			scale_y;
 	guint			delayed_monitor_layout_handler;
+	/* Session tab not visible: output suppressed but for a periodic refresh */
+	gboolean		hidden;
+	guint			hidden_refresh_handler;
+	guint			hidden_resuppress_handler;
 	gboolean		use_client_keymap;
 
 	gint			srcBpp;
@@ -372,18 +384,40 @@ struct rf_context {
 
 	GAsyncQueue *		ui_queue;
 	pthread_mutex_t		ui_queue_mutex;
+	/* Held by the FreeRDP thread from BeginPaint to EndPaint and while resizing
+	 * gdi->primary_buffer, for a consistent copy of the framebuffer */
+	pthread_mutex_t		paint_mutex;
+	/* Copy of the framebuffer handed out by get_framebuffer, main thread only,
+	 * and the area painted since it was last brought up to date, under paint_mutex */
+	cairo_surface_t *	fb_snapshot;
+	cairo_region_t *	fb_damage;
 	guint			ui_handler;
 
 	GArray *		pressed_keys;
 	GAsyncQueue *		event_queue;
 	gint			event_pipe[2];
 	HANDLE			event_handle;
+	/* Transport socket sampled for the byte counters of the connection
+	 * metrics and tuned for the input mode, -1 when unknown (i.e. through a gateway) */
+	int			transport_sockfd;
+	/* Input transmission, see REMMINA_RDP_INPUT_MODE_* */
+	gint			input_mode;
+	gint64			input_latency_budget;
+	gint64			input_batch_deadline;
 	UINT16         	last_x;
 	UINT16         	last_y;
 
 	rfClipboard		clipboard;
 
 	GArray *		keymap; /* Array of RemminaPluginRdpKeymapEntry */
+	/* Hardware keycode -> RDP scancode with the keymap above applied, 0 for
+	 * keys without a scancode. Built at connect and after a keyboard mapping
+	 * change, so a key event is a single lookup */
+	DWORD			keycode_scancodes[256];
+	gboolean		keycode_scancodes_valid;
+	gulong			keys_changed_handler;
+	/* Cached "viewonly" profile setting, updated by REMMINA_RDP_FEATURE_VIEWONLY */
+	gboolean		viewonly;
 
 	gboolean		attempt_interactive_authentication;
 	
@@ -0,0 +1,163 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <freerdp/version.h>
+#include <winpr/string.h>
+#include "remmina/remmina_trace_calls.h"
+#include "rdp_utils.h"
+
+guchar *remmina_rdp_utils_lf2crlf(const guchar *data, gsize *size)
+{
+	TRACE_CALL(__func__);
+	guchar c;
+	guchar *outbuf;
+	guchar *out;
+	const guchar *in_end;
+	const guchar *in;
+
+	outbuf = (guchar *)malloc((*size) * 2 + 1);
+	if (!outbuf)
+		return NULL;
+	out = outbuf;
+	in = data;
+	in_end = data + (*size);
+
+	while (in < in_end) {
+		c = *in++;
+		if (c == '\n') {
+			*out++ = '\r';
+			*out++ = '\n';
+		} else {
+			*out++ = c;
+		}
+	}
+
+	*out++ = 0;
+	*size = out - outbuf;
+
+	return outbuf;
+}
+
+void remmina_rdp_utils_crlf2lf(guchar *data, gsize *size)
+{
+	TRACE_CALL(__func__);
+	guchar c;
+	guchar *out;
+	guchar *in;
+	guchar *in_end;
+
+	out = data;
+	in = data;
+	in_end = data + (*size);
+
+	while (in < in_end) {
+		c = *in++;
+		if (c != '\r')
+			*out++ = c;
+	}
+
+	*size = out - data;
+}
+
+gchar *remmina_rdp_utils_utf16_to_text(const guchar *data, gsize *size)
+{
+	TRACE_CALL(__func__);
+	gchar *output;
+
+	output = g_utf16_to_utf8((const gunichar2 *)data, *size / sizeof(gunichar2), NULL, NULL, NULL);
+	if (output) {
+		*size = strlen(output) + 1;
+		remmina_rdp_utils_crlf2lf((guchar *)output, size);
+	}
+	return output;
+}
+
+guchar *remmina_rdp_utils_text_to_utf16(const gchar *text, gsize *size)
+{
+	TRACE_CALL(__func__);
+	guchar *crlf;
+	guchar *outbuf = NULL;
+
+	*size = strlen(text);
+	crlf = remmina_rdp_utils_lf2crlf((const guchar *)text, size);
+	if (!crlf) {
+		*size = 0;
+		return NULL;
+	}
+#if FREERDP_VERSION_MAJOR >= 3
+	size_t len = 0;
+	outbuf = (guchar *)ConvertUtf8NToWCharAlloc((const char *)crlf, *size, &len);
+	*size = outbuf ? (len + 1) * sizeof(WCHAR) : 0;
+#else
+	const int rc = ConvertToUnicode(CP_UTF8, 0, (CHAR *)crlf, -1, (WCHAR **)&outbuf, 0);
+	*size = rc > 0 ? (gsize)rc * sizeof(WCHAR) : 0;
+#endif
+	free(crlf);
+	return outbuf;
+}
+
+void remmina_rdp_utils_scale_area(gint width, gint height, gint scale_width, gint scale_height,
+				  gint *x, gint *y, gint *w, gint *h)
+{
+	TRACE_CALL(__func__);
+	gint sx, sy, sw, sh;
+
+	if ((scale_width == width) && (scale_height == height)) {
+		/* Same size, just copy the pixels */
+		*x = MIN(MAX(0, *x), width - 1);
+		*y = MIN(MAX(0, *y), height - 1);
+		*w = MIN(width - *x, *w);
+		*h = MIN(height - *y, *h);
+		return;
+	}
+
+	sx = MIN(MAX(0, (*x) * scale_width / width
+		     - scale_width / width - 2), scale_width - 1);
+
+	sy = MIN(MAX(0, (*y) * scale_height / height
+		     - scale_height / height - 2), scale_height - 1);
+
+	sw = MIN(scale_width - sx, (*w) * scale_width / width
+		 + scale_width / width + 4);
+
+	sh = MIN(scale_height - sy, (*h) * scale_height / height
+		 + scale_height / height + 4);
+
+	*x = sx;
+	*y = sy;
+	*w = sw;
+	*h = sh;
+}
@@ -0,0 +1,64 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Clipboard text conversions. They do not depend on the session, so they
+ * can be exercised on their own. Buffers returned by the FreeRDP side
+ * conversions are allocated with malloc(), like the ones FreeRDP frees. */
+
+/* Returns a NUL terminated copy of data with every \n turned into \r\n;
+ * *size is updated to the new length, terminator included. */
+guchar *remmina_rdp_utils_lf2crlf(const guchar *data, gsize *size);
+/* Drops every \r of data in place and updates *size */
+void remmina_rdp_utils_crlf2lf(guchar *data, gsize *size);
+/* UTF-16 text received from the server to UTF-8 with \n line endings.
+ * *size is the number of input bytes, it is set to the output length
+ * including the terminator. Free the result with g_free(). */
+gchar *remmina_rdp_utils_utf16_to_text(const guchar *data, gsize *size);
+/* UTF-8 text with \n line endings to the UTF-16 the server expects.
+ * *size is set to the number of bytes, terminator included. */
+guchar *remmina_rdp_utils_text_to_utf16(const gchar *text, gsize *size);
+
+/* Grow the damaged rectangle x, y, w, h of a width x height desktop to the
+ * area it covers once scaled to scale_width x scale_height, extended by
+ * one scaled pixel to avoid gaps */
+void remmina_rdp_utils_scale_area(gint width, gint height, gint scale_width, gint scale_height,
+				  gint *x, gint *y, gint *w, gint *h);
+
+G_END_DECLS
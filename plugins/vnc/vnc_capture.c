@@ -0,0 +1,341 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <gio/gio.h>
+#include "vnc_capture.h"
+
+#define VNC_CAPTURE_MAGIC "RMNAVNC"
+#define VNC_CAPTURE_VERSION 1
+#define VNC_CAPTURE_HEADER_SIZE 24
+#define VNC_CAPTURE_RECORD_SIZE 12
+#define VNC_CAPTURE_BUFFER (64 * 1024)
+
+struct _RemminaVncCapture {
+	gboolean		replay;
+	gboolean		realtime;
+	FILE *			file;
+	gint64			start;
+
+	GSocketConnection *	server;         /* Capture only */
+	gint			peer;           /* Our end of the socket pair */
+	pthread_t		thread;
+	gint			done;
+};
+
+static gboolean remmina_vnc_capture_send_all(gint fd, const guint8 *data, gsize len)
+{
+	struct pollfd pfd = { fd, POLLOUT, 0 };
+	ssize_t n;
+
+	while (len > 0) {
+		n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		/* GSocket made the server socket non blocking */
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			poll(&pfd, 1, -1);
+			continue;
+		}
+		if (n <= 0)
+			return FALSE;
+		data += n;
+		len -= n;
+	}
+	return TRUE;
+}
+
+static void remmina_vnc_capture_record(RemminaVncCapture *capture, const guint8 *data, gsize len)
+{
+	guint8 header[VNC_CAPTURE_RECORD_SIZE];
+	guint64 t = GUINT64_TO_LE((guint64)(g_get_monotonic_time() - capture->start));
+	guint32 l = GUINT32_TO_LE((guint32)len);
+
+	memcpy(header, &t, 8);
+	memcpy(header + 8, &l, 4);
+	fwrite(header, 1, sizeof(header), capture->file);
+	fwrite(data, 1, len, capture->file);
+}
+
+static gpointer remmina_vnc_capture_relay(gpointer data)
+{
+	RemminaVncCapture *capture = (RemminaVncCapture *)data;
+	struct pollfd fds[2];
+	guint8 *buf;
+	ssize_t n;
+
+	buf = g_malloc(VNC_CAPTURE_BUFFER);
+	fds[0].fd = g_socket_get_fd(g_socket_connection_get_socket(capture->server));
+	fds[0].events = POLLIN;
+	fds[1].fd = capture->peer;
+	fds[1].events = POLLIN;
+
+	while (TRUE) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (fds[0].revents) {
+			n = recv(fds[0].fd, buf, VNC_CAPTURE_BUFFER, 0);
+			if (n < 0 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			if (n <= 0)
+				break;
+			remmina_vnc_capture_record(capture, buf, n);
+			if (!remmina_vnc_capture_send_all(capture->peer, buf, n))
+				break;
+		}
+		if (fds[1].revents) {
+			n = recv(fds[1].fd, buf, VNC_CAPTURE_BUFFER, 0);
+			if (n <= 0 || !remmina_vnc_capture_send_all(fds[0].fd, buf, n))
+				break;
+		}
+	}
+
+	/* Let libvncclient see the end of the connection */
+	shutdown(capture->peer, SHUT_WR);
+	g_free(buf);
+	return NULL;
+}
+
+static gpointer remmina_vnc_capture_feed(gpointer data)
+{
+	RemminaVncCapture *capture = (RemminaVncCapture *)data;
+	guint8 header[VNC_CAPTURE_RECORD_SIZE], *buf, discard[4096];
+	struct pollfd fd;
+	gint64 due, now;
+	guint64 t;
+	guint32 len = 0, sent = 0;
+	gboolean pending = FALSE;
+	ssize_t n;
+
+	buf = g_malloc(VNC_CAPTURE_BUFFER);
+	fd.fd = capture->peer;
+	capture->start = g_get_monotonic_time();
+	due = capture->start;
+
+	while (TRUE) {
+		if (!pending) {
+			if (fread(header, 1, sizeof(header), capture->file) != sizeof(header))
+				break;
+			memcpy(&t, header, 8);
+			memcpy(&len, header + 8, 4);
+			len = GUINT32_FROM_LE(len);
+			if (len > VNC_CAPTURE_BUFFER) {
+				buf = g_realloc(buf, len);
+			}
+			if (fread(buf, 1, len, capture->file) != len)
+				break;
+			if (capture->realtime)
+				due = capture->start + (gint64)GUINT64_FROM_LE(t);
+			sent = 0;
+			pending = TRUE;
+		}
+
+		/* Keep reading what the client sends, or it would block on a full socket */
+		now = g_get_monotonic_time();
+		fd.events = POLLIN | (now >= due ? POLLOUT : 0);
+		if (poll(&fd, 1, now >= due ? -1 : (gint)((due - now + 999) / 1000)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (fd.revents & (POLLERR | POLLNVAL))
+			break;
+		if (fd.revents & (POLLIN | POLLHUP)) {
+			n = recv(capture->peer, discard, sizeof(discard), MSG_DONTWAIT);
+			if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+				break;
+		}
+		if (fd.revents & POLLOUT) {
+			n = send(capture->peer, buf + sent, len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (n < 0 && errno != EAGAIN && errno != EINTR)
+				break;
+			if (n > 0)
+				sent += n;
+			if (sent == len)
+				pending = FALSE;
+		}
+	}
+
+	g_atomic_int_set(&capture->done, !pending && feof(capture->file));
+	shutdown(capture->peer, SHUT_WR);
+	g_free(buf);
+	return NULL;
+}
+
+static gboolean remmina_vnc_capture_socketpair(RemminaVncCapture *capture, gint *sock, GError **error)
+{
+	gint fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "socketpair: %s", g_strerror(errno));
+		return FALSE;
+	}
+	capture->peer = fds[0];
+	*sock = fds[1];
+	return TRUE;
+}
+
+RemminaVncCapture *remmina_vnc_capture_new(const gchar *filename, const gchar *host, gint port,
+					   gint colordepth, gint quality, gint *sock, GError **error)
+{
+	RemminaVncCapture *capture;
+	GSocketClient *client;
+	guint8 header[VNC_CAPTURE_HEADER_SIZE] = { 0 };
+	guint32 v;
+	gint fd;
+
+	capture = g_new0(RemminaVncCapture, 1);
+	capture->peer = -1;
+
+	/* The stream holds everything typed in the session, only the owner may read it.
+	 * Never reuse an existing file, it may be another capture. */
+	fd = open(filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0 || !(capture->file = fdopen(fd, "wb"))) {
+		g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "%s: %s", filename, g_strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	memcpy(header, VNC_CAPTURE_MAGIC, 8);
+	v = GUINT32_TO_LE(VNC_CAPTURE_VERSION);
+	memcpy(header + 8, &v, 4);
+	v = GUINT32_TO_LE((guint32)colordepth);
+	memcpy(header + 12, &v, 4);
+	v = GUINT32_TO_LE((guint32)quality);
+	memcpy(header + 16, &v, 4);
+	fwrite(header, 1, sizeof(header), capture->file);
+
+	client = g_socket_client_new();
+	capture->server = g_socket_client_connect_to_host(client, host, port, NULL, error);
+	g_object_unref(client);
+	if (!capture->server || !remmina_vnc_capture_socketpair(capture, sock, error)) {
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+
+	capture->start = g_get_monotonic_time();
+	if (pthread_create(&capture->thread, NULL, remmina_vnc_capture_relay, capture)) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not start the capture thread");
+		close(*sock);
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	return capture;
+}
+
+RemminaVncCapture *remmina_vnc_capture_replay(const gchar *filename, gboolean realtime,
+					      gint *colordepth, gint *quality, gint *sock, GError **error)
+{
+	RemminaVncCapture *capture;
+	guint8 header[VNC_CAPTURE_HEADER_SIZE];
+	guint32 v;
+
+	capture = g_new0(RemminaVncCapture, 1);
+	capture->peer = -1;
+	capture->replay = TRUE;
+	capture->realtime = realtime;
+
+	capture->file = fopen(filename, "rb");
+	if (!capture->file) {
+		g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno), "%s: %s", filename, g_strerror(errno));
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	if (fread(header, 1, sizeof(header), capture->file) != sizeof(header) ||
+	    memcmp(header, VNC_CAPTURE_MAGIC, 8) != 0) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s is not a VNC capture", filename);
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	memcpy(&v, header + 8, 4);
+	if (GUINT32_FROM_LE(v) != VNC_CAPTURE_VERSION) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "%s: unsupported capture version %u", filename, GUINT32_FROM_LE(v));
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	memcpy(&v, header + 12, 4);
+	*colordepth = GUINT32_FROM_LE(v);
+	memcpy(&v, header + 16, 4);
+	*quality = GUINT32_FROM_LE(v);
+
+	if (!remmina_vnc_capture_socketpair(capture, sock, error)) {
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	if (pthread_create(&capture->thread, NULL, remmina_vnc_capture_feed, capture)) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not start the replay thread");
+		close(*sock);
+		remmina_vnc_capture_free(capture);
+		return NULL;
+	}
+	return capture;
+}
+
+gboolean remmina_vnc_capture_replay_done(RemminaVncCapture *capture)
+{
+	return capture && capture->replay && g_atomic_int_get(&capture->done);
+}
+
+void remmina_vnc_capture_free(RemminaVncCapture *capture)
+{
+	if (!capture)
+		return;
+
+	if (capture->thread) {
+		/* Wakes up the thread whatever it waits for */
+		shutdown(capture->peer, SHUT_RDWR);
+		if (capture->server)
+			g_socket_shutdown(g_socket_connection_get_socket(capture->server), TRUE, TRUE, NULL);
+		pthread_join(capture->thread, NULL);
+	}
+	if (capture->peer >= 0)
+		close(capture->peer);
+	if (capture->server)
+		g_object_unref(capture->server);
+	if (capture->file)
+		fclose(capture->file);
+	g_free(capture);
+}
@@ -0,0 +1,70 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Capture and replay of the raw VNC stream, to measure the decoding and
+ * rendering path without a server.
+ *
+ * Capturing connects to the server itself and hands libvncclient one end
+ * of a socket pair; a relay thread copies both directions and appends
+ * what the server sends to a .vnccap file with timestamps. Replaying
+ * feeds such a file to the same kind of socket pair, as fast as the
+ * client reads it or with the recorded timing, and discards whatever the
+ * client sends back. Since the bytes are captured on the wire, only
+ * sessions without RFB level encryption can be replayed.
+ *
+ * File layout, little endian:
+ *   "RMNAVNC\0", guint32 version, guint32 colordepth, guint32 quality, guint32 reserved
+ *   then records of gint64 microseconds since the start, guint32 length, data
+ */
+
+typedef struct _RemminaVncCapture RemminaVncCapture;
+
+/* Returns the socket libvncclient has to use in *sock */
+RemminaVncCapture *remmina_vnc_capture_new(const gchar *filename, const gchar *host, gint port,
+					   gint colordepth, gint quality, gint *sock, GError **error);
+/* colordepth and quality are the ones of the captured session, the replay must ask for the same */
+RemminaVncCapture *remmina_vnc_capture_replay(const gchar *filename, gboolean realtime,
+					      gint *colordepth, gint *quality, gint *sock, GError **error);
+/* The replay has sent everything */
+gboolean remmina_vnc_capture_replay_done(RemminaVncCapture *capture);
+void remmina_vnc_capture_free(RemminaVncCapture *capture);
+
+G_END_DECLS
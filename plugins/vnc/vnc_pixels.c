@@ -0,0 +1,178 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include <arpa/inet.h>
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_pixels.h"
+
+static gint remmina_plugin_vnc_pixels_bits(gint n)
+{
+	TRACE_CALL(__func__);
+	gint b = 0;
+
+	while (n) {
+		b++;
+		n >>= 1;
+	}
+	return b ? b : 1;
+}
+
+void remmina_plugin_vnc_pixels_format(rfbPixelFormat *format, gint colordepth)
+{
+	TRACE_CALL(__func__);
+
+	format->trueColour = 1;
+	format->bigEndian = G_BYTE_ORDER == G_BIG_ENDIAN;
+
+	switch (colordepth) {
+	case 8:
+		format->depth = 8;
+		format->bitsPerPixel = 8;
+		format->blueMax = 3;
+		format->blueShift = 6;
+		format->greenMax = 7;
+		format->greenShift = 3;
+		format->redMax = 7;
+		format->redShift = 0;
+		break;
+	case 16:
+		format->depth = 15;
+		format->bitsPerPixel = 16;
+		format->redShift = 11;
+		format->greenShift = 6;
+		format->blueShift = 1;
+		format->redMax = 31;
+		format->greenMax = 31;
+		format->blueMax = 31;
+		break;
+	case 32:
+	default:
+		format->depth = 24;
+		format->bitsPerPixel = 32;
+		format->blueShift = 0;
+		format->redShift = 16;
+		format->greenShift = 8;
+		format->blueMax = 0xff;
+		format->redMax = 0xff;
+		format->greenMax = 0xff;
+		break;
+	}
+}
+
+void remmina_plugin_vnc_pixels_fill(const rfbPixelFormat *format, guchar *dest, gint dest_rowstride,
+				    guchar *src, gint src_rowstride, guchar *mask, gint w, gint h)
+{
+	TRACE_CALL(__func__);
+	guchar *srcptr;
+	gint bytesPerPixel;
+	guint32 src_pixel;
+	gint ix, iy;
+	gint i;
+	guchar c;
+	gint rs, gs, bs, rm, gm, bm, rl, gl, bl, rr, gr, br;
+	gint r;
+	guint32 *destptr;
+
+	union {
+		struct {
+			guchar a, r, g, b;
+		} colors;
+		guint32 argb;
+	} dst_pixel;
+
+	bytesPerPixel = format->bitsPerPixel / 8;
+	switch (format->bitsPerPixel) {
+	case 32:
+		/* The following codes fill in the Alpha channel swap red/green value */
+		for (iy = 0; iy < h; iy++) {
+			destptr = (guint32 *)(dest + iy * dest_rowstride);
+			srcptr = src + iy * src_rowstride;
+			for (ix = 0; ix < w; ix++) {
+				if (!mask || *mask++) {
+					dst_pixel.colors.a = 0xff;
+					dst_pixel.colors.r = *(srcptr + 2);
+					dst_pixel.colors.g = *(srcptr + 1);
+					dst_pixel.colors.b = *srcptr;
+					*destptr++ = ntohl(dst_pixel.argb);
+				} else {
+					*destptr++ = 0;
+				}
+				srcptr += 4;
+			}
+		}
+		break;
+	default:
+		rm = format->redMax;
+		gm = format->greenMax;
+		bm = format->blueMax;
+		rr = remmina_plugin_vnc_pixels_bits(rm);
+		gr = remmina_plugin_vnc_pixels_bits(gm);
+		br = remmina_plugin_vnc_pixels_bits(bm);
+		rl = 8 - rr;
+		gl = 8 - gr;
+		bl = 8 - br;
+		rs = format->redShift;
+		gs = format->greenShift;
+		bs = format->blueShift;
+		for (iy = 0; iy < h; iy++) {
+			destptr = (guint32 *)(dest + iy * dest_rowstride);
+			srcptr = src + iy * src_rowstride;
+			for (ix = 0; ix < w; ix++) {
+				src_pixel = 0;
+				for (i = 0; i < bytesPerPixel; i++)
+					src_pixel += (*srcptr++) << (8 * i);
+
+				if (!mask || *mask++) {
+					dst_pixel.colors.a = 0xff;
+					c = (guchar)((src_pixel >> rs) & rm) << rl;
+					for (r = rr; r < 8; r *= 2)
+						c |= c >> r;
+					dst_pixel.colors.r = c;
+					c = (guchar)((src_pixel >> gs) & gm) << gl;
+					for (r = gr; r < 8; r *= 2)
+						c |= c >> r;
+					dst_pixel.colors.g = c;
+					c = (guchar)((src_pixel >> bs) & bm) << bl;
+					for (r = br; r < 8; r *= 2)
+						c |= c >> r;
+					dst_pixel.colors.b = c;
+					*destptr++ = ntohl(dst_pixel.argb);
+				} else {
+					*destptr++ = 0;
+				}
+			}
+		}
+		break;
+	}
+}
@@ -38,6 +38,7 @@
 #include <gmodule.h>
 #include "vnc_plugin.h"
 #include <rfb/rfbclient.h>
+#include <time.h>
 
 #ifdef HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
@@ -55,11 +56,25 @@
 #define REMMINA_PLUGIN_VNC_FEATURE_DYNRESUPDATE 	       10
 
 #define VNC_DEFAULT_PORT 5900
+/* A hidden session reads one server message at most every VNC_HIDDEN_POLL_US */
+#define VNC_HIDDEN_POLL_US (5 * G_USEC_PER_SEC)
 
 #define GET_PLUGIN_DATA(gp) (RemminaPluginVncData *)g_object_get_data(G_OBJECT(gp), "plugin-data")
 
 static RemminaPluginService *remmina_plugin_service = NULL;
 
+/* CPU time of the calling thread in microseconds, to account the replay stages.
+ * Always 0 outside of a replay, live sessions do not pay for the clock reads. */
+static gint64 remmina_plugin_vnc_thread_cpu(RemminaPluginVncData *gpdata)
+{
+	struct timespec ts;
+
+	if (!gpdata->replay)
+		return 0;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
 static int dot_cursor_x_hot = 2;
 static int dot_cursor_y_hot = 2;
 static const gchar *dot_cursor_xpm[] =
@@ -125,18 +140,6 @@ static void onMainThread_schedule_callback_and_wait(struct onMainThread_cb_data
 	pthread_mutex_destroy(&d->mu);
 }
 
-/**
- * Function check_for_endianness() returns 1, if architecture
- * is little endian, 0 in case of big endian.
- */
-static gboolean check_for_endianness(void)
-{
-	unsigned int x = 1;
-	char *c = (char *)&x;
-
-	return (int)*c;
-}
-
 static void remmina_plugin_vnc_event_push(RemminaProtocolWidget *gp, gint event_type, gpointer p1, gpointer p2, gpointer p3)
 {
 	TRACE_CALL(__func__);
@@ -325,6 +328,49 @@ static RemminaPluginVncEvent *remmina_plugin_vnc_event_queue_pop_head(RemminaPlu
 	return event;
 }
 
+/* Size of a PointerEvent message, and of the IPv4 and TCP headers without
+ * options spared by every segment not sent */
+#define VNC_POINTER_EVENT_SIZE 6
+#define VNC_TCPIP_HEADER_SIZE  40
+
+/* Whether the next queued event is a pointer motion with the same buttons,
+ * making this one pointless in a batch */
+static gboolean remmina_plugin_vnc_event_superseded(RemminaPluginVncData *gpdata, RemminaPluginVncEvent *event)
+{
+	RemminaPluginVncEvent *next;
+	gboolean superseded;
+
+	if (event->event_type != REMMINA_PLUGIN_VNC_EVENT_POINTER)
+		return FALSE;
+
+	CANCEL_DEFER
+	pthread_mutex_lock(&gpdata->vnc_event_queue_mutex);
+
+	next = g_queue_peek_head(gpdata->vnc_event_queue);
+	superseded = next && next->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER &&
+		     next->event_data.pointer.button_mask == event->event_data.pointer.button_mask;
+
+	pthread_mutex_unlock(&gpdata->vnc_event_queue_mutex);
+	CANCEL_ASYNC
+
+	return superseded;
+}
+
+/* Holds back writes while cork is TRUE, then flushes them as few segments as possible */
+static void remmina_plugin_vnc_cork(rfbClient *cl, gboolean cork)
+{
+	TRACE_CALL(__func__);
+	int optval = cork;
+
+#if defined(HAVE_NETINET_TCP_H) && defined(TCP_CORK)
+	setsockopt(cl->sock, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
+#elif defined(HAVE_NETINET_TCP_H) && defined(TCP_NOPUSH)
+	setsockopt(cl->sock, IPPROTO_TCP, TCP_NOPUSH, &optval, sizeof(optval));
+#else
+	(void)optval;
+#endif
+}
+
 static void remmina_plugin_vnc_process_vnc_event(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -332,17 +378,31 @@ static void remmina_plugin_vnc_process_vnc_event(RemminaProtocolWidget *gp)
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	rfbClient *cl;
 	gchar buf[100];
+	gboolean batched;
+	gint sent = 0, coalesced = 0, packets_saved;
 
 	cl = (rfbClient *)gpdata->client;
+	/* libvncclient writes each message to the socket at once, batching
+	 * merges them into one TCP segment instead */
+	batched = cl && gpdata->input_mode == REMMINA_PLUGIN_VNC_INPUT_MODE_BATCHED;
+	if (batched)
+		remmina_plugin_vnc_cork(cl, TRUE);
 	while ((event = remmina_plugin_vnc_event_queue_pop_head(gpdata)) != NULL) {
+		if (batched && remmina_plugin_vnc_event_superseded(gpdata, event)) {
+			coalesced++;
+			remmina_plugin_vnc_event_free(event);
+			continue;
+		}
 		if (cl) {
 			switch (event->event_type) {
 			case REMMINA_PLUGIN_VNC_EVENT_KEY:
 				SendKeyEvent(cl, event->event_data.key.keyval, event->event_data.key.pressed);
+				sent++;
 				break;
 			case REMMINA_PLUGIN_VNC_EVENT_POINTER:
 				SendPointerEvent(cl, event->event_data.pointer.x, event->event_data.pointer.y,
 						 event->event_data.pointer.button_mask);
+				sent++;
 				break;
 			case REMMINA_PLUGIN_VNC_EVENT_CUTTEXT:
 				if (event->event_data.text.text) {
@@ -360,6 +420,13 @@ static void remmina_plugin_vnc_process_vnc_event(RemminaProtocolWidget *gp)
 				TextChatClose(cl);
 				TextChatFinish(cl);
 				break;
+			case REMMINA_PLUGIN_VNC_EVENT_RESYNC:
+				/* Conversions were skipped while hidden, get a whole new frame */
+				if (gpdata->resync_pending) {
+					gpdata->resync_pending = FALSE;
+					SendFramebufferUpdateRequest(cl, 0, 0, cl->width, cl->height, FALSE);
+				}
+				break;
 			default:
 				rfbClientLog("Ignoring VNC event: 0x%x\n", event->event_type);
 				break;
@@ -370,6 +437,17 @@ static void remmina_plugin_vnc_process_vnc_event(RemminaProtocolWidget *gp)
 	if (read(gpdata->vnc_event_pipe[0], buf, sizeof(buf))) {
 		/* Ignore */
 	}
+
+	if (batched) {
+		remmina_plugin_vnc_cork(cl, FALSE);
+		packets_saved = coalesced + (sent > 1 ? sent - 1 : 0);
+		if (packets_saved > 0) {
+			remmina_plugin_service->protocol_widget_metrics_add(gp, REMMINA_METRICS_INPUT_PACKETS_SAVED, packets_saved);
+			remmina_plugin_service->protocol_widget_metrics_add(gp, REMMINA_METRICS_INPUT_BYTES_SAVED,
+									    coalesced * VNC_POINTER_EVENT_SIZE +
+									    packets_saved * VNC_TCPIP_HEADER_SIZE);
+		}
+	}
 }
 
 typedef struct _RemminaPluginVncCuttextParam {
@@ -439,45 +517,8 @@ static void remmina_plugin_vnc_update_colordepth(rfbClient *cl, gint colordepth)
 {
 	TRACE_CALL(__func__);
 
-	cl->format.depth = colordepth;
 	cl->appData.requestedDepth = colordepth;
-
-	cl->format.trueColour = 1;
-	cl->format.bigEndian = check_for_endianness()?FALSE:TRUE;
-
-	switch (colordepth) {
-	case 8:
-		cl->format.depth = 8;
-		cl->format.bitsPerPixel = 8;
-		cl->format.blueMax = 3;
-		cl->format.blueShift = 6;
-		cl->format.greenMax = 7;
-		cl->format.greenShift = 3;
-		cl->format.redMax = 7;
-		cl->format.redShift = 0;
-		break;
-	case 16:
-		cl->format.depth = 15;
-		cl->format.bitsPerPixel = 16;
-		cl->format.redShift = 11;
-		cl->format.greenShift = 6;
-		cl->format.blueShift = 1;
-		cl->format.redMax = 31;
-		cl->format.greenMax = 31;
-		cl->format.blueMax = 31;
-		break;
-	case 32:
-	default:
-		cl->format.depth = 24;
-		cl->format.bitsPerPixel = 32;
-		cl->format.blueShift = 0;
-		cl->format.redShift = 16;
-		cl->format.greenShift = 8;
-		cl->format.blueMax = 0xff;
-		cl->format.redMax = 0xff;
-		cl->format.greenMax = 0xff;
-		break;
-	}
+	remmina_plugin_vnc_pixels_format(&cl->format, colordepth);
 
 	rfbClientLog("colordepth          = %d\n", colordepth);
 	rfbClientLog("format.depth        = %d\n", cl->format.depth);
@@ -500,6 +541,7 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	gint width, height, depth, size;
 	gboolean scale;
 	cairo_surface_t *new_surface, *old_surface;
+	cairo_rectangle_int_t rect;
 
 	width = cl->width;
 	height = cl->height;
@@ -517,6 +559,10 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	remmina_plugin_service->protocol_plugin_set_height(gp, height);
 
 	gpdata->rgb_buffer = new_surface;
+	rect.x = rect.y = 0;
+	rect.width = width;
+	rect.height = height;
+	cairo_region_union_rectangle(gpdata->fb_damage, &rect);
 
 	if (gpdata->vnc_buffer)
 		g_free(gpdata->vnc_buffer);
@@ -541,23 +587,12 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	return TRUE;
 }
 
-static gint remmina_plugin_vnc_bits(gint n)
-{
-	TRACE_CALL(__func__);
-	gint b = 0;
-
-	while (n) {
-		b++;
-		n >>= 1;
-	}
-	return b ? b : 1;
-}
-
 static gboolean remmina_plugin_vnc_queue_draw_area_real(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	gint x, y, w, h;
+	gint dx, dy, dw, dh;
 
 	if (GTK_IS_WIDGET(gp) && gpdata->connected) {
 		LOCK_BUFFER(FALSE)
@@ -566,8 +601,15 @@ static gboolean remmina_plugin_vnc_queue_draw_area_real(RemminaProtocolWidget *g
 		w = gpdata->queuedraw_w;
 		h = gpdata->queuedraw_h;
 		gpdata->queuedraw_handler = 0;
+		dx = gpdata->damage_x1;
+		dy = gpdata->damage_y1;
+		dw = gpdata->damage_x2 - dx;
+		dh = gpdata->damage_y2 - dy;
+		gpdata->damage_x1 = gpdata->damage_y1 = G_MAXINT;
+		gpdata->damage_x2 = gpdata->damage_y2 = 0;
 		UNLOCK_BUFFER(FALSE)
 
+		remmina_plugin_service->protocol_widget_damage(gp, dx, dy, dw, dh);
 		gtk_widget_queue_draw_area(GTK_WIDGET(gp), x, y, w, h);
 	}
 	return FALSE;
@@ -599,93 +641,6 @@ static void remmina_plugin_vnc_queue_draw_area(RemminaProtocolWidget *gp, gint x
 	UNLOCK_BUFFER(TRUE)
 }
 
-static void remmina_plugin_vnc_rfb_fill_buffer(rfbClient *cl, guchar *dest, gint dest_rowstride, guchar *src,
-					       gint src_rowstride, guchar *mask, gint w, gint h)
-{
-	TRACE_CALL(__func__);
-	guchar *srcptr;
-	gint bytesPerPixel;
-	guint32 src_pixel;
-	gint ix, iy;
-	gint i;
-	guchar c;
-	gint rs, gs, bs, rm, gm, bm, rl, gl, bl, rr, gr, br;
-	gint r;
-	guint32 *destptr;
-
-	union {
-		struct {
-			guchar a, r, g, b;
-		} colors;
-		guint32 argb;
-	} dst_pixel;
-
-	bytesPerPixel = cl->format.bitsPerPixel / 8;
-	switch (cl->format.bitsPerPixel) {
-	case 32:
-		/* The following codes fill in the Alpha channel swap red/green value */
-		for (iy = 0; iy < h; iy++) {
-			destptr = (guint32 *)(dest + iy * dest_rowstride);
-			srcptr = src + iy * src_rowstride;
-			for (ix = 0; ix < w; ix++) {
-				if (!mask || *mask++) {
-					dst_pixel.colors.a = 0xff;
-					dst_pixel.colors.r = *(srcptr + 2);
-					dst_pixel.colors.g = *(srcptr + 1);
-					dst_pixel.colors.b = *srcptr;
-					*destptr++ = ntohl(dst_pixel.argb);
-				} else {
-					*destptr++ = 0;
-				}
-				srcptr += 4;
-			}
-		}
-		break;
-	default:
-		rm = cl->format.redMax;
-		gm = cl->format.greenMax;
-		bm = cl->format.blueMax;
-		rr = remmina_plugin_vnc_bits(rm);
-		gr = remmina_plugin_vnc_bits(gm);
-		br = remmina_plugin_vnc_bits(bm);
-		rl = 8 - rr;
-		gl = 8 - gr;
-		bl = 8 - br;
-		rs = cl->format.redShift;
-		gs = cl->format.greenShift;
-		bs = cl->format.blueShift;
-		for (iy = 0; iy < h; iy++) {
-			destptr = (guint32 *)(dest + iy * dest_rowstride);
-			srcptr = src + iy * src_rowstride;
-			for (ix = 0; ix < w; ix++) {
-				src_pixel = 0;
-				for (i = 0; i < bytesPerPixel; i++)
-					src_pixel += (*srcptr++) << (8 * i);
-
-				if (!mask || *mask++) {
-					dst_pixel.colors.a = 0xff;
-					c = (guchar)((src_pixel >> rs) & rm) << rl;
-					for (r = rr; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.r = c;
-					c = (guchar)((src_pixel >> gs) & gm) << gl;
-					for (r = gr; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.g = c;
-					c = (guchar)((src_pixel >> bs) & bm) << bl;
-					for (r = br; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.b = c;
-					*destptr++ = ntohl(dst_pixel.argb);
-				} else {
-					*destptr++ = 0;
-				}
-			}
-		}
-		break;
-	}
-}
-
 static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w, int h)
 {
 	TRACE_CALL(__func__);
@@ -694,18 +649,38 @@ static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w,
 	gint bytesPerPixel;
 	gint rowstride;
 	gint width;
+	gint64 cpu;
+	cairo_rectangle_int_t rect;
+
+	/* Nobody looks at a hidden session, skip the conversion until it is shown again.
+	 * A thumbnail still wants the (throttled) updates. */
+	if (g_atomic_int_get(&gpdata->hidden) && !remmina_plugin_service->protocol_widget_framebuffer_wanted(gp)) {
+		gpdata->resync_pending = TRUE;
+		return;
+	}
 
 	LOCK_BUFFER(TRUE)
 
 	if (w >= 1 || h >= 1) {
+		cpu = remmina_plugin_vnc_thread_cpu(gpdata);
+		gpdata->damage_x1 = MIN(gpdata->damage_x1, x);
+		gpdata->damage_y1 = MIN(gpdata->damage_y1, y);
+		gpdata->damage_x2 = MAX(gpdata->damage_x2, x + w);
+		gpdata->damage_y2 = MAX(gpdata->damage_y2, y + h);
+		rect.x = x;
+		rect.y = y;
+		rect.width = w;
+		rect.height = h;
+		cairo_region_union_rectangle(gpdata->fb_damage, &rect);
 		width = remmina_plugin_service->protocol_plugin_get_width(gp);
 		bytesPerPixel = cl->format.bitsPerPixel / 8;
 		rowstride = cairo_image_surface_get_stride(gpdata->rgb_buffer);
 		cairo_surface_flush(gpdata->rgb_buffer);
-		remmina_plugin_vnc_rfb_fill_buffer(cl, cairo_image_surface_get_data(gpdata->rgb_buffer) + y * rowstride + x * 4,
+		remmina_plugin_vnc_pixels_fill(&cl->format, cairo_image_surface_get_data(gpdata->rgb_buffer) + y * rowstride + x * 4,
 						   rowstride, gpdata->vnc_buffer + ((y * width + x) * bytesPerPixel), width * bytesPerPixel, NULL,
 						   w, h);
 		cairo_surface_mark_dirty(gpdata->rgb_buffer);
+		gpdata->cpu_convert += remmina_plugin_vnc_thread_cpu(gpdata) - cpu;
 	}
 
 	if ((remmina_plugin_service->remmina_protocol_widget_get_current_scale_mode(gp) != REMMINA_PROTOCOL_WIDGET_SCALE_MODE_NONE))
@@ -713,14 +688,19 @@ static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w,
 
 	UNLOCK_BUFFER(TRUE)
 
+	remmina_plugin_service->protocol_widget_metrics_add(gp, REMMINA_METRICS_FRAMES, 1);
 	remmina_plugin_vnc_queue_draw_area(gp, x, y, w, h);
 }
 
-static void remmina_plugin_vnc_rfb_finished(rfbClient *cl) __attribute__ ((unused));
 static void remmina_plugin_vnc_rfb_finished(rfbClient *cl)
 {
 	TRACE_CALL(__func__);
-	REMMINA_PLUGIN_DEBUG("FinishedFrameBufferUpdate");
+	RemminaProtocolWidget *gp = rfbClientGetClientData(cl, NULL);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+
+	/* One FramebufferUpdate message, whatever its number of rectangles */
+	gpdata->frames++;
+	remmina_plugin_service->protocol_widget_metrics_sample_socket(gp, cl->sock);
 }
 
 static void remmina_plugin_vnc_rfb_led_state(rfbClient *cl, int value, int pad)
@@ -783,6 +763,9 @@ remmina_plugin_vnc_rfb_password(rfbClient *cl)
 	gchar *pwd = NULL;
 
 	gpdata->auth_called = TRUE;
+	/* The response goes nowhere, the capture holds the server verdict */
+	if (gpdata->replay)
+		return g_strdup("");
 	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 
 	if (gpdata->auth_first)
@@ -829,6 +812,12 @@ remmina_plugin_vnc_rfb_credential(rfbClient *cl, int credentialType)
 
 	cred = g_new0(rfbCredential, 1);
 
+	if (gpdata->replay && credentialType == rfbCredentialTypeUser) {
+		cred->userCredential.username = g_strdup("");
+		cred->userCredential.password = g_strdup("");
+		return cred;
+	}
+
 	switch (credentialType) {
 	case rfbCredentialTypeUser:
 
@@ -913,7 +902,7 @@ static void remmina_plugin_vnc_rfb_cursor_shape(rfbClient *cl, int xhot, int yho
 	if (width && height) {
 		gint stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
 		guchar *data = g_malloc(stride * height);
-		remmina_plugin_vnc_rfb_fill_buffer(cl, data, stride, cl->rcSource,
+		remmina_plugin_vnc_pixels_fill(&cl->format, data, stride, cl->rcSource,
 						   width * cl->format.bitsPerPixel / 8, cl->rcMask, width, height);
 		cairo_surface_t *surface = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, width, height, stride);
 		if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
@@ -1117,6 +1106,22 @@ static gboolean remmina_plugin_vnc_incoming_connection(RemminaProtocolWidget *gp
 }
 
 
+static void remmina_plugin_vnc_replay_report(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	gdouble elapsed;
+
+	/* remmina-bench "vnc_replay" is the measurement, this is only a hint for the debug log */
+	elapsed = (g_get_monotonic_time() - gpdata->replay_start) / (gdouble)G_USEC_PER_SEC;
+	REMMINA_PLUGIN_DEBUG("Replay: %d frames in %.3f s, cpu ms decode %.1f convert %.1f render %.1f",
+			     gpdata->frames, elapsed, gpdata->cpu_decode / 1000.0, gpdata->cpu_convert / 1000.0,
+			     gpdata->cpu_render / 1000.0);
+
+	if (!remmina_vnc_capture_replay_done(gpdata->capture))
+		remmina_plugin_service->protocol_plugin_set_error(gp, "The VNC capture could not be replayed to the end");
+}
+
 static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -1126,6 +1131,9 @@ static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 	rfbClient *cl;
 	fd_set fds;
 	struct timeval timeout;
+	gboolean poll_server = TRUE;
+	gboolean handled;
+	gint64 now, cpu, convert;
 
 	if (!gpdata->connected) {
 		gpdata->running = FALSE;
@@ -1134,20 +1142,47 @@ static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 
 	cl = (rfbClient *)gpdata->client;
 
+	/* libvncclient asks for the next update after handling one: reading the
+	 * server rarely while hidden also throttles the update requests */
+	timeout.tv_sec = 10;
+	timeout.tv_usec = 0;
+	if (g_atomic_int_get(&gpdata->hidden)) {
+		now = g_get_monotonic_time();
+		if (now - gpdata->hidden_poll_time < VNC_HIDDEN_POLL_US) {
+			poll_server = FALSE;
+			timeout.tv_sec = (VNC_HIDDEN_POLL_US - (now - gpdata->hidden_poll_time)) / G_USEC_PER_SEC;
+			timeout.tv_usec = (VNC_HIDDEN_POLL_US - (now - gpdata->hidden_poll_time)) % G_USEC_PER_SEC;
+		} else {
+			gpdata->hidden_poll_time = now;
+		}
+	}
+
+	/* A batch of input waits for its deadline, the pending events must not wake us up */
+	if (gpdata->input_batch_deadline) {
+		now = g_get_monotonic_time();
+		if (now >= gpdata->input_batch_deadline) {
+			gpdata->input_batch_deadline = 0;
+			remmina_plugin_vnc_process_vnc_event(gp);
+		} else if (gpdata->input_batch_deadline - now < timeout.tv_sec * G_USEC_PER_SEC + timeout.tv_usec) {
+			timeout.tv_sec = (gpdata->input_batch_deadline - now) / G_USEC_PER_SEC;
+			timeout.tv_usec = (gpdata->input_batch_deadline - now) % G_USEC_PER_SEC;
+		}
+	}
+
 	/*
 	 * Do not explicitly wait while data is on the buffer, see:
 	 * - https://jira.glyptodon.com/browse/GUAC-1056
 	 * - https://jira.glyptodon.com/browse/GUAC-1056?focusedCommentId=14348&page=com.atlassian.jira.plugin.system.issuetabpanels:comment-tabpanel#comment-14348
 	 * - https://github.com/apache/guacamole-server/blob/67680bd2d51e7949453f0f7ffc7f4234a1136715/src/protocols/vnc/vnc.c#L155
 	 */
-	if (cl->buffered)
+	if (cl->buffered && poll_server)
 		goto handle_buffered;
 
-	timeout.tv_sec = 10;
-	timeout.tv_usec = 0;
 	FD_ZERO(&fds);
-	FD_SET(cl->sock, &fds);
-	FD_SET(gpdata->vnc_event_pipe[0], &fds);
+	if (poll_server)
+		FD_SET(cl->sock, &fds);
+	if (!gpdata->input_batch_deadline)
+		FD_SET(gpdata->vnc_event_pipe[0], &fds);
 	ret = select(MAX(cl->sock, gpdata->vnc_event_pipe[0]) + 1, &fds, NULL, NULL, &timeout);
 
 	/* Sometimes it returns <0 when opening a modal dialog in other window. Absolutely weird */
@@ -1155,17 +1190,29 @@ static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 	if (ret <= 0)
 		return TRUE;
 
-	if (FD_ISSET(gpdata->vnc_event_pipe[0], &fds))
-		remmina_plugin_vnc_process_vnc_event(gp);
-	if (FD_ISSET(cl->sock, &fds)) {
+	if (FD_ISSET(gpdata->vnc_event_pipe[0], &fds)) {
+		/* The events following this one get the latency budget to join its batch */
+		if (gpdata->input_mode == REMMINA_PLUGIN_VNC_INPUT_MODE_BATCHED && gpdata->input_latency_budget > 0)
+			gpdata->input_batch_deadline = g_get_monotonic_time() + gpdata->input_latency_budget;
+		else
+			remmina_plugin_vnc_process_vnc_event(gp);
+	}
+	if (poll_server && FD_ISSET(cl->sock, &fds)) {
 		i = WaitForMessage(cl, 500);
 		if (i < 0)
 			return TRUE;
 handle_buffered:
-		if (!HandleRFBServerMessage(cl)) {
+		cpu = remmina_plugin_vnc_thread_cpu(gpdata);
+		convert = gpdata->cpu_convert;
+		handled = HandleRFBServerMessage(cl);
+		gpdata->cpu_decode += remmina_plugin_vnc_thread_cpu(gpdata) - cpu - (gpdata->cpu_convert - convert);
+		if (!handled) {
 			gpdata->running = FALSE;
-			// TCP_USER_TIMEOUT should handle connection timeout
-			remmina_plugin_service->protocol_plugin_set_error(gp, "VNC connection timed out");
+			if (gpdata->replay)
+				remmina_plugin_vnc_replay_report(gp);
+			else
+				// TCP_USER_TIMEOUT should handle connection timeout
+				remmina_plugin_service->protocol_plugin_set_error(gp, "VNC connection timed out");
 			if (gpdata->connected && !remmina_plugin_service->protocol_plugin_is_closed(gp)) {
 				remmina_plugin_service->protocol_plugin_signal_connection_closed(gp);
 			}
@@ -1176,6 +1223,64 @@ handle_buffered:
 	return TRUE;
 }
 
+/* Connects through a relay recording the stream to <recording_path>/remmina_vnc_<server>_<date>.vnccap */
+static void remmina_plugin_vnc_capture_start(RemminaProtocolWidget *gp, rfbClient *cl, gint colordepth, gint quality)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	GDateTime *now;
+	GError *error = NULL;
+	gchar *dir, *date, *name, *filename;
+	gint sock, i;
+
+	dir = remmina_plugin_service->pref_get_value("recording_path");
+	if (!dir || !dir[0]) {
+		g_free(dir);
+		dir = g_strdup(g_get_user_special_dir(G_USER_DIRECTORY_VIDEOS));
+		if (!dir)
+			dir = g_strdup(g_get_home_dir());
+	}
+	now = g_date_time_new_now_local();
+	date = g_date_time_format(now, "%Y%m%d-%H%M%S");
+	g_mkdir_with_parents(dir, 0700);
+
+	/* A retry after an authentication failure starts a new capture,
+	 * possibly within the same second */
+	remmina_vnc_capture_free(gpdata->capture);
+	for (i = 0; i < 100; i++) {
+		if (i == 0)
+			name = g_strdup_printf("remmina_vnc_%s_%s.vnccap", cl->serverHost, date);
+		else
+			name = g_strdup_printf("remmina_vnc_%s_%s-%d.vnccap", cl->serverHost, date, i);
+		g_strdelimit(name, G_DIR_SEPARATOR_S ":", '_');
+		filename = g_build_filename(dir, name, NULL);
+		gpdata->capture = remmina_vnc_capture_new(filename, cl->serverHost, cl->serverPort, colordepth, quality, &sock, &error);
+		if (gpdata->capture || !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+			break;
+		g_clear_error(&error);
+		g_free(filename);
+		g_free(name);
+		filename = name = NULL;
+	}
+	if (gpdata->capture) {
+		REMMINA_PLUGIN_DEBUG("Capturing the VNC stream to %s", filename);
+		cl->sock = sock;
+		cl->listenSpecified = TRUE;
+		SetNonBlocking(cl->sock);
+	} else if (error) {
+		REMMINA_PLUGIN_WARNING("Could not capture the VNC stream: %s", error->message);
+		g_error_free(error);
+	} else {
+		REMMINA_PLUGIN_WARNING("Could not capture the VNC stream: too many captures named after %s", date);
+	}
+
+	g_free(filename);
+	g_free(name);
+	g_free(date);
+	g_date_time_unref(now);
+	g_free(dir);
+}
+
 static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -1185,7 +1290,11 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 	gchar *host;
 	gchar *s = NULL;
 	gint optval;
-	
+	rfbBool connected;
+	const gchar *replay_file;
+	gint replay_sock = -1;
+	GError *error = NULL;
+
 	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 	gpdata->running = TRUE;
 
@@ -1194,10 +1303,32 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 	gint colordepth = remmina_plugin_service->file_get_int(remminafile, "colordepth", 32);
 	gint quality = remmina_plugin_service->file_get_int(remminafile, "quality", 9);
 
+	gpdata->input_mode = remmina_plugin_service->file_get_int(remminafile, "input_mode", REMMINA_PLUGIN_VNC_INPUT_MODE_IMMEDIATE);
+	gpdata->input_latency_budget = CLAMP(remmina_plugin_service->file_get_int(remminafile, "input_latency_budget", 20), 0, 500) * 1000;
+
+	/* No server: the stream comes from a capture, with the settings it was made with */
+	replay_file = remmina_plugin_service->file_get_string(remminafile, "replay_file");
+	if (replay_file) {
+		gpdata->replay = TRUE;
+		gpdata->capture = remmina_vnc_capture_replay(replay_file,
+							     remmina_plugin_service->file_get_int(remminafile, "replay_realtime", FALSE),
+							     &colordepth, &quality, &replay_sock, &error);
+		if (!gpdata->capture) {
+			remmina_plugin_service->protocol_plugin_set_error(gp, "%s", error->message);
+			g_error_free(error);
+			gpdata->running = FALSE;
+			remmina_plugin_service->protocol_plugin_signal_connection_closed(gp);
+			return FALSE;
+		}
+	}
+
 	while (gpdata->connected) {
 		gpdata->auth_called = FALSE;
 
-		host = remmina_plugin_service->protocol_plugin_start_direct_tunnel(gp, VNC_DEFAULT_PORT, TRUE);
+		if (gpdata->replay)
+			host = g_strdup(replay_file);
+		else
+			host = remmina_plugin_service->protocol_plugin_start_direct_tunnel(gp, VNC_DEFAULT_PORT, TRUE);
 
 		if (host == NULL) {
 			REMMINA_PLUGIN_DEBUG("host is null");
@@ -1228,12 +1359,7 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 		cl->GetPassword = remmina_plugin_vnc_rfb_password;
 		cl->GetCredential = remmina_plugin_vnc_rfb_credential;
 		cl->GotFrameBufferUpdate = remmina_plugin_vnc_rfb_updatefb;
-		/**
-		 * @fixme we have to implement FinishedFrameBufferUpdate
-		 * This is to know when the server has finished to send a batch of frame buffer
-		 * updates.
-		 * cl->FinishedFrameBufferUpdate = remmina_plugin_vnc_rfb_finished;
-		 */
+		cl->FinishedFrameBufferUpdate = remmina_plugin_vnc_rfb_finished;
 		/**
 		 * @fixme we have to implement HandleKeyboardLedState
 		 * cl->HandleKeyboardLedState = remmina_plugin_vnc_rfb_led_state
@@ -1252,7 +1378,12 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 
 		rfbClientSetClientData(cl, NULL, gp);
 
-		if (host[0] == '\0') {
+		if (gpdata->replay) {
+			cl->serverHost = g_strdup(host);
+			cl->listenSpecified = TRUE;
+			cl->sock = replay_sock;
+			SetNonBlocking(cl->sock);
+		} else if (host[0] == '\0') {
 			cl->serverHost = g_strdup(host);
 			cl->listenSpecified = TRUE;
 			if (remmina_plugin_service->file_get_int(remminafile, "ssh_tunnel_enabled", FALSE))
@@ -1297,6 +1428,11 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 			REMMINA_PLUGIN_DEBUG("cl->destPort: %d", cl->destPort);
 		}
 
+		/* Plain TCP connections only, the relay cannot follow a repeater or a UNIX socket */
+		if (!gpdata->replay && !cl->listenSpecified && !cl->destHost && cl->serverPort > 0 &&
+		    remmina_plugin_service->file_get_int(remminafile, "capture_traffic", FALSE))
+			remmina_plugin_vnc_capture_start(gp, cl, colordepth, quality);
+
 		int showcursor = remmina_plugin_service->file_get_int(remminafile, "showcursor", FALSE);
 
 		cl->appData.useRemoteCursor = (showcursor ? FALSE : TRUE);
@@ -1319,14 +1455,19 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 			cl->appData.encodingsString = "zrle ultra copyrect hextile zlib corre rre raw";
 		SetFormatAndEncodings(cl);
 
-		if (remmina_plugin_service->file_get_int(remminafile, "disableencryption", FALSE)) {
+		/* A capture is only useful if the stream can be decoded without the session keys */
+		if (remmina_plugin_service->file_get_int(remminafile, "disableencryption", FALSE) || gpdata->capture) {
 			vnc_encryption_disable_requested = TRUE;
 			SetClientAuthSchemes(cl, remmina_plugin_vnc_no_encrypt_auth_types, -1);
 		} else {
 			vnc_encryption_disable_requested = FALSE;
 		}
 
-		if (rfbInitClient(cl, NULL, NULL)) {
+		remmina_plugin_service->protocol_widget_metrics_phase(gp, "vnc_connect", TRUE);
+		gpdata->replay_start = g_get_monotonic_time();
+		connected = rfbInitClient(cl, NULL, NULL);
+		remmina_plugin_service->protocol_widget_metrics_phase(gp, "vnc_connect", FALSE);
+		if (connected) {
 			if (cl->sock) {
 #ifdef HAVE_NETINET_TCP_H
 				// SO_KEEPALIVE = good connection should not be closed due to inactivity
@@ -1346,6 +1487,13 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 					REMMINA_PLUGIN_DEBUG("TCP_USER_TIMEOUT set to %i seconds", optval/1000);
 				}
 #endif // TCP_USER_TIMEOUT
+				optval = gpdata->input_mode != REMMINA_PLUGIN_VNC_INPUT_MODE_NAGLE;
+				if (setsockopt(cl->sock, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) < 0) {
+					REMMINA_PLUGIN_DEBUG("TCP_NODELAY not set");
+				}
+				else {
+					REMMINA_PLUGIN_DEBUG("TCP_NODELAY %s", optval ? "enabled" : "disabled");
+				}
 #endif // HAVE_NETINET_TCP_H
 			}
 			else {
@@ -1357,6 +1505,13 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 			REMMINA_PLUGIN_DEBUG("Client initialization failed");
 		}
 
+		/* A replay cannot be retried, the capture has been consumed */
+		if (gpdata->replay) {
+			remmina_plugin_service->protocol_plugin_set_error(gp, "Could not replay %s: %s", replay_file, vnc_error);
+			gpdata->connected = FALSE;
+			break;
+		}
+
 		/* If the authentication is not called, it has to be a fatal error and must quit */
 		if (!gpdata->auth_called) {
 			REMMINA_PLUGIN_DEBUG("Client not authenticated");
@@ -1824,10 +1979,16 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 		rfbClientCleanup((rfbClient *)gpdata->client);
 		gpdata->client = NULL;
 	}
+	remmina_vnc_capture_free(gpdata->capture);
+	gpdata->capture = NULL;
 	if (gpdata->rgb_buffer) {
 		cairo_surface_destroy(gpdata->rgb_buffer);
 		gpdata->rgb_buffer = NULL;
 	}
+	if (gpdata->fb_snapshot) {
+		cairo_surface_destroy(gpdata->fb_snapshot);
+		gpdata->fb_snapshot = NULL;
+	}
 	if (gpdata->vnc_buffer) {
 		g_free(gpdata->vnc_buffer);
 		gpdata->vnc_buffer = NULL;
@@ -1842,6 +2003,8 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 
 
 	pthread_mutex_destroy(&gpdata->buffer_mutex);
+	cairo_region_destroy(gpdata->fb_damage);
+	gpdata->fb_damage = NULL;
 	remmina_plugin_service->protocol_plugin_signal_connection_closed(gp);
 
 	return FALSE;
@@ -1975,6 +2138,7 @@ static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context,
 	cairo_surface_t *surface;
 	gint width, height;
 	GtkAllocation widget_allocation;
+	gint64 cpu = remmina_plugin_vnc_thread_cpu(gpdata);
 
 	LOCK_BUFFER(FALSE)
 
@@ -1999,9 +2163,56 @@ static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context,
 	cairo_fill(context);
 
 	UNLOCK_BUFFER(FALSE)
+	gpdata->cpu_render += remmina_plugin_vnc_thread_cpu(gpdata) - cpu;
 	return TRUE;
 }
 
+static cairo_surface_t *remmina_plugin_vnc_get_framebuffer(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	cairo_rectangle_int_t full;
+	cairo_t *cr;
+
+	if (!gpdata || !gpdata->connected)
+		return NULL;
+
+	/* The VNC thread keeps writing rgb_buffer: bring a private copy up to
+	 * date with the area updated since the last call */
+	LOCK_BUFFER(FALSE)
+	if (!gpdata->rgb_buffer) {
+		UNLOCK_BUFFER(FALSE)
+		return NULL;
+	}
+	full.x = full.y = 0;
+	full.width = cairo_image_surface_get_width(gpdata->rgb_buffer);
+	full.height = cairo_image_surface_get_height(gpdata->rgb_buffer);
+	if (gpdata->fb_snapshot && (cairo_image_surface_get_width(gpdata->fb_snapshot) != full.width ||
+				    cairo_image_surface_get_height(gpdata->fb_snapshot) != full.height)) {
+		cairo_surface_destroy(gpdata->fb_snapshot);
+		gpdata->fb_snapshot = NULL;
+	}
+	if (!gpdata->fb_snapshot) {
+		gpdata->fb_snapshot = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, full.width, full.height);
+		cairo_region_union_rectangle(gpdata->fb_damage, &full);
+	}
+	cairo_region_intersect_rectangle(gpdata->fb_damage, &full);
+	if (!cairo_region_is_empty(gpdata->fb_damage)) {
+		cr = cairo_create(gpdata->fb_snapshot);
+		gdk_cairo_region(cr, gpdata->fb_damage);
+		cairo_clip(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(cr, gpdata->rgb_buffer, 0, 0);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_region_destroy(gpdata->fb_damage);
+		gpdata->fb_damage = cairo_region_create();
+	}
+	UNLOCK_BUFFER(FALSE)
+
+	return cairo_surface_reference(gpdata->fb_snapshot);
+}
+
 static void remmina_plugin_vnc_init(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -2067,6 +2278,8 @@ static void remmina_plugin_vnc_init(RemminaProtocolWidget *gp)
 	fcntl(gpdata->vnc_event_pipe[0], F_SETFL, flags | O_NONBLOCK);
 
 	pthread_mutex_init(&gpdata->buffer_mutex, NULL);
+	gpdata->fb_damage = cairo_region_create();
+	gpdata->damage_x1 = gpdata->damage_y1 = G_MAXINT;
 }
 
 /* Array of key/value pairs for color depths */
@@ -2088,6 +2301,19 @@ static gpointer quality_list[] =
 	NULL
 };
 
+/* Values of REMMINA_PLUGIN_VNC_INPUT_MODE_* */
+static gpointer input_mode_list[] =
+{
+	"0", N_("Immediate"),
+	"1", N_("Let TCP coalesce small packets"),
+	"2", N_("Batched"),
+	NULL
+};
+
+static gchar input_latency_budget_tooltip[] =
+	N_("In batched input mode, how long in ms input is held back to be sent\n"
+	   "together with the events following it (default: 20, at most 500)");
+
 static gchar repeater_tooltip[] =
 	N_("Connect to VNC using a repeater:\n"
 	   "  • The server field must contain the repeater ID, e.g. ID:123456789\n"
@@ -2183,6 +2409,8 @@ static const RemminaProtocolSetting remmina_plugin_vnc_advanced_settings[] =
 #ifdef TCP_USER_TIMEOUT
 	{ REMMINA_PROTOCOL_SETTING_TYPE_INT,  "vnc_timeout", N_("TCP_USER_TIMEOUT length (seconds)"), FALSE, NULL, vnc_timeout_tooltip },
 #endif // TCP_USER_TIMEOUT
+	{ REMMINA_PROTOCOL_SETTING_TYPE_SELECT, "input_mode", N_("Input transmission"), FALSE, input_mode_list, NULL },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_INT,  "input_latency_budget", N_("Input latency budget (ms)"), FALSE, NULL, input_latency_budget_tooltip },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "tightencoding",          N_("Force tight encoding"),			        TRUE,  NULL, N_("Enabling this may help when the remote desktop looks scrambled") },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disablesmoothscrolling", N_("Disable smooth scrolling"),		        FALSE, NULL, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disablepasswordstoring", N_("Forget passwords after use"),		        TRUE,  NULL, NULL },
@@ -2193,6 +2421,8 @@ static const RemminaProtocolSetting remmina_plugin_vnc_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disableencryption",	     N_("Turn off encryption"),			            FALSE, NULL, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "viewonly",		         N_("View only"),				                TRUE,  NULL, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "closeonfailure",		 N_("Close on connection failure"),				TRUE,  NULL, NULL },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "record_session",		 N_("Record the session to a video file"),		TRUE,  NULL, NULL },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "capture_traffic",		 N_("Capture the VNC stream for replay"),		TRUE,  NULL, N_("Turns off encryption, the capture is saved next to the session recordings") },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_END,   NULL,                     NULL,                                          FALSE, NULL, NULL }
 };
 
@@ -2215,6 +2445,23 @@ static const RemminaProtocolFeature remmina_plugin_vnc_features[] =
 	{ REMMINA_PROTOCOL_FEATURE_TYPE_END,          0,	                                          NULL,                                                 NULL,	              NULL }
 };
 
+/* Called on the main thread when the session tab is shown or hidden */
+static void remmina_plugin_vnc_on_visibility(RemminaProtocolWidget *gp, gboolean visible)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+
+	if (!gpdata)
+		return;
+
+	g_atomic_int_set(&gpdata->hidden, visible ? 0 : 1);
+	/* Also wakes up the VNC thread, so it polls the server again at once.
+	 * A hidden session gets called again when a thumbnail or a recording
+	 * starts, those need the areas skipped while nobody was looking. */
+	if ((visible || remmina_plugin_service->protocol_widget_framebuffer_wanted(gp)) && gpdata->connected)
+		remmina_plugin_vnc_event_push(gp, REMMINA_PLUGIN_VNC_EVENT_RESYNC, NULL, NULL, NULL);
+}
+
 /* Protocol plugin definition and features */
 static RemminaProtocolPlugin remmina_plugin_vnc =
 {
@@ -2234,7 +2481,12 @@ static RemminaProtocolPlugin remmina_plugin_vnc =
 	remmina_plugin_vnc_close_connection,            // Plugin close connection
 	remmina_plugin_vnc_query_feature,               // Query for available features
 	remmina_plugin_vnc_call_feature,                // Call a feature
-	remmina_plugin_vnc_keystroke                    // Send a keystroke
+	remmina_plugin_vnc_keystroke,                   // Send a keystroke
+	NULL,                                           // No screenshot support available
+	NULL,                                           // RCW map event
+	NULL,                                           // RCW unmap event
+	remmina_plugin_vnc_on_visibility,               // Session visibility changed
+	remmina_plugin_vnc_get_framebuffer              // Framebuffer for thumbnails
 };
 
 /* Protocol plugin definition and features */
@@ -2259,7 +2511,55 @@ static RemminaProtocolPlugin remmina_plugin_vnci =
 	remmina_plugin_vnc_keystroke,                   // Send a keystroke
 	NULL,                                           // No screenshot support available
 	NULL,                                           // RCW map event
-	NULL                                            // RCW unmap event
+	NULL,                                           // RCW unmap event
+	remmina_plugin_vnc_on_visibility,               // Session visibility changed
+	remmina_plugin_vnc_get_framebuffer              // Framebuffer for thumbnails
+};
+
+/* "remmina -c file.vnccap" replays a capture made with "capture_traffic" */
+static gboolean remmina_plugin_vnc_capture_import_test(RemminaFilePlugin *plugin, const gchar *from_file)
+{
+	TRACE_CALL(__func__);
+	return g_str_has_suffix(from_file, ".vnccap");
+}
+
+static RemminaFile *remmina_plugin_vnc_capture_import(RemminaFilePlugin *plugin, const gchar *from_file)
+{
+	TRACE_CALL(__func__);
+	RemminaFile *remminafile;
+	gchar *name;
+
+	remminafile = remmina_plugin_service->file_new();
+	name = g_path_get_basename(from_file);
+	remmina_plugin_service->file_set_string(remminafile, "name", name);
+	remmina_plugin_service->file_set_string(remminafile, "server", name);
+	remmina_plugin_service->file_set_string(remminafile, "protocol", VNC_PLUGIN_NAME);
+	remmina_plugin_service->file_set_string(remminafile, "replay_file", from_file);
+	g_free(name);
+
+	return remminafile;
+}
+
+static gboolean remmina_plugin_vnc_capture_export_test(RemminaFilePlugin *plugin, RemminaFile *remminafile)
+{
+	TRACE_CALL(__func__);
+	return FALSE;
+}
+
+/* File plugin definition */
+static RemminaFilePlugin remmina_plugin_vnc_capture =
+{
+	REMMINA_PLUGIN_TYPE_FILE,                       // Type
+	"VNCCAP",                                       // Name
+	N_("VNC - Capture replay"),                     // Description
+	GETTEXT_PACKAGE,                                // Translation domain
+	VNC_PLUGIN_VERSION,                             // Version number
+	remmina_plugin_vnc_capture_import_test,         // Test import function
+	remmina_plugin_vnc_capture_import,              // Import function
+	remmina_plugin_vnc_capture_export_test,         // Test export function
+	NULL,                                           // No export
+	NULL,                                           // Export hints
+	NULL                                            // Export extension
 };
 
 G_MODULE_EXPORT gboolean remmina_plugin_entry(RemminaPluginService *service);
@@ -2278,5 +2578,8 @@ gboolean remmina_plugin_entry(RemminaPluginService *service)
 	if (!service->register_plugin((RemminaPlugin *)&remmina_plugin_vnci))
 		return FALSE;
 
+	if (!service->register_plugin((RemminaPlugin *)&remmina_plugin_vnc_capture))
+		return FALSE;
+
 	return TRUE;
 }
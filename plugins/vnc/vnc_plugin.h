@@ -34,6 +34,8 @@
 
 #pragma once
 #include "common/remmina_plugin.h"
+#include "vnc_capture.h"
+#include "vnc_pixels.h"
 
 #ifndef __PLUGIN_CONFIG_H
 #define __PLUGIN_CONFIG_H
@@ -93,6 +95,12 @@ typedef struct _RemminaPluginVncData {
 
 	gint			queuedraw_x, queuedraw_y, queuedraw_w, queuedraw_h;
 	guint			queuedraw_handler;
+	/* Unscaled area updated since the last queued draw, for the thumbnail */
+	gint			damage_x1, damage_y1, damage_x2, damage_y2;
+	/* Copy of rgb_buffer handed out by get_framebuffer, main thread only,
+	 * and the area updated since it was last brought up to date, under buffer_mutex */
+	cairo_surface_t *	fb_snapshot;
+	cairo_region_t *	fb_damage;
 
 	gulong			clipboard_handler;
 	GDateTime		*clipboard_timer;
@@ -111,21 +119,47 @@ typedef struct _RemminaPluginVncData {
 	pthread_mutex_t		vnc_event_queue_mutex;
 	GQueue *		vnc_event_queue;
 	gint			vnc_event_pipe[2];
+	/* Input transmission, see REMMINA_PLUGIN_VNC_INPUT_MODE_* */
+	gint			input_mode;
+	gint64			input_latency_budget;
+	gint64			input_batch_deadline;
 
 	pthread_t		thread;
 	pthread_mutex_t		buffer_mutex;
 
 	float		scroll_x_accumulator, scroll_y_accumulator;
 
+	/* Session tab not visible, set by the main thread */
+	gint			hidden;
+	/* VNC thread only: last server poll while hidden, updates skipped while hidden */
+	gint64			hidden_poll_time;
+	gboolean		resync_pending;
+
+	/* Capture of the VNC stream, or the capture replayed instead of a server */
+	RemminaVncCapture *	capture;
+	gboolean		replay;
+	gint64			replay_start;
+	/* Per stage thread CPU time in microseconds and FramebufferUpdate count, only counted by a replay */
+	gint64			cpu_decode;
+	gint64			cpu_convert;
+	gint64			cpu_render;
+	gint			frames;
+
 } RemminaPluginVncData;
 
+/* "input_mode" profile setting */
+#define REMMINA_PLUGIN_VNC_INPUT_MODE_IMMEDIATE 0       /* One TCP segment per input event, TCP_NODELAY set */
+#define REMMINA_PLUGIN_VNC_INPUT_MODE_NAGLE     1       /* TCP_NODELAY cleared, the kernel coalesces small writes */
+#define REMMINA_PLUGIN_VNC_INPUT_MODE_BATCHED   2       /* Input held for the latency budget, sent as one corked write */
+
 enum {
 	REMMINA_PLUGIN_VNC_EVENT_KEY,
 	REMMINA_PLUGIN_VNC_EVENT_POINTER,
 	REMMINA_PLUGIN_VNC_EVENT_CUTTEXT,
 	REMMINA_PLUGIN_VNC_EVENT_CHAT_OPEN,
 	REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND,
-	REMMINA_PLUGIN_VNC_EVENT_CHAT_CLOSE
+	REMMINA_PLUGIN_VNC_EVENT_CHAT_CLOSE,
+	REMMINA_PLUGIN_VNC_EVENT_RESYNC
 };
 
 typedef struct _RemminaPluginVncEvent {
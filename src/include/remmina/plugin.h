@@ -101,6 +101,11 @@ typedef struct _RemminaProtocolPlugin {
 	gboolean (*get_plugin_screenshot)(RemminaProtocolWidget *gp, RemminaPluginScreenshotData *rpsd);
 	gboolean (*map_event)(RemminaProtocolWidget *gp);
 	gboolean (*unmap_event)(RemminaProtocolWidget *gp);
+	/* The session tab became visible or hidden, optional */
+	void (*visibility_changed)(RemminaProtocolWidget *gp, gboolean visible);
+	/* New reference to an image surface holding the remote desktop, optional, main thread.
+	 * The plugin may update the surface on the next call, do not keep it */
+	cairo_surface_t *(*get_framebuffer)(RemminaProtocolWidget *gp);
 } RemminaProtocolPlugin;
 
 typedef struct _RemminaEntryPlugin {
@@ -321,6 +326,12 @@ typedef struct _RemminaPluginService {
 	GtkWindow *(*get_window)(void);
 	gint (*plugin_unlock_new)(GtkWindow* parent);
 	void (*add_network_state)(gchar* key, gchar* value);
+	void (*protocol_widget_metrics_phase)(RemminaProtocolWidget *gp, const gchar *phase, gboolean begin);
+	void (*protocol_widget_metrics_add)(RemminaProtocolWidget *gp, RemminaMetricsCounter counter, gint64 value);
+	gboolean (*protocol_widget_framebuffer_wanted)(RemminaProtocolWidget *gp);
+	void (*protocol_widget_damage)(RemminaProtocolWidget *gp, gint x, gint y, gint w, gint h);
+	gboolean (*protocol_widget_is_recording)(RemminaProtocolWidget *gp);
+	gboolean (*protocol_widget_metrics_sample_socket)(RemminaProtocolWidget *gp, gint fd);
 } RemminaPluginService;
 
 /* "Prototype" of the plugin entry function */
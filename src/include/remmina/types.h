@@ -162,4 +162,15 @@ typedef enum {
 
 } RemminaMessagePanelFlags;
 
+/* Steady state counters of a connection, see protocol_widget_metrics_add() */
+typedef enum {
+	REMMINA_METRICS_FRAMES,                 /* frames painted, value is the number of frames */
+	REMMINA_METRICS_BYTES_IN,               /* bytes received from the server, see protocol_widget_metrics_sample_socket() */
+	REMMINA_METRICS_BYTES_OUT,              /* bytes sent to the server */
+	REMMINA_METRICS_INPUT_LATENCY,          /* one sample, in microseconds, from an input event to the next frame */
+	REMMINA_METRICS_INPUT_PACKETS_SAVED,    /* input messages coalesced away or merged into another TCP segment */
+	REMMINA_METRICS_INPUT_BYTES_SAVED,      /* protocol and TCP/IP header bytes not sent thanks to input batching */
+	REMMINA_METRICS_LAST
+} RemminaMetricsCounter;
+
 G_END_DECLS
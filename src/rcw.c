@@ -61,6 +61,7 @@
 #include "remmina_pref.h"
 #include "remmina_protocol_widget.h"
 #include "remmina_public.h"
+#include "remmina_screenshot.h"
 #include "remmina_scrolled_viewport.h"
 #include "remmina_unlock.h"
 #include "remmina_utils.h"
@@ -87,6 +88,15 @@ G_DEFINE_TYPE(RemminaConnectionWindow, rcw, GTK_TYPE_WINDOW)
 
 #define FULL_SCREEN_TARGET_MONITOR_UNDEFINED -1
 
+/* Overview of all the open sessions: tile size and how often a tile may be redrawn */
+#define OVERVIEW_TILE_WIDTH 320
+#define OVERVIEW_TILE_HEIGHT 200
+#define OVERVIEW_VISIBLE_INTERVAL_US (G_USEC_PER_SEC / 5)
+#define OVERVIEW_HIDDEN_INTERVAL_US G_USEC_PER_SEC
+#define OVERVIEW_TICK_TIME 50
+/* Share of one CPU the overview may spend rescaling, whatever the number of tiles */
+#define OVERVIEW_CPU_PERCENT 20
+
 struct _RemminaConnectionWindowPriv {
 	GtkNotebook *					notebook;
 	GtkWidget *					floating_toolbar_widget;
@@ -137,6 +147,9 @@ struct _RemminaConnectionWindowPriv {
 
 	gboolean					sticky;
 
+	/* The window is mapped and not iconified */
+	gboolean					shown;
+
 	/* Flag to turn off toolbar signal handling when toolbar is
 	 * reconfiguring, usually due to a tab switch */
 	gboolean					toolbar_is_reconfiguring;
@@ -180,8 +193,31 @@ typedef struct _RemminaConnectionObject {
 	gboolean			dynres_unlocked;
 
 	gulong				deferred_open_size_allocate_handler;
+
+	/* Periodic screenshots, see remmina_pref.screenshot_interval */
+	guint				screenshot_eventsourceid;
 } RemminaConnectionObject;
 
+typedef struct _RemminaOverviewTile {
+	GtkWidget *	proto;
+	GtkWidget *	button;
+	GtkWidget *	drawing_area;
+	gint64		next_update;
+} RemminaOverviewTile;
+
+/* The overview window, shared by all the connection windows */
+typedef struct _RemminaOverview {
+	GtkWidget *	window;
+	GtkWidget *	flowbox;
+	GPtrArray *	tiles;
+	guint		tick_source;
+	guint		next_tile;
+	/* No rescaling before this time, keeps the CPU share under OVERVIEW_CPU_PERCENT */
+	gint64		idle_until;
+} RemminaOverview;
+
+static RemminaOverview *overview = NULL;
+
 enum {
 	TOOLBARPLACE_SIGNAL,
 	LAST_SIGNAL
@@ -202,6 +238,8 @@ static void rcw_place_toolbar(GtkToolbar *toolbar, GtkGrid *grid, GtkWidget *sib
 static void rco_update_toolbar(RemminaConnectionObject *cnnobj);
 static void rcw_keyboard_grab(RemminaConnectionWindow *cnnwin);
 static GtkWidget *rcw_append_new_page(RemminaConnectionWindow *cnnwin, RemminaConnectionObject *cnnobj);
+static void rcw_overview_show(void);
+static void rcw_overview_add_tile(RemminaConnectionObject *cnnobj);
 static void rcw_ftb_multimon_move_toolbar(RemminaConnectionWindowPriv *priv);
 
 static void rcw_ftb_drag_begin(GtkWidget *widget, GdkDragContext *context, gpointer user_data);
@@ -394,6 +432,26 @@ static RemminaConnectionObject *rcw_get_visible_cnnobj(RemminaConnectionWindow *
 	}
 }
 
+/* Only the current tab of a shown window is visible, the other sessions may throttle */
+static void rcw_update_visibility(RemminaConnectionWindow *cnnwin)
+{
+	TRACE_CALL(__func__);
+	RemminaConnectionObject *cnnobj;
+	gint i, n, np;
+
+	if (cnnwin == NULL || cnnwin->priv == NULL || cnnwin->priv->notebook == NULL)
+		return;
+
+	n = gtk_notebook_get_n_pages(GTK_NOTEBOOK(cnnwin->priv->notebook));
+	np = gtk_notebook_get_current_page(GTK_NOTEBOOK(cnnwin->priv->notebook));
+	for (i = 0; i < n; i++) {
+		cnnobj = rcw_get_cnnobj_at_page(cnnwin, i);
+		if (cnnobj && cnnobj->proto)
+			remmina_protocol_widget_set_visible(REMMINA_PROTOCOL_WIDGET(cnnobj->proto),
+							    cnnwin->priv->shown && i == np);
+	}
+}
+
 static RemminaScaleMode get_current_allowed_scale_mode(RemminaConnectionObject *cnnobj, gboolean *dynres_avail, gboolean *scale_avail)
 {
 	TRACE_CALL(__func__);
@@ -1653,6 +1711,15 @@ static void rcw_toolbar_switch_page(GtkToolItem *toggle, RemminaConnectionWindow
 #endif
 }
 
+static void rcw_toolbar_overview(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
+{
+	TRACE_CALL(__func__);
+
+	if (cnnwin->priv->toolbar_is_reconfiguring)
+		return;
+	rcw_overview_show();
+}
+
 static void rco_update_toolbar_autofit_button(RemminaConnectionObject *cnnobj)
 {
 	TRACE_CALL(__func__);
@@ -1756,13 +1823,16 @@ static void rcw_toolbar_viewonly_mode(GtkToolItem *toggle, RemminaConnectionWind
 	}
 
 	// When opening connection, take viewonly value from remmina file
-	if (cnnobj->connected) {
-		bactive = gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(toggle));
-		gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(cnnobj->cnnwin->priv->toolitem_viewonly), bactive);
-	}
+	if (!cnnobj->connected)
+		return;
+
+	bactive = gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(toggle));
+	gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(cnnobj->cnnwin->priv->toolitem_viewonly), bactive);
 
 	// Update remmina file and let the plugin handle the viewonly
 	remmina_file_set_int(cnnobj->remmina_file, "viewonly", bactive);
+	remmina_protocol_widget_call_feature_by_type(REMMINA_PROTOCOL_WIDGET(cnnobj->proto),
+						     REMMINA_PROTOCOL_FEATURE_TYPE_VIEWONLY, 0);
 }
 
 static void rcw_toolbar_multi_monitor_mode(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
@@ -2183,7 +2253,13 @@ static void rcw_toolbar_duplicate(GtkToolItem *toggle, RemminaConnectionWindow *
 	remmina_exec_command(REMMINA_COMMAND_CONNECT, cnnobj->remmina_file->filename);
 }
 
-static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
+/**
+ * Copy the remote desktop of cnnobj into a new RGB24 surface, from the
+ * plugin screenshot or else the plugin framebuffer.
+ * When interactive, the image also goes to the clipboard and, if the
+ * plugin provides neither, the window content is used.
+ */
+static cairo_surface_t *rco_screenshot_snapshot(RemminaConnectionObject *cnnobj, gboolean interactive)
 {
 	TRACE_CALL(__func__);
 
@@ -2191,27 +2267,18 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 	GdkWindow *active_window;
 	cairo_t *cr;
 	gint width, height;
-	GString *pngstr;
-	gchar *pngname;
 	GtkWidget *dialog;
 	RemminaProtocolWidget *gp;
 	RemminaPluginScreenshotData rpsd;
-	RemminaConnectionObject *cnnobj;
 	cairo_surface_t *srcsurface;
 	cairo_format_t cairo_format;
 	cairo_surface_t *surface;
 	int stride;
 
-	if (cnnwin->priv->toolbar_is_reconfiguring)
-		return;
-	if (!(cnnobj = rcw_get_visible_cnnobj(cnnwin))) return;
-
-	GDateTime *date = g_date_time_new_now_utc();
-
 	// We will take a screenshot of the currently displayed RemminaProtocolWidget.
 	gp = REMMINA_PROTOCOL_WIDGET(cnnobj->proto);
 
-	gchar *denyclip = remmina_pref_get_value("deny_screenshot_clipboard");
+	gchar *denyclip = interactive ? remmina_pref_get_value("deny_screenshot_clipboard") : NULL;
 
 	REMMINA_DEBUG("deny_screenshot_clipboard is set to %s", denyclip);
 
@@ -2238,18 +2305,41 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 
 		srcsurface = cairo_image_surface_create_for_data(rpsd.buffer, cairo_format, width, height, stride);
 		// Transfer the PixBuf in the main clipboard selection
-		if (denyclip && (g_strcmp0(denyclip, "true")))
-			gtk_clipboard_set_image(c, gdk_pixbuf_get_from_surface(
-							srcsurface, 0, 0, width, height));
+		if (denyclip && (g_strcmp0(denyclip, "true"))) {
+			screenshot = gdk_pixbuf_get_from_surface(srcsurface, 0, 0, width, height);
+			gtk_clipboard_set_image(c, screenshot);
+			g_object_unref(screenshot);
+		}
 		surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
 		cr = cairo_create(surface);
 		cairo_set_source_surface(cr, srcsurface, 0, 0);
 		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 		cairo_paint(cr);
+		cairo_destroy(cr);
 		cairo_surface_destroy(srcsurface);
 
 		free(rpsd.buffer);
-	} else {
+	} else if ((srcsurface = remmina_protocol_widget_get_framebuffer(gp))) {
+		// The plugin framebuffer, unscaled and available even when the tab is hidden
+		width = cairo_image_surface_get_width(srcsurface);
+		height = cairo_image_surface_get_height(srcsurface);
+
+		REMMINA_DEBUG("Screenshot from the plugin framebuffer: w=%d h=%d", width, height);
+
+		// Transfer the PixBuf in the main clipboard selection
+		if (denyclip && (g_strcmp0(denyclip, "true"))) {
+			screenshot = gdk_pixbuf_get_from_surface(srcsurface, 0, 0, width, height);
+			gtk_clipboard_set_image(c, screenshot);
+			g_object_unref(screenshot);
+		}
+		surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+		cr = cairo_create(surface);
+		cairo_set_source_surface(cr, srcsurface, 0, 0);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_surface_destroy(srcsurface);
+	} else if (interactive) {
 		// The plugin is not releasing us a screenshot, just try to catch one via GTK
 
 		/* Warn the user if image is distorted */
@@ -2267,8 +2357,11 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 		height = gdk_window_get_height(active_window);
 
 		screenshot = gdk_pixbuf_get_from_window(active_window, 0, 0, width, height);
-		if (screenshot == NULL)
+		if (screenshot == NULL) {
 			g_print("gdk_pixbuf_get_from_window failed\n");
+			g_free(denyclip);
+			return NULL;
+		}
 
 		// Transfer the PixBuf in the main clipboard selection
 		if (denyclip && (g_strcmp0(denyclip, "true")))
@@ -2280,45 +2373,117 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 		// Copy the source pixbuf to the surface and paint it.
 		gdk_cairo_set_source_pixbuf(cr, screenshot, 0, 0);
 		cairo_paint(cr);
+		cairo_destroy(cr);
 
 		// Deallocate screenshot pixbuf
 		g_object_unref(screenshot);
+	} else {
+		/* A hidden window cannot be captured, only plugin framebuffers are */
+		REMMINA_DEBUG("No framebuffer from the plugin yet, no screenshot");
+		surface = NULL;
 	}
 
+	g_free(denyclip);
+	return surface;
+}
+
+/* Expand remmina_pref.screenshot_name for cnnobj */
+static gchar *rco_screenshot_filename(RemminaConnectionObject *cnnobj)
+{
+	TRACE_CALL(__func__);
+	GDateTime *date = g_date_time_new_now_utc();
+	GString *pngstr;
+	gchar *s;
+
 	//home/antenore/Pictures/remmina_%p_%h_%Y  %m %d-%H%M%S.png pngname
 	//home/antenore/Pictures/remmina_st_  _2018 9 24-151958.240374.png
 
-	pngstr = g_string_new(g_strdup_printf("%s/%s.png",
-					      remmina_pref.screenshot_path,
-					      remmina_pref.screenshot_name));
+	pngstr = g_string_new(NULL);
+	g_string_printf(pngstr, "%s/%s.%s", remmina_pref.screenshot_path, remmina_pref.screenshot_name,
+			remmina_screenshot_get_extension());
 	remmina_utils_string_replace_all(pngstr, "%p",
 					 remmina_file_get_string(cnnobj->remmina_file, "name"));
 	remmina_utils_string_replace_all(pngstr, "%h",
 					 remmina_file_get_string(cnnobj->remmina_file, "server"));
-	remmina_utils_string_replace_all(pngstr, "%Y",
-					 g_strdup_printf("%d", g_date_time_get_year(date)));
-	remmina_utils_string_replace_all(pngstr, "%m", g_strdup_printf("%02d",
-								       g_date_time_get_month(date)));
-	remmina_utils_string_replace_all(pngstr, "%d",
-					 g_strdup_printf("%02d", g_date_time_get_day_of_month(date)));
-	remmina_utils_string_replace_all(pngstr, "%H",
-					 g_strdup_printf("%02d", g_date_time_get_hour(date)));
-	remmina_utils_string_replace_all(pngstr, "%M",
-					 g_strdup_printf("%02d", g_date_time_get_minute(date)));
-	remmina_utils_string_replace_all(pngstr, "%S",
-					 g_strdup_printf("%02d", g_date_time_get_second(date)));
+	/* %Y %m %d %H %M %S as strftime() */
+	s = g_date_time_format(date, "%Y");
+	remmina_utils_string_replace_all(pngstr, "%Y", s);
+	g_free(s);
+	s = g_date_time_format(date, "%m");
+	remmina_utils_string_replace_all(pngstr, "%m", s);
+	g_free(s);
+	s = g_date_time_format(date, "%d");
+	remmina_utils_string_replace_all(pngstr, "%d", s);
+	g_free(s);
+	s = g_date_time_format(date, "%H");
+	remmina_utils_string_replace_all(pngstr, "%H", s);
+	g_free(s);
+	s = g_date_time_format(date, "%M");
+	remmina_utils_string_replace_all(pngstr, "%M", s);
+	g_free(s);
+	s = g_date_time_format(date, "%S");
+	remmina_utils_string_replace_all(pngstr, "%S", s);
+	g_free(s);
 	g_date_time_unref(date);
-	pngname = g_string_free(pngstr, FALSE);
 
-	cairo_surface_write_to_png(surface, pngname);
+	return g_string_free(pngstr, FALSE);
+}
 
-	/* send a desktop notification */
-	if (g_file_test(pngname, G_FILE_TEST_EXISTS))
-		remmina_public_send_notification("remmina-screenshot-is-ready-id", _("Screenshot taken"), pngname);
+static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
+{
+	TRACE_CALL(__func__);
+	RemminaConnectionObject *cnnobj;
+	cairo_surface_t *surface;
+	gchar *pngname;
 
-	//Clean up and return.
-	cairo_destroy(cr);
-	cairo_surface_destroy(surface);
+	if (cnnwin->priv->toolbar_is_reconfiguring)
+		return;
+	if (!(cnnobj = rcw_get_visible_cnnobj(cnnwin))) return;
+
+	if (!(surface = rco_screenshot_snapshot(cnnobj, TRUE)))
+		return;
+
+	/* Encoding a large desktop takes long, it is done on a worker which
+	 * sends the desktop notification */
+	pngname = rco_screenshot_filename(cnnobj);
+	remmina_screenshot_save(surface, pngname, TRUE, NULL);
+	g_free(pngname);
+}
+
+/* Audit trail: remmina_pref.screenshot_interval */
+static gboolean rco_screenshot_periodic(gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaConnectionObject *cnnobj = (RemminaConnectionObject *)user_data;
+	cairo_surface_t *surface;
+	gchar *filename;
+
+	/* Never queue up encodes behind a slow disk */
+	if (!cnnobj->connected || remmina_screenshot_is_busy(G_OBJECT(cnnobj->proto)))
+		return G_SOURCE_CONTINUE;
+
+	if (!remmina_protocol_widget_can_capture(REMMINA_PROTOCOL_WIDGET(cnnobj->proto))) {
+		REMMINA_WARNING("Periodic screenshots are not possible, the %s plugin cannot provide its remote desktop",
+				remmina_file_get_string(cnnobj->remmina_file, "protocol"));
+		cnnobj->screenshot_eventsourceid = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	if ((surface = rco_screenshot_snapshot(cnnobj, FALSE))) {
+		filename = rco_screenshot_filename(cnnobj);
+		remmina_screenshot_save(surface, filename, FALSE, G_OBJECT(cnnobj->proto));
+		g_free(filename);
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static void rco_screenshot_periodic_stop(RemminaConnectionObject *cnnobj)
+{
+	TRACE_CALL(__func__);
+	if (cnnobj->screenshot_eventsourceid) {
+		g_source_remove(cnnobj->screenshot_eventsourceid);
+		cnnobj->screenshot_eventsourceid = 0;
+	}
 }
 
 static void rcw_toolbar_minimize(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
@@ -2631,6 +2796,14 @@ rcw_create_toolbar(RemminaConnectionWindow *cnnwin, gint mode, gboolean is_float
 	g_signal_connect(G_OBJECT(toolitem), "toggled", G_CALLBACK(rcw_toolbar_switch_page), cnnwin);
 	priv->toolitem_switch_page = toolitem;
 
+	/* Overview of all sessions */
+	toolitem = gtk_tool_button_new(NULL, _("_Overview"));
+	gtk_tool_button_set_icon_name(GTK_TOOL_BUTTON(toolitem), "view-grid-symbolic");
+	gtk_tool_item_set_tooltip_text(toolitem, _("Show all sessions"));
+	gtk_toolbar_insert(GTK_TOOLBAR(toolbar), toolitem, -1);
+	gtk_widget_show(GTK_WIDGET(toolitem));
+	g_signal_connect(G_OBJECT(toolitem), "clicked", G_CALLBACK(rcw_toolbar_overview), cnnwin);
+
 	/* Grab keyboard button */
 	toolitem = gtk_toggle_tool_button_new();
 	gtk_tool_button_set_icon_name(GTK_TOOL_BUTTON(toolitem), "org.remmina.Remmina-keyboard-symbolic");
@@ -3392,6 +3565,11 @@ static gboolean rcw_state_event(GtkWidget *widget, GdkEventWindowState *event, g
 			rcw_focus_out((RemminaConnectionWindow *)widget);
 	}
 
+	if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED) {
+		((RemminaConnectionWindow *)widget)->priv->shown = !(event->new_window_state & GDK_WINDOW_STATE_ICONIFIED);
+		rcw_update_visibility((RemminaConnectionWindow *)widget);
+	}
+
 	return FALSE;
 }
 
@@ -3406,6 +3584,8 @@ static gboolean rcw_map_event(GtkWidget *widget, GdkEvent *event, gpointer data)
 	RemminaProtocolWidget *gp;
 
 	if (cnnwin->priv->toolbar_is_reconfiguring) return FALSE;
+	cnnwin->priv->shown = TRUE;
+	rcw_update_visibility(cnnwin);
 	if (!(cnnobj = rcw_get_visible_cnnobj(cnnwin))) return FALSE;
 
 	gp = REMMINA_PROTOCOL_WIDGET(cnnobj->proto);
@@ -3424,6 +3604,8 @@ static gboolean rcw_unmap_event(GtkWidget *widget, GdkEvent *event, gpointer dat
 	RemminaProtocolWidget *gp;
 
 	if (cnnwin->priv->toolbar_is_reconfiguring) return FALSE;
+	cnnwin->priv->shown = FALSE;
+	rcw_update_visibility(cnnwin);
 	if (!(cnnobj = rcw_get_visible_cnnobj(cnnwin))) return FALSE;
 
 	gp = REMMINA_PROTOCOL_WIDGET(cnnobj->proto);
@@ -3446,6 +3628,9 @@ static gboolean rcw_map_event_fullscreen(GtkWidget *widget, GdkEvent *event, gpo
 		return FALSE;
 	}
 
+	((RemminaConnectionWindow *)widget)->priv->shown = TRUE;
+	rcw_update_visibility((RemminaConnectionWindow *)widget);
+
 	cnnobj = rcw_get_visible_cnnobj((RemminaConnectionWindow *)widget);
 	if (!cnnobj) {
 		REMMINA_DEBUG("Remmina Connection Object undefined, cannot go fullscreen");
@@ -3611,6 +3796,7 @@ static void rco_closewin(RemminaProtocolWidget *gp)
 		}
 	}
 	if (cnnobj) {
+		rco_screenshot_periodic_stop(cnnobj);
 		cnnobj->remmina_file = NULL;
 		g_free(cnnobj);
 		gp->cnnobj = NULL;
@@ -3716,9 +3902,211 @@ static GtkWidget *rcw_append_new_page(RemminaConnectionWindow *cnnwin, RemminaCo
 
 	gtk_widget_show(page);
 
+	if (overview)
+		rcw_overview_add_tile(cnnobj);
+
 	return page;
 }
 
+static gboolean rcw_overview_tick(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaOverviewTile *tile;
+	RemminaProtocolWidget *gp;
+	gint64 start, now;
+	guint i, n;
+
+	now = start = g_get_monotonic_time();
+	if (now < overview->idle_until)
+		return G_SOURCE_CONTINUE;
+
+	/* Round robin from the tile that ran out of time last tick, only damaged
+	 * tiles are rescaled, hidden sessions at a lower rate */
+	n = overview->tiles->len;
+	for (i = 0; i < n; i++) {
+		tile = g_ptr_array_index(overview->tiles, (overview->next_tile + i) % n);
+		gp = REMMINA_PROTOCOL_WIDGET(tile->proto);
+		if (now < tile->next_update || !remmina_protocol_widget_thumbnail_is_damaged(gp))
+			continue;
+		if ((now - start) * 100 > OVERVIEW_TICK_TIME * 1000 * OVERVIEW_CPU_PERCENT)
+			break;
+		if (remmina_protocol_widget_update_thumbnail(gp))
+			gtk_widget_queue_draw(tile->drawing_area);
+		tile->next_update = now + (remmina_protocol_widget_is_visible(gp) ?
+					   OVERVIEW_VISIBLE_INTERVAL_US : OVERVIEW_HIDDEN_INTERVAL_US);
+		now = g_get_monotonic_time();
+	}
+	if (n > 0)
+		overview->next_tile = (overview->next_tile + i) % n;
+
+	/* A tick that overran its share is paid back by idling */
+	overview->idle_until = now + (now - start) * (100 - OVERVIEW_CPU_PERCENT) / OVERVIEW_CPU_PERCENT;
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean rcw_overview_tile_draw(GtkWidget *widget, cairo_t *cr, RemminaOverviewTile *tile)
+{
+	TRACE_CALL(__func__);
+	cairo_surface_t *thumbnail;
+	gint width, height;
+
+	cairo_set_source_rgb(cr, 0, 0, 0);
+	cairo_paint(cr);
+
+	thumbnail = remmina_protocol_widget_get_thumbnail(REMMINA_PROTOCOL_WIDGET(tile->proto));
+	if (!thumbnail)
+		return TRUE;
+
+	width = cairo_image_surface_get_width(thumbnail);
+	height = cairo_image_surface_get_height(thumbnail);
+	cairo_set_source_surface(cr, thumbnail,
+				 (gtk_widget_get_allocated_width(widget) - width) / 2,
+				 (gtk_widget_get_allocated_height(widget) - height) / 2);
+	cairo_paint(cr);
+	return TRUE;
+}
+
+static void rcw_overview_tile_clicked(GtkButton *button, RemminaOverviewTile *tile)
+{
+	TRACE_CALL(__func__);
+	RemminaConnectionObject *cnnobj = REMMINA_PROTOCOL_WIDGET(tile->proto)->cnnobj;
+	GtkWidget *page;
+
+	if (!cnnobj || !cnnobj->cnnwin)
+		return;
+
+	page = nb_find_page_by_cnnobj(cnnobj->cnnwin->priv->notebook, cnnobj);
+	if (page)
+		nb_set_current_page(cnnobj->cnnwin->priv->notebook, page);
+	gtk_window_present(GTK_WINDOW(cnnobj->cnnwin));
+	gtk_widget_destroy(overview->window);
+}
+
+static void rcw_overview_tile_destroy(GtkWidget *widget, RemminaOverviewTile *tile)
+{
+	TRACE_CALL(__func__);
+
+	remmina_protocol_widget_set_thumbnail_size(REMMINA_PROTOCOL_WIDGET(tile->proto), 0, 0);
+	if (overview)
+		g_ptr_array_remove(overview->tiles, tile);
+	g_free(tile);
+}
+
+/* The session went away, its flowbox child goes with it */
+static void rcw_overview_proto_destroy(GtkWidget *proto, GtkWidget *button)
+{
+	TRACE_CALL(__func__);
+	gtk_widget_destroy(gtk_widget_get_parent(button));
+}
+
+static void rcw_overview_add_tile(RemminaConnectionObject *cnnobj)
+{
+	TRACE_CALL(__func__);
+	RemminaOverviewTile *tile;
+	GtkWidget *box, *label;
+	guint i;
+
+	/* Moving a tab to another window appends it again */
+	for (i = 0; i < overview->tiles->len; i++) {
+		tile = g_ptr_array_index(overview->tiles, i);
+		if (tile->proto == cnnobj->proto)
+			return;
+	}
+
+	tile = g_new0(RemminaOverviewTile, 1);
+	tile->proto = cnnobj->proto;
+
+	tile->button = gtk_button_new();
+	gtk_button_set_relief(GTK_BUTTON(tile->button), GTK_RELIEF_NONE);
+	box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+	gtk_container_add(GTK_CONTAINER(tile->button), box);
+
+	tile->drawing_area = gtk_drawing_area_new();
+	gtk_widget_set_size_request(tile->drawing_area, OVERVIEW_TILE_WIDTH, OVERVIEW_TILE_HEIGHT);
+	gtk_box_pack_start(GTK_BOX(box), tile->drawing_area, FALSE, FALSE, 0);
+
+	label = gtk_label_new(remmina_file_get_string(cnnobj->remmina_file, "name"));
+	gtk_label_set_ellipsize(GTK_LABEL(label), PANGO_ELLIPSIZE_END);
+	gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 0);
+
+	g_signal_connect(G_OBJECT(tile->drawing_area), "draw", G_CALLBACK(rcw_overview_tile_draw), tile);
+	g_signal_connect(G_OBJECT(tile->button), "clicked", G_CALLBACK(rcw_overview_tile_clicked), tile);
+	g_signal_connect(G_OBJECT(tile->button), "destroy", G_CALLBACK(rcw_overview_tile_destroy), tile);
+	g_signal_connect_object(G_OBJECT(tile->proto), "destroy", G_CALLBACK(rcw_overview_proto_destroy), tile->button, 0);
+
+	remmina_protocol_widget_set_thumbnail_size(REMMINA_PROTOCOL_WIDGET(tile->proto),
+						   OVERVIEW_TILE_WIDTH, OVERVIEW_TILE_HEIGHT);
+	g_ptr_array_add(overview->tiles, tile);
+
+	gtk_widget_show_all(tile->button);
+	gtk_container_add(GTK_CONTAINER(overview->flowbox), tile->button);
+}
+
+static gboolean rcw_overview_add_window_tiles(GtkWidget *widget, gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaConnectionObject *cnnobj;
+	gint i, n;
+
+	if (!REMMINA_IS_CONNECTION_WINDOW(widget))
+		return TRUE;
+
+	n = gtk_notebook_get_n_pages(RCW(widget)->priv->notebook);
+	for (i = 0; i < n; i++)
+		if ((cnnobj = rcw_get_cnnobj_at_page(RCW(widget), i)))
+			rcw_overview_add_tile(cnnobj);
+	return TRUE;
+}
+
+static void rcw_overview_destroy(GtkWidget *widget, gpointer data)
+{
+	TRACE_CALL(__func__);
+
+	g_source_remove(overview->tick_source);
+	g_ptr_array_free(overview->tiles, TRUE);
+	g_free(overview);
+	overview = NULL;
+}
+
+/**
+ * Show a live, downscaled tile of every open session. Tiles are fed from the
+ * plugin framebuffers and only the damaged areas are rescaled, within a
+ * per tile frame rate and a global CPU share.
+ */
+static void rcw_overview_show(void)
+{
+	TRACE_CALL(__func__);
+	GtkWidget *scrolled;
+
+	if (overview) {
+		gtk_window_present(GTK_WINDOW(overview->window));
+		return;
+	}
+
+	overview = g_new0(RemminaOverview, 1);
+	overview->tiles = g_ptr_array_new();
+
+	overview->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_title(GTK_WINDOW(overview->window), _("All sessions"));
+	gtk_window_set_default_size(GTK_WINDOW(overview->window), 3 * OVERVIEW_TILE_WIDTH + 64, 2 * OVERVIEW_TILE_HEIGHT + 96);
+
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(overview->window), scrolled);
+
+	overview->flowbox = gtk_flow_box_new();
+	gtk_flow_box_set_selection_mode(GTK_FLOW_BOX(overview->flowbox), GTK_SELECTION_NONE);
+	gtk_flow_box_set_homogeneous(GTK_FLOW_BOX(overview->flowbox), TRUE);
+	gtk_container_add(GTK_CONTAINER(scrolled), overview->flowbox);
+
+	remmina_widget_pool_foreach(rcw_overview_add_window_tiles, NULL);
+
+	g_signal_connect(G_OBJECT(overview->window), "destroy", G_CALLBACK(rcw_overview_destroy), NULL);
+	overview->tick_source = g_timeout_add(OVERVIEW_TICK_TIME, rcw_overview_tick, NULL);
+
+	gtk_widget_show_all(overview->window);
+}
+
 
 static void rcw_update_notebook(RemminaConnectionWindow *cnnwin)
 {
@@ -3757,6 +4145,7 @@ static gboolean rcw_on_switch_page_finalsel(gpointer user_data)
 	priv = cnnobj->cnnwin->priv;
 
 	if (GTK_IS_WIDGET(cnnobj->cnnwin)) {
+		rcw_update_visibility(cnnobj->cnnwin);
 		rcw_floating_toolbar_show(cnnobj->cnnwin, TRUE);
 		if (!priv->hidetb_eventsource)
 			priv->hidetb_eventsource = g_timeout_add(TB_HIDE_TIME_TIME, (GSourceFunc)
@@ -3788,6 +4177,7 @@ static void rcw_on_page_added(GtkNotebook *notebook, GtkWidget *child, guint pag
 {
 	if (gtk_notebook_get_n_pages(GTK_NOTEBOOK(cnnwin->priv->notebook)) > 0)
 		rcw_update_notebook(cnnwin);
+	rcw_update_visibility(cnnwin);
 }
 
 static void rcw_on_page_removed(GtkNotebook *notebook, GtkWidget *child, guint page_num,
@@ -4561,6 +4951,10 @@ static void rco_on_connect(RemminaProtocolWidget *gp, RemminaConnectionObject *c
 		}
 	}
 
+	if (remmina_pref.screenshot_interval > 0 && !cnnobj->screenshot_eventsourceid)
+		cnnobj->screenshot_eventsourceid = g_timeout_add_seconds(remmina_pref.screenshot_interval,
+									 rco_screenshot_periodic, cnnobj);
+
 	REMMINA_DEBUG("Trying to present the window");
 	/* Try to present window */
 	cnnobj->cnnwin->priv->dwp_eventsourceid = g_timeout_add(200, rcw_delayed_window_present, (gpointer)cnnobj->cnnwin);
@@ -4592,6 +4986,7 @@ static void rco_on_disconnect(RemminaProtocolWidget *gp, gpointer data)
 	rcw_kp_ungrab(cnnobj->cnnwin);
 	rcw_pointer_ungrab(cnnobj->cnnwin);
 	cnnobj->connected = FALSE;
+	rco_screenshot_periodic_stop(cnnobj);
 
 	if (remmina_pref.save_view_mode) {
 		if (cnnobj->cnnwin)
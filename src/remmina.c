@@ -66,6 +66,7 @@
 #include "remmina_public.h"
 #include "remmina_sftp_plugin.h"
 #include "remmina_ssh_plugin.h"
+#include "remmina_video_recorder.h"
 #include "remmina_widget_pool.h"
 #include "remmina/remmina_trace_calls.h"
 #include "remmina_info.h"
@@ -133,7 +134,13 @@ static GOptionEntry remmina_options[] =
 	// TRANSLATORS: Shown in terminal. Do not use characters that may be not supported on a terminal
 	{ "update-profile",   0,    0,			  G_OPTION_ARG_FILENAME,       NULL, N_("Modify connection profile (requires --set-option)"),				     NULL	},
 	// TRANSLATORS: Shown in terminal. Do not use characters that may be not supported on a terminal
-	{ "set-option",	      0,    0,			  G_OPTION_ARG_STRING_ARRAY,   NULL, N_("Set one or more profile settings, to be used with --update-profile"),		     NULL	},
+	{ "set-option",	      0,    0,			  G_OPTION_ARG_STRING_ARRAY,   NULL, N_("Set one or more profile settings, to be used with --update-profile or --bulk-update"),		     NULL	},
+	// TRANSLATORS: Shown in terminal. Do not use characters that may be not supported on a terminal
+	{ "bulk-update",      0,    0,			  G_OPTION_ARG_NONE,	       NULL, N_("Modify all the connection profiles matching --filter (requires --set-option)"),		     NULL	},
+	// TRANSLATORS: Shown in terminal. Do not use characters that may be not supported on a terminal
+	{ "filter",	      0,    0,			  G_OPTION_ARG_STRING_ARRAY,   NULL, N_("Select the profiles whose setting has a value, as in group=Servers, to be used with --bulk-update"),	     N_("SETTING=VALUE")	},
+	// TRANSLATORS: Shown in terminal. Do not use characters that may be not supported on a terminal
+	{ "filter-glob",      0,    0,			  G_OPTION_ARG_NONE,	       NULL, N_("Match the --filter values as wildcard patterns (* and ?) instead of exactly"),	     NULL	},
 	{ "encrypt-password", 0,    0,			  G_OPTION_ARG_NONE,	       NULL, N_("Encrypt a password"),												  NULL		 },
 	{ "disable-news",     0,    0,            G_OPTION_ARG_NONE,           NULL, N_("Disable news"),                                                NULL           },
 	{ "disable-stats",    0,    0,            G_OPTION_ARG_NONE,           NULL, N_("Disable stats"),                                                NULL           },
@@ -367,6 +374,23 @@ static gint remmina_on_local_cmdline(GApplication *app, GVariantDict *opts, gpoi
 		}
 	}
 
+	if (g_variant_dict_lookup_value(opts, "bulk-update", NULL)) {
+		gchar **filters;
+		if (!g_variant_dict_lookup(opts, "filter", "^a&s", &filters)) {
+			status = 1;
+			g_print("Error: --bulk-update requires --filter\n");
+		} else if (!g_variant_dict_lookup(opts, "set-option", "^a&s", &settings)) {
+			status = 1;
+			g_print("Error: --bulk-update requires --set-option\n");
+			g_free(filters);
+		} else {
+			status = remmina_exec_bulk_update(filters, settings,
+							  g_variant_dict_lookup_value(opts, "filter-glob", NULL) != NULL);
+			g_free(filters);
+			g_free(settings);
+		}
+	}
+
 	/* Returning a non negative value here makes the application exit */
 	return status;
 }
@@ -478,7 +502,15 @@ int main(int argc, char *argv[])
 				"\n"
 				"To update username and password and set a different resolution mode of a Remmina connection profile, use:\n"
 				"\n"
-				"\techo \"username\\napassword\" | remmina --update-profile /PATH/TO/FOO.remmina --set-option username --set-option resolution_mode=2 --set-option password\n"));
+				"\techo \"username\\napassword\" | remmina --update-profile /PATH/TO/FOO.remmina --set-option username --set-option resolution_mode=2 --set-option password\n"
+				"\n"
+				"To change the password of all the connection profiles of a user in a group, use:\n"
+				"\n"
+				"\techo \"newpassword\" | remmina --bulk-update --filter group=Servers --filter username=svc_backup --set-option password\n"
+				"\n"
+				"The same for every group whose name starts with Servers:\n"
+				"\n"
+				"\techo \"newpassword\" | remmina --bulk-update --filter-glob --filter \"group=Servers*\" --filter username=svc_backup --set-option password\n"));
 #endif
 
 	g_signal_connect(app, "startup", G_CALLBACK(remmina_on_startup), NULL);
@@ -488,6 +520,10 @@ int main(int argc, char *argv[])
 
 	g_application_set_inactivity_timeout(G_APPLICATION(app), 10000);
 	status = g_application_run(G_APPLICATION(app), argc, argv);
+	remmina_info_stats_cancel();
+	remmina_pref_sync();
+	remmina_file_sync();
+	remmina_video_recorder_wait_all();
 	g_object_unref(app);
 
 	return status;
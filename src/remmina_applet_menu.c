@@ -48,7 +48,9 @@
 G_DEFINE_TYPE( RemminaAppletMenu, remmina_applet_menu, GTK_TYPE_MENU)
 
 struct _RemminaAppletMenuPriv {
-	gboolean hide_count;
+	gboolean			hide_count;
+	GPtrArray *			profiles;       /* RemminaFileMeta */
+	struct _RemminaAppletMenuGroup *root;
 };
 
 enum {
@@ -58,9 +60,15 @@ enum {
 static guint remmina_applet_menu_signals[LAST_SIGNAL] =
 { 0 };
 
+static void remmina_applet_menu_group_free(gpointer data);
+
 static void remmina_applet_menu_destroy(RemminaAppletMenu *menu, gpointer data)
 {
 	TRACE_CALL(__func__);
+	if (menu->priv->root)
+		remmina_applet_menu_group_free(menu->priv->root);
+	if (menu->priv->profiles)
+		g_ptr_array_unref(menu->priv->profiles);
 	g_free(menu->priv);
 }
 
@@ -239,45 +247,154 @@ void remmina_applet_menu_set_hide_count(RemminaAppletMenu *menu, gboolean hide_c
 	menu->priv->hide_count = hide_count;
 }
 
+/* Group of the profile tree, its submenu is only filled when first selected */
+typedef struct _RemminaAppletMenuGroup {
+	RemminaAppletMenu *	menu;
+	gchar *			name;
+	GHashTable *		children;       /* name -> RemminaAppletMenuGroup */
+	GPtrArray *		profiles;       /* RemminaFileMeta owned by the menu */
+	gint			count;          /* Profiles in the group and its subgroups */
+	gboolean		populated;
+} RemminaAppletMenuGroup;
+
+static void remmina_applet_menu_group_free(gpointer data)
+{
+	RemminaAppletMenuGroup *g = (RemminaAppletMenuGroup *)data;
+
+	g_free(g->name);
+	g_hash_table_destroy(g->children);
+	g_ptr_array_unref(g->profiles);
+	g_free(g);
+}
+
+static RemminaAppletMenuGroup *remmina_applet_menu_group_new(RemminaAppletMenu *menu, const gchar *name)
+{
+	RemminaAppletMenuGroup *g;
+
+	g = g_new0(RemminaAppletMenuGroup, 1);
+	g->menu = menu;
+	g->name = g_strdup(name);
+	g->children = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, remmina_applet_menu_group_free);
+	g->profiles = g_ptr_array_new();
+	return g;
+}
+
+static gint remmina_applet_menu_compare_meta(gconstpointer a, gconstpointer b)
+{
+	const RemminaFileMeta *ma = *(const RemminaFileMeta **)a;
+	const RemminaFileMeta *mb = *(const RemminaFileMeta **)b;
+
+	return strcoll(ma->name, mb->name);
+}
+
+static gint remmina_applet_menu_compare_group(gconstpointer a, gconstpointer b)
+{
+	return strcoll(((const RemminaAppletMenuGroup *)a)->name, ((const RemminaAppletMenuGroup *)b)->name);
+}
+
+static void remmina_applet_menu_fill(GtkWidget *submenu, RemminaAppletMenuGroup *g);
+
+static void remmina_applet_menu_on_group_select(GtkMenuItem *groupmenuitem, RemminaAppletMenuGroup *g)
+{
+	TRACE_CALL(__func__);
+
+	if (g->populated)
+		return;
+	remmina_applet_menu_fill(gtk_menu_item_get_submenu(groupmenuitem), g);
+}
+
+/* Add the subgroups of g, then its profiles, to submenu */
+static void remmina_applet_menu_fill(GtkWidget *submenu, RemminaAppletMenuGroup *g)
+{
+	TRACE_CALL(__func__);
+	RemminaAppletMenuGroup *child;
+	GtkWidget *groupmenuitem;
+	GtkWidget *menuitem;
+	GList *children, *l;
+	gchar *s;
+
+	g->populated = TRUE;
+
+	children = g_list_sort(g_hash_table_get_values(g->children), remmina_applet_menu_compare_group);
+	for (l = children; l; l = l->next) {
+		child = (RemminaAppletMenuGroup *)l->data;
+		remmina_applet_menu_add_group(submenu, child->name, -1, NULL, &groupmenuitem);
+		/* Counted here, the profiles do not go through remmina_applet_menu_add_item() */
+		if (!g->menu->priv->hide_count) {
+			g_object_set_data(G_OBJECT(groupmenuitem), "count", GINT_TO_POINTER(child->count));
+			s = g_strdup_printf("%s (%i)", child->name, child->count);
+			gtk_menu_item_set_label(GTK_MENU_ITEM(groupmenuitem), s);
+			g_free(s);
+		}
+		g_signal_connect(G_OBJECT(groupmenuitem), "select", G_CALLBACK(remmina_applet_menu_on_group_select), child);
+	}
+	g_list_free(children);
+
+	for (guint i = 0; i < g->profiles->len; i++) {
+		menuitem = remmina_applet_menu_item_new_from_meta(g_ptr_array_index(g->profiles, i));
+		gtk_widget_show(menuitem);
+		gtk_menu_shell_append(GTK_MENU_SHELL(submenu), menuitem);
+		remmina_applet_menu_register_item(g->menu, REMMINA_APPLET_MENU_ITEM(menuitem));
+	}
+}
+
+/**
+ * Add all the connection profiles to the menu.
+ *
+ * The profiles come from the metadata index of the file manager, so no
+ * profile is read from disk unless it changed since the previous call.
+ * Only the top level is created here: the items of a group are created
+ * when its menu item is first selected.
+ */
 void remmina_applet_menu_populate(RemminaAppletMenu *menu)
 {
 	TRACE_CALL(__func__);
+	RemminaAppletMenuGroup *g, *child;
+	RemminaFileMeta *meta;
 	GtkWidget *menuitem;
-	gchar filename[MAX_PATH_LEN];
-	GDir *dir;
-	gchar *remmina_data_dir;
-	const gchar *name;
-	gint count = 0;
+	gchar **path;
 
 	gboolean new_ontop = remmina_pref.applet_new_ontop;
 
-	remmina_data_dir = remmina_file_get_datadir();
-	dir = g_dir_open(remmina_data_dir, 0, NULL);
-	if (dir != NULL) {
-		/* Iterate all remote desktop profiles */
-		while ((name = g_dir_read_name(dir)) != NULL) {
-			if (!g_str_has_suffix(name, ".remmina"))
-				continue;
-			g_snprintf(filename, sizeof(filename), "%s/%s", remmina_data_dir, name);
-
-			menuitem = remmina_applet_menu_item_new(REMMINA_APPLET_MENU_ITEM_FILE, filename);
-			if (menuitem != NULL) {
-				remmina_applet_menu_add_item(menu, REMMINA_APPLET_MENU_ITEM(menuitem));
-				gtk_widget_show(menuitem);
-				count++;
+	if (menu->priv->root)
+		remmina_applet_menu_group_free(menu->priv->root);
+	if (menu->priv->profiles)
+		g_ptr_array_unref(menu->priv->profiles);
+
+	menu->priv->profiles = remmina_file_manager_get_meta();
+	g_ptr_array_sort(menu->priv->profiles, remmina_applet_menu_compare_meta);
+
+	menu->priv->root = remmina_applet_menu_group_new(menu, NULL);
+	for (guint i = 0; i < menu->priv->profiles->len; i++) {
+		meta = g_ptr_array_index(menu->priv->profiles, i);
+		g = menu->priv->root;
+		if (meta->group && meta->group[0]) {
+			path = g_strsplit(meta->group, "/", -1);
+			for (gint j = 0; path[j]; j++) {
+				if (path[j][0] == '\0')
+					continue;
+				child = g_hash_table_lookup(g->children, path[j]);
+				if (!child) {
+					child = remmina_applet_menu_group_new(menu, path[j]);
+					g_hash_table_insert(g->children, child->name, child);
+				}
+				child->count++;
+				g = child;
 			}
+			g_strfreev(path);
 		}
-		g_dir_close(dir);
-		if (count > 0) {
-			/* Separator */
-			menuitem = gtk_separator_menu_item_new();
-			gtk_widget_show(menuitem);
-			if (new_ontop)
-				gtk_menu_shell_prepend(GTK_MENU_SHELL(menu), menuitem);
-			else
-				gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
-		}
+		g_ptr_array_add(g->profiles, meta);
 	}
-	g_free(remmina_data_dir);
-}
 
+	remmina_applet_menu_fill(GTK_WIDGET(menu), menu->priv->root);
+
+	if (menu->priv->profiles->len > 0) {
+		/* Separator */
+		menuitem = gtk_separator_menu_item_new();
+		gtk_widget_show(menuitem);
+		if (new_ontop)
+			gtk_menu_shell_prepend(GTK_MENU_SHELL(menu), menuitem);
+		else
+			gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
+	}
+}
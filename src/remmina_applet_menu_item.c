@@ -75,15 +75,52 @@ static void remmina_applet_menu_item_init(RemminaAppletMenuItem* item)
 	g_signal_connect(G_OBJECT(item), "destroy", G_CALLBACK(remmina_applet_menu_item_destroy), NULL);
 }
 
+/* Add the protocol icon, the label and the tooltip */
+static GtkWidget* remmina_applet_menu_item_build(RemminaAppletMenuItem* item)
+{
+	TRACE_CALL(__func__);
+	GtkWidget* widget;
+	GtkWidget* box;
+	GtkWidget* icon;
+
+	/* Get the icon based on the protocol */
+	gchar* icon_name;
+	RemminaProtocolPlugin *plugin;
+	plugin  = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL,
+									    item->protocol);
+	if (!plugin) {
+		icon_name = g_strconcat(REMMINA_APP_ID, "-symbolic", NULL);
+	} else {
+		icon_name = g_strdup(item->ssh_tunnel_enabled ? plugin->icon_name_ssh : plugin->icon_name);
+	}
+	icon = gtk_image_new_from_icon_name(icon_name, GTK_ICON_SIZE_MENU);
+	g_free(icon_name);
+
+	/* Create the label */
+	widget = gtk_label_new(item->name);
+	box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+	gtk_widget_show(widget);
+	gtk_widget_show(icon);
+	gtk_widget_show(box);
+	gtk_widget_set_valign(widget, GTK_ALIGN_START);
+	gtk_widget_set_halign(widget, GTK_ALIGN_START);
+	gtk_container_add(GTK_CONTAINER(box), icon);
+	gtk_container_add(GTK_CONTAINER(box), widget);
+	gtk_container_add(GTK_CONTAINER(item), box);
+
+	if (item->server) {
+		gtk_widget_set_tooltip_text(GTK_WIDGET(item), item->server);
+	}
+
+	return GTK_WIDGET(item);
+}
+
 GtkWidget* remmina_applet_menu_item_new(RemminaAppletMenuItemType item_type, ...)
 {
 	TRACE_CALL(__func__);
 	va_list ap;
 	RemminaAppletMenuItem* item;
 	GKeyFile* gkeyfile;
-	GtkWidget* widget;
-	GtkWidget* box;
-	GtkWidget* icon;
 
 	va_start(ap, item_type);
 
@@ -133,37 +170,25 @@ GtkWidget* remmina_applet_menu_item_new(RemminaAppletMenuItemType item_type, ...
 
 	va_end(ap);
 
+	return remmina_applet_menu_item_build(item);
+}
 
-	/* Get the icon based on the protocol */
-	gchar* icon_name;
-	RemminaProtocolPlugin *plugin;
-	plugin  = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL,
-									    item->protocol);
-	if (!plugin) {
-		icon_name = g_strconcat(REMMINA_APP_ID, "-symbolic", NULL);
-	} else {
-		icon_name = g_strdup(item->ssh_tunnel_enabled ? plugin->icon_name_ssh : plugin->icon_name);
-	}
-	icon = gtk_image_new_from_icon_name(icon_name, GTK_ICON_SIZE_MENU);
-	g_free(icon_name);
-
-	/* Create the label */
-	widget = gtk_label_new(item->name);
-	box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
-	gtk_widget_show(widget);
-	gtk_widget_show(icon);
-	gtk_widget_show(box);
-	gtk_widget_set_valign(widget, GTK_ALIGN_START);
-	gtk_widget_set_halign(widget, GTK_ALIGN_START);
-	gtk_container_add(GTK_CONTAINER(box), icon);
-	gtk_container_add(GTK_CONTAINER(box), widget);
-	gtk_container_add(GTK_CONTAINER(item), box);
-
-	if (item->server) {
-		gtk_widget_set_tooltip_text(GTK_WIDGET(item), item->server);
-	}
+/* A profile item from the metadata index, without reading the profile */
+GtkWidget* remmina_applet_menu_item_new_from_meta(const RemminaFileMeta* meta)
+{
+	TRACE_CALL(__func__);
+	RemminaAppletMenuItem* item;
 
-	return GTK_WIDGET(item);
+	item = REMMINA_APPLET_MENU_ITEM(g_object_new(REMMINA_TYPE_APPLET_MENU_ITEM, NULL));
+	item->item_type = REMMINA_APPLET_MENU_ITEM_FILE;
+	item->filename = g_strdup(meta->filename);
+	item->name = g_strdup(meta->name);
+	item->group = g_strdup(meta->group);
+	item->protocol = g_strdup(meta->protocol);
+	item->server = g_strdup(meta->server);
+	item->ssh_tunnel_enabled = meta->ssh_tunnel_enabled;
+
+	return remmina_applet_menu_item_build(item);
 }
 
 gint remmina_applet_menu_item_compare(gconstpointer a, gconstpointer b, gpointer user_data)
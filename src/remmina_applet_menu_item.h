@@ -36,6 +36,7 @@
 #pragma once
 
 #include <gtk/gtk.h>
+#include "remmina_file_manager.h"
 
 G_BEGIN_DECLS
 
@@ -70,6 +71,7 @@ GType remmina_applet_menu_item_get_type(void)
 G_GNUC_CONST;
 
 GtkWidget *remmina_applet_menu_item_new(RemminaAppletMenuItemType item_type, ...);
+GtkWidget *remmina_applet_menu_item_new_from_meta(const RemminaFileMeta *meta);
 gint remmina_applet_menu_item_compare(gconstpointer a, gconstpointer b, gpointer user_data);
 
 G_END_DECLS
@@ -0,0 +1,528 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "remmina_bulk.h"
+#include "remmina_crypt.h"
+#include "remmina_file.h"
+#include "remmina_log.h"
+#include "remmina_main.h"
+#include "remmina_plugin_manager.h"
+#include "remmina_pref.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Keyring entries written per main loop iteration */
+#define REMMINA_BULK_KEYRING_BATCH 32
+#define REMMINA_BULK_PROGRESS_INTERVAL 100
+
+typedef enum {
+	REMMINA_BULK_PREPARE,
+	REMMINA_BULK_KEYRING,
+	REMMINA_BULK_COMMIT,
+	REMMINA_BULK_ROLLBACK
+} RemminaBulkPhase;
+
+typedef struct _RemminaBulkProfile {
+	gchar *		filename;
+	gchar *		name;
+	gchar *		original;
+	gsize		original_len;
+	gchar *		updated;
+	gsize		updated_len;
+	gboolean	written;
+} RemminaBulkProfile;
+
+typedef struct _RemminaBulkSecret {
+	RemminaBulkProfile *	profile;
+	gchar *			setting;
+	gchar *			value;          /* NULL to remove it from the keyring */
+	gchar *			previous;
+	gboolean		applied;
+} RemminaBulkSecret;
+
+struct _RemminaBulkOp {
+	GPtrArray *		profiles;
+	GPtrArray *		settings;       /* setting, value, setting, value… */
+	GPtrArray *		secrets;
+
+	RemminaSecretPlugin *	secret_plugin;
+	gboolean		secret_service_available;
+
+	GThreadPool *		pool;
+	RemminaBulkPhase	phase;
+	gint			pending;        /* Profiles left in the current phase, atomic */
+	gint			progress;       /* atomic */
+	guint			total;
+	guint			keyring_pos;
+	guint			progress_source;
+
+	pthread_mutex_t		mutex;
+	gchar *			error;          /* First error, protected by mutex */
+
+	RemminaBulkProgressFunc progress_cb;
+	RemminaBulkDoneFunc	done_cb;
+	gpointer		user_data;
+};
+
+static void remmina_bulk_profile_free(gpointer data)
+{
+	RemminaBulkProfile *p = (RemminaBulkProfile *)data;
+
+	g_free(p->filename);
+	g_free(p->name);
+	g_free(p->original);
+	g_free(p->updated);
+	g_free(p);
+}
+
+static void remmina_bulk_secret_free(gpointer data)
+{
+	RemminaBulkSecret *s = (RemminaBulkSecret *)data;
+
+	g_free(s->setting);
+	if (s->value)
+		memset(s->value, 0, strlen(s->value));
+	g_free(s->value);
+	if (s->previous)
+		memset(s->previous, 0, strlen(s->previous));
+	g_free(s->previous);
+	g_free(s);
+}
+
+RemminaBulkOp *remmina_bulk_new(void)
+{
+	TRACE_CALL(__func__);
+	RemminaBulkOp *op;
+
+	op = g_new0(RemminaBulkOp, 1);
+	op->profiles = g_ptr_array_new_with_free_func(remmina_bulk_profile_free);
+	op->settings = g_ptr_array_new_with_free_func(g_free);
+	op->secrets = g_ptr_array_new_with_free_func(remmina_bulk_secret_free);
+	pthread_mutex_init(&op->mutex, NULL);
+	return op;
+}
+
+void remmina_bulk_free(RemminaBulkOp *op)
+{
+	TRACE_CALL(__func__);
+
+	g_ptr_array_unref(op->profiles);
+	g_ptr_array_unref(op->settings);
+	g_ptr_array_unref(op->secrets);
+	pthread_mutex_destroy(&op->mutex);
+	g_free(op->error);
+	g_free(op);
+}
+
+void remmina_bulk_add_profile(RemminaBulkOp *op, const gchar *filename)
+{
+	TRACE_CALL(__func__);
+	RemminaBulkProfile *p;
+
+	p = g_new0(RemminaBulkProfile, 1);
+	p->filename = g_strdup(filename);
+	g_ptr_array_add(op->profiles, p);
+}
+
+void remmina_bulk_set(RemminaBulkOp *op, const gchar *setting, const gchar *value)
+{
+	TRACE_CALL(__func__);
+
+	g_ptr_array_add(op->settings, g_strdup(setting));
+	g_ptr_array_add(op->settings, g_strdup(value ? value : ""));
+}
+
+guint remmina_bulk_get_profile_count(RemminaBulkOp *op)
+{
+	return op->profiles->len;
+}
+
+static void remmina_bulk_set_error(RemminaBulkOp *op, gchar *error)
+{
+	pthread_mutex_lock(&op->mutex);
+	if (op->error == NULL) {
+		REMMINA_WARNING("%s", error);
+		op->error = error;
+	} else {
+		g_free(error);
+	}
+	pthread_mutex_unlock(&op->mutex);
+}
+
+static gboolean remmina_bulk_failed(RemminaBulkOp *op)
+{
+	gboolean failed;
+
+	pthread_mutex_lock(&op->mutex);
+	failed = op->error != NULL;
+	pthread_mutex_unlock(&op->mutex);
+	return failed;
+}
+
+/* Value the operation gives to setting, or NULL when it is not changed */
+static const gchar *remmina_bulk_get_setting(RemminaBulkOp *op, const gchar *setting)
+{
+	for (guint i = 0; i + 1 < op->settings->len; i += 2)
+		if (g_strcmp0(g_ptr_array_index(op->settings, i), setting) == 0)
+			return g_ptr_array_index(op->settings, i + 1);
+	return NULL;
+}
+
+static void remmina_bulk_add_secret(RemminaBulkOp *op, RemminaBulkProfile *p, const gchar *setting, const gchar *value)
+{
+	RemminaBulkSecret *s;
+
+	s = g_new0(RemminaBulkSecret, 1);
+	s->profile = p;
+	s->setting = g_strdup(setting);
+	s->value = g_strdup(value);
+	pthread_mutex_lock(&op->mutex);
+	g_ptr_array_add(op->secrets, s);
+	pthread_mutex_unlock(&op->mutex);
+}
+
+/* Worker: read the profile and compute its new content, nothing is written yet */
+static void remmina_bulk_prepare(RemminaBulkOp *op, RemminaBulkProfile *p)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolPlugin *protocol_plugin = NULL;
+	GKeyFile *gkeyfile;
+	GError *err = NULL;
+	const gchar *setting, *value;
+	gchar *proto, *s;
+	gint nopasswdsave;
+
+	if (!g_file_get_contents(p->filename, &p->original, &p->original_len, &err)) {
+		remmina_bulk_set_error(op, g_strdup_printf(_("Unable to read %s: %s"), p->filename, err->message));
+		g_error_free(err);
+		return;
+	}
+
+	gkeyfile = g_key_file_new();
+	if (!g_key_file_load_from_data(gkeyfile, p->original, p->original_len, G_KEY_FILE_NONE, &err)) {
+		remmina_bulk_set_error(op, g_strdup_printf(_("Unable to parse %s: %s"), p->filename, err->message));
+		g_error_free(err);
+		g_key_file_free(gkeyfile);
+		return;
+	}
+
+	p->name = g_key_file_get_string(gkeyfile, "remmina", "name", NULL);
+	proto = g_key_file_get_string(gkeyfile, "remmina", "protocol", NULL);
+	if (proto)
+		protocol_plugin = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, proto);
+	g_free(proto);
+
+	if ((value = remmina_bulk_get_setting(op, "disablepasswordstoring")) != NULL)
+		nopasswdsave = atoi(value);
+	else
+		nopasswdsave = g_key_file_get_integer(gkeyfile, "remmina", "disablepasswordstoring", NULL);
+
+	for (guint i = 0; i + 1 < op->settings->len; i += 2) {
+		setting = g_ptr_array_index(op->settings, i);
+		value = g_ptr_array_index(op->settings, i + 1);
+		if (!protocol_plugin || !remmina_plugin_manager_is_encrypted_setting(protocol_plugin, setting)) {
+			g_key_file_set_string(gkeyfile, "remmina", setting, value);
+			continue;
+		}
+		/* Same storage rules as remmina_file_save() */
+		if (op->secret_service_available && nopasswdsave == 0) {
+			remmina_bulk_add_secret(op, p, setting, value[0] ? value : NULL);
+			g_key_file_set_string(gkeyfile, "remmina", setting, value[0] ? "." : "");
+		} else if (value[0] && nopasswdsave == 0) {
+			s = remmina_crypt_encrypt(value);
+			g_key_file_set_string(gkeyfile, "remmina", setting, s);
+			g_free(s);
+		} else {
+			if (op->secret_service_available)
+				remmina_bulk_add_secret(op, p, setting, NULL);
+			g_key_file_set_string(gkeyfile, "remmina", setting, "");
+		}
+	}
+
+	p->updated = g_key_file_to_data(gkeyfile, &p->updated_len, NULL);
+	g_key_file_free(gkeyfile);
+}
+
+/* Whether the profile on disk still has the content we expect, e.g. it
+ * was not saved from the editor since it was read */
+static gboolean remmina_bulk_unchanged(RemminaBulkProfile *p, const gchar *expected, gsize expected_len)
+{
+	gchar *content;
+	gsize len;
+	gboolean unchanged;
+
+	if (!g_file_get_contents(p->filename, &content, &len, NULL))
+		return FALSE;
+	unchanged = len == expected_len && memcmp(content, expected, len) == 0;
+	g_free(content);
+	return unchanged;
+}
+
+/* Worker: replace the profile atomically */
+static void remmina_bulk_commit(RemminaBulkOp *op, RemminaBulkProfile *p)
+{
+	TRACE_CALL(__func__);
+	GError *err = NULL;
+
+	if (!remmina_bulk_unchanged(p, p->original, p->original_len)) {
+		remmina_bulk_set_error(op, g_strdup_printf(_("%s has been modified during the update"), p->filename));
+		return;
+	}
+	if (!g_file_set_contents(p->filename, p->updated, p->updated_len, &err)) {
+		remmina_bulk_set_error(op, g_strdup_printf(_("Unable to save %s: %s"), p->filename, err->message));
+		g_error_free(err);
+		return;
+	}
+	p->written = TRUE;
+}
+
+/* Worker: put back the content the profile had before the operation */
+static void remmina_bulk_rollback(RemminaBulkOp *op, RemminaBulkProfile *p)
+{
+	TRACE_CALL(__func__);
+	GError *err = NULL;
+
+	if (!p->written)
+		return;
+	/* Whoever saved it after us wins, their version is newer than ours */
+	if (!remmina_bulk_unchanged(p, p->updated, p->updated_len)) {
+		REMMINA_CRITICAL("Not restoring %s, it has been modified after the update", p->filename);
+		return;
+	}
+	if (!g_file_set_contents(p->filename, p->original, p->original_len, &err)) {
+		REMMINA_CRITICAL("Unable to restore %s: %s", p->filename, err->message);
+		g_error_free(err);
+	}
+}
+
+static gboolean remmina_bulk_phase_done(gpointer data);
+
+static void remmina_bulk_worker(gpointer data, gpointer user_data)
+{
+	RemminaBulkProfile *p = (RemminaBulkProfile *)data;
+	RemminaBulkOp *op = (RemminaBulkOp *)user_data;
+
+	switch (op->phase) {
+	case REMMINA_BULK_PREPARE:
+		/* No need to read the others once one profile failed */
+		if (!remmina_bulk_failed(op))
+			remmina_bulk_prepare(op, p);
+		break;
+	case REMMINA_BULK_COMMIT:
+		if (!remmina_bulk_failed(op))
+			remmina_bulk_commit(op, p);
+		break;
+	case REMMINA_BULK_ROLLBACK:
+		remmina_bulk_rollback(op, p);
+		break;
+	default:
+		break;
+	}
+
+	g_atomic_int_inc(&op->progress);
+	if (g_atomic_int_dec_and_test(&op->pending))
+		g_idle_add(remmina_bulk_phase_done, op);
+}
+
+/* Run the current phase on every profile in the thread pool */
+static void remmina_bulk_start_phase(RemminaBulkOp *op, RemminaBulkPhase phase)
+{
+	TRACE_CALL(__func__);
+
+	op->phase = phase;
+	if (op->profiles->len == 0) {
+		g_idle_add(remmina_bulk_phase_done, op);
+		return;
+	}
+	g_atomic_int_set(&op->pending, op->profiles->len);
+	for (guint i = 0; i < op->profiles->len; i++)
+		g_thread_pool_push(op->pool, g_ptr_array_index(op->profiles, i), NULL);
+}
+
+static void remmina_bulk_report_progress(RemminaBulkOp *op)
+{
+	if (op->progress_cb)
+		op->progress_cb(MIN((guint)g_atomic_int_get(&op->progress), op->total), op->total, op->user_data);
+}
+
+static gboolean remmina_bulk_progress_cb(gpointer data)
+{
+	remmina_bulk_report_progress((RemminaBulkOp *)data);
+	return G_SOURCE_CONTINUE;
+}
+
+static void remmina_bulk_finish(RemminaBulkOp *op)
+{
+	TRACE_CALL(__func__);
+	gboolean written = FALSE;
+
+	if (op->progress_source) {
+		g_source_remove(op->progress_source);
+		op->progress_source = 0;
+	}
+	g_thread_pool_free(op->pool, FALSE, TRUE);
+	op->pool = NULL;
+
+	if (!op->error) {
+		g_atomic_int_set(&op->progress, op->total);
+		remmina_bulk_report_progress(op);
+		written = op->profiles->len > 0;
+	}
+
+	if (op->done_cb)
+		op->done_cb(op->error ? 0 : op->profiles->len, op->error, op->user_data);
+
+	if (written && !remmina_pref.list_refresh_workaround)
+		remmina_main_update_file_datetime(NULL);
+
+	remmina_bulk_free(op);
+}
+
+/* Main thread: give back to the keyring the values it had before */
+static void remmina_bulk_keyring_rollback(RemminaBulkOp *op)
+{
+	TRACE_CALL(__func__);
+	RemminaBulkSecret *s;
+	RemminaFile *remminafile;
+
+	for (guint i = 0; i < op->secrets->len; i++) {
+		s = g_ptr_array_index(op->secrets, i);
+		if (!s->applied)
+			continue;
+		remminafile = remmina_file_new_for_keyring(s->profile->filename, s->profile->name);
+		if (s->previous)
+			op->secret_plugin->store_password(op->secret_plugin, remminafile, s->setting, s->previous);
+		else
+			op->secret_plugin->delete_password(op->secret_plugin, remminafile, s->setting);
+		remmina_file_free(remminafile);
+	}
+}
+
+/* Main thread: write a batch of keyring entries, remembering the old values */
+static gboolean remmina_bulk_keyring_step(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaBulkOp *op = (RemminaBulkOp *)data;
+	RemminaBulkSecret *s;
+	RemminaFile *remminafile;
+	guint n;
+
+	for (n = 0; n < REMMINA_BULK_KEYRING_BATCH && op->keyring_pos < op->secrets->len; n++, op->keyring_pos++) {
+		s = g_ptr_array_index(op->secrets, op->keyring_pos);
+		remminafile = remmina_file_new_for_keyring(s->profile->filename, s->profile->name);
+		s->previous = op->secret_plugin->get_password(op->secret_plugin, remminafile, s->setting);
+		if (g_strcmp0(s->previous, s->value) != 0) {
+			if (s->value)
+				op->secret_plugin->store_password(op->secret_plugin, remminafile, s->setting, s->value);
+			else
+				op->secret_plugin->delete_password(op->secret_plugin, remminafile, s->setting);
+			s->applied = TRUE;
+		}
+		remmina_file_free(remminafile);
+		g_atomic_int_inc(&op->progress);
+	}
+
+	if (op->keyring_pos < op->secrets->len)
+		return G_SOURCE_CONTINUE;
+
+	remmina_bulk_start_phase(op, REMMINA_BULK_COMMIT);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean remmina_bulk_phase_done(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaBulkOp *op = (RemminaBulkOp *)data;
+
+	switch (op->phase) {
+	case REMMINA_BULK_PREPARE:
+		if (op->error) {
+			/* Nothing has been touched yet */
+			remmina_bulk_finish(op);
+			break;
+		}
+		op->total += op->secrets->len;
+		if (op->secrets->len > 0) {
+			op->phase = REMMINA_BULK_KEYRING;
+			g_idle_add(remmina_bulk_keyring_step, op);
+		} else {
+			remmina_bulk_start_phase(op, REMMINA_BULK_COMMIT);
+		}
+		break;
+	case REMMINA_BULK_COMMIT:
+		if (op->error) {
+			REMMINA_WARNING("Bulk profile update failed, restoring the previous profiles");
+			remmina_bulk_start_phase(op, REMMINA_BULK_ROLLBACK);
+			break;
+		}
+		remmina_bulk_finish(op);
+		break;
+	case REMMINA_BULK_ROLLBACK:
+		remmina_bulk_keyring_rollback(op);
+		remmina_bulk_finish(op);
+		break;
+	default:
+		break;
+	}
+	return G_SOURCE_REMOVE;
+}
+
+void remmina_bulk_run(RemminaBulkOp *op, RemminaBulkProgressFunc progress, RemminaBulkDoneFunc done, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+
+	op->progress_cb = progress;
+	op->done_cb = done;
+	op->user_data = user_data;
+
+	op->secret_plugin = remmina_plugin_manager_get_secret_plugin();
+	op->secret_service_available = op->secret_plugin && op->secret_plugin->is_service_available(op->secret_plugin);
+
+	/* Profiles are read from disk, write what is still queued first */
+	remmina_file_sync();
+
+	REMMINA_DEBUG("Updating %u profiles", op->profiles->len);
+	op->total = op->profiles->len * 2;
+	op->pool = g_thread_pool_new(remmina_bulk_worker, op, g_get_num_processors(), FALSE, NULL);
+	if (op->progress_cb)
+		op->progress_source = g_timeout_add(REMMINA_BULK_PROGRESS_INTERVAL, remmina_bulk_progress_cb, op);
+	remmina_bulk_start_phase(op, REMMINA_BULK_PREPARE);
+}
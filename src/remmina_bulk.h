@@ -0,0 +1,75 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Applies the same settings to many connection profiles at once, e.g. to
+ * rotate the password of a service account.
+ *
+ * Profiles are read and rewritten by a pool of worker threads without
+ * going through remmina_file_load(), so secrets that do not change are
+ * never read from the keyring. Keyring writes must run on the main
+ * thread (secret plugins use the RemminaFile API), they are done in
+ * batches from an idle handler to keep the UI responsive.
+ *
+ * The operation is all-or-nothing: if any profile cannot be read or
+ * written, or changed on disk since it was read, the profiles already
+ * rewritten get their previous content back and the keyring entries
+ * their previous value. A profile changed again after it was rewritten
+ * is left alone.
+ */
+
+typedef struct _RemminaBulkOp RemminaBulkOp;
+
+/* Called on the main thread, done grows up to total */
+typedef void (*RemminaBulkProgressFunc)(guint done, guint total, gpointer user_data);
+/* Called on the main thread once, error is NULL on success */
+typedef void (*RemminaBulkDoneFunc)(guint changed, const gchar *error, gpointer user_data);
+
+RemminaBulkOp *remmina_bulk_new(void);
+void remmina_bulk_add_profile(RemminaBulkOp *op, const gchar *filename);
+/* Setting to apply to every profile, secrets are stored as remmina_file_save() does */
+void remmina_bulk_set(RemminaBulkOp *op, const gchar *setting, const gchar *value);
+guint remmina_bulk_get_profile_count(RemminaBulkOp *op);
+/* Only for an operation that is not run */
+void remmina_bulk_free(RemminaBulkOp *op);
+/* Takes ownership of op, which is freed after done has been called */
+void remmina_bulk_run(RemminaBulkOp *op, RemminaBulkProgressFunc progress, RemminaBulkDoneFunc done, gpointer user_data);
+
+G_END_DECLS
@@ -38,6 +38,7 @@
 #include "buildflags.h"
 #include <glib/gi18n.h>
 #include <stdlib.h>
+#include <string.h>
 #include "remmina.h"
 #include "remmina_main.h"
 #include "remmina_log.h"
@@ -55,6 +56,7 @@
 #include "remmina/remmina_trace_calls.h"
 #include "remmina_file_manager.h"
 #include "remmina_crypt.h"
+#include "remmina_bulk.h"
 
 #include "remmina_icon.h"
 
@@ -223,6 +225,126 @@ int remmina_exec_set_setting(gchar *profilefilename, gchar **settings)
 
 }
 
+struct bulk_update_data {
+	GMainLoop *loop;
+	int status;
+};
+
+static void remmina_exec_bulk_update_progress(guint done, guint total, gpointer user_data)
+{
+	g_print("\r%u/%u", done, total);
+}
+
+static void remmina_exec_bulk_update_done(guint changed, const gchar *error, gpointer user_data)
+{
+	struct bulk_update_data *bud = (struct bulk_update_data *)user_data;
+
+	g_print("\n");
+	if (error) {
+		g_print("Error: %s\nNo profile has been modified\n", error);
+		bud->status = 1;
+	} else {
+		g_print("%u profiles modified\n", changed);
+		bud->status = 0;
+	}
+	g_main_loop_quit(bud->loop);
+}
+
+/* used for commandline parameter --bulk-update --filter K=V --set-option Y --set-option Z
+ * The profiles are selected through the metadata index: the setting of the
+ * profile must be equal to every filter, or match it as a wildcard pattern
+ * with --filter-glob.
+ * return a status code for exit()
+ */
+int remmina_exec_bulk_update(gchar **filters, gchar **settings, gboolean glob)
+{
+	TRACE_CALL(__func__);
+	struct bulk_update_data bud;
+	RemminaFileMeta *meta;
+	RemminaBulkOp *op;
+	GPtrArray *profiles;
+	const gchar *value;
+	gchar **tk;
+	char *line = NULL;
+	size_t len = 0;
+	ssize_t read;
+	gboolean match;
+	int i, j;
+
+	for (i = 0; filters[i] != NULL; i++) {
+		tk = g_strsplit(filters[i], "=", 2);
+		if (tk[1] == NULL) {
+			g_print("Error: filter %s is not in the form setting=value\n", filters[i]);
+			g_strfreev(tk);
+			return 1;
+		}
+		g_strfreev(tk);
+	}
+
+	op = remmina_bulk_new();
+	profiles = remmina_file_manager_get_meta();
+	for (i = 0; i < profiles->len; i++) {
+		meta = g_ptr_array_index(profiles, i);
+		match = TRUE;
+		for (j = 0; filters[j] != NULL && match; j++) {
+			tk = g_strsplit(filters[j], "=", 2);
+			value = remmina_file_meta_get_string(meta, tk[0]);
+			if (value == NULL) {
+				g_print("Error: profiles cannot be filtered by %s\n", tk[0]);
+				g_strfreev(tk);
+				g_ptr_array_unref(profiles);
+				remmina_bulk_free(op);
+				return 1;
+			}
+			match = glob ? g_pattern_match_simple(tk[1], value) : g_strcmp0(value, tk[1]) == 0;
+			g_strfreev(tk);
+		}
+		if (match)
+			remmina_bulk_add_profile(op, meta->filename);
+	}
+	g_ptr_array_unref(profiles);
+
+	if (remmina_bulk_get_profile_count(op) == 0) {
+		g_print("No profile matches the filters\n");
+		remmina_bulk_free(op);
+		return 1;
+	}
+
+	for (i = 0; settings[i] != NULL; i++) {
+		if (strlen(settings[i]) == 0)
+			continue;
+		tk = g_strsplit(settings[i], "=", 2);
+		if (tk[1] == NULL) {
+			read = getline(&line, &len, stdin);
+			if (read <= 0) {
+				g_print("Error: an extra line of standard input is needed\n");
+				g_strfreev(tk);
+				free(line);
+				remmina_bulk_free(op);
+				return 1;
+			}
+			newline_remove(line);
+			remmina_bulk_set(op, tk[0], line);
+		} else {
+			remmina_bulk_set(op, tk[0], tk[1]);
+		}
+		g_strfreev(tk);
+	}
+	if (line) {
+		memset(line, 0, len);
+		free(line);
+	}
+
+	g_print("Modifying %u profiles\n", remmina_bulk_get_profile_count(op));
+	bud.loop = g_main_loop_new(NULL, FALSE);
+	bud.status = 1;
+	remmina_bulk_run(op, remmina_exec_bulk_update_progress, remmina_exec_bulk_update_done, &bud);
+	g_main_loop_run(bud.loop);
+	g_main_loop_unref(bud.loop);
+
+	return bud.status;
+}
+
 static void remmina_exec_autostart_cb(RemminaFile *remminafile, gpointer user_data)
 {
 	TRACE_CALL(__func__);
@@ -67,5 +67,6 @@ void remmina_exec_exitremmina_one_confirm(void);
 void remmina_application_condexit(RemminaCondExitType why);
 
 int remmina_exec_set_setting(gchar *profilefilename, gchar **settings);
+int remmina_exec_bulk_update(gchar **filters, gchar **settings, gboolean glob);
 
 G_END_DECLS
@@ -42,6 +42,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <locale.h>
+#include <pthread.h>
 #include <langinfo.h>
 #include <stdlib.h>
 #include <string.h>
@@ -73,6 +74,225 @@
 
 static struct timespec times[2];
 
+/* Profile and state files are not written by remmina_file_save() itself.
+ * The changed keys are queued per path and written together shortly
+ * after, so a burst of saves of the same profile (credentials, window
+ * geometry and last_success at disconnect…) ends up in one write. A
+ * queued write merges its keys into what is on disk at that moment and
+ * replaces the file atomically. Readers of a path flush it first. */
+#define REMMINA_FILE_WRITE_DELAY 300
+
+typedef struct _RemminaFilePendingWrite {
+	GKeyFile *	updates;
+	gboolean	remove_legacy;  /* Drop the keys no longer used in profiles */
+} RemminaFilePendingWrite;
+
+static pthread_mutex_t remmina_file_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Held from taking a queued write until it is on disk, so that a reader
+ * flushing the same path waits for it instead of reading the old file.
+ * Taken before remmina_file_write_mutex. */
+static pthread_mutex_t remmina_file_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *remmina_file_pending_writes = NULL;  /* path -> RemminaFilePendingWrite */
+static guint remmina_file_write_timeout = 0;
+static gboolean remmina_file_list_stale = FALSE;        /* Files written since the list was reloaded */
+
+static void remmina_file_pending_write_free(gpointer data)
+{
+	RemminaFilePendingWrite *w = (RemminaFilePendingWrite *)data;
+
+	g_key_file_free(w->updates);
+	g_free(w);
+}
+
+/* Copy every key of src into dest, replacing the existing values */
+static void remmina_file_merge_keys(GKeyFile *dest, GKeyFile *src)
+{
+	gchar **groups, **keys, *value;
+
+	groups = g_key_file_get_groups(src, NULL);
+	for (gint i = 0; groups[i]; i++) {
+		keys = g_key_file_get_keys(src, groups[i], NULL, NULL);
+		for (gint j = 0; keys && keys[j]; j++) {
+			value = g_key_file_get_value(src, groups[i], keys[j], NULL);
+			g_key_file_set_value(dest, groups[i], keys[j], value);
+			g_free(value);
+		}
+		g_strfreev(keys);
+	}
+	g_strfreev(groups);
+}
+
+static gboolean remmina_file_write(const gchar *path, RemminaFilePendingWrite *w)
+{
+	TRACE_CALL(__func__);
+	GKeyFile *gkeyfile;
+	gchar *content;
+	gsize length = 0;
+	GError *err = NULL;
+	gboolean ret;
+
+	gkeyfile = g_key_file_new();
+	/* it will fail if it’s a new file, but shouldn’t matter. */
+	g_key_file_load_from_file(gkeyfile, path, G_KEY_FILE_NONE, NULL);
+
+	remmina_file_merge_keys(gkeyfile, w->updates);
+
+	if (w->remove_legacy) {
+		/* Avoid storing redundant and deprecated "resolution" field */
+		g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "resolution", NULL);
+
+		/* Delete old pre-1.4 ssh keys */
+		g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "ssh_enabled", NULL);
+		g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "save_ssh_server", NULL);
+		g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "save_ssh_username", NULL);
+	}
+
+	content = g_key_file_to_data(gkeyfile, &length, NULL);
+	ret = g_file_set_contents(path, content, length, &err);
+	if (ret) {
+		REMMINA_DEBUG("%s saved", path);
+		pthread_mutex_lock(&remmina_file_write_mutex);
+		remmina_file_list_stale = TRUE;
+		pthread_mutex_unlock(&remmina_file_write_mutex);
+	} else {
+		REMMINA_WARNING("Remmina connection profile cannot be saved, with error %d (%s)", err->code, err->message);
+	}
+	if (err != NULL)
+		g_error_free(err);
+	g_free(content);
+	g_key_file_free(gkeyfile);
+	return ret;
+}
+
+/* Write now whatever is queued for path */
+static void remmina_file_flush(const gchar *path)
+{
+	TRACE_CALL(__func__);
+	RemminaFilePendingWrite *w = NULL;
+	gchar *key = NULL;
+
+	if (!path)
+		return;
+
+	pthread_mutex_lock(&remmina_file_flush_mutex);
+	pthread_mutex_lock(&remmina_file_write_mutex);
+	if (remmina_file_pending_writes &&
+	    g_hash_table_lookup_extended(remmina_file_pending_writes, path, (gpointer *)&key, (gpointer *)&w))
+		g_hash_table_steal(remmina_file_pending_writes, key);
+	pthread_mutex_unlock(&remmina_file_write_mutex);
+
+	if (w) {
+		remmina_file_write(path, w);
+		remmina_file_pending_write_free(w);
+		g_free(key);
+	}
+	pthread_mutex_unlock(&remmina_file_flush_mutex);
+}
+
+/* Write everything that is queued */
+static void remmina_file_flush_all(void)
+{
+	TRACE_CALL(__func__);
+	GHashTable *pending;
+	GHashTableIter iter;
+	gpointer path, w;
+
+	pthread_mutex_lock(&remmina_file_flush_mutex);
+	pthread_mutex_lock(&remmina_file_write_mutex);
+	pending = remmina_file_pending_writes;
+	remmina_file_pending_writes = NULL;
+	pthread_mutex_unlock(&remmina_file_write_mutex);
+
+	if (pending) {
+		g_hash_table_iter_init(&iter, pending);
+		while (g_hash_table_iter_next(&iter, &path, &w))
+			remmina_file_write((const gchar *)path, (RemminaFilePendingWrite *)w);
+		g_hash_table_destroy(pending);
+	}
+	pthread_mutex_unlock(&remmina_file_flush_mutex);
+}
+
+static gboolean remmina_file_write_cb(gpointer data)
+{
+	TRACE_CALL(__func__);
+	gboolean stale;
+
+	remmina_file_flush_all();
+
+	pthread_mutex_lock(&remmina_file_write_mutex);
+	remmina_file_write_timeout = 0;
+	stale = remmina_file_list_stale;
+	remmina_file_list_stale = FALSE;
+	pthread_mutex_unlock(&remmina_file_write_mutex);
+
+	/* Once for the whole batch instead of once per remmina_file_save() */
+	if (stale && !remmina_pref.list_refresh_workaround)
+		remmina_main_update_file_datetime(NULL);
+	return G_SOURCE_REMOVE;
+}
+
+/* Takes ownership of updates */
+static void remmina_file_queue_write(const gchar *path, GKeyFile *updates, gboolean remove_legacy)
+{
+	TRACE_CALL(__func__);
+	RemminaFilePendingWrite *w;
+
+	if (!path) {
+		g_key_file_free(updates);
+		return;
+	}
+
+	pthread_mutex_lock(&remmina_file_write_mutex);
+	if (!remmina_file_pending_writes)
+		remmina_file_pending_writes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, remmina_file_pending_write_free);
+
+	w = g_hash_table_lookup(remmina_file_pending_writes, path);
+	if (!w) {
+		w = g_new0(RemminaFilePendingWrite, 1);
+		w->updates = updates;
+		g_hash_table_insert(remmina_file_pending_writes, g_strdup(path), w);
+	} else {
+		/* Coalesce with the write already queued, newer values win */
+		remmina_file_merge_keys(w->updates, updates);
+		g_key_file_free(updates);
+	}
+	w->remove_legacy |= remove_legacy;
+
+	if (remmina_file_write_timeout == 0)
+		remmina_file_write_timeout = g_timeout_add(REMMINA_FILE_WRITE_DELAY, remmina_file_write_cb, NULL);
+	pthread_mutex_unlock(&remmina_file_write_mutex);
+}
+
+static gboolean remmina_file_has_pending_write(const gchar *path)
+{
+	gboolean ret;
+
+	pthread_mutex_lock(&remmina_file_write_mutex);
+	ret = remmina_file_pending_writes && g_hash_table_contains(remmina_file_pending_writes, path);
+	pthread_mutex_unlock(&remmina_file_write_mutex);
+	return ret;
+}
+
+/* Write all queued profile and state changes now. The connection list
+ * is still reloaded by the pending timeout. */
+void remmina_file_sync(void)
+{
+	TRACE_CALL(__func__);
+
+	remmina_file_flush_all();
+}
+
+/* Every setting has to be written, e.g. the profile is new or moved */
+static void remmina_file_mark_all_dirty(RemminaFile *remminafile)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, remminafile->settings);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		g_hash_table_add(remminafile->dirty_settings, g_strdup((const gchar *)key));
+}
+
 static RemminaFile *
 remmina_file_new_empty(void)
 {
@@ -86,10 +306,30 @@ remmina_file_new_empty(void)
 	 * it’s used by remmina_file_store_secret_plugin_password() to know
 	 * where to change */
 	remminafile->spsettings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	/* Keys changed since the profile was loaded or last saved */
+	remminafile->dirty_settings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	remminafile->dirty_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 	remminafile->prevent_saving = FALSE;
 	return remminafile;
 }
 
+/**
+ * Return a RemminaFile holding only the filename and the name of a
+ * profile: enough for the secret plugin to address the keyring entries
+ * of the profile, without loading it.
+ */
+RemminaFile *
+remmina_file_new_for_keyring(const gchar *filename, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	RemminaFile *remminafile;
+
+	remminafile = remmina_file_new_empty();
+	remminafile->filename = g_strdup(filename);
+	g_hash_table_insert(remminafile->settings, g_strdup("name"), g_strdup(name ? name : ""));
+	return remminafile;
+}
+
 RemminaFile *
 remmina_file_new(void)
 {
@@ -102,6 +342,7 @@ remmina_file_new(void)
 	if (remminafile) {
 		g_free(remminafile->filename);
 		remminafile->filename = NULL;
+		remmina_file_mark_all_dirty(remminafile);
 	} else {
 		remminafile = remmina_file_new_empty();
 	}
@@ -176,6 +417,7 @@ void remmina_file_generate_filename(RemminaFile *remminafile)
 	else
 		remminafile->filename = NULL;
 	g_dir_close(dir);
+	remmina_file_mark_all_dirty(remminafile);
 
 }
 
@@ -184,6 +426,7 @@ void remmina_file_set_filename(RemminaFile *remminafile, const gchar *filename)
 	TRACE_CALL(__func__);
 	g_free(remminafile->filename);
 	remminafile->filename = g_strdup(filename);
+	remmina_file_mark_all_dirty(remminafile);
 }
 
 void remmina_file_set_statefile(RemminaFile *remminafile)
@@ -361,6 +604,7 @@ remmina_file_load(const gchar *filename)
 
 	gkeyfile = g_key_file_new();
 
+	remmina_file_flush(filename);
 	if (g_file_test(filename, G_FILE_TEST_IS_REGULAR | G_FILE_TEST_EXISTS)) {
 		if (!g_key_file_load_from_file(gkeyfile, filename, G_KEY_FILE_NONE, NULL)) {
 			g_key_file_free(gkeyfile);
@@ -459,6 +703,8 @@ remmina_file_load(const gchar *filename)
 		}
 	}
 
+	/* What we just read is what is on disk, only the upgraded keys are left to save */
+	g_hash_table_remove_all(remminafile->dirty_settings);
 	upgrade_sshkeys_202001(remminafile);
 	g_strfreev(keys);
 	remmina_file_set_statefile(remminafile);
@@ -469,6 +715,7 @@ remmina_file_load(const gchar *filename)
 void remmina_file_set_string(RemminaFile *remminafile, const gchar *setting, const gchar *value)
 {
 	TRACE_CALL(__func__);
+	const gchar *old;
 
 	/* Note: setting and value are copied on the heap, so it is responsibility of the caller
 	 * to deallocate them when returning from remmina_file_set_string() if needed */
@@ -496,20 +743,27 @@ void remmina_file_set_string(RemminaFile *remminafile, const gchar *setting, con
 			remmina_main_show_warning_dialog(message);
 			return;
 		}
-		g_hash_table_insert(remminafile->settings, g_strdup(setting), g_strdup(value));
 	} else {
-		g_hash_table_insert(remminafile->settings, g_strdup(setting), g_strdup(""));
+		value = "";
 	}
+
+	if (g_hash_table_lookup_extended(remminafile->settings, setting, NULL, (gpointer *)&old) && g_strcmp0(old, value) == 0)
+		return;
+	g_hash_table_insert(remminafile->settings, g_strdup(setting), g_strdup(value));
+	g_hash_table_add(remminafile->dirty_settings, g_strdup(setting));
 }
 
 void remmina_file_set_state(RemminaFile *remminafile, const gchar *setting, const gchar *value)
 {
 	TRACE_CALL(__func__);
+	const gchar *old;
 
-	if (value && value[0] != 0)
-		g_hash_table_insert(remminafile->states, g_strdup(setting), g_strdup(value));
-	else
-		g_hash_table_insert(remminafile->states, g_strdup(setting), g_strdup(""));
+	if (!value)
+		value = "";
+	if (g_hash_table_lookup_extended(remminafile->states, setting, NULL, (gpointer *)&old) && g_strcmp0(old, value) == 0)
+		return;
+	g_hash_table_insert(remminafile->states, g_strdup(setting), g_strdup(value));
+	g_hash_table_add(remminafile->dirty_states, g_strdup(setting));
 }
 
 const gchar *
@@ -662,36 +916,6 @@ gdouble remmina_file_get_state_double(RemminaFile *	remminafile,
 	return d;
 }
 
-static GKeyFile *
-remmina_file_get_keyfile(RemminaFile *remminafile)
-{
-	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
-
-	if (remminafile->filename == NULL)
-		return NULL;
-	gkeyfile = g_key_file_new();
-	if (!g_key_file_load_from_file(gkeyfile, remminafile->filename, G_KEY_FILE_NONE, NULL)) {
-		/* it will fail if it’s a new file, but shouldn’t matter. */
-	}
-	return gkeyfile;
-}
-
-static GKeyFile *
-remmina_file_get_keystate(RemminaFile *remminafile)
-{
-	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
-
-	if (remminafile->statefile == NULL)
-		return NULL;
-	gkeyfile = g_key_file_new();
-	if (!g_key_file_load_from_file(gkeyfile, remminafile->statefile, G_KEY_FILE_NONE, NULL)) {
-		/* it will fail if it’s a new file, but shouldn’t matter. */
-	}
-	return gkeyfile;
-}
-
 void remmina_file_free(RemminaFile *remminafile)
 {
 	TRACE_CALL(__func__);
@@ -708,6 +932,10 @@ void remmina_file_free(RemminaFile *remminafile)
 		g_hash_table_destroy(remminafile->spsettings);
 	if (remminafile->states)
 		g_hash_table_destroy(remminafile->states);
+	if (remminafile->dirty_settings)
+		g_hash_table_destroy(remminafile->dirty_settings);
+	if (remminafile->dirty_states)
+		g_hash_table_destroy(remminafile->dirty_states);
 
 	g_free(remminafile);
 }
@@ -721,21 +949,25 @@ void remmina_file_save(RemminaFile *remminafile)
 	RemminaProtocolPlugin *protocol_plugin;
 	GHashTableIter iter;
 	const gchar *key, *value;
-	gchar *s, *proto, *content;
+	gchar *s, *proto;
 	gint nopasswdsave;
 	GKeyFile *gkeyfile;
 	GKeyFile *gkeystate;
-	gsize length = 0;
-	GError *err = NULL;
 
 	if (remminafile->prevent_saving)
 		return;
 
-	if ((gkeyfile = remmina_file_get_keyfile(remminafile)) == NULL)
+	if (remminafile->filename == NULL)
 		return;
 
-	if ((gkeystate = remmina_file_get_keystate(remminafile)) == NULL)
+	/* A profile removed from disk behind our back has to be written in full */
+	if (!g_file_test(remminafile->filename, G_FILE_TEST_EXISTS) && !remmina_file_has_pending_write(remminafile->filename))
+		remmina_file_mark_all_dirty(remminafile);
+
+	if (g_hash_table_size(remminafile->dirty_settings) == 0 && g_hash_table_size(remminafile->dirty_states) == 0) {
+		REMMINA_DEBUG("Profile %s unchanged, not saving", remminafile->filename);
 		return;
+	}
 
 	REMMINA_DEBUG("Saving profile");
 	/* get disablepasswordstoring */
@@ -752,8 +984,20 @@ void remmina_file_save(RemminaFile *remminafile)
 	secret_plugin = remmina_plugin_manager_get_secret_plugin();
 	secret_service_available = secret_plugin && secret_plugin->is_service_available(secret_plugin);
 
-	g_hash_table_iter_init(&iter, remminafile->settings);
-	while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&value)) {
+	/* Toggling disablepasswordstoring moves every secret in or out of the keyring */
+	if (g_hash_table_contains(remminafile->dirty_settings, "disablepasswordstoring")) {
+		g_hash_table_iter_init(&iter, remminafile->settings);
+		while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL))
+			if (remmina_plugin_manager_is_encrypted_setting(protocol_plugin, key))
+				g_hash_table_add(remminafile->dirty_settings, g_strdup(key));
+	}
+
+	/* Only the changed keys are written, secrets left untouched are
+	 * not sent to the keyring again */
+	gkeyfile = g_key_file_new();
+	g_hash_table_iter_init(&iter, remminafile->dirty_settings);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL)) {
+		value = g_hash_table_lookup(remminafile->settings, key);
 		if (remmina_plugin_manager_is_encrypted_setting(protocol_plugin, key)) {
 			if (remminafile->filename && g_strcmp0(remminafile->filename, remmina_pref_file)) {
 				if (secret_service_available && nopasswdsave == 0) {
@@ -787,46 +1031,24 @@ void remmina_file_save(RemminaFile *remminafile)
 				}
 			}
 		} else {
-			g_key_file_set_string(gkeyfile, KEYFILE_GROUP_REMMINA, key, value);
+			g_key_file_set_string(gkeyfile, KEYFILE_GROUP_REMMINA, key, value ? value : "");
 		}
 	}
-
-	/* Avoid storing redundant and deprecated "resolution" field */
-	g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "resolution", NULL);
-
-	/* Delete old pre-1.4 ssh keys */
-	g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "ssh_enabled", NULL);
-	g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "save_ssh_server", NULL);
-	g_key_file_remove_key(gkeyfile, KEYFILE_GROUP_REMMINA, "save_ssh_username", NULL);
+	g_hash_table_remove_all(remminafile->dirty_settings);
 
 	/* Store gkeyfile to disk (password are already sent to keyring) */
-	content = g_key_file_to_data(gkeyfile, &length, NULL);
+	remmina_file_queue_write(remminafile->filename, gkeyfile, TRUE);
 
-	if (g_file_set_contents(remminafile->filename, content, length, &err))
-		REMMINA_DEBUG("Profile saved");
-	else
-		REMMINA_WARNING("Remmina connection profile cannot be saved, with error %d (%s)", err->code, err->message);
-	if (err != NULL)
-		g_error_free(err);
-
-	g_free(content), content = NULL;
 	/* Saving states */
-	g_hash_table_iter_init(&iter, remminafile->states);
-	while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&value))
-		g_key_file_set_string(gkeyfile, KEYFILE_GROUP_STATE, key, value);
-	content = g_key_file_to_data(gkeystate, &length, NULL);
-	if (g_file_set_contents(remminafile->statefile, content, length, &err))
-		REMMINA_DEBUG("Connection profile states saved");
-	else
-		REMMINA_WARNING("Remmina connection profile cannot be saved, with error %d (%s)", err->code, err->message);
-	if (err != NULL)
-		g_error_free(err);
-	g_free(content), content = NULL;
-	g_key_file_free(gkeyfile);
-	g_key_file_free(gkeystate);
-
-	if (!remmina_pref.list_refresh_workaround)
-		remmina_main_update_file_datetime(remminafile);
+	if (remminafile->statefile && g_hash_table_size(remminafile->dirty_states) > 0) {
+		gkeystate = g_key_file_new();
+		g_hash_table_iter_init(&iter, remminafile->dirty_states);
+		while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL))
+			g_key_file_set_string(gkeystate, KEYFILE_GROUP_STATE, key,
+					      (const gchar *)g_hash_table_lookup(remminafile->states, key));
+		remmina_file_queue_write(remminafile->statefile, gkeystate, FALSE);
+	}
+	g_hash_table_remove_all(remminafile->dirty_states);
 }
 
 void remmina_file_store_secret_plugin_password(RemminaFile *remminafile, const gchar *key, const gchar *value)
@@ -858,9 +1080,13 @@ remmina_file_dup(RemminaFile *remminafile)
 	dupfile = remmina_file_new_empty();
 	dupfile->filename = g_strdup(remminafile->filename);
 
+	/* Same file, so the copy only has to write what the original had to */
 	g_hash_table_iter_init(&iter, remminafile->settings);
 	while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&value))
-		remmina_file_set_string(dupfile, key, value);
+		g_hash_table_insert(dupfile->settings, g_strdup(key), g_strdup(value));
+	g_hash_table_iter_init(&iter, remminafile->dirty_settings);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL))
+		g_hash_table_add(dupfile->dirty_settings, g_strdup(key));
 
 	remmina_file_set_statefile(dupfile);
 	remmina_file_touch(dupfile);
@@ -902,6 +1128,7 @@ void remmina_file_delete(const gchar *filename)
 	remminafile = remmina_file_load(filename);
 	if (remminafile) {
 		remmina_file_unsave_passwords(remminafile);
+		remmina_file_flush(remminafile->filename);
 		remmina_file_free(remminafile);
 	}
 	g_unlink(filename);
@@ -914,6 +1141,7 @@ remmina_file_get_state(RemminaFile *remminafile, const gchar *setting)
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GKeyFile) key_file = g_key_file_new();
 
+	remmina_file_flush(remminafile->statefile);
 	if (!g_key_file_load_from_file(key_file, remminafile->statefile, G_KEY_FILE_NONE, &error)) {
 		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
 			REMMINA_CRITICAL("Could not load the state file. %s", error->message);
@@ -935,9 +1163,8 @@ void remmina_file_state_last_success(RemminaFile *remminafile)
 {
 	TRACE_CALL(__func__);
 
-	g_autoptr(GKeyFile) key_statefile = g_key_file_new();
+	GKeyFile *key_statefile;
 	g_autoptr(GKeyFile) key_remminafile = g_key_file_new();
-	GError *error = NULL;
 
 	g_autoptr(GDateTime) d = g_date_time_new_now_utc();
 
@@ -946,16 +1173,12 @@ void remmina_file_state_last_success(RemminaFile *remminafile)
 			       g_date_time_get_month(d),
 			       g_date_time_get_day_of_month(d));
 
+	/* Merged into the state file, the other states are kept */
+	key_statefile = g_key_file_new();
 	g_key_file_set_string(key_statefile, KEYFILE_GROUP_STATE, "last_success", date);
 
 	REMMINA_DEBUG("State file %s.", remminafile->statefile);
-	if (!g_key_file_save_to_file(key_statefile, remminafile->statefile, &error)) {
-		REMMINA_CRITICAL("Could not save the key file. %s", error->message);
-		g_error_free(error);
-		g_free(date);
-		error = NULL;
-		return;
-	}
+	remmina_file_queue_write(remminafile->statefile, key_statefile, FALSE);
 	/* Delete old pre-1.5 keys */
 	g_key_file_remove_key(key_remminafile, KEYFILE_GROUP_REMMINA, "last_success", NULL);
 	REMMINA_DEBUG("Last connection made on %s.", date);
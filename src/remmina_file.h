@@ -50,6 +50,8 @@ struct _RemminaFile {
 	GHashTable *	settings;
 	GHashTable *	states;
 	GHashTable *	spsettings;
+	GHashTable *	dirty_settings;
+	GHashTable *	dirty_states;
 	gboolean	prevent_saving;
 };
 
@@ -79,6 +81,7 @@ enum {
 
 /* Create a empty .remmina file */
 RemminaFile *remmina_file_new(void);
+RemminaFile *remmina_file_new_for_keyring(const gchar *filename, const gchar *name);
 RemminaFile *remmina_file_copy(const gchar *filename);
 void remmina_file_generate_filename(RemminaFile *remminafile);
 void remmina_file_set_filename(RemminaFile *remminafile, const gchar *filename);
@@ -103,6 +106,8 @@ const gchar *remmina_file_get_state(RemminaFile *remminafile, const gchar *setti
 gdouble remmina_file_get_state_double(RemminaFile *remminafile, const gchar *setting, gdouble default_value);
 /* Create or overwrite the .remmina file */
 void remmina_file_save(RemminaFile *remminafile);
+/* Write the pending profile changes now */
+void remmina_file_sync(void);
 /* Free the RemminaFile object */
 void remmina_file_free(RemminaFile *remminafile);
 /* Duplicate a RemminaFile object */
@@ -2070,6 +2070,7 @@ static void remmina_file_editor_on_save(GtkWidget *button, RemminaFileEditor *gf
 	remmina_file_editor_file_save(gfe);
 
 	remmina_file_save(gfe->priv->remmina_file);
+	remmina_file_sync();
 	remmina_icon_populate_menu();
 
 	gtk_widget_destroy(GTK_WIDGET(gfe));
@@ -2114,6 +2115,7 @@ static void remmina_file_editor_on_save_connect(GtkWidget *button, RemminaFileEd
 	remmina_file_editor_file_save(gfe);
 
 	remmina_file_save(gfe->priv->remmina_file);
+	remmina_file_sync();
 	remmina_icon_populate_menu();
 
 	gf = remmina_file_dup(gfe->priv->remmina_file);
@@ -39,7 +39,9 @@
 
 #include <errno.h>
 #include <gtk/gtk.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "remmina_log.h"
 #include "remmina_public.h"
@@ -357,6 +359,233 @@ void remmina_file_manager_free_group_tree(GNode *node)
 	g_node_unlink(node);
 }
 
+/* Metadata index of the connection profiles.
+ *
+ * Listing and filtering profiles only needs a few plain settings, while
+ * remmina_file_load() parses everything and asks the keyring for every
+ * secret. The index keeps the plain settings of every .remmina file of
+ * the data dir and only parses again the files whose inode, size or
+ * mtime changed since the previous scan (profiles are replaced
+ * atomically, so a rewrite always changes the inode). */
+
+typedef struct _RemminaFileMetaEntry {
+	RemminaFileMeta meta;
+	ino_t		ino;
+	goffset		size;
+	gint64		mtime;
+	gboolean	seen;
+} RemminaFileMetaEntry;
+
+static pthread_mutex_t meta_mutex = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *meta_index = NULL;   /* filename -> RemminaFileMetaEntry */
+static gchar *meta_index_dir = NULL;
+
+static void remmina_file_meta_clear(RemminaFileMeta *meta)
+{
+	g_free(meta->filename);
+	g_free(meta->name);
+	g_free(meta->group);
+	g_free(meta->protocol);
+	g_free(meta->server);
+	g_free(meta->username);
+	g_free(meta->domain);
+	g_free(meta->gateway_username);
+	g_free(meta->gateway_domain);
+	g_free(meta->labels);
+	g_free(meta->last_success);
+}
+
+static void remmina_file_meta_entry_free(gpointer data)
+{
+	RemminaFileMetaEntry *e = (RemminaFileMetaEntry *)data;
+
+	remmina_file_meta_clear(&e->meta);
+	g_free(e);
+}
+
+void remmina_file_meta_free(RemminaFileMeta *meta)
+{
+	if (!meta)
+		return;
+	remmina_file_meta_clear(meta);
+	g_free(meta);
+}
+
+static RemminaFileMeta *remmina_file_meta_dup(const RemminaFileMeta *meta)
+{
+	RemminaFileMeta *dup;
+
+	dup = g_new0(RemminaFileMeta, 1);
+	dup->filename = g_strdup(meta->filename);
+	dup->name = g_strdup(meta->name);
+	dup->group = g_strdup(meta->group);
+	dup->protocol = g_strdup(meta->protocol);
+	dup->server = g_strdup(meta->server);
+	dup->username = g_strdup(meta->username);
+	dup->domain = g_strdup(meta->domain);
+	dup->gateway_username = g_strdup(meta->gateway_username);
+	dup->gateway_domain = g_strdup(meta->gateway_domain);
+	dup->labels = g_strdup(meta->labels);
+	dup->last_success = g_strdup(meta->last_success);
+	dup->ssh_tunnel_enabled = meta->ssh_tunnel_enabled;
+	return dup;
+}
+
+/* Value of one of the indexed settings, "" when not set, NULL when the setting is not indexed */
+const gchar *remmina_file_meta_get_string(const RemminaFileMeta *meta, const gchar *setting)
+{
+	const gchar *value;
+
+	if (g_strcmp0(setting, "name") == 0)
+		value = meta->name;
+	else if (g_strcmp0(setting, "group") == 0)
+		value = meta->group;
+	else if (g_strcmp0(setting, "protocol") == 0)
+		value = meta->protocol;
+	else if (g_strcmp0(setting, "server") == 0)
+		value = meta->server;
+	else if (g_strcmp0(setting, "username") == 0)
+		value = meta->username;
+	else if (g_strcmp0(setting, "domain") == 0)
+		value = meta->domain;
+	else if (g_strcmp0(setting, "gateway_username") == 0)
+		value = meta->gateway_username;
+	else if (g_strcmp0(setting, "gateway_domain") == 0)
+		value = meta->gateway_domain;
+	else if (g_strcmp0(setting, "labels") == 0)
+		value = meta->labels;
+	else
+		return NULL;
+	return value ? value : "";
+}
+
+static gboolean remmina_file_meta_parse(const gchar *filename, RemminaFileMeta *meta)
+{
+	TRACE_CALL(__func__);
+	GKeyFile *gkeyfile;
+
+	gkeyfile = g_key_file_new();
+	if (!g_key_file_load_from_file(gkeyfile, filename, G_KEY_FILE_NONE, NULL) ||
+	    !g_key_file_has_key(gkeyfile, "remmina", "name", NULL)) {
+		g_key_file_free(gkeyfile);
+		return FALSE;
+	}
+
+	meta->filename = g_strdup(filename);
+	meta->name = g_key_file_get_string(gkeyfile, "remmina", "name", NULL);
+	meta->group = g_key_file_get_string(gkeyfile, "remmina", "group", NULL);
+	meta->protocol = g_key_file_get_string(gkeyfile, "remmina", "protocol", NULL);
+	meta->server = g_key_file_get_string(gkeyfile, "remmina", "server", NULL);
+	meta->username = g_key_file_get_string(gkeyfile, "remmina", "username", NULL);
+	meta->domain = g_key_file_get_string(gkeyfile, "remmina", "domain", NULL);
+	meta->gateway_username = g_key_file_get_string(gkeyfile, "remmina", "gateway_username", NULL);
+	meta->gateway_domain = g_key_file_get_string(gkeyfile, "remmina", "gateway_domain", NULL);
+	meta->labels = g_key_file_get_string(gkeyfile, "remmina", "labels", NULL);
+	meta->last_success = g_key_file_get_string(gkeyfile, "remmina", "last_success", NULL);
+	meta->ssh_tunnel_enabled = g_key_file_get_boolean(gkeyfile, "remmina", "ssh_tunnel_enabled", NULL);
+
+	g_key_file_free(gkeyfile);
+	if (meta->name == NULL) {
+		remmina_file_meta_clear(meta);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Bring the index up to date with the data dir, meta_mutex must be held */
+static void remmina_file_manager_meta_refresh(void)
+{
+	TRACE_CALL(__func__);
+	gchar filename[MAX_PATH_LEN];
+	GHashTableIter iter;
+	RemminaFileMetaEntry *e;
+	struct stat st;
+	const gchar *name;
+	gchar *remmina_data_dir;
+	GDir *dir;
+	gint64 mtime;
+
+	remmina_data_dir = remmina_file_get_datadir();
+	if (meta_index == NULL || g_strcmp0(remmina_data_dir, meta_index_dir) != 0) {
+		if (meta_index)
+			g_hash_table_destroy(meta_index);
+		meta_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, remmina_file_meta_entry_free);
+		g_free(meta_index_dir);
+		meta_index_dir = g_strdup(remmina_data_dir);
+	}
+
+	g_hash_table_iter_init(&iter, meta_index);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e))
+		e->seen = FALSE;
+
+	dir = g_dir_open(remmina_data_dir, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			if (!g_str_has_suffix(name, ".remmina"))
+				continue;
+			g_snprintf(filename, MAX_PATH_LEN, "%s/%s", remmina_data_dir, name);
+			if (stat(filename, &st) < 0)
+				continue;
+#ifdef __APPLE__
+			mtime = (gint64)st.st_mtimespec.tv_sec * G_USEC_PER_SEC + st.st_mtimespec.tv_nsec / 1000;
+#else
+			mtime = (gint64)st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+#endif
+			e = g_hash_table_lookup(meta_index, filename);
+			if (e && e->ino == st.st_ino && e->size == st.st_size && e->mtime == mtime) {
+				e->seen = TRUE;
+				continue;
+			}
+			if (e)
+				g_hash_table_remove(meta_index, filename);
+
+			e = g_new0(RemminaFileMetaEntry, 1);
+			if (!remmina_file_meta_parse(filename, &e->meta)) {
+				g_free(e);
+				continue;
+			}
+			e->ino = st.st_ino;
+			e->size = st.st_size;
+			e->mtime = mtime;
+			e->seen = TRUE;
+			g_hash_table_insert(meta_index, g_strdup(filename), e);
+		}
+		g_dir_close(dir);
+	}
+
+	/* Forget the profiles deleted since the previous scan */
+	g_hash_table_iter_init(&iter, meta_index);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e))
+		if (!e->seen)
+			g_hash_table_iter_remove(&iter);
+
+	g_free(remmina_data_dir);
+}
+
+/**
+ * Return the metadata of every connection profile. Only the profiles
+ * changed since the previous call are read from disk.
+ *
+ * Free the returned array with g_ptr_array_unref().
+ */
+GPtrArray *remmina_file_manager_get_meta(void)
+{
+	TRACE_CALL(__func__);
+	GHashTableIter iter;
+	RemminaFileMetaEntry *e;
+	GPtrArray *list;
+
+	pthread_mutex_lock(&meta_mutex);
+	remmina_file_manager_meta_refresh();
+	list = g_ptr_array_new_full(g_hash_table_size(meta_index), (GDestroyNotify)remmina_file_meta_free);
+	g_hash_table_iter_init(&iter, meta_index);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e))
+		g_ptr_array_add(list, remmina_file_meta_dup(&e->meta));
+	pthread_mutex_unlock(&meta_mutex);
+
+	return list;
+}
+
 RemminaFile *remmina_file_manager_load_file(const gchar *filename)
 {
 	TRACE_CALL(__func__);
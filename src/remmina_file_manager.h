@@ -46,6 +46,23 @@ typedef struct _RemminaGroupData {
 	gchar * labels;
 } RemminaGroupData;
 
+/* Plain settings of a profile, as kept by the metadata index */
+typedef struct _RemminaFileMeta {
+	gchar *		filename;
+	gchar *		name;
+	gchar *		group;
+	gchar *		protocol;
+	gchar *		server;
+	gchar *		username;
+	gchar *		domain;
+	gchar *		gateway_username;
+	gchar *		gateway_domain;
+	gchar *		labels;
+	/* Pre-1.5 profiles only, newer ones keep it in the state file */
+	gchar *		last_success;
+	gboolean	ssh_tunnel_enabled;
+} RemminaFileMeta;
+
 /* Initialize */
 gchar *remmina_file_get_datadir(void);
 void remmina_file_manager_init(void);
@@ -55,6 +72,10 @@ gint remmina_file_manager_iterate(GFunc func, gpointer user_data);
 gchar *remmina_file_manager_get_groups(void);
 GNode *remmina_file_manager_get_group_tree(void);
 void remmina_file_manager_free_group_tree(GNode *node);
+/* Metadata of all profiles, without loading them nor their secrets */
+GPtrArray *remmina_file_manager_get_meta(void);
+const gchar *remmina_file_meta_get_string(const RemminaFileMeta *meta, const gchar *setting);
+void remmina_file_meta_free(RemminaFileMeta *meta);
 /* Load or import a file */
 RemminaFile *remmina_file_manager_load_file(const gchar *filename);
 
@@ -139,6 +139,9 @@
 #include <string.h>
 #include <sys/utsname.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
@@ -191,11 +194,19 @@ struct ProfilesData {
 #define INFO_PERIODIC_CHECK_1ST_MS 1000
 #define INFO_PERIODIC_CHECK_INTERVAL_MS 86400000
 
+/* Minimum time between two statistics collections */
+#define INFO_STATS_MIN_INTERVAL_US (3600 * G_USEC_PER_SEC)
+
 #define PERIODIC_UPLOAD_URL "https://info.remmina.org/info/upload_stats"
 #define INFO_REQUEST_URL "https://info.remmina.org/info/handshake"
 
  
 static RemminaInfoDialog *remmina_info_dialog;
+
+/* Statistics collector state, shared between the main thread and the worker */
+static gint info_stats_running = 0;
+static gint info_stats_cancelled = 0;
+static gint64 info_stats_last_run = 0;
 #define GET_OBJ(object_name) gtk_builder_get_object(remmina_info_dialog->builder, object_name)
 
 typedef struct {
@@ -678,12 +689,13 @@ static JsonNode *remmina_info_stats_get_indicator(void)
 }
 
 /**
- * Given a remmina file, fills a structure containing profiles keys/value tuples.
+ * Given the metadata of a profile, fills a structure containing profiles keys/value tuples.
  *
- * This is used as a callback function with remmina_file_manager_iterate.
+ * The metadata comes from the profile index, so no profile is loaded and
+ * no secret is decrypted.
  * @todo Move this in a separate file.
  */
-static void remmina_info_profiles_get_data(RemminaFile *remminafile, gpointer user_data)
+static void remmina_info_profiles_get_data(const RemminaFileMeta *meta, gpointer user_data)
 {
 	TRACE_CALL(__func__);
 
@@ -699,8 +711,8 @@ static void remmina_info_profiles_get_data(RemminaFile *remminafile, gpointer us
 	struct ProfilesData* pdata;
 	pdata = (struct ProfilesData*)user_data;
 
-	pdata->protocol = remmina_file_get_string(remminafile, "protocol");
-	const gchar *last_success = remmina_file_get_string(remminafile, "last_success");
+	pdata->protocol = meta->protocol;
+	const gchar *last_success = meta->last_success;
 
 	prof_gdate = pdata_gdate = NULL;
 	if (last_success && last_success[0] != '\0' && strlen(last_success) >= 6) {
@@ -816,6 +828,8 @@ static JsonNode *remmina_info_stats_get_profiles(void)
 	gchar *s;
 
 	gint profiles_count;
+	guint i;
+	GPtrArray *profiles;
 	GHashTableIter pcountiter, pdateiter;
 	gpointer pcountkey, pcountvalue;
 	gpointer pdatekey, pdatevalue;
@@ -844,9 +858,14 @@ static JsonNode *remmina_info_stats_get_profiles(void)
 	pdata->proto_count = g_hash_table_new_full(g_str_hash, g_str_equal,
 		(GDestroyNotify)g_free, NULL);
 
-	profiles_count = remmina_file_manager_iterate(
-		(GFunc)remmina_info_profiles_get_data,
-		(gpointer)pdata);
+	profiles = remmina_file_manager_get_meta();
+	for (i = 0; i < profiles->len; i++) {
+		if (g_atomic_int_get(&info_stats_cancelled))
+			break;
+		remmina_info_profiles_get_data(g_ptr_array_index(profiles, i), pdata);
+	}
+	profiles_count = profiles->len;
+	g_ptr_array_unref(profiles);
 
 	json_builder_add_int_value(b, profiles_count);
 
@@ -1267,24 +1286,72 @@ static gboolean remmina_info_stats_collector_done(gpointer data)
 	return G_SOURCE_REMOVE;
 }
 
+static gpointer remmina_info_stats_worker(gpointer data)
+{
+	TRACE_CALL(__func__);
+	JsonNode *n;
+
+#ifdef __linux__
+	/* On Linux the nice value is per thread: only this worker is lowered */
+	if (setpriority(PRIO_PROCESS, 0, 19) < 0)
+		REMMINA_DEBUG("Unable to lower the priority of the statistics collector");
+#endif
+
+	n = remmina_info_stats_get_all();
+
+	/* Encryption and upload do not need the main thread either */
+	if (g_atomic_int_get(&info_stats_cancelled)) {
+		REMMINA_DEBUG("Statistics collection cancelled");
+		if (n)
+			json_node_unref(n);
+	} else {
+		remmina_info_stats_collector_done(n);
+	}
+
+	g_atomic_int_set(&info_stats_running, 0);
+	return NULL;
+}
+
 /**
- * Collect stats and notify when collection is done
- * 
+ * Start collecting stats on a low priority worker thread, which posts
+ * them when done. Requests made while a collection is running, or less
+ * than INFO_STATS_MIN_INTERVAL_US after the previous one, are dropped.
+ *
  * @return gpointer
  */
 gpointer remmina_info_stats_collector(void)
 {
-	JsonNode *n;
+	TRACE_CALL(__func__);
+	GThread *t;
+	gint64 now;
 
-	n = remmina_info_stats_get_all();
+	if (!g_atomic_int_compare_and_exchange(&info_stats_running, 0, 1))
+		return NULL;
+
+	now = g_get_monotonic_time();
+	if (info_stats_last_run > 0 && now - info_stats_last_run < INFO_STATS_MIN_INTERVAL_US) {
+		REMMINA_DEBUG("Statistics collected recently, skipping");
+		g_atomic_int_set(&info_stats_running, 0);
+		return NULL;
+	}
+	info_stats_last_run = now;
+	g_atomic_int_set(&info_stats_cancelled, 0);
 
-	/* Stats collecting is done. Notify main thread calling
-	 * remmina_info_stats_collector_done() */
-	g_idle_add(remmina_info_stats_collector_done, n);
+	t = g_thread_new("remmina_info_stats", remmina_info_stats_worker, NULL);
+	g_thread_unref(t);
 
 	return NULL;
 }
 
+/**
+ * Stop a running statistics collection, nothing is posted for it.
+ */
+void remmina_info_stats_cancel(void)
+{
+	TRACE_CALL(__func__);
+	g_atomic_int_set(&info_stats_cancelled, 1);
+}
+
 static void remmina_info_request(gpointer data)
 {
 	// send initial handshake here, in a callback decide how to handle response
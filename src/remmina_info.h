@@ -46,6 +46,7 @@ JsonNode *remmina_info_stats_get_python(void);
 JsonNode *remmina_info_stats_get_uid(void);
 gboolean  remmina_info_show_response(gpointer user_data);
 gpointer remmina_info_stats_collector(void);
+void remmina_info_stats_cancel(void);
 gboolean remmina_info_periodic_check(gpointer user_data);
 void remmina_info_schedule(void);
 
@@ -0,0 +1,336 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include "rcw.h"
+#include "remmina_file.h"
+#include "remmina_file_manager.h"
+#include "remmina_launch_queue.h"
+#include "remmina_log.h"
+#include "remmina_pref.h"
+#include "remmina_unlock.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* A connection still handshaking after this many seconds, usually because
+ * it is waiting for credentials, does not hold its slot any longer */
+#define REMMINA_LAUNCH_QUEUE_SLOT_TIMEOUT 20
+
+typedef enum {
+	REMMINA_LAUNCH_QUEUED,
+	REMMINA_LAUNCH_CONNECTING,
+	REMMINA_LAUNCH_CONNECTED,
+	REMMINA_LAUNCH_FAILED,
+	REMMINA_LAUNCH_SKIPPED,
+	REMMINA_LAUNCH_STALLED
+} RemminaLaunchState;
+
+typedef struct _RemminaLaunchItem {
+	RemminaLaunchQueue *	queue;
+	gchar *			filename;
+	gchar *			name;
+	RemminaFile *		remminafile;
+	RemminaLaunchState	state;
+	GtkWidget *		proto;
+	gulong			connect_handler;
+	gulong			disconnect_handler;
+	gulong			destroy_handler;
+	guint			timeout_source;
+	/* Monotonic times, in microseconds */
+	gint64			started;
+	gint64			finished;
+} RemminaLaunchItem;
+
+struct _RemminaLaunchQueue {
+	GPtrArray *	items;
+	GHashTable *	filenames;
+	guint		next;
+	guint		active;
+	guint		pending;
+	gint64		started;
+};
+
+static void remmina_launch_queue_schedule(RemminaLaunchQueue *queue);
+
+static void remmina_launch_item_free(RemminaLaunchItem *item)
+{
+	TRACE_CALL(__func__);
+	if (item->remminafile)
+		remmina_file_free(item->remminafile);
+	g_free(item->filename);
+	g_free(item->name);
+	g_free(item);
+}
+
+RemminaLaunchQueue *remmina_launch_queue_new(void)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchQueue *queue;
+
+	queue = g_new0(RemminaLaunchQueue, 1);
+	queue->items = g_ptr_array_new_with_free_func((GDestroyNotify)remmina_launch_item_free);
+	queue->filenames = g_hash_table_new(g_str_hash, g_str_equal);
+
+	return queue;
+}
+
+void remmina_launch_queue_free(RemminaLaunchQueue *queue)
+{
+	TRACE_CALL(__func__);
+	g_ptr_array_free(queue->items, TRUE);
+	g_hash_table_destroy(queue->filenames);
+	g_free(queue);
+}
+
+void remmina_launch_queue_add(RemminaLaunchQueue *queue, const gchar *filename)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchItem *item;
+
+	if (filename == NULL || g_hash_table_contains(queue->filenames, filename))
+		return;
+
+	item = g_new0(RemminaLaunchItem, 1);
+	item->queue = queue;
+	item->filename = g_strdup(filename);
+	item->state = REMMINA_LAUNCH_QUEUED;
+	g_ptr_array_add(queue->items, item);
+	g_hash_table_add(queue->filenames, item->filename);
+}
+
+typedef struct {
+	RemminaLaunchQueue *	queue;
+	const gchar *		group;
+} RemminaLaunchGroupData;
+
+static void remmina_launch_queue_add_group_cb(RemminaFile *remminafile, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchGroupData *gd = (RemminaLaunchGroupData *)user_data;
+
+	if (g_strcmp0(gd->group, remmina_file_get_string(remminafile, "group")) == 0)
+		remmina_launch_queue_add(gd->queue, remminafile->filename);
+}
+
+void remmina_launch_queue_add_group(RemminaLaunchQueue *queue, const gchar *group)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchGroupData gd = { queue, group };
+
+	remmina_file_manager_iterate((GFunc)remmina_launch_queue_add_group_cb, &gd);
+}
+
+static const gchar *remmina_launch_state_to_string(RemminaLaunchState state)
+{
+	switch (state) {
+	case REMMINA_LAUNCH_QUEUED: return "queued";
+	case REMMINA_LAUNCH_CONNECTING: return "connecting";
+	case REMMINA_LAUNCH_CONNECTED: return "connected";
+	case REMMINA_LAUNCH_FAILED: return "failed";
+	case REMMINA_LAUNCH_SKIPPED: return "skipped";
+	case REMMINA_LAUNCH_STALLED: return "still connecting";
+	}
+	return "unknown";
+}
+
+static void remmina_launch_queue_done(RemminaLaunchQueue *queue)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchItem *item;
+	guint i;
+
+	REMMINA_INFO("Launched %u connections in %.3fs, at most %d at a time",
+		     queue->items->len,
+		     (g_get_monotonic_time() - queue->started) / 1000000.0,
+		     remmina_pref.launch_concurrency);
+	for (i = 0; i < queue->items->len; i++) {
+		item = (RemminaLaunchItem *)g_ptr_array_index(queue->items, i);
+		if (item->started == 0) {
+			REMMINA_INFO("  “%s”: %s", item->name ? item->name : item->filename,
+				     remmina_launch_state_to_string(item->state));
+			continue;
+		}
+		REMMINA_INFO("  “%s”: %s, waited %.3fs for a slot, handshake %.3fs",
+			     item->name ? item->name : item->filename,
+			     remmina_launch_state_to_string(item->state),
+			     (item->started - queue->started) / 1000000.0,
+			     (item->finished - item->started) / 1000000.0);
+	}
+
+	remmina_launch_queue_free(queue);
+}
+
+/* The connection is either up, gone or slow: stop following it and give
+ * its slot to the next queued connection */
+static void remmina_launch_item_finish(RemminaLaunchItem *item, RemminaLaunchState state)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchQueue *queue = item->queue;
+
+	if (item->state != REMMINA_LAUNCH_CONNECTING)
+		return;
+
+	item->state = state;
+	item->finished = g_get_monotonic_time();
+	if (item->timeout_source) {
+		g_source_remove(item->timeout_source);
+		item->timeout_source = 0;
+	}
+	g_signal_handler_disconnect(item->proto, item->connect_handler);
+	g_signal_handler_disconnect(item->proto, item->disconnect_handler);
+	g_signal_handler_disconnect(item->proto, item->destroy_handler);
+	item->proto = NULL;
+
+	REMMINA_DEBUG("“%s” is %s after %.3fs", item->name, remmina_launch_state_to_string(state),
+		      (item->finished - item->started) / 1000000.0);
+
+	queue->active--;
+	queue->pending--;
+	remmina_launch_queue_schedule(queue);
+}
+
+static void remmina_launch_item_on_connect(GtkWidget *proto, RemminaLaunchItem *item)
+{
+	TRACE_CALL(__func__);
+	remmina_launch_item_finish(item, REMMINA_LAUNCH_CONNECTED);
+}
+
+static void remmina_launch_item_on_disconnect(GtkWidget *proto, RemminaLaunchItem *item)
+{
+	TRACE_CALL(__func__);
+	remmina_launch_item_finish(item, REMMINA_LAUNCH_FAILED);
+}
+
+static gboolean remmina_launch_item_on_timeout(gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchItem *item = (RemminaLaunchItem *)user_data;
+
+	item->timeout_source = 0;
+	remmina_launch_item_finish(item, REMMINA_LAUNCH_STALLED);
+	return G_SOURCE_REMOVE;
+}
+
+static void remmina_launch_item_start(RemminaLaunchItem *item)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchQueue *queue = item->queue;
+	RemminaFile *remminafile = item->remminafile;
+	GtkWidget *proto;
+
+	item->started = g_get_monotonic_time();
+	item->remminafile = NULL;
+
+	/* The connection window owns the file from now on */
+	remmina_file_touch(remminafile);
+	proto = rcw_open_from_file_full(remminafile, NULL, NULL, NULL);
+	if (proto == NULL) {
+		item->state = REMMINA_LAUNCH_FAILED;
+		item->finished = g_get_monotonic_time();
+		queue->pending--;
+		return;
+	}
+
+	item->state = REMMINA_LAUNCH_CONNECTING;
+	item->proto = proto;
+	item->connect_handler = g_signal_connect(G_OBJECT(proto), "connect",
+						 G_CALLBACK(remmina_launch_item_on_connect), item);
+	item->disconnect_handler = g_signal_connect(G_OBJECT(proto), "disconnect",
+						    G_CALLBACK(remmina_launch_item_on_disconnect), item);
+	item->destroy_handler = g_signal_connect(G_OBJECT(proto), "destroy",
+						 G_CALLBACK(remmina_launch_item_on_disconnect), item);
+	item->timeout_source = g_timeout_add_seconds(REMMINA_LAUNCH_QUEUE_SLOT_TIMEOUT,
+						     remmina_launch_item_on_timeout, item);
+	queue->active++;
+}
+
+static void remmina_launch_queue_schedule(RemminaLaunchQueue *queue)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchItem *item;
+	guint max_active;
+
+	max_active = remmina_pref.launch_concurrency > 0 ? (guint)remmina_pref.launch_concurrency : G_MAXUINT;
+
+	while (queue->active < max_active && queue->next < queue->items->len) {
+		item = (RemminaLaunchItem *)g_ptr_array_index(queue->items, queue->next++);
+		if (item->state == REMMINA_LAUNCH_QUEUED)
+			remmina_launch_item_start(item);
+	}
+
+	if (queue->pending == 0)
+		remmina_launch_queue_done(queue);
+}
+
+void remmina_launch_queue_run(RemminaLaunchQueue *queue, GtkWindow *parent)
+{
+	TRACE_CALL(__func__);
+	RemminaLaunchItem *item;
+	gboolean lock_edit;
+	gint unlocked = -1;
+	guint i;
+
+	/* Same condition as the multiple selection "Connect" always used */
+	lock_edit = remmina_pref_get_boolean("use_primary_password") &&
+		    remmina_pref_get_boolean("lock_edit");
+
+	/* Load everything first, so that the unlock prompt is asked once for
+	 * the whole batch instead of once per locked profile */
+	for (i = 0; i < queue->items->len; i++) {
+		item = (RemminaLaunchItem *)g_ptr_array_index(queue->items, i);
+		item->remminafile = remmina_file_manager_load_file(item->filename);
+		if (item->remminafile == NULL) {
+			REMMINA_WARNING("Could not load “%s”", item->filename);
+			item->state = REMMINA_LAUNCH_FAILED;
+			continue;
+		}
+		item->name = g_strdup(remmina_file_get_string(item->remminafile, "name"));
+
+		if (lock_edit || remmina_file_get_int(item->remminafile, "profile-lock", FALSE)) {
+			if (unlocked < 0)
+				unlocked = remmina_unlock_new(parent);
+			if (unlocked == 0) {
+				item->state = REMMINA_LAUNCH_SKIPPED;
+				remmina_file_free(item->remminafile);
+				item->remminafile = NULL;
+				continue;
+			}
+		}
+		queue->pending++;
+	}
+
+	queue->started = g_get_monotonic_time();
+	remmina_launch_queue_schedule(queue);
+}
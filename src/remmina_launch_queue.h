@@ -0,0 +1,58 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RemminaLaunchQueue RemminaLaunchQueue;
+
+/* A launch queue opens many connection profiles at once. Primary password
+ * and profile lock prompts are asked once for the whole batch, then at most
+ * remmina_pref.launch_concurrency connections are handshaking at the same
+ * time. The time spent by each connection waiting for a slot and connecting
+ * is logged when the queue is done. */
+RemminaLaunchQueue *remmina_launch_queue_new(void);
+/* Queue a profile, duplicates are ignored */
+void remmina_launch_queue_add(RemminaLaunchQueue *queue, const gchar *filename);
+/* Queue all the profiles of a group */
+void remmina_launch_queue_add_group(RemminaLaunchQueue *queue, const gchar *group);
+/* Start the queue, which frees itself once all its connections are done */
+void remmina_launch_queue_run(RemminaLaunchQueue *queue, GtkWindow *parent);
+/* Free a queue which has not been run */
+void remmina_launch_queue_free(RemminaLaunchQueue *queue);
+
+G_END_DECLS
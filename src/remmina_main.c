@@ -61,6 +61,7 @@
 #include "remmina_bug_report.h"
 #include "remmina_log.h"
 #include "remmina_icon.h"
+#include "remmina_launch_queue.h"
 #include "remmina_main.h"
 #include "remmina_exec.h"
 #include "remmina_mpchange.h"
@@ -72,20 +73,6 @@ static RemminaMain *remminamain;
 
 #define RM_GET_OBJECT(object_name) gtk_builder_get_object(remminamain->builder, object_name)
 
-enum {
-	PROTOCOL_COLUMN,
-	NAME_COLUMN,
-	GROUP_COLUMN,
-	SERVER_COLUMN,
-	PLUGIN_COLUMN,
-	DATE_COLUMN,
-	FILENAME_COLUMN,
-	LABELS_COLUMN,
-	NOTES_COLUMN,
-	STATUS_COLUMN,
-	N_COLUMNS
-};
-
 static
 const gchar *supported_mime_types[] = {
 	"x-scheme-handler/rdp",
@@ -211,6 +198,11 @@ void remmina_main_destroy(void)
 		g_object_unref(G_OBJECT(remminamain->priv->file_model_filter));
 		g_free(remminamain->priv->selected_filename);
 		g_free(remminamain->priv->selected_name);
+		if (remminamain->priv->network_update_source)
+			g_source_remove(remminamain->priv->network_update_source);
+		g_hash_table_destroy(remminamain->priv->network_updates);
+		remmina_network_monitor_free(remminamain->monitor);
+		g_hash_table_destroy(remminamain->network_states);
 		g_free(remminamain->priv);
 		g_free(remminamain);
 		remminamain = NULL;
@@ -357,29 +349,89 @@ static gboolean remmina_main_selection_func(GtkTreeSelection *selection, GtkTree
 	return TRUE;
 }
 
+static const gchar *remmina_main_status_icon_name(const gchar *result)
+{
+	if (result != NULL) {
+		if (strncmp("Yes", result, strlen("Yes")) == 0)
+			return "org.remmina.Remmina-status-green";
+		else if (strncmp("No", result, strlen("No")) == 0)
+			return "org.remmina.Remmina-status-red";
+	}
+	return "org.remmina.Remmina-status-grey";
+}
+
+/* Status reported by a plugin wins, otherwise ask the monitor, which queues a probe when needed */
+static const gchar *remmina_main_get_status_icon(RemminaFile *remminafile)
+{
+	const gchar *result;
+
+	if (!remmina_pref_get_boolean("status_check"))
+		return "";
+
+	result = (const gchar *)g_hash_table_lookup(remminamain->network_states, remminafile->filename);
+	if (result == NULL)
+		result = remmina_monitor_can_reach(remminafile, remminamain->monitor);
+	return remmina_main_status_icon_name(result);
+}
+
+static gboolean remmina_main_network_update_row(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
+{
+	GHashTable *updates = (GHashTable *)data;
+	gchar *filename = NULL;
+	const gchar *result;
+
+	gtk_tree_model_get(model, iter, FILENAME_COLUMN, &filename, -1);
+	if (!filename)
+		return FALSE;
+
+	result = (const gchar *)g_hash_table_lookup(updates, filename);
+	if (result) {
+		if (GTK_IS_TREE_STORE(model))
+			gtk_tree_store_set(GTK_TREE_STORE(model), iter, STATUS_COLUMN, remmina_main_status_icon_name(result), -1);
+		else
+			gtk_list_store_set(GTK_LIST_STORE(model), iter, STATUS_COLUMN, remmina_main_status_icon_name(result), -1);
+	}
+	g_free(filename);
+	return FALSE;
+}
+
+/* Apply all the pending status changes with one walk of the model instead of reloading the list */
+static gboolean remmina_main_network_update_cb(gpointer user_data)
+{
+	TRACE_CALL(__func__);
+
+	remminamain->priv->network_update_source = 0;
+	if (remminamain->priv->file_model && remmina_pref_get_boolean("status_check"))
+		gtk_tree_model_foreach(remminamain->priv->file_model, remmina_main_network_update_row,
+				       remminamain->priv->network_updates);
+	g_hash_table_remove_all(remminamain->priv->network_updates);
+	return G_SOURCE_REMOVE;
+}
+
+static void remmina_main_queue_network_status(const gchar *filename, const gchar *result)
+{
+	g_hash_table_replace(remminamain->priv->network_updates, g_strdup(filename), g_strdup(result));
+	if (!remminamain->priv->network_update_source)
+		remminamain->priv->network_update_source = g_timeout_add(250, remmina_main_network_update_cb, NULL);
+}
+
+static void remmina_main_monitor_update(const gchar *filename, gboolean reachable, gpointer user_data)
+{
+	if (!remminamain || g_hash_table_contains(remminamain->network_states, filename))
+		return;
+	remmina_main_queue_network_status(filename, reachable ? "Yes" : "No");
+}
+
 static void remmina_main_load_file_list_callback(RemminaFile *remminafile, gpointer user_data)
 {
 	TRACE_CALL(__func__);
 	GtkTreeIter iter;
 	GtkListStore *store;
-	gchar* status_icon = "";
+	const gchar *status_icon;
 	store = GTK_LIST_STORE(user_data);
 	gchar *datetime;
-	if (remmina_pref_get_boolean("status_check")){
-		status_icon = "org.remmina.Remmina-status-grey";
-		if (g_hash_table_contains(remminamain->network_states, remminafile->filename)){
-			gchar* result = (gchar*)g_hash_table_lookup(remminamain->network_states, remminafile->filename);
-			if (result != NULL){
-				if (strncmp("Yes", result, strlen("Yes")) == 0){
-					status_icon = "org.remmina.Remmina-status-green";
-				}
-				else if (strncmp("No", result, strlen("No")) == 0){
-					status_icon = "org.remmina.Remmina-status-red";
-				}
-			}
-		}
-	}
-	
+	status_icon = remmina_main_get_status_icon(remminafile);
+
 	datetime = remmina_file_get_datetime(remminafile);
 	gtk_list_store_append(store, &iter);
 	gtk_list_store_set(store, &iter,
@@ -507,21 +559,8 @@ static void remmina_main_load_file_tree_callback(RemminaFile *remminafile, gpoin
 	GtkTreeStore *store;
 	gboolean found;
 	gchar *datetime = NULL;
-	gchar* status_icon = "";
-	if (remmina_pref_get_boolean("status_check")){
-		status_icon = "org.remmina.Remmina-status-grey";
-		if (g_hash_table_contains(remminamain->network_states, remminafile->filename)){
-			gchar* result = (gchar*)g_hash_table_lookup(remminamain->network_states, remminafile->filename);
-			if (result != NULL){
-				if (strncmp("Yes", result, strlen("Yes")) == 0){
-					status_icon = "org.remmina.Remmina-status-green";
-				}
-				else if (strncmp("No", result, strlen("No")) == 0){
-					status_icon = "org.remmina.Remmina-status-red";
-				}
-			}
-		}
-	}
+	const gchar *status_icon;
+	status_icon = remmina_main_get_status_icon(remminafile);
 
 	store = GTK_TREE_STORE(user_data);
 
@@ -559,14 +598,12 @@ static void remmina_main_file_model_on_sort(GtkTreeSortable *sortable, gpointer
 	remmina_pref_save();
 }
 
-static gboolean remmina_main_filter_visible_func(GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+gboolean remmina_main_filter_row(GtkTreeModel *model, GtkTreeIter *iter, const gchar *text)
 {
 	TRACE_CALL(__func__);
-	gchar *text;
 	gchar *protocol, *name, *labels, *group, *server, *plugin, *date, *s;
 	gboolean result = TRUE;
 
-	text = g_ascii_strdown(gtk_entry_get_text(remminamain->entry_quick_connect_server), -1);
 	if (text && text[0]) {
 		gtk_tree_model_get(model, iter,
 				   PROTOCOL_COLUMN, &protocol,
@@ -646,6 +683,17 @@ static gboolean remmina_main_filter_visible_func(GtkTreeModel *model, GtkTreeIte
 		g_free(plugin);
 		g_free(date);
 	}
+	return result;
+}
+
+static gboolean remmina_main_filter_visible_func(GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	gchar *text;
+	gboolean result;
+
+	text = g_ascii_strdown(gtk_entry_get_text(remminamain->entry_quick_connect_server), -1);
+	result = remmina_main_filter_row(model, iter, text);
 	g_free(text);
 	return result;
 }
@@ -1075,72 +1123,48 @@ void remmina_main_on_action_connection_connect_multiple(GSimpleAction *action, G
 	GtkTreeSelection *sel = gtk_tree_view_get_selection(remminamain->tree_files_list);
 	GtkTreeModel *model = gtk_tree_view_get_model(remminamain->tree_files_list);
 	GList *list = gtk_tree_selection_get_selected_rows(sel, &model);
+	GList *l;
+	RemminaLaunchQueue *queue;
 	gchar *file_to_load = NULL;
 
-
-	while (list) {
-		GtkTreePath *path = list->data;
+	/* Collect the selection first, the launch queue then opens the
+	 * connections in parallel and asks the unlock prompt only once */
+	queue = remmina_launch_queue_new();
+	for (l = list; l; l = g_list_next(l)) {
+		GtkTreePath *path = l->data;
 		GtkTreeIter iter;
-		
+
 		if (!gtk_tree_model_get_iter(model, &iter, path)) {
 			GtkWidget *dialog_warning;
-			dialog_warning = gtk_message_dialog_new(remminamain->window, GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_OK, 
+			dialog_warning = gtk_message_dialog_new(remminamain->window, GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_OK,
 				_("Failed to load files!"));
 			gtk_dialog_run(GTK_DIALOG(dialog_warning));
 			gtk_widget_destroy(dialog_warning);
+			g_list_free_full(list, (GDestroyNotify)gtk_tree_path_free);
+			remmina_launch_queue_free(queue);
 			remmina_main_clear_selection_data();
 			return;
 		}
 
-		gtk_tree_model_get(model, &iter, 
+		gtk_tree_model_get(model, &iter,
 				FILENAME_COLUMN, &file_to_load, -1);
 
-		if (file_to_load == NULL){
-			gtk_tree_model_get(model, &iter, 
+		if (file_to_load == NULL) {
+			gtk_tree_model_get(model, &iter,
 				GROUP_COLUMN, &file_to_load, -1);
 
 			REMMINA_DEBUG("Group column is %s", file_to_load);
-			if (remminamain->priv->selected_name){
-				remmina_file_manager_iterate((GFunc)remmina_main_load_by_group_callback, NULL);
-			}
-		}
-
-		RemminaFile *remminafile = remmina_file_load(file_to_load);
-
-		if (remminafile == NULL){
-			list = g_list_next(list);
-			continue;
+			remmina_launch_queue_add_group(queue, file_to_load);
+		} else {
+			remmina_launch_queue_add(queue, file_to_load);
 		}
+		g_free(file_to_load);
+		file_to_load = NULL;
+	}
+	g_list_free_full(list, (GDestroyNotify)gtk_tree_path_free);
 
-		if (((remmina_pref_get_boolean("lock_edit")
-				&& remmina_pref_get_boolean("use_primary_password"))
-				|| remmina_file_get_int (remminafile, "profile-lock", FALSE))
-			&& remmina_unlock_new(remminamain->window) == 0){
-				list = g_list_next(list);
-				continue;
-			}
-
-
-		if (remmina_file_get_int (remminafile, "profile-lock", FALSE) == 1
-			&& remmina_unlock_new(remminamain->window) == 0){
-				list = g_list_next(list);
-				continue;
-			}
-				
-
-		remmina_file_touch(remminafile);
-		rcw_open_from_filename(file_to_load);
-
-		
-
-		if (remminafile) {
-			remmina_file_free(remminafile);
-			remminafile = NULL;
-		}
+	remmina_launch_queue_run(queue, remminamain->window);
 
-		list = g_list_next(list);
-	}
-	
 	remmina_main_clear_selection_data();
 }
 
@@ -1355,8 +1379,10 @@ static void remmina_main_import_file_list(GSList *files)
 		gtk_widget_show(dlg);
 	}
 	g_string_free(err, TRUE);
-	if (imported)
+	if (imported) {
+		remmina_file_sync();
 		remmina_main_load_files();
+	}
 }
 
 static void remmina_main_action_tools_import_on_response(GtkNativeDialog *dialog, gint response_id, gpointer user_data)
@@ -1797,6 +1823,7 @@ static void remmina_main_init(void)
 
 	REMMINA_DEBUG ("Initializing monitor");
 	remminamain->monitor = remmina_network_monitor_new();
+	remmina_network_monitor_set_update_func(remminamain->monitor, remmina_main_monitor_update, NULL);
 
 	remminamain->priv->expanded_group = remmina_string_array_new_from_string(remmina_pref.expanded_group);
 	if (!kioskmode && kioskmode == FALSE)
@@ -1865,9 +1892,11 @@ void remmina_main_add_network_status(gchar* key, gchar* value)
 {
 	if (remminamain != NULL){
 		g_hash_table_insert(remminamain->network_states, key, value);
-		remmina_main_load_files();
+		remmina_main_queue_network_status(key, value);
+	} else {
+		g_free(key);
+		g_free(value);
 	}
-	
 }
 
 /* RemminaMain instance */
@@ -1880,6 +1909,7 @@ GtkWidget *remmina_main_new(void)
 	remminamain = g_new0(RemminaMain, 1);
 	remminamain->priv = g_new0(RemminaMainPriv, 1);
 	remminamain->network_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	remminamain->priv->network_updates = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 	/* Assign UI widgets to the private members */
 	remminamain->builder = remmina_public_gtk_builder_new_from_resource("/org/remmina/Remmina/src/../data/ui/remmina_main.glade");
 	remminamain->window = GTK_WINDOW(RM_GET_OBJECT("RemminaMain"));
@@ -46,6 +46,21 @@
 
 typedef struct _RemminaMainPriv RemminaMainPriv;
 
+/* Columns of the connection list and tree models */
+enum {
+	PROTOCOL_COLUMN,
+	NAME_COLUMN,
+	GROUP_COLUMN,
+	SERVER_COLUMN,
+	PLUGIN_COLUMN,
+	DATE_COLUMN,
+	FILENAME_COLUMN,
+	LABELS_COLUMN,
+	NOTES_COLUMN,
+	STATUS_COLUMN,
+	N_COLUMNS
+};
+
 typedef struct _RemminaMain {
 	GtkBuilder *		builder;
 	GtkWindow *		window;
@@ -99,6 +114,9 @@ struct _RemminaMainPriv {
 	gchar *			selected_name;
 	gboolean		override_view_file_mode_to_list;
 	RemminaStringArray *	expanded_group;
+	/* filename -> "Yes"/"No", applied to the status column in batches */
+	GHashTable *		network_updates;
+	guint			network_update_source;
 };
 
 G_BEGIN_DECLS
@@ -110,6 +128,8 @@ GtkWindow *remmina_main_get_window(void);
 
 void remmina_main_update_file_datetime(RemminaFile *file);
 void remmina_main_add_network_status(gchar* key, gchar* value);
+/* Whether a row of the connection model matches the lowercase search text */
+gboolean remmina_main_filter_row(GtkTreeModel *model, GtkTreeIter *iter, const gchar *text);
 
 void remmina_main_destroy(void);
 void remmina_main_on_destroy_event(void);
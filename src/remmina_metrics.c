@@ -0,0 +1,534 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <string.h>
+#ifdef HAVE_TCP_INFO_BYTES_RECEIVED
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#endif
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include "json-glib/json-glib.h"
+#include "remmina_log.h"
+#include "remmina_metrics.h"
+#include "remmina/remmina_trace_calls.h"
+
+#if !JSON_CHECK_VERSION(1, 2, 0)
+	#define json_node_unref(x) json_node_free(x)
+#endif
+
+/* Rates are computed over windows of this many microseconds */
+#define REMMINA_METRICS_RATE_WINDOW 1000000
+
+typedef struct _RemminaMetricsPhase {
+	gchar * name;
+	gint64	begin;
+	gint64	end;    /* 0 while the phase is running */
+} RemminaMetricsPhase;
+
+struct _RemminaMetrics {
+	gint			refcount;
+	pthread_mutex_t		mutex;
+
+	gint64			origin;
+	GArray *		phases;
+	gint64			first_frame;
+
+	gint64			totals[REMMINA_METRICS_LAST];
+	/* Not every protocol can count its bytes, those counters are hidden until fed */
+	gboolean		reported[REMMINA_METRICS_LAST];
+	/* Socket totals at the last remmina_metrics_sample_socket() */
+	guint64			socket_in;
+	guint64			socket_out;
+	/* totals[REMMINA_METRICS_INPUT_LATENCY] is the number of samples */
+	gint64			latency_sum;
+	gint64			latency_max;
+	/* Rate windows */
+	gint64			window_start;
+	gint64			window_totals[REMMINA_METRICS_LAST];
+	gdouble			rates[REMMINA_METRICS_LAST];
+};
+
+static const gchar *remmina_metrics_counter_names[REMMINA_METRICS_LAST] = {
+	"frames",
+	"bytes_in",
+	"bytes_out",
+	"input_latency_samples",
+	"input_packets_saved",
+	"input_bytes_saved"
+};
+
+static void remmina_metrics_phase_clear(RemminaMetricsPhase *phase)
+{
+	g_free(phase->name);
+}
+
+RemminaMetrics *remmina_metrics_new(void)
+{
+	TRACE_CALL(__func__);
+	RemminaMetrics *metrics;
+
+	metrics = g_new0(RemminaMetrics, 1);
+	metrics->refcount = 1;
+	pthread_mutex_init(&metrics->mutex, NULL);
+	metrics->phases = g_array_new(FALSE, TRUE, sizeof(RemminaMetricsPhase));
+	g_array_set_clear_func(metrics->phases, (GDestroyNotify)remmina_metrics_phase_clear);
+	metrics->origin = g_get_monotonic_time();
+	metrics->window_start = metrics->origin;
+
+	return metrics;
+}
+
+RemminaMetrics *remmina_metrics_ref(RemminaMetrics *metrics)
+{
+	TRACE_CALL(__func__);
+	g_atomic_int_inc(&metrics->refcount);
+	return metrics;
+}
+
+void remmina_metrics_unref(RemminaMetrics *metrics)
+{
+	TRACE_CALL(__func__);
+	if (!g_atomic_int_dec_and_test(&metrics->refcount))
+		return;
+	g_array_free(metrics->phases, TRUE);
+	pthread_mutex_destroy(&metrics->mutex);
+	g_free(metrics);
+}
+
+void remmina_metrics_reset(RemminaMetrics *metrics)
+{
+	TRACE_CALL(__func__);
+	gint i;
+
+	pthread_mutex_lock(&metrics->mutex);
+	g_array_set_size(metrics->phases, 0);
+	metrics->origin = g_get_monotonic_time();
+	metrics->first_frame = 0;
+	for (i = 0; i < REMMINA_METRICS_LAST; i++) {
+		metrics->totals[i] = 0;
+		metrics->reported[i] = FALSE;
+		metrics->window_totals[i] = 0;
+		metrics->rates[i] = 0.0;
+	}
+	metrics->socket_in = 0;
+	metrics->socket_out = 0;
+	metrics->latency_sum = 0;
+	metrics->latency_max = 0;
+	metrics->window_start = metrics->origin;
+	pthread_mutex_unlock(&metrics->mutex);
+}
+
+void remmina_metrics_phase_begin(RemminaMetrics *metrics, const gchar *phase)
+{
+	TRACE_CALL(__func__);
+	RemminaMetricsPhase p;
+
+	p.name = g_strdup(phase);
+	p.begin = g_get_monotonic_time();
+	p.end = 0;
+
+	pthread_mutex_lock(&metrics->mutex);
+	g_array_append_val(metrics->phases, p);
+	pthread_mutex_unlock(&metrics->mutex);
+}
+
+void remmina_metrics_phase_end(RemminaMetrics *metrics, const gchar *phase)
+{
+	TRACE_CALL(__func__);
+	RemminaMetricsPhase *p;
+	gint64 now = g_get_monotonic_time();
+	guint i;
+
+	pthread_mutex_lock(&metrics->mutex);
+	/* The last running phase with this name, phases may be retried */
+	for (i = metrics->phases->len; i > 0; i--) {
+		p = &g_array_index(metrics->phases, RemminaMetricsPhase, i - 1);
+		if (p->end == 0 && g_strcmp0(p->name, phase) == 0) {
+			p->end = now;
+			REMMINA_DEBUG("Phase %s took %.3fs", phase, (p->end - p->begin) / 1000000.0);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&metrics->mutex);
+}
+
+/* Must be called with the mutex held */
+static void remmina_metrics_update_rates(RemminaMetrics *metrics, gint64 now)
+{
+	gint64 elapsed = now - metrics->window_start;
+	gint i;
+
+	if (elapsed < REMMINA_METRICS_RATE_WINDOW)
+		return;
+	for (i = 0; i < REMMINA_METRICS_LAST; i++) {
+		metrics->rates[i] = (metrics->totals[i] - metrics->window_totals[i]) * 1000000.0 / elapsed;
+		metrics->window_totals[i] = metrics->totals[i];
+	}
+	metrics->window_start = now;
+}
+
+void remmina_metrics_add(RemminaMetrics *metrics, RemminaMetricsCounter counter, gint64 value)
+{
+	TRACE_CALL(__func__);
+	gint64 now;
+
+	if (counter < 0 || counter >= REMMINA_METRICS_LAST)
+		return;
+
+	now = g_get_monotonic_time();
+	pthread_mutex_lock(&metrics->mutex);
+	metrics->reported[counter] = TRUE;
+	switch (counter) {
+	case REMMINA_METRICS_INPUT_LATENCY:
+		metrics->totals[counter]++;
+		metrics->latency_sum += value;
+		if (value > metrics->latency_max)
+			metrics->latency_max = value;
+		break;
+	case REMMINA_METRICS_FRAMES:
+		if (metrics->first_frame == 0)
+			metrics->first_frame = now;
+		/* fallthrough */
+	default:
+		metrics->totals[counter] += value;
+		break;
+	}
+	remmina_metrics_update_rates(metrics, now);
+	pthread_mutex_unlock(&metrics->mutex);
+}
+
+gboolean remmina_metrics_sample_socket(RemminaMetrics *metrics, gint fd)
+{
+	TRACE_CALL(__func__);
+#ifdef HAVE_TCP_INFO_BYTES_RECEIVED
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	guint64 in, out;
+
+	memset(&info, 0, sizeof(info));
+	if (fd < 0 || getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0 ||
+	    len < G_STRUCT_OFFSET(struct tcp_info, tcpi_bytes_received) + sizeof(info.tcpi_bytes_received))
+		return FALSE;
+
+	pthread_mutex_lock(&metrics->mutex);
+	/* Totals going back mean a new socket, after a reconnection */
+	in = info.tcpi_bytes_received >= metrics->socket_in ? info.tcpi_bytes_received - metrics->socket_in : info.tcpi_bytes_received;
+	out = info.tcpi_bytes_acked >= metrics->socket_out ? info.tcpi_bytes_acked - metrics->socket_out : info.tcpi_bytes_acked;
+	metrics->socket_in = info.tcpi_bytes_received;
+	metrics->socket_out = info.tcpi_bytes_acked;
+	pthread_mutex_unlock(&metrics->mutex);
+
+	remmina_metrics_add(metrics, REMMINA_METRICS_BYTES_IN, in);
+	remmina_metrics_add(metrics, REMMINA_METRICS_BYTES_OUT, out);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/* Must be called with the mutex held, a counter never fed is exported as null */
+static void remmina_metrics_json_add_counter(RemminaMetrics *metrics, JsonBuilder *b, RemminaMetricsCounter counter, gboolean rate)
+{
+	if ((counter == REMMINA_METRICS_BYTES_IN || counter == REMMINA_METRICS_BYTES_OUT) && !metrics->reported[counter])
+		json_builder_add_null_value(b);
+	else if (rate)
+		json_builder_add_double_value(b, metrics->rates[counter]);
+	else
+		json_builder_add_int_value(b, metrics->totals[counter]);
+}
+
+static JsonNode *remmina_metrics_to_json_node(RemminaMetrics *metrics, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	JsonBuilder *b;
+	JsonNode *r;
+	RemminaMetricsPhase *p;
+	gint64 now = g_get_monotonic_time();
+	gint64 since;
+	guint i;
+
+	b = json_builder_new();
+	pthread_mutex_lock(&metrics->mutex);
+	remmina_metrics_update_rates(metrics, now);
+
+	json_builder_begin_object(b);
+	json_builder_set_member_name(b, "name");
+	json_builder_add_string_value(b, name ? name : "");
+	json_builder_set_member_name(b, "uptime_ms");
+	json_builder_add_int_value(b, (now - metrics->origin) / 1000);
+
+	/* Offsets are relative to the start of the connection */
+	json_builder_set_member_name(b, "phases");
+	json_builder_begin_array(b);
+	for (i = 0; i < metrics->phases->len; i++) {
+		p = &g_array_index(metrics->phases, RemminaMetricsPhase, i);
+		json_builder_begin_object(b);
+		json_builder_set_member_name(b, "name");
+		json_builder_add_string_value(b, p->name);
+		json_builder_set_member_name(b, "start_ms");
+		json_builder_add_double_value(b, (p->begin - metrics->origin) / 1000.0);
+		json_builder_set_member_name(b, "duration_ms");
+		if (p->end)
+			json_builder_add_double_value(b, (p->end - p->begin) / 1000.0);
+		else
+			json_builder_add_null_value(b);
+		json_builder_end_object(b);
+	}
+	json_builder_end_array(b);
+
+	json_builder_set_member_name(b, "first_frame_ms");
+	if (metrics->first_frame)
+		json_builder_add_double_value(b, (metrics->first_frame - metrics->origin) / 1000.0);
+	else
+		json_builder_add_null_value(b);
+
+	json_builder_set_member_name(b, "counters");
+	json_builder_begin_object(b);
+	for (i = 0; i < REMMINA_METRICS_LAST; i++) {
+		json_builder_set_member_name(b, remmina_metrics_counter_names[i]);
+		remmina_metrics_json_add_counter(metrics, b, i, FALSE);
+	}
+	json_builder_end_object(b);
+
+	/* Over the last second, and on average since the first frame */
+	since = metrics->first_frame ? now - metrics->first_frame : 0;
+	json_builder_set_member_name(b, "rates");
+	json_builder_begin_object(b);
+	json_builder_set_member_name(b, "fps");
+	json_builder_add_double_value(b, metrics->rates[REMMINA_METRICS_FRAMES]);
+	json_builder_set_member_name(b, "bytes_in_per_s");
+	remmina_metrics_json_add_counter(metrics, b, REMMINA_METRICS_BYTES_IN, TRUE);
+	json_builder_set_member_name(b, "bytes_out_per_s");
+	remmina_metrics_json_add_counter(metrics, b, REMMINA_METRICS_BYTES_OUT, TRUE);
+	json_builder_set_member_name(b, "average_fps");
+	json_builder_add_double_value(b, since > 0 ? metrics->totals[REMMINA_METRICS_FRAMES] * 1000000.0 / since : 0.0);
+	json_builder_end_object(b);
+
+	json_builder_set_member_name(b, "input_latency_ms");
+	json_builder_begin_object(b);
+	json_builder_set_member_name(b, "average");
+	if (metrics->totals[REMMINA_METRICS_INPUT_LATENCY] > 0)
+		json_builder_add_double_value(b, metrics->latency_sum / 1000.0 / metrics->totals[REMMINA_METRICS_INPUT_LATENCY]);
+	else
+		json_builder_add_null_value(b);
+	json_builder_set_member_name(b, "max");
+	json_builder_add_double_value(b, metrics->latency_max / 1000.0);
+	json_builder_end_object(b);
+
+	json_builder_end_object(b);
+	pthread_mutex_unlock(&metrics->mutex);
+
+	r = json_builder_get_root(b);
+	g_object_unref(b);
+	return r;
+}
+
+gchar *remmina_metrics_to_json(RemminaMetrics *metrics, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	JsonGenerator *g;
+	JsonNode *n;
+	gchar *s;
+
+	n = remmina_metrics_to_json_node(metrics, name);
+	g = json_generator_new();
+	json_generator_set_pretty(g, TRUE);
+	json_generator_set_root(g, n);
+	json_node_unref(n);
+	s = json_generator_to_data(g, NULL);
+	g_object_unref(g);
+
+	return s;
+}
+
+/*-----------------------------------------------------------------------------*
+*                           Metrics dialog                                    *
+*-----------------------------------------------------------------------------*/
+#define REMMINA_METRICS_DIALOG_RESPONSE_EXPORT 1
+
+typedef struct _RemminaMetricsDialog {
+	RemminaMetrics *	metrics;
+	gchar *			name;
+	GtkWidget *		dialog;
+	GtkTextBuffer *		buffer;
+	guint			refresh_source;
+} RemminaMetricsDialog;
+
+static gboolean remmina_metrics_dialog_refresh(gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaMetricsDialog *md = (RemminaMetricsDialog *)user_data;
+	RemminaMetrics *metrics = md->metrics;
+	RemminaMetricsPhase *p;
+	GString *text;
+	gint64 now = g_get_monotonic_time();
+	guint i;
+
+	text = g_string_new(NULL);
+	pthread_mutex_lock(&metrics->mutex);
+	remmina_metrics_update_rates(metrics, now);
+
+	// TRANSLATORS: Title of the list of connection phases in the connection metrics window
+	g_string_append_printf(text, "%s\n", _("Phases"));
+	for (i = 0; i < metrics->phases->len; i++) {
+		p = &g_array_index(metrics->phases, RemminaMetricsPhase, i);
+		if (p->end)
+			g_string_append_printf(text, "  %-28s +%9.3fs %9.3fs\n", p->name,
+					       (p->begin - metrics->origin) / 1000000.0, (p->end - p->begin) / 1000000.0);
+		else
+			g_string_append_printf(text, "  %-28s +%9.3fs %10s\n", p->name,
+					       (p->begin - metrics->origin) / 1000000.0, "…");
+	}
+	if (metrics->first_frame)
+		g_string_append_printf(text, "  %-28s +%9.3fs\n", "first_frame",
+				       (metrics->first_frame - metrics->origin) / 1000000.0);
+
+	// TRANSLATORS: Title of the list of steady state counters in the connection metrics window
+	g_string_append_printf(text, "\n%s\n", _("Counters"));
+	g_string_append_printf(text, "  %-28s %12" G_GINT64_FORMAT " %10.1f/s\n", "frames",
+			       metrics->totals[REMMINA_METRICS_FRAMES], metrics->rates[REMMINA_METRICS_FRAMES]);
+	if (metrics->reported[REMMINA_METRICS_BYTES_IN])
+		g_string_append_printf(text, "  %-28s %12" G_GINT64_FORMAT " %10.0f/s\n", "bytes_in",
+				       metrics->totals[REMMINA_METRICS_BYTES_IN], metrics->rates[REMMINA_METRICS_BYTES_IN]);
+	if (metrics->reported[REMMINA_METRICS_BYTES_OUT])
+		g_string_append_printf(text, "  %-28s %12" G_GINT64_FORMAT " %10.0f/s\n", "bytes_out",
+				       metrics->totals[REMMINA_METRICS_BYTES_OUT], metrics->rates[REMMINA_METRICS_BYTES_OUT]);
+	if (metrics->totals[REMMINA_METRICS_INPUT_LATENCY] > 0)
+		g_string_append_printf(text, "  %-28s %9.1fms avg %9.1fms max\n", "input_latency",
+				       metrics->latency_sum / 1000.0 / metrics->totals[REMMINA_METRICS_INPUT_LATENCY],
+				       metrics->latency_max / 1000.0);
+	if (metrics->totals[REMMINA_METRICS_INPUT_PACKETS_SAVED] > 0) {
+		g_string_append_printf(text, "  %-28s %12" G_GINT64_FORMAT "\n", "input_packets_saved",
+				       metrics->totals[REMMINA_METRICS_INPUT_PACKETS_SAVED]);
+		g_string_append_printf(text, "  %-28s %12" G_GINT64_FORMAT "\n", "input_bytes_saved",
+				       metrics->totals[REMMINA_METRICS_INPUT_BYTES_SAVED]);
+	}
+	pthread_mutex_unlock(&metrics->mutex);
+
+	gtk_text_buffer_set_text(md->buffer, text->str, -1);
+	g_string_free(text, TRUE);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void remmina_metrics_dialog_export(RemminaMetricsDialog *md)
+{
+	TRACE_CALL(__func__);
+	GtkWidget *chooser;
+	GError *error = NULL;
+	gchar *filename;
+	gchar *json;
+
+	chooser = gtk_file_chooser_dialog_new(_("Export connection metrics"), GTK_WINDOW(md->dialog),
+					      GTK_FILE_CHOOSER_ACTION_SAVE,
+					      _("_Cancel"), GTK_RESPONSE_CANCEL,
+					      _("_Save"), GTK_RESPONSE_ACCEPT, NULL);
+	gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(chooser), TRUE);
+	filename = g_strdup_printf("%s-metrics.json", md->name ? md->name : "remmina");
+	gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(chooser), filename);
+	g_free(filename);
+
+	if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+		json = remmina_metrics_to_json(md->metrics, md->name);
+		if (!g_file_set_contents(filename, json, -1, &error)) {
+			REMMINA_WARNING("Could not export the connection metrics: %s", error->message);
+			g_error_free(error);
+		}
+		g_free(json);
+		g_free(filename);
+	}
+	gtk_widget_destroy(chooser);
+}
+
+static void remmina_metrics_dialog_on_response(GtkDialog *dialog, gint response_id, RemminaMetricsDialog *md)
+{
+	TRACE_CALL(__func__);
+	if (response_id == REMMINA_METRICS_DIALOG_RESPONSE_EXPORT) {
+		remmina_metrics_dialog_export(md);
+		return;
+	}
+	gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+static void remmina_metrics_dialog_on_destroy(GtkWidget *widget, RemminaMetricsDialog *md)
+{
+	TRACE_CALL(__func__);
+	g_source_remove(md->refresh_source);
+	remmina_metrics_unref(md->metrics);
+	g_free(md->name);
+	g_free(md);
+}
+
+void remmina_metrics_dialog_show(RemminaMetrics *metrics, const gchar *name, GtkWindow *parent)
+{
+	TRACE_CALL(__func__);
+	RemminaMetricsDialog *md;
+	GtkWidget *scrolled;
+	GtkWidget *view;
+	gchar *title;
+
+	md = g_new0(RemminaMetricsDialog, 1);
+	md->metrics = remmina_metrics_ref(metrics);
+	md->name = g_strdup(name);
+
+	// TRANSLATORS: “%s” is a placeholder for the connection profile name
+	title = g_strdup_printf(_("Connection metrics of “%s”"), name ? name : "*");
+	md->dialog = gtk_dialog_new_with_buttons(title, parent, GTK_DIALOG_DESTROY_WITH_PARENT,
+						 _("_Export…"), REMMINA_METRICS_DIALOG_RESPONSE_EXPORT,
+						 _("_Close"), GTK_RESPONSE_CLOSE, NULL);
+	g_free(title);
+	gtk_window_set_default_size(GTK_WINDOW(md->dialog), 560, 420);
+
+	view = gtk_text_view_new();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+	gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+	md->buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), view);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(md->dialog))), scrolled, TRUE, TRUE, 0);
+
+	g_signal_connect(md->dialog, "response", G_CALLBACK(remmina_metrics_dialog_on_response), md);
+	g_signal_connect(md->dialog, "destroy", G_CALLBACK(remmina_metrics_dialog_on_destroy), md);
+
+	remmina_metrics_dialog_refresh(md);
+	md->refresh_source = g_timeout_add_seconds(1, remmina_metrics_dialog_refresh, md);
+
+	gtk_widget_show_all(md->dialog);
+}
@@ -0,0 +1,63 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include "remmina/types.h"
+
+G_BEGIN_DECLS
+
+/* Timings of the phases of a connection (tunnel, connect, authentication,
+ * first frame…) and its steady state counters. Phases and counters may be
+ * updated from any thread. */
+typedef struct _RemminaMetrics RemminaMetrics;
+
+RemminaMetrics *remmina_metrics_new(void);
+RemminaMetrics *remmina_metrics_ref(RemminaMetrics *metrics);
+void remmina_metrics_unref(RemminaMetrics *metrics);
+/* Forget everything, at the start of a new connection attempt */
+void remmina_metrics_reset(RemminaMetrics *metrics);
+void remmina_metrics_phase_begin(RemminaMetrics *metrics, const gchar *phase);
+void remmina_metrics_phase_end(RemminaMetrics *metrics, const gchar *phase);
+void remmina_metrics_add(RemminaMetrics *metrics, RemminaMetricsCounter counter, gint64 value);
+/* Adds the bytes received and acknowledged on a TCP socket since the last
+ * sample, FALSE when the platform or the socket cannot tell */
+gboolean remmina_metrics_sample_socket(RemminaMetrics *metrics, gint fd);
+/* The returned string must be freed with g_free() */
+gchar *remmina_metrics_to_json(RemminaMetrics *metrics, const gchar *name);
+/* A window showing the metrics, refreshed every second, with a JSON export */
+void remmina_metrics_dialog_show(RemminaMetrics *metrics, const gchar *name, GtkWindow *parent);
+
+G_END_DECLS
@@ -31,142 +31,302 @@
  *  files in the program, then also delete it here.
  *
  */
-
 #include "config.h"
 #include "remmina_monitor.h"
 #include "remmina_log.h"
 #include "remmina_public.h"
 #include "remmina/remmina_trace_calls.h"
 
+/* Probes in flight at once, so a large profile list does not flood DNS */
+#define REMMINA_MONITOR_MAX_PROBES	32
+/* TCP connect timeout of a single probe, in seconds */
+#define REMMINA_MONITOR_PROBE_TIMEOUT	3
+/* How long a probe result is trusted, in microseconds */
+#define REMMINA_MONITOR_TTL		(60 * G_USEC_PER_SEC)
+/* Profiles not looked up for this long, in microseconds, are forgotten */
+#define REMMINA_MONITOR_PRUNE_AGE	(10 * 60 * G_USEC_PER_SEC)
+
+typedef enum {
+	REMMINA_MONITOR_UNKNOWN,
+	REMMINA_MONITOR_QUEUED,
+	REMMINA_MONITOR_PROBING,
+	REMMINA_MONITOR_ONLINE,
+	REMMINA_MONITOR_OFFLINE
+} RemminaMonitorState;
+
+typedef struct _RemminaMonitorTarget {
+	RemminaMonitor *	monitor;
+	gchar *			host;
+	guint16			port;
+	RemminaMonitorState	state;
+	/* Result of the last completed probe, valid when checked > 0 */
+	gboolean		reachable;
+	gint64			checked;
+	/* Profiles pointing at this endpoint, filename -> time of the last lookup */
+	GHashTable *		filenames;
+} RemminaMonitorTarget;
+
 RemminaMonitor *rm_monitor;
 
-static void remmina_monitor_can_reach_cb (GNetworkMonitor *netmonitor, GAsyncResult *result, RemminaMonitor *monitor)
+static void remmina_monitor_target_free(RemminaMonitorTarget *target)
 {
-	g_autoptr (GError) error = NULL;
+	g_free(target->host);
+	g_hash_table_destroy(target->filenames);
+	g_free(target);
+}
 
-	gchar *status = NULL;
+static void remmina_monitor_dispose(RemminaMonitor *monitor)
+{
+	TRACE_CALL(__func__);
 
-	gboolean is_reachable = g_network_monitor_can_reach_finish (netmonitor, result, &error);
+	g_object_unref(monitor->client);
+	g_object_unref(monitor->cancellable);
+	g_queue_free(monitor->queue);
+	g_hash_table_destroy(monitor->filenames);
+	g_hash_table_destroy(monitor->targets);
+	if (rm_monitor == monitor)
+		rm_monitor = NULL;
+	g_free(monitor);
+}
 
-	const gchar *addr_tostr = g_strdup(g_socket_connectable_to_string (monitor->addr));
+static void remmina_monitor_dispatch(RemminaMonitor *monitor);
 
-	if (is_reachable) {
+static void remmina_monitor_probe_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	TRACE_CALL(__func__);
 
-		REMMINA_DEBUG ("Network object %s is reachable", g_socket_connectable_to_string (monitor->addr));
-		status = g_strdup ("online");
+	RemminaMonitorTarget *target = (RemminaMonitorTarget *)user_data;
+	RemminaMonitor *monitor = target->monitor;
+	g_autoptr (GError) error = NULL;
+	GSocketConnection *connection;
+	GHashTableIter iter;
+	gpointer filename;
+	gboolean reachable;
+
+	connection = g_socket_client_connect_finish(G_SOCKET_CLIENT(source), result, &error);
+	if (connection)
+		g_object_unref(connection);
+	monitor->probes--;
+
+	if (monitor->disposed) {
+		if (monitor->probes == 0)
+			remmina_monitor_dispose(monitor);
+		return;
+	}
 
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		target->state = REMMINA_MONITOR_UNKNOWN;
 	} else {
+		reachable = (connection != NULL);
+		REMMINA_DEBUG("Network object %s:%u is %s", target->host, target->port,
+			      reachable ? "reachable" : "not reachable");
+		target->state = reachable ? REMMINA_MONITOR_ONLINE : REMMINA_MONITOR_OFFLINE;
+		target->reachable = reachable;
+		target->checked = g_get_monotonic_time();
+
+		if (monitor->update_func) {
+			g_hash_table_iter_init(&iter, target->filenames);
+			while (g_hash_table_iter_next(&iter, &filename, NULL))
+				monitor->update_func((const gchar *)filename, reachable, monitor->update_data);
+		}
+	}
+
+	remmina_monitor_dispatch(monitor);
+}
+
+/* Start queued probes until the concurrency cap is reached */
+static void remmina_monitor_dispatch(RemminaMonitor *monitor)
+{
+	TRACE_CALL(__func__);
 
-		REMMINA_DEBUG ("Network object %s is not reachable", g_socket_connectable_to_string (monitor->addr));
-		status = g_strdup ("offline");
+	RemminaMonitorTarget *target;
+	GSocketConnectable *addr;
+
+	while (monitor->probes < REMMINA_MONITOR_MAX_PROBES && !g_queue_is_empty(monitor->queue)) {
+		target = (RemminaMonitorTarget *)g_queue_pop_head(monitor->queue);
+		if (!monitor->connected) {
+			target->state = REMMINA_MONITOR_UNKNOWN;
+			continue;
+		}
+
+		REMMINA_DEBUG("Testing for %s:%u", target->host, target->port);
+		target->state = REMMINA_MONITOR_PROBING;
+		monitor->probes++;
+		addr = g_network_address_new(target->host, target->port);
+		g_socket_client_connect_async(monitor->client, addr, monitor->cancellable,
+					      remmina_monitor_probe_cb, target);
+		g_object_unref(addr);
 	}
+}
 
-	if (g_hash_table_replace (monitor->server_status, g_strdup(addr_tostr), g_strdup(status))) {
-		REMMINA_DEBUG ("Inserting %s -> %s", addr_tostr, status);
-	} else {
-		REMMINA_DEBUG ("Replacing %s -> %s", addr_tostr, status);
+static void remmina_monitor_network_changed(GNetworkMonitor *netmonitor, gboolean available, RemminaMonitor *monitor)
+{
+	TRACE_CALL(__func__);
+
+	GHashTableIter iter;
+	gpointer value;
+
+	remmina_network_monitor_status(monitor);
+
+	/* Routes may have changed, so no cached result can be trusted anymore */
+	g_hash_table_iter_init(&iter, monitor->targets);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		((RemminaMonitorTarget *)value)->checked = 0;
+}
+
+/* Forget the profiles not looked up for a while, e.g. deleted ones, then the
+ * endpoints no profile points at anymore */
+static void remmina_monitor_prune(RemminaMonitor *monitor, gint64 now)
+{
+	TRACE_CALL(__func__);
+
+	GHashTableIter iter, fiter;
+	gpointer value, filename, used;
+	RemminaMonitorTarget *target;
+
+	g_hash_table_iter_init(&iter, monitor->targets);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		target = (RemminaMonitorTarget *)value;
+		g_hash_table_iter_init(&fiter, target->filenames);
+		while (g_hash_table_iter_next(&fiter, &filename, &used)) {
+			if (now - *(gint64 *)used < REMMINA_MONITOR_PRUNE_AGE)
+				continue;
+			g_hash_table_remove(monitor->filenames, filename);
+			g_hash_table_iter_remove(&fiter);
+		}
+		/* Queued and probing targets are still referenced */
+		if (g_hash_table_size(target->filenames) == 0 &&
+		    target->state != REMMINA_MONITOR_QUEUED && target->state != REMMINA_MONITOR_PROBING)
+			g_hash_table_iter_remove(&iter);
+	}
+	monitor->pruned = now;
+}
+
+/* Remember that the profile points at target, and when it was looked up */
+static void remmina_monitor_target_add_filename(RemminaMonitor *monitor, RemminaMonitorTarget *target,
+						const gchar *filename, gint64 now)
+{
+	TRACE_CALL(__func__);
+
+	RemminaMonitorTarget *previous;
+	gint64 *used;
+
+	used = (gint64 *)g_hash_table_lookup(target->filenames, filename);
+	if (used) {
+		*used = now;
+		return;
 	}
 
-	g_free (status);
+	/* The server of the profile changed */
+	previous = (RemminaMonitorTarget *)g_hash_table_lookup(monitor->filenames, filename);
+	if (previous)
+		g_hash_table_remove(previous->filenames, filename);
+
+	used = g_new(gint64, 1);
+	*used = now;
+	g_hash_table_insert(target->filenames, g_strdup(filename), used);
+	g_hash_table_replace(monitor->filenames, g_strdup(filename), target);
 }
 
-gchar *remmina_monitor_can_reach(RemminaFile *remminafile, RemminaMonitor *monitor)
+/**
+ * Returns the cached reachability of the profile endpoint as "Yes" or "No",
+ * or NULL when it is not known yet. Stale or unknown endpoints get a probe
+ * queued, its result is reported later through the update function.
+ */
+const gchar *remmina_monitor_can_reach(RemminaFile *remminafile, RemminaMonitor *monitor)
 {
 	TRACE_CALL(__func__);
 
 	const gchar *server;
 	const gchar *ssh_tunnel_server;
-	const gchar *addr_tostr = NULL;
-	gchar *status = NULL;
-	gchar *ssh_tunnel_host, *srv_host;
-	gint netmonit, srv_port, ssh_tunnel_port;
 	const gchar *protocol;
+	gchar *host = NULL;
+	gchar *key;
+	gint port;
 	gint default_port = 0;
+	gint64 now;
+	RemminaMonitorTarget *target;
 
-
-	if (!remminafile) {
-		status = g_strdup ("I/O Error");
-		REMMINA_DEBUG (status);
+	if (!remminafile || !monitor || monitor->disposed)
 		return NULL;
-	}
 
-	netmonit = remmina_file_get_int(remminafile, "enable-netmonit", FALSE);
+	if (!remmina_file_get_int(remminafile, "enable-netmonit", TRUE))
+		return NULL;
 
-	if (!netmonit) {
-		status = g_strdup ("Monitoring disabled");
-		REMMINA_DEBUG (status);
+	protocol = remmina_file_get_string(remminafile, "protocol");
+	if (!protocol || protocol[0] == '\0')
 		return NULL;
-	}
 
-	protocol = remmina_file_get_string (remminafile, "protocol");
-
-	if (protocol && protocol[0] != '\0') {
-		REMMINA_DEBUG ("Evaluating protocol %s for monitoring", protocol);
-		if (g_strcmp0("RDP", protocol) == 0)
-			default_port = 3389;
-		if (g_strcmp0("VNC", protocol) == 0)
-			default_port = 5900;
-		if (g_strcmp0("GVNC", protocol) == 0)
-			default_port = 5900;
-		if (g_strcmp0("SPICE", protocol) == 0)
-			default_port = 5900;
-		if (g_strcmp0("WWW", protocol) == 0)
-			default_port = 443;
-		if (g_strcmp0("X2GO", protocol) == 0)
-			default_port = 22;
-		if (g_strcmp0("SSH", protocol) == 0)
-			default_port = 22;
-		if (g_strcmp0("SFTP", protocol) == 0)
-			default_port = 22;
-		if (g_strcmp0("EXEC", protocol) == 0)
-			default_port = -1;
-
-		if (default_port == 0) {
-			status = g_strdup ("Unknown protocol");
-			REMMINA_DEBUG (status);
-			return NULL;
-		}
-		if (default_port < 0) {
-			status = g_strdup ("Cannot monitor");
-			REMMINA_DEBUG (status);
-			return NULL;
-		}
+	if (g_strcmp0("RDP", protocol) == 0)
+		default_port = 3389;
+	if (g_strcmp0("VNC", protocol) == 0)
+		default_port = 5900;
+	if (g_strcmp0("GVNC", protocol) == 0)
+		default_port = 5900;
+	if (g_strcmp0("SPICE", protocol) == 0)
+		default_port = 5900;
+	if (g_strcmp0("WWW", protocol) == 0)
+		default_port = 443;
+	if (g_strcmp0("X2GO", protocol) == 0)
+		default_port = 22;
+	if (g_strcmp0("SSH", protocol) == 0)
+		default_port = 22;
+	if (g_strcmp0("SFTP", protocol) == 0)
+		default_port = 22;
+
+	/* Unknown protocols and EXEC cannot be monitored */
+	if (default_port <= 0)
+		return NULL;
 
+	if (remmina_file_get_int(remminafile, "ssh_tunnel_enabled", FALSE)) {
 		ssh_tunnel_server = remmina_file_get_string(remminafile, "ssh_tunnel_server");
-		if (remmina_file_get_int(remminafile, "ssh_tunnel_enabled", FALSE)) {
-			remmina_public_get_server_port(ssh_tunnel_server, 22, &ssh_tunnel_host, &ssh_tunnel_port);
-			monitor->addr = g_network_address_new (ssh_tunnel_host, ssh_tunnel_port);
-			g_free(ssh_tunnel_host), ssh_tunnel_host = NULL;
-		} else {
-			server = remmina_file_get_string(remminafile, "server");
-			remmina_public_get_server_port(server, default_port, &srv_host, &srv_port);
-			monitor->addr = g_network_address_new (srv_host, srv_port);
-			g_free(srv_host), srv_host = NULL;
-		}
-		addr_tostr = g_strdup(g_socket_connectable_to_string (monitor->addr));
-
-		REMMINA_DEBUG ("addr is %s", addr_tostr);
-		if (monitor->connected && netmonit) {
-			REMMINA_DEBUG ("Testing for %s", addr_tostr);
-			g_network_monitor_can_reach_async (
-					monitor->netmonitor,
-					monitor->addr,
-					NULL,
-					(GAsyncReadyCallback) remmina_monitor_can_reach_cb,
-					monitor);
-		}
-
+		remmina_public_get_server_port(ssh_tunnel_server, 22, &host, &port);
+	} else {
+		server = remmina_file_get_string(remminafile, "server");
+		remmina_public_get_server_port(server, default_port, &host, &port);
+	}
 
-		status = (gchar *)g_hash_table_lookup (monitor->server_status, addr_tostr);
+	if (!host || host[0] == '\0' || port <= 0 || port > G_MAXUINT16) {
+		g_free(host);
+		return NULL;
+	}
 
+	now = g_get_monotonic_time();
+	if (now - monitor->pruned >= REMMINA_MONITOR_TTL)
+		remmina_monitor_prune(monitor, now);
+
+	key = g_strdup_printf("%s:%d", host, port);
+	target = (RemminaMonitorTarget *)g_hash_table_lookup(monitor->targets, key);
+	if (!target) {
+		target = g_new0(RemminaMonitorTarget, 1);
+		target->monitor = monitor;
+		target->host = host;
+		target->port = (guint16)port;
+		target->state = REMMINA_MONITOR_UNKNOWN;
+		target->filenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+		g_hash_table_insert(monitor->targets, key, target);
+	} else {
+		g_free(host);
+		g_free(key);
 	}
 
-	if (!status) {
-		return g_strdup(addr_tostr);
-	} else
-		return status;
+	if (remminafile->filename)
+		remmina_monitor_target_add_filename(monitor, target, remminafile->filename, now);
 
+	if ((target->state == REMMINA_MONITOR_ONLINE || target->state == REMMINA_MONITOR_OFFLINE)
+	    && target->checked > 0 && now - target->checked < REMMINA_MONITOR_TTL)
+		return target->reachable ? "Yes" : "No";
 
+	if (monitor->connected && target->state != REMMINA_MONITOR_QUEUED && target->state != REMMINA_MONITOR_PROBING) {
+		target->state = REMMINA_MONITOR_QUEUED;
+		g_queue_push_tail(monitor->queue, target);
+		remmina_monitor_dispatch(monitor);
+	}
+
+	/* A stale result is still better than nothing while the new probe runs */
+	if (target->checked > 0)
+		return target->reachable ? "Yes" : "No";
+	return NULL;
 }
 
 gboolean remmina_network_monitor_status (RemminaMonitor *rm_monitor)
@@ -175,12 +335,6 @@ gboolean remmina_network_monitor_status (RemminaMonitor *rm_monitor)
 
 	gboolean status = g_network_monitor_get_connectivity (rm_monitor->netmonitor);
 
-	rm_monitor->server_status = g_hash_table_new_full(
-			g_str_hash,
-			g_str_equal,
-			(GDestroyNotify)g_free,
-			(GDestroyNotify)g_free);
-
 	switch (status)
 	{
 		case G_NETWORK_CONNECTIVITY_LOCAL:
@@ -207,6 +361,13 @@ gboolean remmina_network_monitor_status (RemminaMonitor *rm_monitor)
 	return status;
 }
 
+void remmina_network_monitor_set_update_func (RemminaMonitor *monitor, RemminaMonitorUpdateFunc func, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+
+	monitor->update_func = func;
+	monitor->update_data = user_data;
+}
 
 RemminaMonitor *remmina_network_monitor_new (void)
 {
@@ -215,6 +376,36 @@ RemminaMonitor *remmina_network_monitor_new (void)
 	rm_monitor = g_new0(RemminaMonitor, 1);
 
 	rm_monitor->netmonitor = g_network_monitor_get_default ();
+	rm_monitor->client = g_socket_client_new ();
+	g_socket_client_set_timeout (rm_monitor->client, REMMINA_MONITOR_PROBE_TIMEOUT);
+	rm_monitor->cancellable = g_cancellable_new ();
+	rm_monitor->targets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+						    (GDestroyNotify)remmina_monitor_target_free);
+	rm_monitor->filenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	rm_monitor->queue = g_queue_new ();
+
+	remmina_network_monitor_status (rm_monitor);
+	rm_monitor->changed_handler = g_signal_connect (rm_monitor->netmonitor, "network-changed",
+							G_CALLBACK(remmina_monitor_network_changed), rm_monitor);
 
 	return rm_monitor;
 }
+
+void remmina_network_monitor_free (RemminaMonitor *monitor)
+{
+	TRACE_CALL(__func__);
+
+	if (!monitor)
+		return;
+
+	g_signal_handler_disconnect (monitor->netmonitor, monitor->changed_handler);
+	monitor->disposed = TRUE;
+	monitor->update_func = NULL;
+	g_queue_clear (monitor->queue);
+
+	/* Probes still in flight own the monitor until their callback runs */
+	if (monitor->probes > 0)
+		g_cancellable_cancel (monitor->cancellable);
+	else
+		remmina_monitor_dispose (monitor);
+}
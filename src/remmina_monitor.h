@@ -31,7 +31,6 @@
  *  files in the program, then also delete it here.
  *
  */
-
 #pragma once
 
 #include <glib/gi18n.h>
@@ -40,18 +39,33 @@
 
 #include "remmina_file.h"
 
+/* Called on the main thread for each profile whose probe target got a fresh result */
+typedef void (*RemminaMonitorUpdateFunc)(const gchar *filename, gboolean reachable, gpointer user_data);
+
 typedef struct _RemminaMonitor {
     GNetworkMonitor *		netmonitor;
     gboolean			connected;
-    GSocketConnectable *	addr;
-    gboolean			reachable;
-    GHashTable *		server_status;
+    gulong			changed_handler;
+    GSocketClient *		client;
+    GCancellable *		cancellable;
+    /* "host:port" -> RemminaMonitorTarget, one probe per distinct endpoint */
+    GHashTable *		targets;
+    /* Profile filename -> RemminaMonitorTarget it was last seen pointing at */
+    GHashTable *		filenames;
+    gint64			pruned;
+    GQueue *			queue;
+    guint			probes;
+    gboolean			disposed;
+    RemminaMonitorUpdateFunc	update_func;
+    gpointer			update_data;
 } RemminaMonitor;
 
 G_BEGIN_DECLS
 
 gboolean remmina_network_monitor_status (RemminaMonitor *rm_monitor);
 RemminaMonitor *remmina_network_monitor_new (void);
-gchar *remmina_monitor_can_reach(RemminaFile *remminafile, RemminaMonitor *monitor);
+void remmina_network_monitor_set_update_func (RemminaMonitor *monitor, RemminaMonitorUpdateFunc func, gpointer user_data);
+void remmina_network_monitor_free (RemminaMonitor *monitor);
+const gchar *remmina_monitor_can_reach(RemminaFile *remminafile, RemminaMonitor *monitor);
 
 G_END_DECLS
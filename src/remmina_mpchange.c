@@ -40,6 +40,7 @@
 #include "remmina_mpchange.h"
 #include "remmina_file.h"
 #include "remmina_file_manager.h"
+#include "remmina_bulk.h"
 #include "remmina_pref.h"
 #include "remmina_public.h"
 #include "remmina_main.h"
@@ -64,11 +65,11 @@ struct mpchanger_params {
 	GtkDialog* dialog;
 	GtkTreeView* table;
 	GtkButton* btnDoChange;
+	GtkButton* btnCancelChange;
 	GtkLabel* statusLabel;
 
-	GtkTreeIter iter;
 	int changed_passwords_count;
-	guint sid;
+	gboolean running;               // A bulk update is in progress, the dialog cannot be closed
 	guint searchentrychange_timeout_source_id;
 };
 
@@ -100,7 +101,7 @@ static gboolean remmina_mpchange_fieldcompare(const gchar *needle, const gchar *
 
 }
 
-static void remmina_mpchange_file_list_callback(RemminaFile *remminafile, gpointer user_data)
+static void remmina_mpchange_file_list_callback(RemminaFileMeta *meta, gpointer user_data)
 {
 	TRACE_CALL(__func__);
 	GtkListStore* store;
@@ -116,11 +117,11 @@ static void remmina_mpchange_file_list_callback(RemminaFile *remminafile, gpoint
 	store = GTK_LIST_STORE(mpcp->store);
 
 
-	username = remmina_file_get_string(remminafile, "username");
-	domain = remmina_file_get_string(remminafile, "domain");
-	group = remmina_file_get_string(remminafile, "group");
-	gatewayusername = remmina_file_get_string(remminafile, "gateway_username");
-	gatewaydomain = remmina_file_get_string(remminafile, "gateway_domain");
+	username = remmina_file_meta_get_string(meta, "username");
+	domain = remmina_file_meta_get_string(meta, "domain");
+	group = remmina_file_meta_get_string(meta, "group");
+	gatewayusername = remmina_file_meta_get_string(meta, "gateway_username");
+	gatewaydomain = remmina_file_meta_get_string(meta, "gateway_domain");
 
 	if (username == NULL)
 		username = "";
@@ -154,11 +155,11 @@ static void remmina_mpchange_file_list_callback(RemminaFile *remminafile, gpoint
 	t = g_strdup_printf("%s\\%s", gatewaydomain, gatewayusername);
 	gtk_list_store_set(store, &iter,
 		COL_F, matchcount >= 5 ? TRUE : FALSE,
-		COL_NAME, remmina_file_get_string(remminafile, "name"),
+		COL_NAME, meta->name,
 		COL_GROUP, group,
 		COL_USERNAME,   s,
 		COL_GATEWAY_USERNAME,   t,
-		COL_FILENAME, remminafile->filename,
+		COL_FILENAME, meta->filename,
 		-1);
 	g_free(s);
 	g_free(t);
@@ -179,26 +180,6 @@ static void remmina_mpchange_checkbox_toggle(GtkCellRendererToggle *cell, gchar
 	gtk_list_store_set(mpcp->store, &iter, COL_F, !a, -1);
 }
 
-static void remmina_mpchange_dochange(gchar* fname, struct mpchanger_params* mpcp)
-{
-	TRACE_CALL(__func__);
-
-	RemminaFile* remminafile;
-
-	remminafile = remmina_file_load(fname);
-	if (remminafile) {
-		if(mpcp->password[0] != 0){
-			remmina_file_store_secret_plugin_password(remminafile, "password", mpcp->password);
-		}
-		if(mpcp->gatewaypassword[0] != 0){
-			remmina_file_store_secret_plugin_password(remminafile, "gateway_password", mpcp->gatewaypassword);
-		}
-		remmina_file_free(remminafile);
-		mpcp->changed_passwords_count++;
-	}
-
-}
-
 static void enable_inputs(struct mpchanger_params* mpcp, gboolean ena)
 {
 	gtk_widget_set_sensitive(GTK_WIDGET(mpcp->eGroup), ena);
@@ -214,27 +195,43 @@ static void enable_inputs(struct mpchanger_params* mpcp, gboolean ena)
 	gtk_widget_set_sensitive(GTK_WIDGET(mpcp->table), ena);
 }
 
-static gboolean changenext(gpointer user_data)
+static void remmina_mpchange_progress(guint done, guint total, gpointer user_data)
 {
 	TRACE_CALL(__func__);
 	struct mpchanger_params* mpcp = (struct mpchanger_params*)user_data;
-	gchar* fname;
-	gboolean sel;
+	gchar *s;
 
-	gtk_tree_model_get(GTK_TREE_MODEL(mpcp->store), &mpcp->iter, COL_F, &sel, -1);
-	gtk_tree_model_get(GTK_TREE_MODEL(mpcp->store), &mpcp->iter, COL_FILENAME, &fname, -1);
-	if (sel) {
-		remmina_mpchange_dochange(fname, mpcp);
-	}
-	g_free(fname);
+	s = g_strdup_printf(_("Resetting passwords, please wait… %u/%u"), done, total);
+	gtk_label_set_text(mpcp->statusLabel, s);
+	g_free(s);
+}
 
-	if (gtk_tree_model_iter_next(GTK_TREE_MODEL(mpcp->store), &mpcp->iter)) {
-		return G_SOURCE_CONTINUE;
-	}else  {
-		gtk_dialog_response(mpcp->dialog, 1);
-		mpcp->sid = 0;
-		return G_SOURCE_REMOVE;
+static void remmina_mpchange_done(guint changed, const gchar *error, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	struct mpchanger_params* mpcp = (struct mpchanger_params*)user_data;
+
+	mpcp->running = FALSE;
+	if (error) {
+		GtkWidget *msgDialog;
+		msgDialog = gtk_message_dialog_new(GTK_WINDOW(mpcp->dialog),
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_MESSAGE_ERROR,
+			GTK_BUTTONS_CLOSE,
+			_("No password has been changed.\n%s"), error);
+		gtk_dialog_run(GTK_DIALOG(msgDialog));
+		gtk_widget_destroy(msgDialog);
 	}
+	mpcp->changed_passwords_count = changed;
+	gtk_dialog_response(mpcp->dialog, 1);
+}
+
+static gboolean remmina_mpchange_delete_event(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+	struct mpchanger_params* mpcp = (struct mpchanger_params*)user_data;
+
+	/* The bulk update owns mpcp until it is done */
+	return mpcp->running;
 }
 
 static void remmina_mpchange_dochange_clicked(GtkButton *btn, gpointer user_data)
@@ -242,13 +239,17 @@ static void remmina_mpchange_dochange_clicked(GtkButton *btn, gpointer user_data
 	TRACE_CALL(__func__);
 	struct mpchanger_params* mpcp = (struct mpchanger_params*)user_data;
 	const gchar *passwd1, *passwd2, *gatewaypasswd1, *gatewaypasswd2;
+	RemminaBulkOp *op;
+	GtkTreeIter iter;
+	gboolean sel;
+	gchar *fname;
 
 	if (mpcp->searchentrychange_timeout_source_id) {
 		g_source_remove(mpcp->searchentrychange_timeout_source_id);
 		mpcp->searchentrychange_timeout_source_id = 0;
 	}
 
-	if (!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(mpcp->store), &mpcp->iter))
+	if (!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(mpcp->store), &iter))
 		return;
 
 	passwd1 = gtk_entry_get_text(mpcp->ePassword1);
@@ -287,10 +288,24 @@ static void remmina_mpchange_dochange_clicked(GtkButton *btn, gpointer user_data
 	mpcp->gatewaypassword = g_strdup(gatewaypasswd1);
 	mpcp->changed_passwords_count = 0;
 
+	op = remmina_bulk_new();
+	do {
+		gtk_tree_model_get(GTK_TREE_MODEL(mpcp->store), &iter, COL_F, &sel, COL_FILENAME, &fname, -1);
+		if (sel)
+			remmina_bulk_add_profile(op, fname);
+		g_free(fname);
+	} while (gtk_tree_model_iter_next(GTK_TREE_MODEL(mpcp->store), &iter));
+	if (mpcp->password[0] != 0)
+		remmina_bulk_set(op, "password", mpcp->password);
+	if (mpcp->gatewaypassword[0] != 0)
+		remmina_bulk_set(op, "gateway_password", mpcp->gatewaypassword);
+
 	gtk_label_set_text(mpcp->statusLabel, _("Resetting passwords, please wait…"));
 
 	enable_inputs(mpcp, FALSE);
-	mpcp->sid = g_idle_add(changenext, (gpointer)mpcp);
+	gtk_widget_set_sensitive(GTK_WIDGET(mpcp->btnCancelChange), FALSE);
+	mpcp->running = TRUE;
+	remmina_bulk_run(op, remmina_mpchange_progress, remmina_mpchange_done, mpcp);
 
 }
 
@@ -330,8 +345,12 @@ static gboolean remmina_mpchange_searchfield_changed_to(gpointer user_data)
 	}
 	mpcp->store = gtk_list_store_new(NUM_COLS, G_TYPE_BOOLEAN, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
 
-	if (mpcp->group[0] != 0 || mpcp->domain[0] != 0 || mpcp->username[0] != 0 || mpcp->gatewayusername[0] != 0 || mpcp->gatewaydomain[0] != 0)
-		remmina_file_manager_iterate((GFunc)remmina_mpchange_file_list_callback, (gpointer)mpcp);
+	if (mpcp->group[0] != 0 || mpcp->domain[0] != 0 || mpcp->username[0] != 0 || mpcp->gatewayusername[0] != 0 || mpcp->gatewaydomain[0] != 0) {
+		/* The metadata index avoids loading every profile and its secrets on each keystroke */
+		GPtrArray *profiles = remmina_file_manager_get_meta();
+		g_ptr_array_foreach(profiles, (GFunc)remmina_mpchange_file_list_callback, (gpointer)mpcp);
+		g_ptr_array_unref(profiles);
+	}
 
 	gtk_tree_view_set_model(mpcp->table, GTK_TREE_MODEL(mpcp->store));
 
@@ -358,7 +377,8 @@ static void remmina_mpchange_stopsearch(GtkSearchEntry *entry, gpointer user_dat
 	TRACE_CALL(__func__);
 	/* The stop-search signal is emitted when pressing Esc on a GtkSearchEntry. We end the dialog. */
 	struct mpchanger_params *mpcp = (struct mpchanger_params *)user_data;
-	gtk_dialog_response(mpcp->dialog, 1);
+	if (!mpcp->running)
+		gtk_dialog_response(mpcp->dialog, 1);
 }
 
 static gboolean remmina_file_multipasswd_changer_mt(gpointer d)
@@ -457,14 +477,12 @@ static gboolean remmina_file_multipasswd_changer_mt(gpointer d)
 	mpcp->btnDoChange = GTK_BUTTON(GET_DIALOG_OBJECT("btnDoChange"));
 	g_signal_connect(mpcp->btnDoChange, "clicked", G_CALLBACK(remmina_mpchange_dochange_clicked), (gpointer)mpcp);
 
+	mpcp->btnCancelChange = GTK_BUTTON(GET_DIALOG_OBJECT("btnCancelChange"));
+	g_signal_connect(G_OBJECT(dialog), "delete-event", G_CALLBACK(remmina_mpchange_delete_event), (gpointer)mpcp);
+
 	gtk_dialog_run(dialog);
 	gtk_widget_destroy(GTK_WIDGET(dialog));
 
-	if (mpcp->sid) {
-		g_source_remove(mpcp->sid);
-		mpcp->sid = 0;
-	}
-
 	if (mpcp->searchentrychange_timeout_source_id) {
 		g_source_remove(mpcp->searchentrychange_timeout_source_id);
 		mpcp->searchentrychange_timeout_source_id = 0;
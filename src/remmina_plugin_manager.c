@@ -325,6 +325,12 @@ RemminaPluginService remmina_plugin_manager_service =
 	remmina_main_get_window,
 	remmina_unlock_new,
 	remmina_main_add_network_status,
+	remmina_protocol_widget_metrics_phase,
+	remmina_protocol_widget_metrics_add,
+	remmina_protocol_widget_framebuffer_wanted,
+	remmina_protocol_widget_damage,
+	remmina_protocol_widget_is_recording,
+	remmina_protocol_widget_metrics_sample_socket,
 };
 
 static const char *get_filename_ext(const char *filename) {
@@ -684,6 +690,10 @@ RemminaPlugin* remmina_plugin_manager_get_plugin(RemminaPluginType type, const g
 	RemminaPlugin *plugin;
 	guint i;
 
+	/* Nothing is registered before remmina_plugin_manager_init() */
+	if (!remmina_plugin_table)
+		return NULL;
+
 	for (i = 0; i < remmina_plugin_table->len; i++) {
 		plugin = (RemminaPlugin*)g_ptr_array_index(remmina_plugin_table, i);
 		if (plugin->type == type && g_strcmp0(plugin->name, name) == 0) {
@@ -44,6 +44,7 @@
 #include <sys/time.h>
 #include <sys/utsname.h>
 
+#include <pthread.h>
 #include <glib/gstdio.h>
 #include <gdk/gdkkeysyms.h>
 #include <gtk/gtk.h>
@@ -76,26 +77,178 @@ static const gchar *default_keymap_data = "# Please check gdk/gdkkeysyms.h for a
 					  "Meta_L = Super_L\n"
 					  "Meta_R = Super_R\n";
 
-static void remmina_pref_gen_secret(void)
+/* In memory copy of remmina.pref.
+ *
+ * The file is parsed once and kept in sync by a file monitor. Changes
+ * are applied to the copy right away and also remembered, per key, in
+ * remmina_pref_store_pending; a write-back coalesces all of them into a
+ * single save. The save re-reads the file and applies the pending keys
+ * on top, so changes made by other writers in the meantime are kept. */
+#define REMMINA_PREF_STORE_WRITE_DELAY 500
+
+static pthread_mutex_t remmina_pref_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+static GKeyFile *remmina_pref_store = NULL;
+static GHashTable *remmina_pref_store_pending = NULL;  /* "group\nkey" -> raw value */
+static guint remmina_pref_store_timeout = 0;
+static GFileMonitor *remmina_pref_store_monitor = NULL;
+
+/* Must be called with remmina_pref_store_mutex held */
+static GKeyFile *remmina_pref_store_get(void)
+{
+	TRACE_CALL(__func__);
+
+	if (!remmina_pref_store) {
+		remmina_pref_store = g_key_file_new();
+		g_key_file_load_from_file(remmina_pref_store, remmina_pref_file, G_KEY_FILE_NONE, NULL);
+	}
+	return remmina_pref_store;
+}
+
+static void remmina_pref_store_apply_pending(GKeyFile *gkeyfile)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	gchar **group_key;
+
+	g_hash_table_iter_init(&iter, remmina_pref_store_pending);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		group_key = g_strsplit((const gchar *)key, "\n", 2);
+		/* No value: the key has been removed */
+		if (value)
+			g_key_file_set_value(gkeyfile, group_key[0], group_key[1], (const gchar *)value);
+		else
+			g_key_file_remove_key(gkeyfile, group_key[0], group_key[1], NULL);
+		g_strfreev(group_key);
+	}
+}
+
+/* Writes the pending keys, returns FALSE when remmina.pref could not be saved */
+static gboolean remmina_pref_store_write(GError **error)
 {
 	TRACE_CALL(__func__);
-	guchar s[32];
-	gint i;
 	GKeyFile *gkeyfile;
 	g_autofree gchar *content = NULL;
 	gsize length;
+	gboolean ret = TRUE;
+
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	if (remmina_pref_store_pending && g_hash_table_size(remmina_pref_store_pending) > 0) {
+		gkeyfile = g_key_file_new();
+		g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
+		remmina_pref_store_apply_pending(gkeyfile);
+		content = g_key_file_to_data(gkeyfile, &length, NULL);
+		ret = g_file_set_contents(remmina_pref_file, content, length, error);
+		if (ret) {
+			g_hash_table_remove_all(remmina_pref_store_pending);
+			if (remmina_pref_store)
+				g_key_file_free(remmina_pref_store);
+			remmina_pref_store = gkeyfile;
+		} else {
+			g_key_file_free(gkeyfile);
+		}
+	}
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
+	return ret;
+}
+
+static gboolean remmina_pref_store_write_cb(gpointer data)
+{
+	TRACE_CALL(__func__);
+	GError *error = NULL;
+
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	remmina_pref_store_timeout = 0;
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
+
+	if (!remmina_pref_store_write(&error)) {
+		REMMINA_WARNING("Cannot save Remmina preferences: %s", error->message);
+		g_error_free(error);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* Remember the current value of group/key, or its removal, to be written back.
+ * Must be called with remmina_pref_store_mutex held. */
+static void remmina_pref_store_mark(const gchar *group, const gchar *key)
+{
+	TRACE_CALL(__func__);
+
+	if (!remmina_pref_store_pending)
+		remmina_pref_store_pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_replace(remmina_pref_store_pending, g_strconcat(group, "\n", key, NULL),
+			     g_key_file_get_value(remmina_pref_store, group, key, NULL));
+	if (remmina_pref_store_timeout == 0)
+		remmina_pref_store_timeout = g_timeout_add(REMMINA_PREF_STORE_WRITE_DELAY, remmina_pref_store_write_cb, NULL);
+}
+
+static void remmina_pref_store_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, gpointer data)
+{
+	TRACE_CALL(__func__);
+
+	if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+	    event_type != G_FILE_MONITOR_EVENT_CREATED &&
+	    event_type != G_FILE_MONITOR_EVENT_DELETED)
+		return;
+
+	/* Keys not written back yet stay on top of what is on disk */
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	if (remmina_pref_store) {
+		g_key_file_free(remmina_pref_store);
+		remmina_pref_store = NULL;
+		if (remmina_pref_store_pending)
+			remmina_pref_store_apply_pending(remmina_pref_store_get());
+	}
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
+}
+
+static void remmina_pref_store_monitor_init(void)
+{
+	TRACE_CALL(__func__);
+	GFile *file;
+
+	if (remmina_pref_store_monitor)
+		return;
+
+	file = g_file_new_for_path(remmina_pref_file);
+	remmina_pref_store_monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(file);
+	if (remmina_pref_store_monitor)
+		g_signal_connect(remmina_pref_store_monitor, "changed", G_CALLBACK(remmina_pref_store_changed), NULL);
+}
+
+/* Write back now whatever is still pending, to be called before exiting */
+void remmina_pref_sync(void)
+{
+	TRACE_CALL(__func__);
+	GError *error = NULL;
+
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	if (remmina_pref_store_timeout) {
+		g_source_remove(remmina_pref_store_timeout);
+		remmina_pref_store_timeout = 0;
+	}
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
+
+	if (!remmina_pref_store_write(&error)) {
+		REMMINA_WARNING("Cannot save Remmina preferences: %s", error->message);
+		g_error_free(error);
+	}
+}
+
+static void remmina_pref_gen_secret(void)
+{
+	TRACE_CALL(__func__);
+	guchar s[32];
+	gint i;
 
 	for (i = 0; i < 32; i++)
 		s[i] = (guchar)(randombytes_uniform(257));
 	remmina_pref.secret = g_base64_encode(s, 32);
 
-	gkeyfile = g_key_file_new();
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
-	g_key_file_set_string(gkeyfile, "remmina_pref", "secret", remmina_pref.secret);
-	content = g_key_file_to_data(gkeyfile, &length, NULL);
-	g_file_set_contents(remmina_pref_file, content, length, NULL);
-
-	g_key_file_free(gkeyfile);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	g_key_file_set_string(remmina_pref_store_get(), "remmina_pref", "secret", remmina_pref.secret);
+	remmina_pref_store_mark("remmina_pref", "secret");
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 }
 
 static guint remmina_pref_get_keyval_from_str(const gchar *str)
@@ -296,6 +449,8 @@ void remmina_pref_init(void)
 
 	g_free(remmina_dir);
 
+	remmina_pref_store_monitor_init();
+
 	gkeyfile = g_key_file_new();
 
 	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
@@ -313,6 +468,13 @@ void remmina_pref_init(void)
 	if (extrahardening)
 		remmina_pref.confirm_close = FALSE;
 
+	/* Maximum number of connections handshaking at the same time when
+	 * opening many profiles at once, 0 means no limit */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "launch_concurrency", NULL))
+		remmina_pref.launch_concurrency = g_key_file_get_integer(gkeyfile, "remmina_pref", "launch_concurrency", NULL);
+	else
+		remmina_pref.launch_concurrency = DEFAULT_LAUNCH_CONCURRENCY;
+
 	if (g_key_file_has_key(gkeyfile, "remmina_pref", "use_master_password", NULL)) {
 		remmina_pref.use_primary_password = g_key_file_get_boolean(gkeyfile, "remmina_pref", "use_master_password", NULL);
 	} else if (g_key_file_has_key(gkeyfile, "remmina_pref", "use_primary_password", NULL))
@@ -555,11 +717,39 @@ void remmina_pref_init(void)
 	else
 		remmina_pref.screenshot_name = g_strdup("remmina_%p_%h_%Y%m%d-%H%M%S");
 
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "screenshot_format", NULL))
+		remmina_pref.screenshot_format = g_key_file_get_string(gkeyfile, "remmina_pref", "screenshot_format", NULL);
+	else
+		remmina_pref.screenshot_format = g_strdup("png");
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "screenshot_interval", NULL))
+		remmina_pref.screenshot_interval = g_key_file_get_integer(gkeyfile, "remmina_pref", "screenshot_interval", NULL);
+	else
+		remmina_pref.screenshot_interval = 0;
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "recording_path", NULL)) {
+		remmina_pref.recording_path = g_key_file_get_string(gkeyfile, "remmina_pref", "recording_path", NULL);
+	} else {
+		remmina_pref.recording_path = g_get_user_special_dir(G_USER_DIRECTORY_VIDEOS);
+		if (remmina_pref.recording_path == NULL)
+			remmina_pref.recording_path = g_get_home_dir();
+	}
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "recording_fps", NULL))
+		remmina_pref.recording_fps = CLAMP(g_key_file_get_integer(gkeyfile, "remmina_pref", "recording_fps", NULL), 1, 30);
+	else
+		remmina_pref.recording_fps = 10;
+
 	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_parseconfig", NULL))
 		remmina_pref.ssh_parseconfig = g_key_file_get_boolean(gkeyfile, "remmina_pref", "ssh_parseconfig", NULL);
 	else
 		remmina_pref.ssh_parseconfig = DEFAULT_SSH_PARSECONFIG;
 
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_tunnel_sharing", NULL))
+		remmina_pref.ssh_tunnel_sharing = g_key_file_get_boolean(gkeyfile, "remmina_pref", "ssh_tunnel_sharing", NULL);
+	else
+		remmina_pref.ssh_tunnel_sharing = DEFAULT_SSH_TUNNEL_SHARING;
+
 	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sshtunnel_port", NULL))
 		remmina_pref.sshtunnel_port = g_key_file_get_integer(gkeyfile, "remmina_pref", "sshtunnel_port", NULL);
 	else
@@ -920,157 +1110,285 @@ gboolean remmina_pref_save(void)
 	}
 	GKeyFile *gkeyfile;
 	GError *error = NULL;
-	g_autofree gchar *content = NULL;
-	gsize length;
-
-	gkeyfile = g_key_file_new();
 
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	gkeyfile = remmina_pref_store_get();
 
 	g_key_file_set_string(gkeyfile, "remmina_pref", "datadir_path", remmina_pref.datadir_path);
+	remmina_pref_store_mark("remmina_pref", "datadir_path");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "remmina_file_name", remmina_pref.remmina_file_name);
+	remmina_pref_store_mark("remmina_pref", "remmina_file_name");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "screenshot_path", remmina_pref.screenshot_path);
+	remmina_pref_store_mark("remmina_pref", "screenshot_path");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "screenshot_name", remmina_pref.screenshot_name);
+	remmina_pref_store_mark("remmina_pref", "screenshot_name");
+	g_key_file_set_string(gkeyfile, "remmina_pref", "screenshot_format", remmina_pref.screenshot_format);
+	remmina_pref_store_mark("remmina_pref", "screenshot_format");
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "screenshot_interval", remmina_pref.screenshot_interval);
+	remmina_pref_store_mark("remmina_pref", "screenshot_interval");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "deny_screenshot_clipboard", remmina_pref.deny_screenshot_clipboard);
+	remmina_pref_store_mark("remmina_pref", "deny_screenshot_clipboard");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "save_view_mode", remmina_pref.save_view_mode);
+	remmina_pref_store_mark("remmina_pref", "save_view_mode");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "confirm_close", remmina_pref.confirm_close);
-	if (g_key_file_remove_key(gkeyfile, "remmina_pref", "use_master_password", NULL))
+	remmina_pref_store_mark("remmina_pref", "confirm_close");
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "launch_concurrency", remmina_pref.launch_concurrency);
+	remmina_pref_store_mark("remmina_pref", "launch_concurrency");
+	if (g_key_file_remove_key(gkeyfile, "remmina_pref", "use_master_password", NULL)) {
 		REMMINA_DEBUG("use_master_password removed…");
-	else
+		remmina_pref_store_mark("remmina_pref", "use_master_password");
+	} else {
 		REMMINA_INFO("use_master_password already migrated");
+	}
 #if SODIUM_VERSION_INT >= 90200
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "use_primary_password", remmina_pref.use_primary_password);
+	remmina_pref_store_mark("remmina_pref", "use_primary_password");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "unlock_timeout", remmina_pref.unlock_timeout);
+	remmina_pref_store_mark("remmina_pref", "unlock_timeout");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "unlock_password", remmina_pref.unlock_password);
+	remmina_pref_store_mark("remmina_pref", "unlock_password");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_connect", remmina_pref.lock_connect);
+	remmina_pref_store_mark("remmina_pref", "lock_connect");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_edit", remmina_pref.lock_edit);
+	remmina_pref_store_mark("remmina_pref", "lock_edit");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_view_passwords", remmina_pref.lock_view_passwords);
+	remmina_pref_store_mark("remmina_pref", "lock_view_passwords");
 #else
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "use_primary_password", FALSE);
+	remmina_pref_store_mark("remmina_pref", "use_primary_password");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "unlock_timeout", 0);
+	remmina_pref_store_mark("remmina_pref", "unlock_timeout");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "unlock_password", g_strdup(""));
+	remmina_pref_store_mark("remmina_pref", "unlock_password");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_connect", FALSE);
+	remmina_pref_store_mark("remmina_pref", "lock_connect");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_edit", FALSE);
+	remmina_pref_store_mark("remmina_pref", "lock_edit");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "lock_view_passwords", FALSE);
+	remmina_pref_store_mark("remmina_pref", "lock_view_passwords");
 #endif
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "enc_mode", remmina_pref.enc_mode);
+	remmina_pref_store_mark("remmina_pref", "enc_mode");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "audit", remmina_pref.audit);
+	remmina_pref_store_mark("remmina_pref", "audit");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "trust_all", remmina_pref.trust_all);
+	remmina_pref_store_mark("remmina_pref", "trust_all");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "floating_toolbar_placement", remmina_pref.floating_toolbar_placement);
+	remmina_pref_store_mark("remmina_pref", "floating_toolbar_placement");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "floating_toolbar_monitor", remmina_pref.floating_toolbar_monitor);
+	remmina_pref_store_mark("remmina_pref", "floating_toolbar_monitor");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "toolbar_placement", remmina_pref.toolbar_placement);
+	remmina_pref_store_mark("remmina_pref", "toolbar_placement");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "prevent_snap_welcome_message", remmina_pref.prevent_snap_welcome_message);
+	remmina_pref_store_mark("remmina_pref", "prevent_snap_welcome_message");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "last_quickconnect_protocol", remmina_pref.last_quickconnect_protocol);
+	remmina_pref_store_mark("remmina_pref", "last_quickconnect_protocol");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "fullscreen_on_auto", remmina_pref.fullscreen_on_auto);
+	remmina_pref_store_mark("remmina_pref", "fullscreen_on_auto");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "always_show_tab", remmina_pref.always_show_tab);
+	remmina_pref_store_mark("remmina_pref", "always_show_tab");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "always_show_notes", remmina_pref.always_show_notes);
+	remmina_pref_store_mark("remmina_pref", "always_show_notes");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "mp_left", remmina_pref.mp_left);
+	remmina_pref_store_mark("remmina_pref", "mp_left");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "start_fullscreen", remmina_pref.start_fullscreen);
+	remmina_pref_store_mark("remmina_pref", "start_fullscreen");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "start_dynres", remmina_pref.start_dynres);
+	remmina_pref_store_mark("remmina_pref", "start_dynres");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "toolbar_fix_position_multimon", remmina_pref.toolbar_fix_position_multimon);
+	remmina_pref_store_mark("remmina_pref", "toolbar_fix_position_multimon");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "hide_connection_toolbar", remmina_pref.hide_connection_toolbar);
+	remmina_pref_store_mark("remmina_pref", "hide_connection_toolbar");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "hide_searchbar", remmina_pref.hide_searchbar);
+	remmina_pref_store_mark("remmina_pref", "hide_searchbar");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "default_action", remmina_pref.default_action);
+	remmina_pref_store_mark("remmina_pref", "default_action");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "scale_quality", remmina_pref.scale_quality);
+	remmina_pref_store_mark("remmina_pref", "scale_quality");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_loglevel", remmina_pref.ssh_loglevel);
+	remmina_pref_store_mark("remmina_pref", "ssh_loglevel");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "ssh_parseconfig", remmina_pref.ssh_parseconfig);
+	remmina_pref_store_mark("remmina_pref", "ssh_parseconfig");
+	g_key_file_set_boolean(gkeyfile, "remmina_pref", "ssh_tunnel_sharing", remmina_pref.ssh_tunnel_sharing);
+	remmina_pref_store_mark("remmina_pref", "ssh_tunnel_sharing");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "hide_toolbar", remmina_pref.hide_toolbar);
+	remmina_pref_store_mark("remmina_pref", "hide_toolbar");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "small_toolbutton", remmina_pref.small_toolbutton);
+	remmina_pref_store_mark("remmina_pref", "small_toolbutton");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "view_file_mode", remmina_pref.view_file_mode);
+	remmina_pref_store_mark("remmina_pref", "view_file_mode");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "resolutions", remmina_pref.resolutions);
+	remmina_pref_store_mark("remmina_pref", "resolutions");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "keystrokes", remmina_pref.keystrokes);
+	remmina_pref_store_mark("remmina_pref", "keystrokes");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "main_width", remmina_pref.main_width);
+	remmina_pref_store_mark("remmina_pref", "main_width");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "main_height", remmina_pref.main_height);
+	remmina_pref_store_mark("remmina_pref", "main_height");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "main_maximize", remmina_pref.main_maximize);
+	remmina_pref_store_mark("remmina_pref", "main_maximize");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "main_sort_column_id", remmina_pref.main_sort_column_id);
+	remmina_pref_store_mark("remmina_pref", "main_sort_column_id");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "main_sort_order", remmina_pref.main_sort_order);
+	remmina_pref_store_mark("remmina_pref", "main_sort_order");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "expanded_group", remmina_pref.expanded_group);
+	remmina_pref_store_mark("remmina_pref", "expanded_group");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "toolbar_pin_down", remmina_pref.toolbar_pin_down);
+	remmina_pref_store_mark("remmina_pref", "toolbar_pin_down");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "sshtunnel_port", remmina_pref.sshtunnel_port);
+	remmina_pref_store_mark("remmina_pref", "sshtunnel_port");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_keepidle", remmina_pref.ssh_tcp_keepidle);
+	remmina_pref_store_mark("remmina_pref", "ssh_tcp_keepidle");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_keepintvl", remmina_pref.ssh_tcp_keepintvl);
+	remmina_pref_store_mark("remmina_pref", "ssh_tcp_keepintvl");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_keepcnt", remmina_pref.ssh_tcp_keepcnt);
+	remmina_pref_store_mark("remmina_pref", "ssh_tcp_keepcnt");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_usrtimeout", remmina_pref.ssh_tcp_usrtimeout);
+	remmina_pref_store_mark("remmina_pref", "ssh_tcp_usrtimeout");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_new_ontop", remmina_pref.applet_new_ontop);
+	remmina_pref_store_mark("remmina_pref", "applet_new_ontop");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_hide_count", remmina_pref.applet_hide_count);
+	remmina_pref_store_mark("remmina_pref", "applet_hide_count");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_enable_avahi", remmina_pref.applet_enable_avahi);
+	remmina_pref_store_mark("remmina_pref", "applet_enable_avahi");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "disable_tray_icon", remmina_pref.disable_tray_icon);
+	remmina_pref_store_mark("remmina_pref", "disable_tray_icon");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "dark_theme", remmina_pref.dark_theme);
+	remmina_pref_store_mark("remmina_pref", "dark_theme");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "recent_maximum", remmina_pref.recent_maximum);
+	remmina_pref_store_mark("remmina_pref", "recent_maximum");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "default_mode", remmina_pref.default_mode);
+	remmina_pref_store_mark("remmina_pref", "default_mode");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "tab_mode", remmina_pref.tab_mode);
+	remmina_pref_store_mark("remmina_pref", "tab_mode");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "fullscreen_toolbar_visibility", remmina_pref.fullscreen_toolbar_visibility);
+	remmina_pref_store_mark("remmina_pref", "fullscreen_toolbar_visibility");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "fullscreen_toolbar_delay", remmina_pref.fullscreen_toolbar_delay);
+	remmina_pref_store_mark("remmina_pref", "fullscreen_toolbar_delay");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "auto_scroll_step", remmina_pref.auto_scroll_step);
+	remmina_pref_store_mark("remmina_pref", "auto_scroll_step");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "hostkey", remmina_pref.hostkey);
+	remmina_pref_store_mark("remmina_pref", "hostkey");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_fullscreen", remmina_pref.shortcutkey_fullscreen);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_fullscreen");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_autofit", remmina_pref.shortcutkey_autofit);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_autofit");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_nexttab", remmina_pref.shortcutkey_nexttab);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_nexttab");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_prevtab", remmina_pref.shortcutkey_prevtab);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_prevtab");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_scale", remmina_pref.shortcutkey_scale);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_scale");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_clipboard", remmina_pref.shortcutkey_clipboard);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_clipboard");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_grab", remmina_pref.shortcutkey_grab);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_grab");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_multimon", remmina_pref.shortcutkey_multimon);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_multimon");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_viewonly", remmina_pref.shortcutkey_viewonly);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_viewonly");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_screenshot", remmina_pref.shortcutkey_screenshot);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_screenshot");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_minimize", remmina_pref.shortcutkey_minimize);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_minimize");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_disconnect", remmina_pref.shortcutkey_disconnect);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_disconnect");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "shortcutkey_toolbar", remmina_pref.shortcutkey_toolbar);
+	remmina_pref_store_mark("remmina_pref", "shortcutkey_toolbar");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_copy", remmina_pref.vte_shortcutkey_copy);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_copy");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_paste", remmina_pref.vte_shortcutkey_paste);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_paste");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_select_all", remmina_pref.vte_shortcutkey_select_all);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_select_all");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_increase_font", remmina_pref.vte_shortcutkey_increase_font);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_increase_font");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_decrease_font", remmina_pref.vte_shortcutkey_decrease_font);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_decrease_font");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_shortcutkey_search_text", remmina_pref.vte_shortcutkey_search_text);
+	remmina_pref_store_mark("remmina_pref", "vte_shortcutkey_search_text");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "vte_font", remmina_pref.vte_font ? remmina_pref.vte_font : "");
+	remmina_pref_store_mark("remmina_pref", "vte_font");
 	g_key_file_set_string(gkeyfile, "remmina_pref", "grab_color", remmina_pref.grab_color ? remmina_pref.grab_color : "");
+	remmina_pref_store_mark("remmina_pref", "grab_color");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "grab_color_switch", remmina_pref.grab_color_switch);
+	remmina_pref_store_mark("remmina_pref", "grab_color_switch");
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "vte_allow_bold_text", remmina_pref.vte_allow_bold_text);
+	remmina_pref_store_mark("remmina_pref", "vte_allow_bold_text");
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "vte_lines", remmina_pref.vte_lines);
+	remmina_pref_store_mark("remmina_pref", "vte_lines");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "background", remmina_pref.color_pref.background ? remmina_pref.color_pref.background : "");
+	remmina_pref_store_mark("ssh_colors", "background");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "cursor", remmina_pref.color_pref.cursor ? remmina_pref.color_pref.cursor : "");
+	remmina_pref_store_mark("ssh_colors", "cursor");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "cursor_foreground", remmina_pref.color_pref.cursor_foreground ? remmina_pref.color_pref.cursor_foreground : "");
+	remmina_pref_store_mark("ssh_colors", "cursor_foreground");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "highlight", remmina_pref.color_pref.highlight ? remmina_pref.color_pref.highlight : "");
+	remmina_pref_store_mark("ssh_colors", "highlight");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "highlight_foreground", remmina_pref.color_pref.highlight_foreground ? remmina_pref.color_pref.highlight_foreground : "");
+	remmina_pref_store_mark("ssh_colors", "highlight_foreground");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "colorBD", remmina_pref.color_pref.colorBD ? remmina_pref.color_pref.colorBD : "");
+	remmina_pref_store_mark("ssh_colors", "colorBD");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "foreground", remmina_pref.color_pref.foreground ? remmina_pref.color_pref.foreground : "");
+	remmina_pref_store_mark("ssh_colors", "foreground");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color0", remmina_pref.color_pref.color0 ? remmina_pref.color_pref.color0 : "");
+	remmina_pref_store_mark("ssh_colors", "color0");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color1", remmina_pref.color_pref.color1 ? remmina_pref.color_pref.color1 : "");
+	remmina_pref_store_mark("ssh_colors", "color1");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color2", remmina_pref.color_pref.color2 ? remmina_pref.color_pref.color2 : "");
+	remmina_pref_store_mark("ssh_colors", "color2");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color3", remmina_pref.color_pref.color3 ? remmina_pref.color_pref.color3 : "");
+	remmina_pref_store_mark("ssh_colors", "color3");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color4", remmina_pref.color_pref.color4 ? remmina_pref.color_pref.color4 : "");
+	remmina_pref_store_mark("ssh_colors", "color4");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color5", remmina_pref.color_pref.color5 ? remmina_pref.color_pref.color5 : "");
+	remmina_pref_store_mark("ssh_colors", "color5");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color6", remmina_pref.color_pref.color6 ? remmina_pref.color_pref.color6 : "");
+	remmina_pref_store_mark("ssh_colors", "color6");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color7", remmina_pref.color_pref.color7 ? remmina_pref.color_pref.color7 : "");
+	remmina_pref_store_mark("ssh_colors", "color7");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color8", remmina_pref.color_pref.color8 ? remmina_pref.color_pref.color8 : "");
+	remmina_pref_store_mark("ssh_colors", "color8");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color9", remmina_pref.color_pref.color9 ? remmina_pref.color_pref.color9 : "");
+	remmina_pref_store_mark("ssh_colors", "color9");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color10", remmina_pref.color_pref.color10 ? remmina_pref.color_pref.color10 : "");
+	remmina_pref_store_mark("ssh_colors", "color10");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color11", remmina_pref.color_pref.color11 ? remmina_pref.color_pref.color11 : "");
+	remmina_pref_store_mark("ssh_colors", "color11");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color12", remmina_pref.color_pref.color12 ? remmina_pref.color_pref.color12 : "");
+	remmina_pref_store_mark("ssh_colors", "color12");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color13", remmina_pref.color_pref.color13 ? remmina_pref.color_pref.color13 : "");
+	remmina_pref_store_mark("ssh_colors", "color13");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color14", remmina_pref.color_pref.color14 ? remmina_pref.color_pref.color14 : "");
+	remmina_pref_store_mark("ssh_colors", "color14");
 	g_key_file_set_string(gkeyfile, "ssh_colors", "color15", remmina_pref.color_pref.color15 ? remmina_pref.color_pref.color15 : "");
+	remmina_pref_store_mark("ssh_colors", "color15");
 	g_key_file_set_string(gkeyfile, "remmina_info", "ssh_color_file", remmina_pref.color_file ? remmina_pref.color_file : "");
+	remmina_pref_store_mark("remmina_info", "ssh_color_file");
 	g_key_file_set_boolean(gkeyfile, "remmina_info", "periodic_news_permitted", !remmina_pref.disable_news);
+	remmina_pref_store_mark("remmina_info", "periodic_news_permitted");
 	g_key_file_set_string(gkeyfile, "remmina_info", "periodic_news_last_checksum", remmina_pref.periodic_news_last_checksum ? remmina_pref.periodic_news_last_checksum: "");
+	remmina_pref_store_mark("remmina_info", "periodic_news_last_checksum");
 	g_key_file_set_boolean(gkeyfile, "remmina_info", "periodic_usage_stats_permitted", !remmina_pref.disable_stats);
+	remmina_pref_store_mark("remmina_info", "periodic_usage_stats_permitted");
 	g_key_file_set_string(gkeyfile, "remmina_info", "info_uid_prefix", remmina_pref.info_uid_prefix ? remmina_pref.info_uid_prefix : "");
+	remmina_pref_store_mark("remmina_info", "info_uid_prefix");
 	g_key_file_set_boolean(gkeyfile, "remmina_info", "disable_tip", remmina_pref.disable_tip);
+	remmina_pref_store_mark("remmina_info", "disable_tip");
 
 	/* Default settings */
 	g_key_file_set_string(gkeyfile, "remmina", "name", "");
+	remmina_pref_store_mark("remmina", "name");
 	g_key_file_set_integer(gkeyfile, "remmina", "ignore-tls-errors", 1);
+	remmina_pref_store_mark("remmina", "ignore-tls-errors");
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 
-	content = g_key_file_to_data(gkeyfile, &length, NULL);
-	g_file_set_contents(remmina_pref_file, content, length, &error);
-
-	if (error != NULL) {
+	/* An explicit save is written right away, with everything else pending */
+	if (!remmina_pref_store_write(&error)) {
 		g_warning("remmina_pref_save error: %s", error->message);
 		g_clear_error(&error);
-		g_key_file_free(gkeyfile);
 		return FALSE;
 	}
-	g_key_file_free(gkeyfile);
 	return TRUE;
 }
 
@@ -1081,16 +1399,12 @@ void remmina_pref_add_recent(const gchar *protocol, const gchar *server)
 	GKeyFile *gkeyfile;
 	gchar key[20];
 	g_autofree gchar *val = NULL;
-	g_autofree gchar *content = NULL;
-	gsize length;
 
 	if (remmina_pref.recent_maximum <= 0 || server == NULL || server[0] == 0)
 		return;
 
-	/* Load original value into memory */
-	gkeyfile = g_key_file_new();
-
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	gkeyfile = remmina_pref_store_get();
 
 	g_snprintf(key, sizeof(key), "recent_%s", protocol);
 	array = remmina_string_array_new_from_allocated_string(g_key_file_get_string(gkeyfile, "remmina_pref", key, NULL));
@@ -1103,30 +1417,23 @@ void remmina_pref_add_recent(const gchar *protocol, const gchar *server)
 
 	/* Save */
 	val = remmina_string_array_to_string(array);
+	remmina_string_array_free(array);
 	g_key_file_set_string(gkeyfile, "remmina_pref", key, val);
-
-	content = g_key_file_to_data(gkeyfile, &length, NULL);
-	g_file_set_contents(remmina_pref_file, content, length, NULL);
-
-	g_key_file_free(gkeyfile);
+	remmina_pref_store_mark("remmina_pref", key);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 }
 
 gchar *
 remmina_pref_get_recent(const gchar *protocol)
 {
 	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
 	gchar key[20];
 	gchar *val = NULL;
 
-	gkeyfile = g_key_file_new();
-
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
-
 	g_snprintf(key, sizeof(key), "recent_%s", protocol);
-	val = g_key_file_get_string(gkeyfile, "remmina_pref", key, NULL);
-
-	g_key_file_free(gkeyfile);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	val = g_key_file_get_string(remmina_pref_store_get(), "remmina_pref", key, NULL);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 
 	return val;
 }
@@ -1137,24 +1444,19 @@ void remmina_pref_clear_recent(void)
 	GKeyFile *gkeyfile;
 	gchar **keys;
 	gint i;
-	g_autofree gchar *content = NULL;
-	gsize length;
-
-	gkeyfile = g_key_file_new();
 
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	gkeyfile = remmina_pref_store_get();
 	keys = g_key_file_get_keys(gkeyfile, "remmina_pref", NULL, NULL);
 	if (keys) {
 		for (i = 0; keys[i]; i++)
-			if (strncmp(keys[i], "recent_", 7) == 0)
+			if (strncmp(keys[i], "recent_", 7) == 0) {
 				g_key_file_set_string(gkeyfile, "remmina_pref", keys[i], "");
+				remmina_pref_store_mark("remmina_pref", keys[i]);
+			}
 		g_strfreev(keys);
 	}
-
-	content = g_key_file_to_data(gkeyfile, &length, NULL);
-	g_file_set_contents(remmina_pref_file, content, length, NULL);
-
-	g_key_file_free(gkeyfile);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 }
 
 guint *remmina_pref_keymap_get_table(const gchar *keymap)
@@ -1230,6 +1532,12 @@ gboolean remmina_pref_get_ssh_parseconfig(void)
 	return remmina_pref.ssh_parseconfig;
 }
 
+gboolean remmina_pref_get_ssh_tunnel_sharing(void)
+{
+	TRACE_CALL(__func__);
+	return remmina_pref.ssh_tunnel_sharing;
+}
+
 gint remmina_pref_get_sshtunnel_port(void)
 {
 	TRACE_CALL(__func__);
@@ -1263,35 +1571,21 @@ gint remmina_pref_get_ssh_tcp_usrtimeout(void)
 void remmina_pref_set_value(const gchar *key, const gchar *value)
 {
 	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
-	gsize length;
 
-	gkeyfile = g_key_file_new();
-	if (g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL)) {
-		g_key_file_set_string(gkeyfile, "remmina_pref", key, value);
-		gchar *content = g_key_file_to_data(gkeyfile, &length, NULL);
-		if (g_file_set_contents(remmina_pref_file, content, length, NULL)) {
-			g_free(content);
-		} else {
-			REMMINA_WARNING("Cannot save Remmina preferences");
-			REMMINA_WARNING("Key was \"%s\", and value \"%s\"", key, value);
-		}
-		g_key_file_free(gkeyfile);
-	} else {
-		REMMINA_WARNING("Cannot load Remmina preferences file");
-	}
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	g_key_file_set_string(remmina_pref_store_get(), "remmina_pref", key, value);
+	remmina_pref_store_mark("remmina_pref", key);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 }
 
 gchar *remmina_pref_get_value(const gchar *key)
 {
 	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
 	gchar *value = NULL;
 
-	gkeyfile = g_key_file_new();
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
-	value = g_key_file_get_string(gkeyfile, "remmina_pref", key, NULL);
-	g_key_file_free(gkeyfile);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	value = g_key_file_get_string(remmina_pref_store_get(), "remmina_pref", key, NULL);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 
 	return value;
 }
@@ -1299,13 +1593,11 @@ gchar *remmina_pref_get_value(const gchar *key)
 gboolean remmina_pref_get_boolean(const gchar *key)
 {
 	TRACE_CALL(__func__);
-	GKeyFile *gkeyfile;
 	gboolean value;
 
-	gkeyfile = g_key_file_new();
-	g_key_file_load_from_file(gkeyfile, remmina_pref_file, G_KEY_FILE_NONE, NULL);
-	value = g_key_file_get_boolean(gkeyfile, "remmina_pref", key, NULL);
-	g_key_file_free(gkeyfile);
+	pthread_mutex_lock(&remmina_pref_store_mutex);
+	value = g_key_file_get_boolean(remmina_pref_store_get(), "remmina_pref", key, NULL);
+	pthread_mutex_unlock(&remmina_pref_store_mutex);
 
 	return value;
 }
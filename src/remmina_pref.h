@@ -143,6 +143,13 @@ typedef struct _RemminaPref {
 	const gchar *		screenshot_path;
 	gboolean		deny_screenshot_clipboard;
 	const gchar *		screenshot_name;
+	/* png, jpeg or webp */
+	const gchar *		screenshot_format;
+	/* Seconds between automatic screenshots of every connected session, 0 to disable */
+	gint			screenshot_interval;
+	/* Where sessions with "record_session" set are recorded, and at how many frames per second */
+	const gchar *		recording_path;
+	gint			recording_fps;
 	gboolean		save_view_mode;
 	gint			default_action;
 	gint			scale_quality;
@@ -151,6 +158,7 @@ typedef struct _RemminaPref {
 	gchar *			resolutions;
 	gchar *			keystrokes;
 	gboolean		confirm_close;
+	gint			launch_concurrency;
 	/* In RemminaPrefDialog appearance tab */
 	gboolean		dark_theme;
 	gboolean		list_refresh_workaround;
@@ -176,6 +184,7 @@ typedef struct _RemminaPref {
 	/* In RemminaPrefDialog SSH Option tab */
 	gint			ssh_loglevel;
 	gboolean		ssh_parseconfig;
+	gboolean		ssh_tunnel_sharing;
 	gint			sshtunnel_port;
 	gint			ssh_tcp_keepidle;
 	gint			ssh_tcp_keepintvl;
@@ -260,7 +269,9 @@ typedef struct _RemminaPref {
 
 } RemminaPref;
 
+#define DEFAULT_LAUNCH_CONCURRENCY 8
 #define DEFAULT_SSH_PARSECONFIG TRUE
+#define DEFAULT_SSH_TUNNEL_SHARING TRUE
 #define DEFAULT_SSHTUNNEL_PORT 4732
 #define DEFAULT_SSH_PORT 22
 #define DEFAULT_SSH_LOGLEVEL 1
@@ -281,6 +292,7 @@ extern gboolean disabletrayicon;
 void remmina_pref_init(void);
 gboolean remmina_pref_is_rw(void);
 gboolean remmina_pref_save(void);
+void remmina_pref_sync(void);
 
 void remmina_pref_add_recent(const gchar *protocol, const gchar *server);
 gchar *remmina_pref_get_recent(const gchar *protocol);
@@ -293,6 +305,7 @@ gchar **remmina_pref_keymap_groups(void);
 gint remmina_pref_get_scale_quality(void);
 gint remmina_pref_get_ssh_loglevel(void);
 gboolean remmina_pref_get_ssh_parseconfig(void);
+gboolean remmina_pref_get_ssh_tunnel_sharing(void);
 gint remmina_pref_get_sshtunnel_port(void);
 void remmina_pref_file_load_colors(GKeyFile *gkeyfile, RemminaColorPref *color_pref);
 gint remmina_pref_get_ssh_tcp_keepidle(void);
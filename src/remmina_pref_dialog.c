@@ -196,6 +196,13 @@ void remmina_pref_on_dialog_destroy(GtkWidget *widget, gpointer user_data)
 	}
 	remmina_pref.screenshot_path = gtk_file_chooser_get_filename(remmina_pref_dialog->filechooserbutton_options_screenshots_path);
 	remmina_pref.screenshot_name = gtk_entry_get_text(remmina_pref_dialog->entry_options_screenshot_name);
+	if (gtk_combo_box_get_active_id(remmina_pref_dialog->comboboxtext_options_screenshot_format) != NULL) {
+		g_free((gchar *)remmina_pref.screenshot_format);
+		remmina_pref.screenshot_format = g_strdup(gtk_combo_box_get_active_id(remmina_pref_dialog->comboboxtext_options_screenshot_format));
+	}
+	remmina_pref.screenshot_interval = atoi(gtk_entry_get_text(remmina_pref_dialog->entry_options_screenshot_interval));
+	if (remmina_pref.screenshot_interval < 0)
+		remmina_pref.screenshot_interval = 0;
 	remmina_pref.deny_screenshot_clipboard = gtk_switch_get_active(GTK_SWITCH(remmina_pref_dialog->switch_options_deny_screenshot_clipboard));
 	remmina_pref.save_view_mode = gtk_switch_get_active(GTK_SWITCH(remmina_pref_dialog->switch_options_remember_last_view_mode));
 	remmina_pref.confirm_close = gtk_switch_get_active(GTK_SWITCH(remmina_pref_dialog->switch_options_confirm_close));
@@ -244,6 +251,7 @@ void remmina_pref_on_dialog_destroy(GtkWidget *widget, gpointer user_data)
 	if (remmina_pref.ssh_tcp_usrtimeout <= 0)
 		remmina_pref.ssh_tcp_usrtimeout = SSH_SOCKET_TCP_USER_TIMEOUT;
 	remmina_pref.ssh_parseconfig = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(remmina_pref_dialog->checkbutton_options_ssh_parseconfig));
+	remmina_pref.ssh_tunnel_sharing = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(remmina_pref_dialog->checkbutton_options_ssh_tunnel_sharing));
 #if SODIUM_VERSION_INT >= 90200
 	remmina_pref.unlock_timeout = atoi(gtk_entry_get_text(remmina_pref_dialog->unlock_timeout));
 	if (remmina_pref.unlock_timeout < 0)
@@ -683,6 +691,11 @@ static void remmina_pref_dialog_init(gboolean load_plugins)
 		gtk_entry_set_text(remmina_pref_dialog->entry_options_screenshot_name, remmina_pref.screenshot_name);
 	else
 		gtk_entry_set_text(remmina_pref_dialog->entry_options_screenshot_name, "remmina_%p_%h_%Y%m%d-%H%M%S");
+	if (remmina_pref.screenshot_format == NULL ||
+	    !gtk_combo_box_set_active_id(remmina_pref_dialog->comboboxtext_options_screenshot_format, remmina_pref.screenshot_format))
+		gtk_combo_box_set_active_id(remmina_pref_dialog->comboboxtext_options_screenshot_format, "png");
+	g_snprintf(buf, sizeof(buf), "%i", remmina_pref.screenshot_interval);
+	gtk_entry_set_text(remmina_pref_dialog->entry_options_screenshot_interval, buf);
 
 	gtk_switch_set_active(remmina_pref_dialog->switch_appearance_grab_color, remmina_pref.grab_color_switch);
 	if (remmina_pref.grab_color != NULL)
@@ -691,6 +704,7 @@ static void remmina_pref_dialog_init(gboolean load_plugins)
 		gtk_entry_set_text(remmina_pref_dialog->entry_options_file_name, "#00FF00");
 
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(remmina_pref_dialog->checkbutton_options_ssh_parseconfig), remmina_pref.ssh_parseconfig);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(remmina_pref_dialog->checkbutton_options_ssh_tunnel_sharing), remmina_pref.ssh_tunnel_sharing);
 
 	remmina_pref_dialog_set_button_label(remmina_pref_dialog->button_keyboard_copy, remmina_pref.vte_shortcutkey_copy);
 	remmina_pref_dialog_set_button_label(remmina_pref_dialog->button_keyboard_paste, remmina_pref.vte_shortcutkey_paste);
@@ -795,6 +809,8 @@ GtkWidget *remmina_pref_dialog_new(gint default_tab, GtkWindow *parent)
 	remmina_pref_dialog->entry_options_file_name = GTK_ENTRY(GET_OBJECT("entry_options_file_name"));
 	remmina_pref_dialog->filechooserbutton_options_screenshots_path = GTK_FILE_CHOOSER(GET_OBJECT("filechooserbutton_options_screenshots_path"));
 	remmina_pref_dialog->entry_options_screenshot_name = GTK_ENTRY(GET_OBJECT("entry_options_screenshot_name"));
+	remmina_pref_dialog->comboboxtext_options_screenshot_format = GTK_COMBO_BOX(GET_OBJECT("comboboxtext_options_screenshot_format"));
+	remmina_pref_dialog->entry_options_screenshot_interval = GTK_ENTRY(GET_OBJECT("entry_options_screenshot_interval"));
 	remmina_pref_dialog->switch_options_deny_screenshot_clipboard = GTK_SWITCH(GET_OBJECT("switch_options_deny_screenshot_clipboard"));
 	remmina_pref_dialog->switch_options_remember_last_view_mode = GTK_SWITCH(GET_OBJECT("switch_options_remember_last_view_mode"));
 	remmina_pref_dialog->switch_options_confirm_close = GTK_SWITCH(GET_OBJECT("switch_options_confirm_close"));
@@ -832,6 +848,7 @@ GtkWidget *remmina_pref_dialog_new(gint default_tab, GtkWindow *parent)
 	remmina_pref_dialog->entry_fullscreen_toolbar_delay = GTK_ENTRY(GET_OBJECT("entry_fullscreen_toolbar_delay"));
 	remmina_pref_dialog->comboboxtext_options_scale_quality = GTK_COMBO_BOX(GET_OBJECT("comboboxtext_options_scale_quality"));
 	remmina_pref_dialog->checkbutton_options_ssh_parseconfig = GTK_CHECK_BUTTON(GET_OBJECT("checkbutton_options_ssh_parseconfig"));
+	remmina_pref_dialog->checkbutton_options_ssh_tunnel_sharing = GTK_CHECK_BUTTON(GET_OBJECT("checkbutton_options_ssh_tunnel_sharing"));
 	remmina_pref_dialog->comboboxtext_options_ssh_loglevel = GTK_COMBO_BOX(GET_OBJECT("comboboxtext_options_ssh_loglevel"));
 	remmina_pref_dialog->entry_options_ssh_port = GTK_ENTRY(GET_OBJECT("entry_options_ssh_port"));
 	remmina_pref_dialog->entry_options_ssh_tcp_keepidle = GTK_ENTRY(GET_OBJECT("entry_options_ssh_tcp_keepidle"));
@@ -55,6 +55,8 @@ typedef struct _RemminaPrefDialog {
 	GtkEntry *		entry_options_file_name;
 	GtkFileChooser *	filechooserbutton_options_screenshots_path;
 	GtkEntry *		entry_options_screenshot_name;
+	GtkComboBox *		comboboxtext_options_screenshot_format;
+	GtkEntry *		entry_options_screenshot_interval;
 	GtkSwitch *		switch_appearance_grab_color;
 	GtkSwitch *		switch_options_deny_screenshot_clipboard;
 	GtkSwitch *		switch_options_remember_last_view_mode;
@@ -91,6 +93,7 @@ typedef struct _RemminaPrefDialog {
 	GtkEntry *			entry_fullscreen_toolbar_delay;
 	GtkComboBox *		comboboxtext_security_enc_method;
 	GtkCheckButton *	checkbutton_options_ssh_parseconfig;
+	GtkCheckButton *	checkbutton_options_ssh_tunnel_sharing;
 	GtkEntry *		entry_options_ssh_port;
 	GtkEntry *		entry_options_ssh_tcp_keepidle;
 	GtkEntry *		entry_options_ssh_tcp_keepintvl;
@@ -46,10 +46,12 @@
 #include "remmina_masterthread_exec.h"
 #include "remmina_ext_exec.h"
 #include "remmina_plugin_manager.h"
+#include "remmina_metrics.h"
 #include "remmina_pref.h"
 #include "remmina_protocol_widget.h"
 #include "remmina_public.h"
 #include "remmina_ssh.h"
+#include "remmina_video_recorder.h"
 #include "remmina_log.h"
 #include "remmina/remmina_trace_calls.h"
 
@@ -100,6 +102,22 @@ struct _RemminaProtocolWidgetPriv {
 	gchar *			cacrl;
 	gchar *			clientcert;
 	gchar *			clientkey;
+
+	RemminaMetrics *	metrics;
+
+	/* Whether the session is on screen: current tab of a mapped, not iconified window */
+	gboolean		visible;
+
+	/* Downscaled copy of the remote desktop, only kept while somebody asked for it */
+	gint			thumbnail_width;
+	gint			thumbnail_height;
+	cairo_surface_t *	thumbnail;
+	cairo_region_t *	thumbnail_damage;
+	gint			thumbnail_fb_width;
+	gint			thumbnail_fb_height;
+
+	RemminaVideoRecorder *	recorder;
+	gint			recording;      /* Atomic copy of recorder != NULL for the plugin threads */
 };
 
 enum panel_type {
@@ -206,6 +224,12 @@ static void remmina_protocol_widget_destroy(RemminaProtocolWidget *gp, gpointer
 	g_free(gp->priv->remmina_file);
 	gp->priv->remmina_file = NULL;
 
+	remmina_metrics_unref(gp->priv->metrics);
+	gp->priv->metrics = NULL;
+
+	remmina_protocol_widget_set_thumbnail_size(gp, 0, 0);
+	remmina_protocol_widget_stop_recording(gp);
+
 	g_free(gp->priv);
 	gp->priv = NULL;
 
@@ -239,7 +263,9 @@ static void remmina_protocol_widget_init(RemminaProtocolWidget *gp)
 	gp->priv = priv;
 	gp->priv->user_disconnect = FALSE;
 	gp->priv->closed = TRUE;
+	gp->priv->visible = TRUE;
 	gp->priv->ssh_tunnels = g_ptr_array_new();
+	gp->priv->metrics = remmina_metrics_new();
 
 	g_signal_connect(G_OBJECT(gp), "destroy", G_CALLBACK(remmina_protocol_widget_destroy), NULL);
 }
@@ -254,31 +280,46 @@ static void remmina_protocol_widget_open_connection_real(gpointer data)
 	RemminaProtocolPlugin *plugin;
 	RemminaProtocolFeature *feature;
 	gint num_plugin;
+	gint num_core;
 	gint num_ssh;
 
 	gp->priv->closed = FALSE;
 
 	plugin = gp->priv->plugin;
+	remmina_metrics_phase_begin(gp->priv->metrics, "plugin_init");
 	plugin->init(gp);
+	remmina_metrics_phase_end(gp->priv->metrics, "plugin_init");
 
 	for (num_plugin = 0, feature = (RemminaProtocolFeature *)plugin->features; feature && feature->type; num_plugin++, feature++) {
 	}
 
+	/* Connection metrics */
+	num_core = 1;
+
 	num_ssh = 0;
 #ifdef HAVE_LIBSSH
 	if (remmina_file_get_int(gp->priv->remmina_file, "ssh_tunnel_enabled", FALSE))
 		num_ssh += 2;
 
 #endif
-	if (num_plugin + num_ssh == 0) {
+	if (num_plugin + num_core + num_ssh == 0) {
 		gp->priv->features = NULL;
 	} else {
-		gp->priv->features = g_new0(RemminaProtocolFeature, num_plugin + num_ssh + 1);
+		gp->priv->features = g_new0(RemminaProtocolFeature, num_plugin + num_core + num_ssh + 1);
 		feature = gp->priv->features;
 		if (plugin->features) {
 			memcpy(feature, plugin->features, sizeof(RemminaProtocolFeature) * num_plugin);
 			feature += num_plugin;
 		}
+		feature->type = REMMINA_PROTOCOL_FEATURE_TYPE_TOOL;
+		feature->id = REMMINA_PROTOCOL_FEATURE_TOOL_METRICS;
+		feature->opt1 = _("Connection metrics…");
+		feature->opt1_type_hint = REMMINA_TYPEHINT_STRING;
+		feature->opt2 = "utilities-system-monitor";
+		feature->opt2_type_hint = REMMINA_TYPEHINT_STRING;
+		feature->opt3 = NULL;
+		feature->opt3_type_hint = REMMINA_TYPEHINT_UNDEFINED;
+		feature++;
 #ifdef HAVE_LIBSSH
 		REMMINA_DEBUG("Have SSH");
 		if (num_ssh) {
@@ -306,8 +347,13 @@ static void remmina_protocol_widget_open_connection_real(gpointer data)
 #endif
 	}
 
-	if (!plugin->open_connection(gp))
+	remmina_metrics_phase_begin(gp->priv->metrics, "plugin_open");
+	if (!plugin->open_connection(gp)) {
+		remmina_metrics_phase_end(gp->priv->metrics, "plugin_open");
 		remmina_protocol_widget_close_connection(gp);
+		return;
+	}
+	remmina_metrics_phase_end(gp->priv->metrics, "plugin_open");
 }
 
 static void cancel_open_connection_cb(void *cbdata, int btn)
@@ -324,7 +370,12 @@ void remmina_protocol_widget_open_connection(RemminaProtocolWidget *gp)
 	const gchar *name;
 	RemminaMessagePanel *mp;
 
+	/* The "connect" phase ends when the plugin tells us the connection is open */
+	remmina_metrics_reset(gp->priv->metrics);
+	remmina_metrics_phase_begin(gp->priv->metrics, "connect");
+
 	/* Exec precommand before everything else */
+	remmina_metrics_phase_begin(gp->priv->metrics, "precommand");
 	mp = remmina_message_panel_new();
 	remmina_message_panel_setup_progress(mp, _("Executing external commands…"), NULL, NULL);
 	rco_show_message_panel(gp->cnnobj, mp);
@@ -334,6 +385,7 @@ void remmina_protocol_widget_open_connection(RemminaProtocolWidget *gp)
 		g_object_unref(dialog);
 
 	rco_destroy_message_panel(gp->cnnobj, mp);
+	remmina_metrics_phase_end(gp->priv->metrics, "precommand");
 
 	name = remmina_file_get_string(gp->priv->remmina_file, "name");
 	// TRANSLATORS: “%s” is a placeholder for the connection profile name
@@ -356,6 +408,7 @@ static gboolean conn_closed_real(gpointer data, int button){
 	/* This will close all tunnels */
 	remmina_protocol_widget_close_all_tunnels(gp);
 #endif
+	remmina_protocol_widget_stop_recording(gp);
 	/* Exec postcommand */
 	GtkDialog* dialog = remmina_ext_exec_new(gp->priv->remmina_file, "postcommand");
 	if (dialog)
@@ -404,6 +457,8 @@ static gboolean conn_opened(gpointer data)
 	TRACE_CALL(__func__);
 	RemminaProtocolWidget *gp = (RemminaProtocolWidget *)data;
 
+	remmina_metrics_phase_end(gp->priv->metrics, "connect");
+
 #ifdef HAVE_LIBSSH
 	if (gp->priv->ssh_tunnels) {
 		for (guint i = 0; i < gp->priv->ssh_tunnels->len; i++)
@@ -422,6 +477,8 @@ static gboolean conn_opened(gpointer data)
 		rco_destroy_message_panel(gp->cnnobj, gp->priv->retry_message_panel);
 		gp->priv->retry_message_panel = NULL;
 	}
+	if (remmina_file_get_int(gp->priv->remmina_file, "record_session", FALSE))
+		remmina_protocol_widget_start_recording(gp);
 	g_signal_emit_by_name(G_OBJECT(gp), "connect");
 	return G_SOURCE_REMOVE;
 }
@@ -434,6 +491,33 @@ void remmina_protocol_widget_signal_connection_opened(RemminaProtocolWidget *gp)
 	g_idle_add(conn_opened, (gpointer)gp);
 }
 
+void remmina_protocol_widget_metrics_phase(RemminaProtocolWidget *gp, const gchar *phase, gboolean begin)
+{
+	TRACE_CALL(__func__);
+	if (!gp->priv || !gp->priv->metrics)
+		return;
+	if (begin)
+		remmina_metrics_phase_begin(gp->priv->metrics, phase);
+	else
+		remmina_metrics_phase_end(gp->priv->metrics, phase);
+}
+
+void remmina_protocol_widget_metrics_add(RemminaProtocolWidget *gp, RemminaMetricsCounter counter, gint64 value)
+{
+	TRACE_CALL(__func__);
+	if (!gp->priv || !gp->priv->metrics)
+		return;
+	remmina_metrics_add(gp->priv->metrics, counter, value);
+}
+
+gboolean remmina_protocol_widget_metrics_sample_socket(RemminaProtocolWidget *gp, gint fd)
+{
+	TRACE_CALL(__func__);
+	if (!gp->priv || !gp->priv->metrics)
+		return FALSE;
+	return remmina_metrics_sample_socket(gp->priv->metrics, fd);
+}
+
 static gboolean update_align(gpointer data)
 {
 	TRACE_CALL(__func__);
@@ -758,6 +842,21 @@ gboolean remmina_protocol_widget_plugin_screenshot(RemminaProtocolWidget *gp, Re
 	return gp->priv->plugin->get_plugin_screenshot(gp, rpsd);
 }
 
+cairo_surface_t *remmina_protocol_widget_get_framebuffer(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	if (!gp->priv || !gp->priv->plugin || !gp->priv->plugin->get_framebuffer)
+		return NULL;
+	return gp->priv->plugin->get_framebuffer(gp);
+}
+
+gboolean remmina_protocol_widget_can_capture(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	return gp->priv && gp->priv->plugin &&
+	       (gp->priv->plugin->get_plugin_screenshot || gp->priv->plugin->get_framebuffer);
+}
+
 gboolean remmina_protocol_widget_map_event(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -782,6 +881,232 @@ gboolean remmina_protocol_widget_unmap_event(RemminaProtocolWidget *gp)
 	return gp->priv->plugin->unmap_event(gp);
 }
 
+/**
+ * Tell the plugin whether its session is on screen. Hidden sessions may
+ * throttle or pause their updates and resynchronise when visible again.
+ */
+void remmina_protocol_widget_set_visible(RemminaProtocolWidget *gp, gboolean visible)
+{
+	TRACE_CALL(__func__);
+	visible = visible ? TRUE : FALSE;
+	if (gp->priv->visible == visible)
+		return;
+	gp->priv->visible = visible;
+
+	REMMINA_DEBUG("Session %s is now %s", remmina_file_get_string(gp->priv->remmina_file, "name"),
+		      visible ? "visible" : "hidden");
+	if (gp->priv->plugin && gp->priv->plugin->visibility_changed)
+		gp->priv->plugin->visibility_changed(gp, visible);
+}
+
+gboolean remmina_protocol_widget_is_visible(RemminaProtocolWidget *gp)
+{
+	return gp->priv->visible;
+}
+
+/**
+ * Start (or stop, with a 0 width) keeping a thumbnail of the remote desktop
+ * that fits in width x height. Only the areas the plugin reported through
+ * remmina_protocol_widget_damage() are rescaled on each update.
+ */
+void remmina_protocol_widget_set_thumbnail_size(RemminaProtocolWidget *gp, gint width, gint height)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidgetPriv *priv = gp->priv;
+	gboolean was_wanted;
+
+	if (!priv)
+		return;
+
+	was_wanted = priv->thumbnail_width > 0;
+	if (priv->thumbnail) {
+		cairo_surface_destroy(priv->thumbnail);
+		priv->thumbnail = NULL;
+	}
+	if (priv->thumbnail_damage) {
+		cairo_region_destroy(priv->thumbnail_damage);
+		priv->thumbnail_damage = NULL;
+	}
+
+	if (width <= 0 || height <= 0) {
+		g_atomic_int_set(&priv->thumbnail_width, 0);
+		priv->thumbnail_height = 0;
+	} else {
+		priv->thumbnail_height = height;
+		priv->thumbnail_damage = cairo_region_create();
+		g_atomic_int_set(&priv->thumbnail_width, width);
+	}
+
+	/* A hidden session may be throttling its updates, or may have skipped
+	 * areas that the thumbnail now needs */
+	if (was_wanted != (priv->thumbnail_width > 0) && !priv->visible &&
+	    priv->plugin && priv->plugin->visibility_changed)
+		priv->plugin->visibility_changed(gp, FALSE);
+}
+
+/* May be called from any thread, plugins use it to keep painting while hidden:
+ * somebody looks at a thumbnail, or the session is being recorded */
+gboolean remmina_protocol_widget_framebuffer_wanted(RemminaProtocolWidget *gp)
+{
+	if (!gp->priv)
+		return FALSE;
+	return g_atomic_int_get(&gp->priv->thumbnail_width) > 0 || g_atomic_int_get(&gp->priv->recording);
+}
+
+/* May be called from any thread */
+gboolean remmina_protocol_widget_is_recording(RemminaProtocolWidget *gp)
+{
+	return gp->priv && g_atomic_int_get(&gp->priv->recording);
+}
+
+/* Area of the remote desktop, in remote pixels, that changed since the last update */
+void remmina_protocol_widget_damage(RemminaProtocolWidget *gp, gint x, gint y, gint w, gint h)
+{
+	cairo_rectangle_int_t rect = { x, y, w, h };
+
+	if (!gp->priv || w <= 0 || h <= 0)
+		return;
+	remmina_video_recorder_damage(gp->priv->recorder, x, y, w, h);
+	if (!gp->priv->thumbnail_damage)
+		return;
+	cairo_region_union_rectangle(gp->priv->thumbnail_damage, &rect);
+}
+
+gboolean remmina_protocol_widget_thumbnail_is_damaged(RemminaProtocolWidget *gp)
+{
+	RemminaProtocolWidgetPriv *priv = gp->priv;
+
+	if (!priv || !priv->thumbnail_damage)
+		return FALSE;
+	return !priv->thumbnail || !cairo_region_is_empty(priv->thumbnail_damage);
+}
+
+/**
+ * Rescale the damaged areas of the remote desktop into the thumbnail.
+ * @return TRUE when the thumbnail changed and must be redrawn.
+ */
+gboolean remmina_protocol_widget_update_thumbnail(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidgetPriv *priv = gp->priv;
+	cairo_rectangle_int_t rect;
+	cairo_surface_t *fb;
+	cairo_t *cr;
+	gdouble scale;
+	gint fbw, fbh, i, n;
+	gint x1, y1, x2, y2;
+
+	if (!remmina_protocol_widget_thumbnail_is_damaged(gp))
+		return FALSE;
+	if (!priv->plugin || !priv->plugin->get_framebuffer)
+		return FALSE;
+	if (!(fb = priv->plugin->get_framebuffer(gp)))
+		return FALSE;
+
+	fbw = cairo_image_surface_get_width(fb);
+	fbh = cairo_image_surface_get_height(fb);
+	if (fbw <= 0 || fbh <= 0) {
+		cairo_surface_destroy(fb);
+		return FALSE;
+	}
+	scale = MIN((gdouble)priv->thumbnail_width / fbw, (gdouble)priv->thumbnail_height / fbh);
+
+	/* First update or remote resize: start over with the whole desktop */
+	if (!priv->thumbnail || fbw != priv->thumbnail_fb_width || fbh != priv->thumbnail_fb_height) {
+		if (priv->thumbnail)
+			cairo_surface_destroy(priv->thumbnail);
+		priv->thumbnail = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+							     MAX(1, (gint)(fbw * scale)), MAX(1, (gint)(fbh * scale)));
+		priv->thumbnail_fb_width = fbw;
+		priv->thumbnail_fb_height = fbh;
+		rect.x = rect.y = 0;
+		rect.width = fbw;
+		rect.height = fbh;
+		cairo_region_union_rectangle(priv->thumbnail_damage, &rect);
+	}
+
+	cr = cairo_create(priv->thumbnail);
+	n = cairo_region_num_rectangles(priv->thumbnail_damage);
+	for (i = 0; i < n; i++) {
+		cairo_region_get_rectangle(priv->thumbnail_damage, i, &rect);
+		/* Whole thumbnail pixels, a partially covered one must be filtered again */
+		x1 = (gint)(rect.x * scale);
+		y1 = (gint)(rect.y * scale);
+		x2 = (gint)((rect.x + rect.width) * scale) + 1;
+		y2 = (gint)((rect.y + rect.height) * scale) + 1;
+		cairo_rectangle(cr, x1, y1, x2 - x1, y2 - y1);
+	}
+	cairo_clip(cr);
+	cairo_scale(cr, scale, scale);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cr, fb, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_surface_destroy(fb);
+
+	cairo_region_destroy(priv->thumbnail_damage);
+	priv->thumbnail_damage = cairo_region_create();
+	return TRUE;
+}
+
+cairo_surface_t *remmina_protocol_widget_get_thumbnail(RemminaProtocolWidget *gp)
+{
+	return gp->priv ? gp->priv->thumbnail : NULL;
+}
+
+static cairo_surface_t *remmina_protocol_widget_recording_source(gpointer data)
+{
+	RemminaProtocolWidget *gp = (RemminaProtocolWidget *)data;
+
+	return gp->priv->plugin->get_framebuffer(gp);
+}
+
+/* Records the session to "<recording_path>/remmina_<profile name>_<server>_<date>.rvr",
+ * see remmina_file_format_properties() */
+void remmina_protocol_widget_start_recording(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidgetPriv *priv = gp->priv;
+	gchar *name, *basename;
+
+	if (!priv || priv->recorder)
+		return;
+	if (!priv->plugin->get_framebuffer) {
+		REMMINA_DEBUG("The %s plugin cannot record sessions", priv->plugin->name);
+		return;
+	}
+
+	g_mkdir_with_parents(remmina_pref.recording_path, 0700);
+	name = remmina_file_format_properties(priv->remmina_file, "remmina_%p_%h_%d");
+	g_strdelimit(name, G_DIR_SEPARATOR_S ":", '_');
+	basename = g_build_filename(remmina_pref.recording_path, name, NULL);
+	priv->recorder = remmina_video_recorder_new(basename, remmina_pref.recording_fps,
+						    remmina_protocol_widget_recording_source, gp);
+	g_atomic_int_set(&priv->recording, priv->recorder != NULL);
+	g_free(basename);
+	g_free(name);
+
+	/* A hidden session may be throttling its updates */
+	if (priv->recorder && !priv->visible && priv->plugin->visibility_changed)
+		priv->plugin->visibility_changed(gp, FALSE);
+}
+
+void remmina_protocol_widget_stop_recording(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidgetPriv *priv = gp->priv;
+
+	if (!priv || !priv->recorder)
+		return;
+	g_atomic_int_set(&priv->recording, FALSE);
+	remmina_video_recorder_free(priv->recorder);
+	priv->recorder = NULL;
+
+	if (!priv->visible && priv->plugin && priv->plugin->visibility_changed)
+		priv->plugin->visibility_changed(gp, FALSE);
+}
+
 void remmina_protocol_widget_emit_signal(RemminaProtocolWidget *gp, const gchar *signal_name)
 {
 	TRACE_CALL(__func__);
@@ -849,6 +1174,11 @@ void remmina_protocol_widget_call_feature_by_ref(RemminaProtocolWidget *gp, cons
 {
 	TRACE_CALL(__func__);
 	switch (feature->id) {
+	case REMMINA_PROTOCOL_FEATURE_TOOL_METRICS:
+		remmina_metrics_dialog_show(gp->priv->metrics,
+					    remmina_file_get_string(gp->priv->remmina_file, "name"),
+					    remmina_protocol_widget_get_gtkwindow(gp));
+		return;
 #ifdef HAVE_LIBSSH
 	case REMMINA_PROTOCOL_FEATURE_TOOL_SSH:
 		if (gp->priv->ssh_tunnels && gp->priv->ssh_tunnels->len > 0) {
@@ -951,7 +1281,9 @@ static void cancel_init_tunnel_cb(void *cbdata, int btn)
 	printf("Remmina: Cancelling an opening tunnel is not implemented\n");
 }
 
-static RemminaSSHTunnel *remmina_protocol_widget_init_tunnel(RemminaProtocolWidget *gp)
+/* When shareable, an already authenticated session to the same SSH server
+ * is reused instead of connecting and authenticating again */
+static RemminaSSHTunnel *remmina_protocol_widget_init_tunnel(RemminaProtocolWidget *gp, gboolean shareable)
 {
 	TRACE_CALL(__func__);
 	RemminaSSHTunnel *tunnel;
@@ -963,6 +1295,14 @@ static RemminaSSHTunnel *remmina_protocol_widget_init_tunnel(RemminaProtocolWidg
 
 	tunnel = remmina_ssh_tunnel_new_from_file(gp->priv->remmina_file);
 
+	shareable = shareable && remmina_pref_get_ssh_tunnel_sharing();
+	if (shareable && remmina_ssh_tunnel_pool_attach(tunnel)) {
+		REMMINA_DEBUG("Reusing the SSH connection to “%s”", REMMINA_SSH(tunnel)->server);
+		remmina_metrics_phase_begin(gp->priv->metrics, "ssh_tunnel_shared");
+		remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel_shared");
+		return tunnel;
+	}
+
 	REMMINA_DEBUG("Creating SSH tunnel to “%s” via SSH…", REMMINA_SSH(tunnel)->server);
 	// TRANSLATORS: “%s” is a placeholder for an hostname or an IP address.
 	msg = g_strdup_printf(_("Connecting to “%s” via SSH…"), REMMINA_SSH(tunnel)->server);
@@ -974,15 +1314,21 @@ static RemminaSSHTunnel *remmina_protocol_widget_init_tunnel(RemminaProtocolWidg
 
 	while (1) {
 		if (!partial) {
+			remmina_metrics_phase_begin(gp->priv->metrics, "ssh_tunnel_connect");
 			if (!remmina_ssh_init_session(REMMINA_SSH(tunnel))) {
 				REMMINA_DEBUG("SSH Tunnel init session error: %s", REMMINA_SSH(tunnel)->error);
 				remmina_protocol_widget_set_error(gp, REMMINA_SSH(tunnel)->error);
+				remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel_connect");
 				// exit the loop here: OK
 				break;
 			}
+			remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel_connect");
 		}
 
+		/* Includes the time spent by the user in the auth panel */
+		remmina_metrics_phase_begin(gp->priv->metrics, "ssh_tunnel_auth");
 		ret = remmina_ssh_auth_gui(REMMINA_SSH(tunnel), gp, gp->priv->remmina_file);
+		remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel_auth");
 		REMMINA_DEBUG("Tunnel auth returned %d", ret);
 		switch (ret) {
 		case REMMINA_SSH_AUTH_SUCCESS:
@@ -1049,6 +1395,9 @@ BREAK:
 	}
 	remmina_protocol_widget_mpdestroy(gp->cnnobj, mp);
 
+	if (shareable)
+		remmina_ssh_tunnel_pool_share(tunnel);
+
 	return tunnel;
 }
 #endif
@@ -1139,8 +1488,13 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 		return dest;
 	}
 
-	tunnel = remmina_protocol_widget_init_tunnel(gp);
+	/* The startup command runs on the tunnel session from this thread,
+	 * so it cannot be shared with the thread of another connection */
+	remmina_metrics_phase_begin(gp->priv->metrics, "ssh_tunnel");
+	tunnel = remmina_protocol_widget_init_tunnel(gp,
+						     remmina_file_get_string(gp->priv->remmina_file, "ssh_tunnel_command") == NULL);
 	if (!tunnel) {
+		remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel");
 		g_free(srv_host);
 		g_free(ssh_tunnel_host);
 		REMMINA_DEBUG("remmina_protocol_widget_init_tunnel failed with error is %s",
@@ -1166,13 +1520,25 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 		g_free(ssh_tunnel_host);
 		remmina_protocol_widget_set_error(gp, REMMINA_SSH(tunnel)->error);
 		remmina_ssh_tunnel_free(tunnel);
+		remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel");
 		return NULL;
 	}
 	g_free(srv_host);
 	g_free(ssh_tunnel_host);
+	remmina_metrics_phase_end(gp->priv->metrics, "ssh_tunnel");
 
 	remmina_protocol_widget_mpdestroy(gp->cnnobj, mp);
 
+	/* Another connection was opening through the configured port */
+	if (tunnel->localport != remmina_pref.sshtunnel_port) {
+		// TRANSLATORS: The first %i is the configured port, the second one the port used instead
+		msg = g_strdup_printf(_("Local port %i is in use, the SSH tunnel of “%s” listens on port %i instead."),
+				      remmina_pref.sshtunnel_port, remmina_file_get_string(gp->priv->remmina_file, "name"),
+				      tunnel->localport);
+		remmina_public_send_notification("remmina-ssh-tunnel-port-id", _("SSH tunnel port changed"), msg);
+		g_free(msg);
+	}
+
 	tunnel->destroy_func = remmina_protocol_widget_tunnel_destroy;
 	tunnel->destroy_func_callback_data = (gpointer)gp;
 
@@ -1185,20 +1551,20 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 	const gchar* tunnel_command = remmina_file_get_string(gp->priv->remmina_file, "ssh_tunnel_command");
 	if (tunnel_command != NULL){
 		channel = ssh_channel_new(REMMINA_SSH(tunnel)->session);
-		if (channel == NULL) return g_strdup_printf("127.0.0.1:%i", remmina_pref.sshtunnel_port);
+		if (channel == NULL) return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
 
 		rc = ssh_channel_open_session(channel);
 		if (rc != SSH_OK)
 		{
 			ssh_channel_free(channel);
-			return g_strdup_printf("127.0.0.1:%i", remmina_pref.sshtunnel_port);
+			return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
 		}
 		rc = ssh_channel_request_exec(channel, tunnel_command);
 		if (rc != SSH_OK)
 		{
 			ssh_channel_close(channel);
 			ssh_channel_free(channel);
-			return g_strdup_printf("127.0.0.1:%i", remmina_pref.sshtunnel_port);
+			return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
 		}
 		struct timeval timeout = {10, 0};
 		ssh_channel channels[2];
@@ -1216,7 +1582,7 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 	}
 
 
-	return g_strdup_printf("127.0.0.1:%i", remmina_pref.sshtunnel_port);
+	return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
 
 #else
 
@@ -1247,7 +1613,7 @@ gboolean remmina_protocol_widget_start_reverse_tunnel(RemminaProtocolWidget *gp,
 	if (!remmina_file_get_int(gp->priv->remmina_file, "ssh_tunnel_enabled", FALSE))
 		return TRUE;
 
-	if (!(tunnel = remmina_protocol_widget_init_tunnel(gp)))
+	if (!(tunnel = remmina_protocol_widget_init_tunnel(gp, FALSE)))
 		return FALSE;
 
 	// TRANSLATORS: “%i” is a placeholder for a TCP port number.
@@ -1272,10 +1638,8 @@ gboolean remmina_protocol_widget_ssh_exec(RemminaProtocolWidget *gp, gboolean wa
 	TRACE_CALL(__func__);
 #ifdef HAVE_LIBSSH
 	RemminaSSHTunnel *tunnel;
-	ssh_channel channel;
-	gint status;
-	gboolean ret = FALSE;
-	gchar *cmd, *ptr;
+	gboolean ret;
+	gchar *cmd;
 	va_list args;
 
 	if (gp->priv->ssh_tunnels->len < 1)
@@ -1283,46 +1647,13 @@ gboolean remmina_protocol_widget_ssh_exec(RemminaProtocolWidget *gp, gboolean wa
 
 	tunnel = (RemminaSSHTunnel *)gp->priv->ssh_tunnels->pdata[0];
 
-	if ((channel = ssh_channel_new(REMMINA_SSH(tunnel)->session)) == NULL)
-		return FALSE;
-
 	va_start(args, fmt);
 	cmd = g_strdup_vprintf(fmt, args);
 	va_end(args);
 
-	if (ssh_channel_open_session(channel) == SSH_OK &&
-	    ssh_channel_request_exec(channel, cmd) == SSH_OK) {
-		if (wait) {
-			ssh_channel_send_eof(channel);
-			status = ssh_channel_get_exit_status(channel);
-			ptr = strchr(cmd, ' ');
-			if (ptr) *ptr = '\0';
-			switch (status) {
-			case 0:
-				ret = TRUE;
-				break;
-			case 127:
-				// TRANSLATORS: “%s” is a place holder for a unix command path.
-				remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
-								  _("The “%s” command is not available on the SSH server."), cmd);
-				break;
-			default:
-				// TRANSLATORS: “%s” is a place holder for a unix command path. “%i” is a placeholder for an error code number.
-				remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
-								  _("Could not run the “%s” command on the SSH server (status = %i)."), cmd, status);
-				break;
-			}
-		} else {
-			ret = TRUE;
-		}
-	} else {
-		// TRANSLATORS: %s is a placeholder for an error message
-		remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not run command. %s"));
-	}
+	/* A shared tunnel session is run by its carrier thread */
+	ret = remmina_ssh_tunnel_exec(tunnel, cmd, wait);
 	g_free(cmd);
-	if (wait)
-		ssh_channel_close(channel);
-	ssh_channel_free(channel);
 	return ret;
 
 #else
@@ -1384,7 +1715,7 @@ gboolean remmina_protocol_widget_start_xport_tunnel(RemminaProtocolWidget *gp, R
 	RemminaMessagePanel *mp;
 	RemminaSSHTunnel *tunnel;
 
-	if (!(tunnel = remmina_protocol_widget_init_tunnel(gp))) return FALSE;
+	if (!(tunnel = remmina_protocol_widget_init_tunnel(gp, FALSE))) return FALSE;
 
 	// TRANSLATORS: “%s” is a placeholder for a hostname or IP address.
 	msg = g_strdup_printf(_("Connecting to %s via SSH…"), remmina_file_get_string(gp->priv->remmina_file, "server"));
@@ -1693,9 +2024,9 @@ static void run_destroy_handler(RemminaMessagePanel *mp, gpointer data)
 	shutdown_loop(mpri);
 }
 
-static int remmina_protocol_widget_dialog(enum panel_type dtype, RemminaProtocolWidget *gp, RemminaMessagePanelFlags pflags,
-					  const gchar *title, const gchar *default_username, const gchar *default_password, const gchar *default_domain,
-					  const gchar *strpasswordlabel)
+static int remmina_protocol_widget_dialog_real(enum panel_type dtype, RemminaProtocolWidget *gp, RemminaMessagePanelFlags pflags,
+					       const gchar *title, const gchar *default_username, const gchar *default_password, const gchar *default_domain,
+					       const gchar *strpasswordlabel)
 {
 	TRACE_CALL(__func__);
 
@@ -1768,6 +2099,22 @@ static int remmina_protocol_widget_dialog(enum panel_type dtype, RemminaProtocol
 	return rcbutton;
 }
 
+/* Time spent waiting for the user is recorded apart from the network phases */
+static int remmina_protocol_widget_dialog(enum panel_type dtype, RemminaProtocolWidget *gp, RemminaMessagePanelFlags pflags,
+					  const gchar *title, const gchar *default_username, const gchar *default_password, const gchar *default_domain,
+					  const gchar *strpasswordlabel)
+{
+	TRACE_CALL(__func__);
+	int rcbutton;
+
+	remmina_metrics_phase_begin(gp->priv->metrics, "user_prompt");
+	rcbutton = remmina_protocol_widget_dialog_real(dtype, gp, pflags, title, default_username, default_password,
+						       default_domain, strpasswordlabel);
+	remmina_metrics_phase_end(gp->priv->metrics, "user_prompt");
+
+	return rcbutton;
+}
+
 gchar* remmina_protocol_widget_panel_prompt(RemminaProtocolWidget *gp, const char *msg)
 {
 	remmina_protocol_widget_dialog(RPWDT_PROMPT, gp, 0, msg, NULL, NULL, NULL, NULL);
@@ -2198,8 +2545,14 @@ void remmina_protocol_widget_send_keys_signals(GtkWidget *widget, const guint *k
 	int i;
 	GdkEventKey event;
 	gboolean result;
+	guint16 *keycodes;
 	GdkKeymap *keymap = gdk_keymap_get_for_display(gdk_display_get_default());
 
+	/* Look each keyval up once, for both the press and the release */
+	keycodes = g_new(guint16, MAX(keyvals_length, 1));
+	for (i = 0; i < keyvals_length; i++)
+		keycodes[i] = remmina_public_get_keycode_for_keyval(keymap, keyvals[i]);
+
 	event.window = gtk_widget_get_window(widget);
 	event.send_event = TRUE;
 	event.time = GDK_CURRENT_TIME;
@@ -2213,7 +2566,7 @@ void remmina_protocol_widget_send_keys_signals(GtkWidget *widget, const guint *k
 		event.type = GDK_KEY_PRESS;
 		for (i = 0; i < keyvals_length; i++) {
 			event.keyval = keyvals[i];
-			event.hardware_keycode = remmina_public_get_keycode_for_keyval(keymap, event.keyval);
+			event.hardware_keycode = keycodes[i];
 			event.is_modifier = (int)remmina_public_get_modifier_for_keycode(keymap, event.hardware_keycode);
 			REMMINA_DEBUG("Sending keyval: %u, hardware_keycode: %u", event.keyval, event.hardware_keycode);
 			g_signal_emit_by_name(G_OBJECT(widget), "key-press-event", &event, &result);
@@ -2225,11 +2578,12 @@ void remmina_protocol_widget_send_keys_signals(GtkWidget *widget, const guint *k
 		event.type = GDK_KEY_RELEASE;
 		for (i = (keyvals_length - 1); i >= 0; i--) {
 			event.keyval = keyvals[i];
-			event.hardware_keycode = remmina_public_get_keycode_for_keyval(keymap, event.keyval);
+			event.hardware_keycode = keycodes[i];
 			event.is_modifier = (int)remmina_public_get_modifier_for_keycode(keymap, event.hardware_keycode);
 			g_signal_emit_by_name(G_OBJECT(widget), "key-release-event", &event, &result);
 		}
 	}
+	g_free(keycodes);
 }
 
 void remmina_protocol_widget_update_remote_resolution(RemminaProtocolWidget *gp)
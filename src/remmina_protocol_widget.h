@@ -44,6 +44,7 @@ G_BEGIN_DECLS
 
 #define REMMINA_PROTOCOL_FEATURE_TOOL_SSH  -1
 #define REMMINA_PROTOCOL_FEATURE_TOOL_SFTP -2
+#define REMMINA_PROTOCOL_FEATURE_TOOL_METRICS -3
 
 #define REMMINA_TYPE_PROTOCOL_WIDGET                  (remmina_protocol_widget_get_type())
 #define REMMINA_PROTOCOL_WIDGET(obj)                  (G_TYPE_CHECK_INSTANCE_CAST((obj), REMMINA_TYPE_PROTOCOL_WIDGET, RemminaProtocolWidget))
@@ -105,6 +106,10 @@ void remmina_protocol_widget_open_connection(RemminaProtocolWidget *gp);
 void remmina_protocol_widget_close_connection(RemminaProtocolWidget *gp);
 void remmina_protocol_widget_signal_connection_closed(RemminaProtocolWidget *gp);
 void remmina_protocol_widget_signal_connection_opened(RemminaProtocolWidget *gp);
+/* Connection phase timings and steady state counters, may be called from any thread */
+void remmina_protocol_widget_metrics_phase(RemminaProtocolWidget *gp, const gchar *phase, gboolean begin);
+void remmina_protocol_widget_metrics_add(RemminaProtocolWidget *gp, RemminaMetricsCounter counter, gint64 value);
+gboolean remmina_protocol_widget_metrics_sample_socket(RemminaProtocolWidget *gp, gint fd);
 void remmina_protocol_widget_update_align(RemminaProtocolWidget *gp);
 void remmina_protocol_widget_lock_dynres(RemminaProtocolWidget *gp);
 void remmina_protocol_widget_unlock_dynres(RemminaProtocolWidget *gp);
@@ -175,9 +180,27 @@ void remmina_protocol_widget_send_keystrokes(RemminaProtocolWidget *gp, GtkMenuI
 void remmina_protocol_widget_send_clipboard(RemminaProtocolWidget *gp, GObject *widget);
 /* Take screenshot of plugin */
 gboolean remmina_protocol_widget_plugin_screenshot(RemminaProtocolWidget *gp, RemminaPluginScreenshotData *rpsd);
+/* New reference to the framebuffer of the plugin, NULL when it has none (yet), main thread only */
+cairo_surface_t *remmina_protocol_widget_get_framebuffer(RemminaProtocolWidget *gp);
+/* Whether the remote desktop can be captured without the window, by one of the above */
+gboolean remmina_protocol_widget_can_capture(RemminaProtocolWidget *gp);
 /* Deal with the remimna connection window map/unmap events */
 gboolean remmina_protocol_widget_map_event(RemminaProtocolWidget *gp);
 gboolean remmina_protocol_widget_unmap_event(RemminaProtocolWidget *gp);
+/* Whether the session is on screen, see RemminaProtocolPlugin.visibility_changed */
+void remmina_protocol_widget_set_visible(RemminaProtocolWidget *gp, gboolean visible);
+gboolean remmina_protocol_widget_is_visible(RemminaProtocolWidget *gp);
+/* Damage driven downscaled copy of the remote desktop, main thread only */
+void remmina_protocol_widget_set_thumbnail_size(RemminaProtocolWidget *gp, gint width, gint height);
+gboolean remmina_protocol_widget_framebuffer_wanted(RemminaProtocolWidget *gp);
+void remmina_protocol_widget_damage(RemminaProtocolWidget *gp, gint x, gint y, gint w, gint h);
+gboolean remmina_protocol_widget_is_recording(RemminaProtocolWidget *gp);
+gboolean remmina_protocol_widget_thumbnail_is_damaged(RemminaProtocolWidget *gp);
+gboolean remmina_protocol_widget_update_thumbnail(RemminaProtocolWidget *gp);
+cairo_surface_t *remmina_protocol_widget_get_thumbnail(RemminaProtocolWidget *gp);
+/* Video recording of the session from the plugin framebuffer, main thread only */
+void remmina_protocol_widget_start_recording(RemminaProtocolWidget *gp);
+void remmina_protocol_widget_stop_recording(RemminaProtocolWidget *gp);
 
 void remmina_protocol_widget_update_remote_resolution(RemminaProtocolWidget *gp);
 
@@ -0,0 +1,181 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "remmina_log.h"
+#include "remmina_pref.h"
+#include "remmina_public.h"
+#include "remmina_screenshot.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Encodes running at the same time, more would only compete with the sessions */
+#define REMMINA_SCREENSHOT_MAX_THREADS 2
+
+typedef struct _RemminaScreenshotJob {
+	cairo_surface_t *	surface;
+	gchar *			filename;
+	gchar *			format;
+	gboolean		notify;
+	GObject *		owner;
+	gboolean		saved;
+} RemminaScreenshotJob;
+
+static GThreadPool *screenshot_pool = NULL;
+
+static gboolean remmina_screenshot_can_save(const gchar *format)
+{
+	TRACE_CALL(__func__);
+	GSList *formats, *l;
+	gboolean found = FALSE;
+
+	formats = gdk_pixbuf_get_formats();
+	for (l = formats; l && !found; l = l->next) {
+		gchar *name = gdk_pixbuf_format_get_name(l->data);
+		found = g_strcmp0(name, format) == 0 && gdk_pixbuf_format_is_writable(l->data);
+		g_free(name);
+	}
+	g_slist_free(formats);
+	return found;
+}
+
+/* remmina_pref.screenshot_format, or png when gdk-pixbuf cannot write it */
+static const gchar *remmina_screenshot_get_format(void)
+{
+	TRACE_CALL(__func__);
+	const gchar *format = remmina_pref.screenshot_format;
+
+	if (g_strcmp0(format, "jpeg") != 0 && g_strcmp0(format, "webp") != 0)
+		return "png";
+	if (!remmina_screenshot_can_save(format)) {
+		REMMINA_WARNING("gdk-pixbuf cannot write %s images, screenshots are saved as PNG", format);
+		return "png";
+	}
+	return format;
+}
+
+const gchar *remmina_screenshot_get_extension(void)
+{
+	TRACE_CALL(__func__);
+	const gchar *format = remmina_screenshot_get_format();
+
+	return g_strcmp0(format, "jpeg") == 0 ? "jpg" : format;
+}
+
+static gboolean remmina_screenshot_done(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaScreenshotJob *job = (RemminaScreenshotJob *)data;
+
+	if (job->saved && job->notify)
+		remmina_public_send_notification("remmina-screenshot-is-ready-id", _("Screenshot taken"), job->filename);
+
+	if (job->owner) {
+		g_object_set_data(job->owner, "remmina-screenshot-busy", NULL);
+		g_object_unref(job->owner);
+	}
+	g_free(job->filename);
+	g_free(job->format);
+	g_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static void remmina_screenshot_worker(gpointer data, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaScreenshotJob *job = (RemminaScreenshotJob *)data;
+	GdkPixbuf *pixbuf;
+	GError *error = NULL;
+	gint64 start = g_get_monotonic_time();
+
+	if (g_strcmp0(job->format, "png") == 0) {
+		job->saved = cairo_surface_write_to_png(job->surface, job->filename) == CAIRO_STATUS_SUCCESS;
+	} else {
+		pixbuf = gdk_pixbuf_get_from_surface(job->surface, 0, 0,
+						     cairo_image_surface_get_width(job->surface),
+						     cairo_image_surface_get_height(job->surface));
+		if (pixbuf) {
+			if (g_strcmp0(job->format, "jpeg") == 0)
+				job->saved = gdk_pixbuf_save(pixbuf, job->filename, "jpeg", &error, "quality", "90", NULL);
+			else
+				job->saved = gdk_pixbuf_save(pixbuf, job->filename, job->format, &error, NULL);
+			g_object_unref(pixbuf);
+		}
+	}
+
+	if (error) {
+		REMMINA_WARNING("Cannot save screenshot %s: %s", job->filename, error->message);
+		g_error_free(error);
+	} else if (!job->saved) {
+		REMMINA_WARNING("Cannot save screenshot %s", job->filename);
+	} else {
+		REMMINA_DEBUG("Screenshot %s encoded in %" G_GINT64_FORMAT " ms", job->filename,
+			      (g_get_monotonic_time() - start) / 1000);
+	}
+
+	cairo_surface_destroy(job->surface);
+	job->surface = NULL;
+	g_idle_add(remmina_screenshot_done, job);
+}
+
+void remmina_screenshot_save(cairo_surface_t *surface, const gchar *filename, gboolean notify, GObject *owner)
+{
+	TRACE_CALL(__func__);
+	RemminaScreenshotJob *job;
+
+	if (!screenshot_pool)
+		screenshot_pool = g_thread_pool_new(remmina_screenshot_worker, NULL, REMMINA_SCREENSHOT_MAX_THREADS, FALSE, NULL);
+
+	job = g_new0(RemminaScreenshotJob, 1);
+	job->surface = surface;
+	job->filename = g_strdup(filename);
+	job->format = g_strdup(remmina_screenshot_get_format());
+	job->notify = notify;
+	if (owner) {
+		job->owner = g_object_ref(owner);
+		g_object_set_data(owner, "remmina-screenshot-busy", GINT_TO_POINTER(TRUE));
+	}
+
+	/* The worker is the only one touching the surface from now on */
+	cairo_surface_flush(surface);
+	g_thread_pool_push(screenshot_pool, job, NULL);
+}
+
+gboolean remmina_screenshot_is_busy(GObject *owner)
+{
+	TRACE_CALL(__func__);
+	return g_object_get_data(owner, "remmina-screenshot-busy") != NULL;
+}
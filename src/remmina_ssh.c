@@ -130,24 +130,27 @@ static const gchar *common_identities[] =
 *-----------------------------------------------------------------------------*/
 #define _PATH_UNIX_X    "/tmp/.X11-unix/X%d"
 
+/* Relay buffer of each channel, allocated once when the channel is
+ * registered. 128 KB is four times the largest SSH packet libssh sends,
+ * so a single channel write can fill several packets at once. */
+#define REMMINA_SSH_RELAY_BUFFER_SIZE (128 * 1024)
+
+/* Relay context of a shell or X11 channel. It is handed to libssh as
+ * userdata of both the fd and the channel callbacks, so the data path
+ * never has to look the channel up or take a lock. */
 typedef struct item {
 	ssh_channel channel;
 	gint fd_in;
 	gint fd_out;
 	gboolean protected;
-	pthread_t thread;
-	struct item *next;
+	RemminaSSHShell *shell;
+	gchar *buf;
+	struct ssh_channel_callbacks_struct cb;
 } node_t;
 
-node_t *node = NULL;
-
-// Mutex
-pthread_mutex_t mutex;
-
-// Linked nodes to manage channel/fd tuples
-static void remmina_ssh_insert_item(ssh_channel channel, gint fd_in, gint fd_out, gboolean protected, pthread_t thread);
-static void remmina_ssh_delete_item(ssh_channel channel);
-static node_t * remmina_ssh_search_item(ssh_channel channel);
+// Relay contexts of the channels of a shell
+static node_t * remmina_ssh_insert_item(RemminaSSHShell *shell, ssh_channel channel, gint fd_in, gint fd_out, gboolean protected);
+static void remmina_ssh_free_item(gpointer data);
 
 // X11 Display
 const char * remmina_ssh_ssh_gai_strerror(int gaierr);
@@ -167,109 +170,54 @@ static int remmina_ssh_cp_to_fd_cb(ssh_session session, ssh_channel channel, voi
 static void remmina_ssh_ch_close_cb(ssh_session session, ssh_channel channel, void *userdata);
 
 // Close all X11 channel
-static void remmina_ssh_close_all_x11_ch(pthread_t thread);
+static void remmina_ssh_close_all_x11_ch(RemminaSSHShell *shell);
 
 // X11 Request
 static ssh_channel remmina_ssh_x11_open_request_cb(ssh_session session, const char *shost, int sport, void *userdata);
 
-// SSH Channel Callbacks
-struct ssh_channel_callbacks_struct channel_cb =
-{
-	.channel_data_function = remmina_ssh_cp_to_fd_cb,
-	.channel_eof_function = remmina_ssh_ch_close_cb,
-	.channel_close_function = remmina_ssh_ch_close_cb,
-	.userdata = NULL
-};
-
 // SSH Event Context
 short events = POLLIN | POLLPRI | POLLERR | POLLHUP | POLLNVAL;
 
 // Functions
-static void
-remmina_ssh_insert_item(ssh_channel channel, gint fd_in, gint fd_out, gboolean protected, pthread_t thread)
+/* Must be called with the shell locked or from the shell thread
+ * before anything else can see the shell channels. */
+static node_t *
+remmina_ssh_insert_item(RemminaSSHShell *shell, ssh_channel channel, gint fd_in, gint fd_out, gboolean protected)
 {
 	TRACE_CALL(__func__);
-
-	pthread_mutex_lock(&mutex);
+	node_t *new;
 
 	REMMINA_DEBUG("insert node - fd_in: %d - fd_out: %d - protected %d", fd_in, fd_out, protected);
 
-	node_t *node_iterator, *new;
-	if (node == NULL) {
-		/* Calloc ensure that node is full of 0 */
-		node = (node_t *) calloc(1, sizeof(node_t));
-		node->channel = channel;
-		node->fd_in = fd_in;
-		node->fd_out = fd_out;
-		node->protected = protected;
-		node->thread = thread;
-		node->next = NULL;
-	} else {
-		node_iterator = node;
-		while (node_iterator->next != NULL)
-			node_iterator = node_iterator->next;
-		/* Create the new node */
-		new = (node_t *) malloc(sizeof(node_t));
-		new->channel = channel;
-		new->fd_in = fd_in;
-		new->fd_out = fd_out;
-		new->protected = protected;
-		new->thread = thread;
-		new->next = NULL;
-		node_iterator->next = new;
-	}
-
-	pthread_mutex_unlock(&mutex);
-}
-
-static void
-remmina_ssh_delete_item(ssh_channel channel)
-{
-	TRACE_CALL(__func__);
-
-	REMMINA_DEBUG("delete node");
-
-	pthread_mutex_lock(&mutex);
-
-	node_t *current, *previous = NULL;
-	for (current = node; current; previous = current, current = current->next) {
-		if (current->channel != channel)
-			continue;
+	new = g_new0(node_t, 1);
+	new->channel = channel;
+	new->fd_in = fd_in;
+	new->fd_out = fd_out;
+	new->protected = protected;
+	new->shell = shell;
+	new->buf = g_malloc(REMMINA_SSH_RELAY_BUFFER_SIZE);
 
-		if (previous == NULL)
-			node = current->next;
-		else
-			previous->next = current->next;
+	new->cb.channel_data_function = remmina_ssh_cp_to_fd_cb;
+	new->cb.channel_eof_function = remmina_ssh_ch_close_cb;
+	new->cb.channel_close_function = remmina_ssh_ch_close_cb;
+	new->cb.userdata = new;
+	ssh_callbacks_init(&new->cb);
 
-		free(current);
-		pthread_mutex_unlock(&mutex);
-		return;
-	}
+	g_ptr_array_add(shell->channels, new);
 
-	pthread_mutex_unlock(&mutex);
+	return new;
 }
 
-static node_t *
-remmina_ssh_search_item(ssh_channel channel)
+static void
+remmina_ssh_free_item(gpointer data)
 {
 	TRACE_CALL(__func__);
+	node_t *item = (node_t *)data;
 
+	REMMINA_DEBUG("delete node");
 
-	pthread_mutex_lock(&mutex);
-
-	node_t *current = node;
-	while (current != NULL) {
-		if (current->channel == channel) {
-			pthread_mutex_unlock(&mutex);
-			return current;
-		} else {
-			current = current->next;
-		}
-	}
-
-	pthread_mutex_unlock(&mutex);
-
-	return NULL;
+	g_free(item->buf);
+	g_free(item);
 }
 
 static void
@@ -482,21 +430,52 @@ remmina_ssh_x11_connect_display(void)
 	return sock;
 }
 
+/* Fill the relay buffer with what the fd has ready, up to the size of
+ * the remote window, so a burst of output becomes one channel write
+ * instead of one write per read(). Returns 0 only at end of file, -1 with
+ * errno EAGAIN when nothing was ready after all. */
+static gssize
+remmina_ssh_relay_fill(gint fd, gchar *buf, gsize size)
+{
+	TRACE_CALL(__func__);
+	struct pollfd pfd;
+	gssize sz;
+	gsize len = 0;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN | POLLPRI;
+
+	while (len < size) {
+		sz = read(fd, buf + len, size - len);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			/* EAGAIN after some data only ends this burst */
+			return len > 0 ? (gssize)len : -1;
+		}
+		if (sz == 0)
+			break;
+		len += sz;
+		/* Only keep reading while more data is already waiting */
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLPRI)))
+			break;
+	}
+
+	return len;
+}
+
 static int
 remmina_ssh_cp_to_ch_cb(int fd, int revents, void *userdata)
 {
 	TRACE_CALL(__func__);
-	ssh_channel channel = (ssh_channel)userdata;
-	gchar *buf = (gchar *) g_malloc ( sizeof(gchar) * 0x200000 );
-	if (buf ==NULL){
-		return -1;
-	}
+	node_t *temp_node = (node_t *)userdata;
+	ssh_channel channel = temp_node->channel;
+	gsize size;
 	gint sz = 0, ret = 0;
 
-	node_t *temp_node = remmina_ssh_search_item(channel);
-
-	if (!channel) {
-		if (!temp_node->protected) {
+	if (!channel || !temp_node->buf) {
+		if (!temp_node->protected && temp_node->fd_in >= 0) {
 			shutdown(fd, SHUT_RDWR);
 			close(fd);
 			REMMINA_DEBUG("fd %d closed.", fd);
@@ -506,25 +485,30 @@ remmina_ssh_cp_to_ch_cb(int fd, int revents, void *userdata)
 	}
 
 	if ((revents & POLLIN) || (revents & POLLPRI)) {
-		sz = read(fd, buf, sizeof(buf));
+		/* Do not read more than the remote side can take right now,
+		 * ssh_channel_write() would otherwise block on the window. An
+		 * empty window still reads a full buffer and lets libssh wait
+		 * for the adjust, as it did before. */
+		size = ssh_channel_window_size(channel);
+		if (size == 0 || size > REMMINA_SSH_RELAY_BUFFER_SIZE)
+			size = REMMINA_SSH_RELAY_BUFFER_SIZE;
+		sz = remmina_ssh_relay_fill(fd, temp_node->buf, size);
 		if (sz > 0) {
-			ret = ssh_channel_write(channel, buf, sz);
-			if (ret != sz){
-				g_free(buf);
+			ret = ssh_channel_write(channel, temp_node->buf, sz);
+			if (ret != sz)
 				return -1;
-			}
-				
 		} else if (sz < 0) {
-			g_free(buf);
+			/* Spurious readiness, the fd stays open */
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
 			return -1;
 		} else {
-			REMMINA_WARNING("Why the hell am I here?");
+			REMMINA_DEBUG("End of file on fd %d.", fd);
 			if (!temp_node->protected) {
 				shutdown(fd, SHUT_RDWR);
 				close(fd);
 				REMMINA_DEBUG("fd %d closed.", fd);
 			}
-			g_free(buf);
 			return -1;
 		}
 	}
@@ -534,7 +518,6 @@ remmina_ssh_cp_to_ch_cb(int fd, int revents, void *userdata)
 		ssh_channel_close(channel);
 		ret = -1;
 	}
-	g_free(buf);
 	return ret;
 }
 
@@ -543,18 +526,36 @@ remmina_ssh_cp_to_fd_cb(ssh_session session, ssh_channel channel, void *data, ui
 {
 	TRACE_CALL(__func__);
 	(void)session;
+	(void)channel;
 	(void)is_stderr;
-	// Expecting userdata to be type RemminaSSHShell *, but it is unused
-	// in this function.
-	(void)userdata;
 
-	node_t *temp_node = remmina_ssh_search_item(channel);
-	gint fd = temp_node->fd_out;
-	gint sz = 0;
+	node_t *temp_node = (node_t *)userdata;
+	gssize sz;
+	guint32 done = 0;
+
+	if (temp_node->fd_out < 0)
+		return -1;
+
+	/* The pty and the X11 socket can take less than a whole packet,
+	 * finish the write here instead of having libssh call us again */
+	while (done < len) {
+		sz = write(temp_node->fd_out, (gchar *)data + done, len - done);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		done += sz;
+	}
 
-	sz = write(fd, data, len);
+	if (temp_node->protected) {
+		remmina_ssh_recorder_write(temp_node->shell->recorder, data, done);
+		remmina_ssh_search_index_feed(temp_node->shell->search_index, data, done);
+	}
 
-	return sz;
+	if (done == 0 && len > 0)
+		return -1;
+	return done;
 }
 
 static void
@@ -562,46 +563,49 @@ remmina_ssh_ch_close_cb(ssh_session session, ssh_channel channel, void *userdata
 {
 	TRACE_CALL(__func__);
 	(void)session;
-
-	RemminaSSHShell *shell = (RemminaSSHShell *)userdata;
-
-	node_t *temp_node = remmina_ssh_search_item(channel);
-
-	if (temp_node != NULL) {
-		int fd = temp_node->fd_in;
-
-		if (!temp_node->protected) {
-			remmina_ssh_delete_item(channel);
-			ssh_event_remove_fd(shell->event, fd);
-			shutdown(fd, SHUT_RDWR);
-			close(fd);
-			REMMINA_DEBUG("fd %d closed.", fd);
-		}
+	(void)channel;
+
+	node_t *temp_node = (node_t *)userdata;
+	int fd = temp_node->fd_in;
+
+	/* The context itself stays around until the shell is freed, libssh
+	 * may still be walking the channel callbacks when we get here */
+	if (!temp_node->protected && fd >= 0) {
+		ssh_event_remove_fd(temp_node->shell->event, fd);
+		shutdown(fd, SHUT_RDWR);
+		close(fd);
+		REMMINA_DEBUG("fd %d closed.", fd);
+		temp_node->fd_in = temp_node->fd_out = -1;
+		g_free(temp_node->buf);
+		temp_node->buf = NULL;
 	}
 	REMMINA_DEBUG("Channel closed.");
 }
 
 static void
-remmina_ssh_close_all_x11_ch(pthread_t thread)
+remmina_ssh_close_all_x11_ch(RemminaSSHShell *shell)
 {
 	TRACE_CALL(__func__);
+	node_t *current;
 
 	REMMINA_DEBUG("Close all X11 channels");
 
-	node_t *current = node;
-	while (current != NULL) {
-		if (current->thread == thread && !current->protected) {
-			shutdown(current->fd_in, SHUT_RDWR);
-			close(current->fd_in);
-			REMMINA_DEBUG("thread: %d - fd %d closed.", thread, current->fd_in);
-			if (current->fd_in != current->fd_out) {
-				shutdown(current->fd_out, SHUT_RDWR);
-				close(current->fd_out);
-				REMMINA_DEBUG("thread: %d - fd %d closed.", thread, current->fd_out);
-			}
+	LOCK_SSH(shell)
+	for (guint i = 0; i < shell->channels->len; i++) {
+		current = g_ptr_array_index(shell->channels, i);
+		if (current->protected || current->fd_in < 0)
+			continue;
+		shutdown(current->fd_in, SHUT_RDWR);
+		close(current->fd_in);
+		REMMINA_DEBUG("fd %d closed.", current->fd_in);
+		if (current->fd_in != current->fd_out) {
+			shutdown(current->fd_out, SHUT_RDWR);
+			close(current->fd_out);
+			REMMINA_DEBUG("fd %d closed.", current->fd_out);
 		}
-		current = current->next;
+		current->fd_in = current->fd_out = -1;
 	}
+	UNLOCK_SSH(shell)
 }
 
 static ssh_channel
@@ -617,13 +621,16 @@ remmina_ssh_x11_open_request_cb(ssh_session session, const char *shost, int spor
 	ssh_channel channel = ssh_channel_new(session);
 
 	int sock = remmina_ssh_x11_connect_display();
+	node_t *item;
 
-	remmina_ssh_insert_item(channel, sock, sock, FALSE, shell->thread);
+	LOCK_SSH(shell)
+	item = remmina_ssh_insert_item(shell, channel, sock, sock, FALSE);
+	UNLOCK_SSH(shell)
 
-	ssh_event_add_fd(shell->event, sock, events, remmina_ssh_cp_to_ch_cb, channel);
+	ssh_event_add_fd(shell->event, sock, events, remmina_ssh_cp_to_ch_cb, item);
 	ssh_event_add_session(shell->event, session);
 
-	ssh_add_channel_callbacks(channel, &channel_cb);
+	ssh_add_channel_callbacks(channel, &item->cb);
 
 	return channel;
 }
@@ -2198,26 +2205,35 @@ remmina_ssh_free(RemminaSSH *ssh)
 /*-----------------------------------------------------------------------------*
 *                           SSH Tunnel                                        *
 *-----------------------------------------------------------------------------*/
+/* Each channel/socket pair owns two ring buffers, one per direction.
+ * They are allocated once when the pair is registered, data is read
+ * straight into the free region and written straight from the used
+ * region, so no memory is allocated or copied per chunk. */
+#define REMMINA_SSH_TUNNEL_BUFFER_MIN_SIZE (256 * 1024)
+#define REMMINA_SSH_TUNNEL_BUFFER_MAX_SIZE (4 * 1024 * 1024)
+
 struct _RemminaSSHTunnelBuffer {
 	gchar * data;
-	gchar * ptr;
-	ssize_t len;
+	gsize	size;
+	gsize	head;   /* Offset of the first queued byte */
+	gsize	len;    /* Number of queued bytes */
 };
 
-static RemminaSSHTunnelBuffer *
-remmina_ssh_tunnel_buffer_new(ssize_t len)
+RemminaSSHTunnelBuffer *
+remmina_ssh_tunnel_buffer_new(gsize size)
 {
 	TRACE_CALL(__func__);
 	RemminaSSHTunnelBuffer *buffer;
 
 	buffer = g_new(RemminaSSHTunnelBuffer, 1);
-	buffer->data = (gchar *)g_malloc(len);
-	buffer->ptr = buffer->data;
-	buffer->len = len;
+	buffer->data = (gchar *)g_malloc(size);
+	buffer->size = size;
+	buffer->head = 0;
+	buffer->len = 0;
 	return buffer;
 }
 
-static void
+void
 remmina_ssh_tunnel_buffer_free(RemminaSSHTunnelBuffer *buffer)
 {
 	TRACE_CALL(__func__);
@@ -2227,6 +2243,178 @@ remmina_ssh_tunnel_buffer_free(RemminaSSHTunnelBuffer *buffer)
 	}
 }
 
+/* Contiguous free region where new data can be stored */
+gchar *
+remmina_ssh_tunnel_buffer_tail(RemminaSSHTunnelBuffer *buffer, gsize *avail)
+{
+	gsize tail;
+
+	if (buffer->len == 0)
+		buffer->head = 0;
+	tail = (buffer->head + buffer->len) % buffer->size;
+	if (tail >= buffer->head && buffer->len < buffer->size)
+		*avail = buffer->size - tail;
+	else
+		*avail = buffer->head - tail;
+	return buffer->data + tail;
+}
+
+/* Contiguous region of queued data, starting from the oldest byte */
+gchar *
+remmina_ssh_tunnel_buffer_head(RemminaSSHTunnelBuffer *buffer, gsize *avail)
+{
+	*avail = MIN(buffer->len, buffer->size - buffer->head);
+	return buffer->data + buffer->head;
+}
+
+void
+remmina_ssh_tunnel_buffer_commit(RemminaSSHTunnelBuffer *buffer, gsize len)
+{
+	buffer->len += len;
+}
+
+void
+remmina_ssh_tunnel_buffer_consume(RemminaSSHTunnelBuffer *buffer, gsize len)
+{
+	buffer->head = (buffer->head + len) % buffer->size;
+	buffer->len -= len;
+}
+
+#define remmina_ssh_tunnel_buffer_is_full(b) ((b)->len == (b)->size)
+#define remmina_ssh_tunnel_buffer_is_empty(b) ((b)->len == 0)
+#define remmina_ssh_tunnel_buffer_reset(b) ((b)->len = 0)
+
+gboolean
+remmina_ssh_tunnel_buffer_fill(RemminaSSHTunnelBuffer *buffer, gint fd, gsize *count)
+{
+	gsize avail;
+	ssize_t len;
+	gchar *ptr;
+
+	while (!remmina_ssh_tunnel_buffer_is_full(buffer)) {
+		ptr = remmina_ssh_tunnel_buffer_tail(buffer, &avail);
+		len = read(fd, ptr, avail);
+		if (len > 0) {
+			remmina_ssh_tunnel_buffer_commit(buffer, len);
+			if (count)
+				*count += len;
+			continue;
+		}
+		if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			return FALSE;
+		break;
+	}
+	return TRUE;
+}
+
+gboolean
+remmina_ssh_tunnel_buffer_flush(RemminaSSHTunnelBuffer *buffer, gint fd, gsize *count)
+{
+	gsize avail;
+	ssize_t len;
+	gchar *ptr;
+
+	while (!remmina_ssh_tunnel_buffer_is_empty(buffer)) {
+		ptr = remmina_ssh_tunnel_buffer_head(buffer, &avail);
+		len = write(fd, ptr, avail);
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			break;
+		if (len <= 0)
+			return FALSE;
+		remmina_ssh_tunnel_buffer_consume(buffer, len);
+		if (count)
+			*count += len;
+	}
+	return TRUE;
+}
+
+/* Size the buffers after the SSH channel window, so a full window
+ * can be moved in one go without stalling the remote side. */
+static gsize
+remmina_ssh_tunnel_buffer_size(ssh_channel channel)
+{
+	gsize size;
+
+	size = ssh_channel_window_size(channel);
+	return CLAMP(size, REMMINA_SSH_TUNNEL_BUFFER_MIN_SIZE, REMMINA_SSH_TUNNEL_BUFFER_MAX_SIZE);
+}
+
+/* A local socket bridged to an SSH channel */
+struct _RemminaSSHTunnelChannel {
+	RemminaSSHTunnel *			tunnel;
+	ssh_channel				channel;
+	gint					sock;
+	/* Poll events currently registered in the tunnel event for sock */
+	short					events;
+	/* The local socket or the SSH channel has been closed */
+	gboolean				closing;
+	RemminaSSHTunnelBuffer *		socketbuffer;   /* channel -> socket */
+	RemminaSSHTunnelBuffer *		channelbuffer;  /* socket -> channel */
+	struct ssh_channel_callbacks_struct	cb;
+	/* Set when the connection was accepted for a borrowing tunnel */
+	RemminaSSHTunnelListener *		listener;
+};
+
+/* A borrowing tunnel, as seen by the carrier serving it. Only the carrier
+ * thread allocates and frees it; the borrower may only clear tunnel or set
+ * cancel, holding the carrier lock. */
+struct _RemminaSSHTunnelListener {
+	RemminaSSHTunnel *	tunnel;
+	gchar *			dest;
+	gint			port;
+	gint			sock;
+	gboolean		registered;
+	gboolean		cancel;
+	gint			num_channels;
+};
+
+/* Work a borrowing tunnel hands over to the carrier thread: a liveness
+ * probe when command is NULL, otherwise a command to run. Queued and
+ * completed under the carrier lock. */
+typedef struct _RemminaSSHTunnelRequest {
+	RemminaSSH *	ssh;    /* the borrower, for error messages */
+	const gchar *	command;
+	gboolean	wait;
+	gboolean	result;
+	gboolean	ran;    /* FALSE when the carrier ended first */
+	gboolean	done;
+} RemminaSSHTunnelRequest;
+
+/* Process-wide pool of shared tunnel sessions, indexed by pool key */
+static GHashTable *remmina_ssh_tunnel_pool = NULL;
+static pthread_mutex_t remmina_ssh_tunnel_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void remmina_ssh_tunnel_pool_release(RemminaSSHTunnel *carrier);
+static gboolean remmina_ssh_notify_tunnel_main_thread_end(gpointer data);
+
+/* Non blocking pipe for waking up a thread polling an ssh_event */
+static gboolean
+remmina_ssh_wakeup_pipe_new(gint wakeup[2])
+{
+	TRACE_CALL(__func__);
+	gint i;
+
+	if (pipe(wakeup)) {
+		REMMINA_WARNING("Could not create a wakeup pipe: %s", strerror(errno));
+		wakeup[0] = wakeup[1] = -1;
+		return FALSE;
+	}
+	for (i = 0; i < 2; i++)
+		fcntl(wakeup[i], F_SETFL, fcntl(wakeup[i], F_GETFL, 0) | O_NONBLOCK);
+	return TRUE;
+}
+
+static void
+remmina_ssh_wakeup_pipe_free(gint wakeup[2])
+{
+	TRACE_CALL(__func__);
+	if (wakeup[0] >= 0)
+		close(wakeup[0]);
+	if (wakeup[1] >= 0)
+		close(wakeup[1]);
+	wakeup[0] = wakeup[1] = -1;
+}
+
 RemminaSSHTunnel *
 remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile)
 {
@@ -2239,48 +2427,66 @@ remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile)
 
 	tunnel->tunnel_type = -1;
 	tunnel->channels = NULL;
-	tunnel->sockets = NULL;
-	tunnel->socketbuffers = NULL;
 	tunnel->num_channels = 0;
 	tunnel->max_channels = 0;
+	tunnel->event = NULL;
 	tunnel->thread = 0;
 	tunnel->running = FALSE;
 	tunnel->server_sock = -1;
 	tunnel->dest = NULL;
 	tunnel->port = 0;
-	tunnel->buffer = NULL;
-	tunnel->buffer_len = 0;
-	tunnel->channels_out = NULL;
+	tunnel->localport = 0;
 	tunnel->remotedisplay = 0;
 	tunnel->localdisplay = NULL;
 	tunnel->init_func = NULL;
 	tunnel->connect_func = NULL;
 	tunnel->disconnect_func = NULL;
 	tunnel->callback_data = NULL;
+	tunnel->destroy_func = NULL;
+	tunnel->destroy_func_callback_data = NULL;
+	tunnel->destroy_source = 0;
+	tunnel->carrier = NULL;
+	tunnel->listener = NULL;
+	tunnel->listeners = NULL;
+	tunnel->requests = NULL;
+	remmina_ssh_wakeup_pipe_new(tunnel->wakeup);
+	tunnel->pool_key = NULL;
+	tunnel->refcount = 0;
 
 	return tunnel;
 }
 
+static void
+remmina_ssh_tunnel_channel_free(RemminaSSHTunnelChannel *tc)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnel *tunnel = tc->tunnel;
+
+	if (tunnel->event && tc->events)
+		ssh_event_remove_fd(tunnel->event, tc->sock);
+	close(tc->sock);
+	ssh_remove_channel_callbacks(tc->channel, &tc->cb);
+	ssh_channel_close(tc->channel);
+	ssh_channel_send_eof(tc->channel);
+	ssh_channel_free(tc->channel);
+	remmina_ssh_tunnel_buffer_free(tc->socketbuffer);
+	remmina_ssh_tunnel_buffer_free(tc->channelbuffer);
+	if (tc->listener)
+		tc->listener->num_channels--;
+	g_free(tc);
+}
+
 static void
 remmina_ssh_tunnel_close_all_channels(RemminaSSHTunnel *tunnel)
 {
 	TRACE_CALL(__func__);
 	int i;
 
-	for (i = 0; i < tunnel->num_channels; i++) {
-		close(tunnel->sockets[i]);
-		remmina_ssh_tunnel_buffer_free(tunnel->socketbuffers[i]);
-		ssh_channel_close(tunnel->channels[i]);
-		ssh_channel_send_eof(tunnel->channels[i]);
-		ssh_channel_free(tunnel->channels[i]);
-	}
+	for (i = 0; i < tunnel->num_channels; i++)
+		remmina_ssh_tunnel_channel_free(tunnel->channels[i]);
 
 	g_free(tunnel->channels);
 	tunnel->channels = NULL;
-	g_free(tunnel->sockets);
-	tunnel->sockets = NULL;
-	g_free(tunnel->socketbuffers);
-	tunnel->socketbuffers = NULL;
 
 	tunnel->num_channels = 0;
 	tunnel->max_channels = 0;
@@ -2290,16 +2496,96 @@ static void
 remmina_ssh_tunnel_remove_channel(RemminaSSHTunnel *tunnel, gint n)
 {
 	TRACE_CALL(__func__);
-	ssh_channel_close(tunnel->channels[n]);
-	ssh_channel_send_eof(tunnel->channels[n]);
-	ssh_channel_free(tunnel->channels[n]);
-	close(tunnel->sockets[n]);
-	remmina_ssh_tunnel_buffer_free(tunnel->socketbuffers[n]);
+	remmina_ssh_tunnel_channel_free(tunnel->channels[n]);
 	tunnel->num_channels--;
 	tunnel->channels[n] = tunnel->channels[tunnel->num_channels];
 	tunnel->channels[tunnel->num_channels] = NULL;
-	tunnel->sockets[n] = tunnel->sockets[tunnel->num_channels];
-	tunnel->socketbuffers[n] = tunnel->socketbuffers[tunnel->num_channels];
+}
+
+/* Channel -> socket, called by libssh as soon as channel data arrives.
+ * Data goes straight to the socket when nothing is queued, otherwise it
+ * is appended to the ring buffer. Whatever does not fit is left inside
+ * libssh, which stops reopening the channel window until we drain it. */
+static int
+remmina_ssh_tunnel_channel_data_cb(ssh_session session, ssh_channel channel, void *data, uint32_t len, int is_stderr, void *userdata)
+{
+	TRACE_CALL(__func__);
+	(void)session;
+	(void)channel;
+	(void)is_stderr;
+	RemminaSSHTunnelChannel *tc = (RemminaSSHTunnelChannel *)userdata;
+	gsize done = 0, avail, n;
+	ssize_t lenw;
+	gchar *ptr;
+
+	if (tc->closing)
+		return 0;
+
+	if (remmina_ssh_tunnel_buffer_is_empty(tc->socketbuffer)) {
+		lenw = write(tc->sock, data, len);
+		if (lenw > 0) {
+			done = lenw;
+		} else if (lenw < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tc->tunnel), _("Could not send data to tunnel listening socket. %s"));
+			remmina_ssh_tunnel_buffer_reset(tc->socketbuffer);
+			tc->closing = TRUE;
+			return len;
+		}
+	}
+
+	while (done < len && !remmina_ssh_tunnel_buffer_is_full(tc->socketbuffer)) {
+		ptr = remmina_ssh_tunnel_buffer_tail(tc->socketbuffer, &avail);
+		n = MIN(avail, len - done);
+		memcpy(ptr, (gchar *)data + done, n);
+		remmina_ssh_tunnel_buffer_commit(tc->socketbuffer, n);
+		done += n;
+	}
+
+	return done;
+}
+
+static void
+remmina_ssh_tunnel_channel_eof_cb(ssh_session session, ssh_channel channel, void *userdata)
+{
+	TRACE_CALL(__func__);
+	(void)session;
+	(void)channel;
+	RemminaSSHTunnelChannel *tc = (RemminaSSHTunnelChannel *)userdata;
+
+	// TRANSLATORS: The placeholder %s is an error message
+	remmina_ssh_set_error(REMMINA_SSH(tc->tunnel), _("Could not poll SSH channel. %s"));
+	tc->closing = TRUE;
+}
+
+/* Local socket events. Only plain socket I/O happens here, everything
+ * touching the SSH session is done once ssh_event_dopoll() returns. */
+static int
+remmina_ssh_tunnel_socket_cb(socket_t fd, int revents, void *userdata)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnelChannel *tc = (RemminaSSHTunnelChannel *)userdata;
+
+	if ((revents & POLLOUT) && !remmina_ssh_tunnel_buffer_flush(tc->socketbuffer, fd, NULL)) {
+		// TRANSLATORS: The placeholder %s is an error message
+		remmina_ssh_set_error(REMMINA_SSH(tc->tunnel), _("Could not send data to tunnel listening socket. %s"));
+		remmina_ssh_tunnel_buffer_reset(tc->socketbuffer);
+		tc->closing = TRUE;
+		return 0;
+	}
+
+	if ((revents & (POLLIN | POLLHUP)) && !remmina_ssh_tunnel_buffer_fill(tc->channelbuffer, fd, NULL)) {
+		// TRANSLATORS: The placeholder %s is an error message
+		remmina_ssh_set_error(REMMINA_SSH(tc->tunnel), _("Could not read from tunnel listening socket. %s"));
+		tc->closing = TRUE;
+	}
+
+	if (revents & (POLLERR | POLLNVAL)) {
+		remmina_ssh_tunnel_buffer_reset(tc->socketbuffer);
+		tc->closing = TRUE;
+	}
+
+	return 0;
 }
 
 /* Register the new channel/socket pair */
@@ -2307,36 +2593,131 @@ static void
 remmina_ssh_tunnel_add_channel(RemminaSSHTunnel *tunnel, ssh_channel channel, gint sock)
 {
 	TRACE_CALL(__func__);
+	RemminaSSHTunnelChannel *tc;
 	gint flags;
-	gint i;
+	gsize size;
 
-	i = tunnel->num_channels++;
-	if (tunnel->num_channels > tunnel->max_channels) {
-		/* Allocate an extra NULL pointer in channels for ssh_select */
-		tunnel->channels = (ssh_channel *)g_realloc(tunnel->channels,
-							    sizeof(ssh_channel) * (tunnel->num_channels + 1));
-		tunnel->sockets = (gint *)g_realloc(tunnel->sockets,
-						    sizeof(gint) * tunnel->num_channels);
-		tunnel->socketbuffers = (RemminaSSHTunnelBuffer **)g_realloc(tunnel->socketbuffers,
-									     sizeof(RemminaSSHTunnelBuffer *) * tunnel->num_channels);
-		tunnel->max_channels = tunnel->num_channels;
-
-		tunnel->channels_out = (ssh_channel *)g_realloc(tunnel->channels_out,
-								sizeof(ssh_channel) * (tunnel->num_channels + 1));
-	}
-	tunnel->channels[i] = channel;
-	tunnel->channels[i + 1] = NULL;
-	tunnel->sockets[i] = sock;
-	tunnel->socketbuffers[i] = NULL;
+	if (tunnel->num_channels + 1 > tunnel->max_channels) {
+		tunnel->max_channels = tunnel->num_channels + 1;
+		tunnel->channels = (RemminaSSHTunnelChannel **)g_realloc(tunnel->channels,
+									 sizeof(RemminaSSHTunnelChannel *) * tunnel->max_channels);
+	}
 
 	flags = fcntl(sock, F_GETFL, 0);
 	fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+	tc = g_new0(RemminaSSHTunnelChannel, 1);
+	tc->tunnel = tunnel;
+	tc->channel = channel;
+	tc->sock = sock;
+	size = remmina_ssh_tunnel_buffer_size(channel);
+	tc->socketbuffer = remmina_ssh_tunnel_buffer_new(size);
+	tc->channelbuffer = remmina_ssh_tunnel_buffer_new(size);
+
+	tc->cb.userdata = tc;
+	tc->cb.channel_data_function = remmina_ssh_tunnel_channel_data_cb;
+	tc->cb.channel_eof_function = remmina_ssh_tunnel_channel_eof_cb;
+	tc->cb.channel_close_function = remmina_ssh_tunnel_channel_eof_cb;
+	ssh_callbacks_init(&tc->cb);
+	ssh_add_channel_callbacks(channel, &tc->cb);
+
+	tunnel->channels[tunnel->num_channels++] = tc;
+}
+
+/* Move queued socket data to the channel within the remote window, pull
+ * back channel data that libssh kept while our buffer was full, and
+ * only poll the socket for what the buffers can currently take. */
+static gboolean
+remmina_ssh_tunnel_channel_pump(RemminaSSHTunnelChannel *tc)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnel *tunnel = tc->tunnel;
+	guint32 window;
+	gsize avail;
+	ssize_t len;
+	gchar *ptr;
+	short wanted;
+
+	if (tc->listener && tc->listener->tunnel == NULL)
+		/* The borrowing tunnel has been freed */
+		return FALSE;
+
+	while (!remmina_ssh_tunnel_buffer_is_empty(tc->channelbuffer)) {
+		window = ssh_channel_window_size(tc->channel);
+		if (window == 0)
+			/* Resumed by the next window adjust, which wakes up the event */
+			break;
+		ptr = remmina_ssh_tunnel_buffer_head(tc->channelbuffer, &avail);
+		len = ssh_channel_write(tc->channel, ptr, MIN(avail, window));
+		if (len <= 0) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not write to SSH channel. %s"));
+			return FALSE;
+		}
+		remmina_ssh_tunnel_buffer_consume(tc->channelbuffer, len);
+	}
+
+	while (!remmina_ssh_tunnel_buffer_is_full(tc->socketbuffer)) {
+		len = ssh_channel_poll(tc->channel, 0);
+		if (len <= 0)
+			break;
+		ptr = remmina_ssh_tunnel_buffer_tail(tc->socketbuffer, &avail);
+		len = ssh_channel_read_nonblocking(tc->channel, ptr, MIN(avail, (gsize)len), 0);
+		if (len <= 0)
+			break;
+		remmina_ssh_tunnel_buffer_commit(tc->socketbuffer, len);
+	}
+
+	/* Keep flushing what each side sent before it closed */
+	if (tc->closing && remmina_ssh_tunnel_buffer_is_empty(tc->socketbuffer) &&
+	    (remmina_ssh_tunnel_buffer_is_empty(tc->channelbuffer) || ssh_channel_is_closed(tc->channel)))
+		return FALSE;
+
+	wanted = 0;
+	if (!tc->closing && !remmina_ssh_tunnel_buffer_is_full(tc->channelbuffer))
+		wanted |= POLLIN;
+	if (!remmina_ssh_tunnel_buffer_is_empty(tc->socketbuffer))
+		wanted |= POLLOUT;
+
+	if (wanted != tc->events) {
+		if (tc->events)
+			ssh_event_remove_fd(tunnel->event, tc->sock);
+		if (wanted && ssh_event_add_fd(tunnel->event, tc->sock, wanted, remmina_ssh_tunnel_socket_cb, tc) != SSH_OK) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel), "Could not add tunnel socket to the SSH event.");
+			tc->events = 0;
+			return FALSE;
+		}
+		tc->events = wanted;
+	}
+
+	return TRUE;
 }
 
 static int
 remmina_ssh_tunnel_accept_local_connection(RemminaSSHTunnel *tunnel, gboolean blocking)
 {
-	gint sock, sock_flags;
+	struct pollfd fds[2];
+	gint sock, sock_flags, nfds;
+
+	if (blocking) {
+		/* Wait for a connection, or to be woken up by remmina_ssh_tunnel_free()
+		 * or remmina_ssh_tunnel_cancel_accept() */
+		fds[0].fd = tunnel->server_sock;
+		fds[0].events = POLLIN;
+		fds[1].fd = tunnel->wakeup[0];
+		fds[1].events = POLLIN;
+		nfds = tunnel->wakeup[0] >= 0 ? 2 : 1;
+		do {
+			fds[0].revents = fds[1].revents = 0;
+			if (poll(fds, nfds, -1) < 0 && errno != EINTR)
+				break;
+		} while (tunnel->running && tunnel->server_sock >= 0 && !fds[0].revents && !fds[1].revents);
+		if (!tunnel->running || tunnel->server_sock < 0 || !fds[0].revents) {
+			g_free(REMMINA_SSH(tunnel)->error);
+			REMMINA_SSH(tunnel)->error = g_strdup("Local socket not accepted");
+			return -1;
+		}
+	}
 
 	sock_flags = fcntl(tunnel->server_sock, F_GETFL, 0);
 	if (blocking)
@@ -2357,8 +2738,20 @@ remmina_ssh_tunnel_accept_local_connection(RemminaSSHTunnel *tunnel, gboolean bl
 	return sock;
 }
 
+/* The listening socket only needs to wake up the event loop,
+ * connections are accepted once ssh_event_dopoll() returns */
+static int
+remmina_ssh_tunnel_server_sock_cb(socket_t fd, int revents, void *userdata)
+{
+	TRACE_CALL(__func__);
+	(void)fd;
+	(void)revents;
+	(void)userdata;
+	return 0;
+}
+
 static ssh_channel
-remmina_ssh_tunnel_create_forward_channel(RemminaSSHTunnel *tunnel)
+remmina_ssh_tunnel_create_forward_channel(RemminaSSHTunnel *tunnel, const gchar *dest, gint port)
 {
 	ssh_channel channel = NULL;
 
@@ -2370,8 +2763,8 @@ remmina_ssh_tunnel_create_forward_channel(RemminaSSHTunnel *tunnel)
 	}
 
 	/* Request the SSH server to connect to the destination */
-	REMMINA_DEBUG("SSH tunnel destination is %s", tunnel->dest);
-	if (ssh_channel_open_forward(channel, tunnel->dest, tunnel->port, "127.0.0.1", 0) != SSH_OK) {
+	REMMINA_DEBUG("SSH tunnel destination is %s", dest);
+	if (ssh_channel_open_forward(channel, dest, port, "127.0.0.1", 0) != SSH_OK) {
 		ssh_channel_close(channel);
 		ssh_channel_send_eof(channel);
 		ssh_channel_free(channel);
@@ -2383,46 +2776,296 @@ remmina_ssh_tunnel_create_forward_channel(RemminaSSHTunnel *tunnel)
 	return channel;
 }
 
-static gpointer
-remmina_ssh_tunnel_main_thread_proc(gpointer data)
+/* Bridge a channel forwarded by the server to the local X display or local port */
+static void
+remmina_ssh_tunnel_add_forwarded_channel(RemminaSSHTunnel *tunnel, ssh_channel channel)
 {
 	TRACE_CALL(__func__);
-	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
-	gchar *ptr;
-	ssize_t len = 0, lenw = 0;
-	fd_set set;
-	struct timeval timeout;
-	g_autoptr(GDateTime) t1 = NULL;
-	g_autoptr(GDateTime) t2 = NULL;
-	GTimeSpan diff;                                                 // microseconds
-	ssh_channel channel = NULL;
-	gboolean first = TRUE;
-	gboolean disconnected;
-	gint sock;
-	gint maxfd;
-	gint i;
-	gint ret;
 	struct sockaddr_in sin;
+	gint sock;
 
-	t1 = g_date_time_new_now_local();
-	t2 = g_date_time_new_now_local();
-
-	switch (tunnel->tunnel_type) {
-	case REMMINA_SSH_TUNNEL_OPEN:
-		sock = remmina_ssh_tunnel_accept_local_connection(tunnel, TRUE);
-		if (sock < 0) {
-			if (tunnel)
-				tunnel->thread = 0;
-			return NULL;
-		}
-
-		channel = remmina_ssh_tunnel_create_forward_channel(tunnel);
-		if (!tunnel) {
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(tunnel->localport);
+		sin.sin_addr.s_addr = inet_addr("127.0.0.1");
+		sock = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
+							  _("Cannot connect to local port %i."), tunnel->localport);
 			close(sock);
-			tunnel->thread = 0;
-			return NULL;
+			sock = -1;
 		}
-
+	} else {
+		sock = remmina_public_open_xdisplay(tunnel->localdisplay);
+	}
+
+	if (sock >= 0) {
+		remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
+	} else {
+		/* Failed to create unix socket. Will this happen? */
+		ssh_channel_close(channel);
+		ssh_channel_send_eof(channel);
+		ssh_channel_free(channel);
+	}
+}
+
+static int
+remmina_ssh_wakeup_cb(socket_t fd, int revents, void *userdata)
+{
+	TRACE_CALL(__func__);
+	gchar buf[64];
+
+	(void)revents;
+	(void)userdata;
+	while (read(fd, buf, sizeof(buf)) > 0);
+	return 0;
+}
+
+static void
+remmina_ssh_tunnel_wakeup(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	if (tunnel->wakeup[1] >= 0 && write(tunnel->wakeup[1], "", 1) < 0)
+		REMMINA_DEBUG("Could not wake up the SSH tunnel: %s", strerror(errno));
+}
+
+/* Tell a borrowing tunnel that it will not carry any more connections,
+ * exactly like the end of the thread of a tunnel owning its session */
+static void
+remmina_ssh_tunnel_listener_end(RemminaSSHTunnel *carrier, RemminaSSHTunnelListener *l)
+{
+	TRACE_CALL(__func__);
+	if (l->sock >= 0) {
+		if (l->registered)
+			ssh_event_remove_fd(carrier->event, l->sock);
+		close(l->sock);
+	}
+	if (l->tunnel) {
+		l->tunnel->listener = NULL;
+		if (l->tunnel->disconnect_func)
+			(*l->tunnel->disconnect_func)(l->tunnel, l->tunnel->callback_data);
+		IDLE_ADD((GSourceFunc)remmina_ssh_notify_tunnel_main_thread_end, (gpointer)l->tunnel);
+	}
+	g_free(l->dest);
+	g_free(l);
+}
+
+/* Run command on session. Errors go to ssh, which may be a borrower
+ * without a session of its own. */
+static gboolean
+remmina_ssh_session_exec(ssh_session session, RemminaSSH *ssh, const gchar *command, gboolean wait)
+{
+	TRACE_CALL(__func__);
+	ssh_channel channel;
+	gint status;
+	gboolean ret = FALSE;
+	gchar *cmd, *ptr;
+
+	if ((channel = ssh_channel_new(session)) == NULL)
+		return FALSE;
+
+	if (ssh_channel_open_session(channel) == SSH_OK &&
+	    ssh_channel_request_exec(channel, command) == SSH_OK) {
+		if (wait) {
+			ssh_channel_send_eof(channel);
+			status = ssh_channel_get_exit_status(channel);
+			cmd = g_strdup(command);
+			ptr = strchr(cmd, ' ');
+			if (ptr) *ptr = '\0';
+			switch (status) {
+			case 0:
+				ret = TRUE;
+				break;
+			case 127:
+				// TRANSLATORS: “%s” is a place holder for a unix command path.
+				remmina_ssh_set_application_error(ssh,
+								  _("The “%s” command is not available on the SSH server."), cmd);
+				break;
+			default:
+				// TRANSLATORS: “%s” is a place holder for a unix command path. “%i” is a placeholder for an error code number.
+				remmina_ssh_set_application_error(ssh,
+								  _("Could not run the “%s” command on the SSH server (status = %i)."), cmd, status);
+				break;
+			}
+			g_free(cmd);
+		} else {
+			ret = TRUE;
+		}
+	} else {
+		// TRANSLATORS: %s is a placeholder for an error message
+		remmina_ssh_set_application_error(ssh, _("Could not run command. %s"), ssh_get_error(session));
+	}
+	if (wait)
+		ssh_channel_close(channel);
+	ssh_channel_free(channel);
+	return ret;
+}
+
+/* Carrier side of remmina_ssh_tunnel_request(), between two polls */
+static void
+remmina_ssh_tunnel_serve_requests(RemminaSSHTunnel *carrier)
+{
+	TRACE_CALL(__func__);
+	ssh_session session = REMMINA_SSH(carrier)->session;
+	RemminaSSHTunnelRequest *req;
+	gboolean result;
+
+	LOCK_SSH(carrier)
+	while ((req = g_queue_pop_head(carrier->requests)) != NULL) {
+		UNLOCK_SSH(carrier)
+		if (req->command) {
+			result = remmina_ssh_session_exec(session, req->ssh, req->command, req->wait);
+		} else {
+			/* ssh_is_connected() only knows about the errors already
+			 * seen, a keepalive waits for the server to answer */
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
+			ssh_send_keepalive(session);
+#endif
+			result = ssh_is_connected(session);
+		}
+		LOCK_SSH(carrier)
+		req->result = result;
+		req->ran = TRUE;
+		req->done = TRUE;
+		pthread_cond_broadcast(&carrier->requests_done);
+	}
+	UNLOCK_SSH(carrier)
+}
+
+/* Carrier side of remmina_ssh_tunnel_accept_pending(): follow the borrowers
+ * registering, cancelling and leaving, and accept their local connections
+ * over the shared session. */
+static gboolean
+remmina_ssh_tunnel_serve_listeners(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnelListener *l;
+	ssh_channel channel;
+	GPtrArray *accepted;
+	guint i;
+	gint sock;
+
+	remmina_ssh_tunnel_serve_requests(tunnel);
+
+	/* Accept under the lock, the borrowers take it from the GTK thread.
+	 * Opening the channels is a round trip to the server, done after. */
+	accepted = g_ptr_array_new();
+	LOCK_SSH(tunnel)
+	i = 0;
+	while (i < tunnel->listeners->len) {
+		l = (RemminaSSHTunnelListener *)g_ptr_array_index(tunnel->listeners, i);
+		if (l->sock >= 0 && (l->cancel || l->tunnel == NULL)) {
+			if (l->registered)
+				ssh_event_remove_fd(tunnel->event, l->sock);
+			close(l->sock);
+			l->sock = -1;
+			l->registered = FALSE;
+		}
+		if (l->sock < 0 && l->num_channels == 0) {
+			g_ptr_array_remove_index_fast(tunnel->listeners, i);
+			remmina_ssh_tunnel_listener_end(tunnel, l);
+			continue;
+		}
+		if (l->sock >= 0 && !l->registered) {
+			ssh_event_add_fd(tunnel->event, l->sock, POLLIN, remmina_ssh_tunnel_server_sock_cb, tunnel);
+			l->registered = TRUE;
+		}
+		while (l->sock >= 0 && (sock = accept(l->sock, NULL, NULL)) >= 0) {
+			/* Keeps the listener alive until its channel is open */
+			l->num_channels++;
+			g_ptr_array_add(accepted, l);
+			g_ptr_array_add(accepted, GINT_TO_POINTER(sock));
+		}
+		i++;
+	}
+	UNLOCK_SSH(tunnel)
+
+	/* Listeners are only freed by this thread, and dest and port never change */
+	for (i = 0; i < accepted->len; i += 2) {
+		l = (RemminaSSHTunnelListener *)g_ptr_array_index(accepted, i);
+		sock = GPOINTER_TO_INT(g_ptr_array_index(accepted, i + 1));
+		channel = remmina_ssh_tunnel_create_forward_channel(tunnel, l->dest, l->port);
+		if (!channel) {
+			REMMINA_DEBUG("Could not open new SSH connection. %s", REMMINA_SSH(tunnel)->error);
+			close(sock);
+			l->num_channels--;
+			continue;
+		}
+		remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
+		tunnel->channels[tunnel->num_channels - 1]->listener = l;
+	}
+	g_ptr_array_free(accepted, TRUE);
+
+	return ssh_is_connected(REMMINA_SSH(tunnel)->session);
+}
+
+/* Pick up every connection waiting on the local listening socket or,
+ * for X11 forwarding, every channel opened by the server. Called after
+ * each wakeup of the event loop, so new connections are served at once. */
+static gboolean
+remmina_ssh_tunnel_accept_pending(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	ssh_channel channel;
+	gint sock;
+
+	switch (tunnel->tunnel_type) {
+	case REMMINA_SSH_TUNNEL_OPEN:
+		/**
+		 * Some protocols may open new connections during the session.
+		 * e.g: SPICE opens a new connection for some channels.
+		 */
+		while (tunnel->server_sock >= 0 &&
+		       (sock = remmina_ssh_tunnel_accept_local_connection(tunnel, FALSE)) >= 0) {
+			channel = remmina_ssh_tunnel_create_forward_channel(tunnel, tunnel->dest, tunnel->port);
+			if (!channel) {
+				REMMINA_DEBUG("Could not open new SSH connection. %s", REMMINA_SSH(tunnel)->error);
+				close(sock);
+				return FALSE;
+			}
+			remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
+		}
+		break;
+
+	case REMMINA_SSH_TUNNEL_XPORT:
+		while ((channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 0, &tunnel->port)) != NULL)
+			remmina_ssh_tunnel_add_forwarded_channel(tunnel, channel);
+		break;
+
+	case REMMINA_SSH_TUNNEL_SHARED:
+		return remmina_ssh_tunnel_serve_listeners(tunnel);
+	}
+
+	return TRUE;
+}
+
+static gpointer
+remmina_ssh_tunnel_main_thread_proc(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
+	ssh_channel channel = NULL;
+	gint server_sock = -1;
+	gint sock;
+	gint i;
+	gint ret;
+
+	switch (tunnel->tunnel_type) {
+	case REMMINA_SSH_TUNNEL_OPEN:
+		sock = remmina_ssh_tunnel_accept_local_connection(tunnel, TRUE);
+		if (sock < 0) {
+			if (tunnel)
+				tunnel->thread = 0;
+			return NULL;
+		}
+
+		channel = remmina_ssh_tunnel_create_forward_channel(tunnel, tunnel->dest, tunnel->port);
+		if (!channel) {
+			close(sock);
+			tunnel->thread = 0;
+			return NULL;
+		}
+
 		remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
 		break;
 
@@ -2494,197 +3137,119 @@ remmina_ssh_tunnel_main_thread_proc(gpointer data)
 		}
 
 		break;
+
+	case REMMINA_SSH_TUNNEL_SHARED:
+		/* Borrowing tunnels register their listeners later on */
+		break;
 	}
 
-	tunnel->buffer_len = 10240;
-	tunnel->buffer = g_malloc(tunnel->buffer_len);
 
-	/* Start the tunnel data transmission */
-	while (tunnel->running) {
-		if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT ||
-		    tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-			if (first) {
-				first = FALSE;
-				channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 15000, &tunnel->port);
-				if (!channel) {
-					remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("The server did not respond."));
-					if (tunnel->disconnect_func)
-						(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
-					tunnel->thread = 0;
-					return NULL;
-				}
-				if (tunnel->connect_func)
-					(*tunnel->connect_func)(tunnel, tunnel->callback_data);
-				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-					/* For reverse tunnel, we only need one connection. */
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT ||
+	    tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+		/* 15 s for the server, in slices so that remmina_ssh_tunnel_free() is not kept waiting */
+		for (i = 0; i < 30 && tunnel->running && !channel; i++)
+			channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 500, &tunnel->port);
+		if (!channel) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("The server did not respond."));
+			if (tunnel->disconnect_func)
+				(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
+			tunnel->thread = 0;
+			return NULL;
+		}
+		if (tunnel->connect_func)
+			(*tunnel->connect_func)(tunnel, tunnel->callback_data);
+		if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+			/* For reverse tunnel, we only need one connection. */
 #if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
-					ssh_channel_cancel_forward(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
+			ssh_channel_cancel_forward(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
 #else
-					ssh_forward_cancel(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
+			ssh_forward_cancel(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
 #endif
-				}
-			} else if (tunnel->tunnel_type != REMMINA_SSH_TUNNEL_REVERSE) {
-				/* Poll once per some period of time if no incoming connections.
-				 * Don’t try to poll continuously as it will significantly slow down the loop */
-				t1 = g_date_time_new_now_local();
-				diff = g_date_time_difference(t1, t2) * 10000000
-				       + g_date_time_difference(t1, t2) / 100000;
-				if (diff > 1) {
-					REMMINA_DEBUG("Polling tunnel channels");
-						channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 0, &tunnel->port);
-					if (channel == NULL)
-						t2 = g_date_time_new_now_local();
-				}
-			}
-
-			if (channel) {
-				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-					sin.sin_family = AF_INET;
-					sin.sin_port = htons(tunnel->localport);
-					sin.sin_addr.s_addr = inet_addr("127.0.0.1");
-					sock = socket(AF_INET, SOCK_STREAM, 0);
-					if (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
-						remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
-										  _("Cannot connect to local port %i."), tunnel->localport);
-						close(sock);
-						sock = -1;
-					}
-				} else
-					sock = remmina_public_open_xdisplay(tunnel->localdisplay);
-				if (sock >= 0)
-					remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
-				else {
-					/* Failed to create unix socket. Will this happen? */
-					ssh_channel_close(channel);
-					ssh_channel_send_eof(channel);
-					ssh_channel_free(channel);
-				}
-				channel = NULL;
-			}
 		}
+		remmina_ssh_tunnel_add_forwarded_channel(tunnel, channel);
+	}
 
-		if (tunnel->num_channels <= 0)
-			/* No more connections. We should quit */
-			break;
-
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 200000;
+	/* From here on the tunnel is fully event driven: the SSH session,
+	 * the bridged sockets and the listening socket all live in a single
+	 * ssh_event, and the thread sleeps until one of them has work. */
+	tunnel->event = ssh_event_new();
+	if (tunnel->event == NULL ||
+	    ssh_event_add_session(tunnel->event, REMMINA_SSH(tunnel)->session) != SSH_OK ||
+	    (tunnel->wakeup[0] >= 0 &&
+	     ssh_event_add_fd(tunnel->event, tunnel->wakeup[0], POLLIN, remmina_ssh_wakeup_cb, tunnel) != SSH_OK)) {
+		remmina_ssh_set_application_error(REMMINA_SSH(tunnel), "Could not create the SSH tunnel event.");
+		tunnel->running = FALSE;
+	}
 
-		FD_ZERO(&set);
-		maxfd = 0;
-		for (i = 0; i < tunnel->num_channels; i++) {
-			if (tunnel->sockets[i] > maxfd)
-				maxfd = tunnel->sockets[i];
-			FD_SET(tunnel->sockets[i], &set);
+	/* Start the tunnel data transmission */
+	while (tunnel->running) {
+		if (!remmina_ssh_tunnel_accept_pending(tunnel)) {
+			/* Leave thread loop */
+			tunnel->running = FALSE;
+			break;
 		}
 
-		ret = ssh_select(tunnel->channels, tunnel->channels_out, maxfd + 1, &set, &timeout);
-		if (!tunnel->running) break;
-		if (ret == SSH_EINTR) continue;
-		if (ret == -1) break;
-
 		i = 0;
-		while (tunnel->running && i < tunnel->num_channels) {
-			disconnected = FALSE;
-			if (FD_ISSET(tunnel->sockets[i], &set)) {
-				while (!disconnected &&
-				       (len = read(tunnel->sockets[i], tunnel->buffer, tunnel->buffer_len)) > 0) {
-					for (ptr = tunnel->buffer, lenw = 0; len > 0; len -= lenw, ptr += lenw) {
-						lenw = ssh_channel_write(tunnel->channels[i], (char *)ptr, len);
-						if (lenw <= 0) {
-							disconnected = TRUE;
-							// TRANSLATORS: The placeholder %s is an error message
-							remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not write to SSH channel. %s"));
-							break;
-						}
-					}
-				}
-				if (len == 0) {
-					// TRANSLATORS: The placeholder %s is an error message
-					remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read from tunnel listening socket. %s"));
-					disconnected = TRUE;
-				}
-			}
-			if (disconnected) {
-				REMMINA_DEBUG("tunnel disconnected because %s", REMMINA_SSH(tunnel)->error);
+		while (i < tunnel->num_channels) {
+			if (!remmina_ssh_tunnel_channel_pump(tunnel->channels[i])) {
+				REMMINA_DEBUG("Tunnel connection closed. %s", REMMINA_SSH(tunnel)->error);
 				remmina_ssh_tunnel_remove_channel(tunnel, i);
 				continue;
 			}
 			i++;
 		}
-		if (!tunnel->running) break;
-
-		i = 0;
-		while (tunnel->running && i < tunnel->num_channels) {
-			disconnected = FALSE;
-			if (!tunnel->socketbuffers[i]) {
-				len = ssh_channel_poll(tunnel->channels[i], 0);
-				if (len == SSH_ERROR || len == SSH_EOF) {
-					// TRANSLATORS: The placeholder %s is an error message
-					remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not poll SSH channel. %s"));
-					disconnected = TRUE;
-				} else if (len > 0) {
-					tunnel->socketbuffers[i] = remmina_ssh_tunnel_buffer_new(len);
-					len = ssh_channel_read_nonblocking(tunnel->channels[i], tunnel->socketbuffers[i]->data, len, 0);
-					if (len <= 0) {
-						// TRANSLATORS: The placeholder %s is an error message
-						remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read SSH channel in a non-blocking way. %s"));
-						disconnected = TRUE;
-					} else {
-						tunnel->socketbuffers[i]->len = len;
-					}
-				}
-			}
 
-			if (!disconnected && tunnel->socketbuffers[i]) {
-				for (lenw = 0; tunnel->socketbuffers[i]->len > 0;
-				     tunnel->socketbuffers[i]->len -= lenw, tunnel->socketbuffers[i]->ptr += lenw) {
-					lenw = write(tunnel->sockets[i], tunnel->socketbuffers[i]->ptr, tunnel->socketbuffers[i]->len);
-					if (lenw == -1 && errno == EAGAIN && tunnel->running)
-						/* Sometimes we cannot write to a socket (always EAGAIN), probably because it’s internal
-						 * buffer is full. We need read the pending bytes from the socket first. so here we simply
-						 * break, leave the buffer there, and continue with other data */
-						break;
-					if (lenw <= 0) {
-						// TRANSLATORS: The placeholder %s is an error message
-						remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not send data to tunnel listening socket. %s"));
-						disconnected = TRUE;
-						break;
-					}
-				}
-				if (tunnel->socketbuffers[i]->len <= 0) {
-					remmina_ssh_tunnel_buffer_free(tunnel->socketbuffers[i]);
-					tunnel->socketbuffers[i] = NULL;
-				}
-			}
+		if (tunnel->num_channels <= 0 && tunnel->tunnel_type != REMMINA_SSH_TUNNEL_SHARED)
+			/* No more connections. We should quit */
+			break;
 
-			if (disconnected) {
-				REMMINA_DEBUG("Connection to SSH tunnel dropped. %s", REMMINA_SSH(tunnel)->error);
-				remmina_ssh_tunnel_remove_channel(tunnel, i);
-				continue;
-			}
-			i++;
+		/* Follow remmina_ssh_tunnel_cancel_accept() */
+		if (server_sock != tunnel->server_sock) {
+			if (server_sock >= 0)
+				ssh_event_remove_fd(tunnel->event, server_sock);
+			server_sock = tunnel->server_sock;
+			if (server_sock >= 0)
+				ssh_event_add_fd(tunnel->event, server_sock, POLLIN, remmina_ssh_tunnel_server_sock_cb, tunnel);
 		}
-		/**
-		 * Some protocols may open new connections during the session.
-		 * e.g: SPICE opens a new connection for some channels.
-		 */
-		sock = remmina_ssh_tunnel_accept_local_connection(tunnel, FALSE);
-		if (sock > 0) {
-			channel = remmina_ssh_tunnel_create_forward_channel(tunnel);
-			if (!channel) {
-				REMMINA_DEBUG("Could not open new SSH connection. %s", REMMINA_SSH(tunnel)->error);
-				close(sock);
-				/* Leave thread loop */
-				tunnel->running = FALSE;
-			} else {
-				remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
-			}
+
+		ret = ssh_event_dopoll(tunnel->event, -1);
+		if (!tunnel->running) break;
+		if (ret == SSH_ERROR && !ssh_is_connected(REMMINA_SSH(tunnel)->session)) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not poll SSH channel. %s"));
+			break;
 		}
 	}
 
+	if (tunnel->event && server_sock >= 0)
+		ssh_event_remove_fd(tunnel->event, server_sock);
+
 	remmina_ssh_tunnel_close_all_channels(tunnel);
 
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_SHARED) {
+		/* The shared session is gone, so are all the borrowers */
+		RemminaSSHTunnelRequest *req;
+
+		LOCK_SSH(tunnel)
+		tunnel->running = FALSE;
+		while (tunnel->listeners->len > 0)
+			remmina_ssh_tunnel_listener_end(tunnel, g_ptr_array_remove_index_fast(tunnel->listeners, 0));
+		while ((req = g_queue_pop_head(tunnel->requests)) != NULL) {
+			req->result = FALSE;
+			req->done = TRUE;
+		}
+		pthread_cond_broadcast(&tunnel->requests_done);
+		UNLOCK_SSH(tunnel)
+	}
+
+	if (tunnel->event) {
+		if (tunnel->wakeup[0] >= 0)
+			ssh_event_remove_fd(tunnel->event, tunnel->wakeup[0]);
+		ssh_event_remove_session(tunnel->event, REMMINA_SSH(tunnel)->session);
+		ssh_event_free(tunnel->event);
+		tunnel->event = NULL;
+	}
+
 	tunnel->running = FALSE;
 
 	/* Notify tunnel owner of disconnection */
@@ -2699,6 +3264,10 @@ static gboolean remmina_ssh_notify_tunnel_main_thread_end(gpointer data)
 	TRACE_CALL(__func__);
 	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
 
+	LOCK_SSH(tunnel)
+	tunnel->destroy_source = 0;
+	UNLOCK_SSH(tunnel)
+
 	/* Ask tunnel owner to destroy tunnel object */
 	if (tunnel->destroy_func)
 		(*tunnel->destroy_func)(tunnel, tunnel->destroy_func_callback_data);
@@ -2712,16 +3281,23 @@ remmina_ssh_tunnel_main_thread(gpointer data)
 	TRACE_CALL(__func__);
 	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
 
-	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-
 	while (TRUE) {
 		remmina_ssh_tunnel_main_thread_proc(data);
 		if (tunnel->server_sock < 0 || tunnel->thread == 0 || !tunnel->running) break;
 	}
-	tunnel->thread = 0;
+	/* A shared carrier has no owner to notify, and the borrowers may free
+	 * it as soon as they are told it ended: the last one to release it
+	 * joins this thread, which must not touch the carrier any more. */
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_SHARED)
+		return NULL;
 
-	/* Do after tunnel thread cleanup */
-	IDLE_ADD((GSourceFunc)remmina_ssh_notify_tunnel_main_thread_end, (gpointer)tunnel);
+	/* Do after tunnel thread cleanup. remmina_ssh_tunnel_free() drops it
+	 * when it comes first. */
+	LOCK_SSH(tunnel)
+	tunnel->destroy_source = IDLE_ADD((GSourceFunc)remmina_ssh_notify_tunnel_main_thread_end, (gpointer)tunnel);
+	UNLOCK_SSH(tunnel)
+
+	tunnel->thread = 0;
 
 	return NULL;
 }
@@ -2731,9 +3307,20 @@ void
 remmina_ssh_tunnel_cancel_accept(RemminaSSHTunnel *tunnel)
 {
 	TRACE_CALL(__func__);
+	if (tunnel->carrier) {
+		/* The listening socket belongs to the carrier thread now */
+		LOCK_SSH(tunnel->carrier)
+		if (tunnel->listener)
+			tunnel->listener->cancel = TRUE;
+		UNLOCK_SSH(tunnel->carrier)
+		remmina_ssh_tunnel_wakeup(tunnel->carrier);
+		tunnel->server_sock = -1;
+		return;
+	}
 	if (tunnel->server_sock >= 0) {
 		close(tunnel->server_sock);
 		tunnel->server_sock = -1;
+		remmina_ssh_tunnel_wakeup(tunnel);
 	}
 }
 
@@ -2744,6 +3331,7 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	gint sock;
 	gint sockopt = 1;
 	struct sockaddr_in sin;
+	socklen_t sinlen;
 
 	tunnel->tunnel_type = REMMINA_SSH_TUNNEL_OPEN;
 	tunnel->dest = g_strdup(host);
@@ -2766,10 +3354,23 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	sin.sin_addr.s_addr = inet_addr("127.0.0.1");
 
 	if (bind(sock, (struct sockaddr *)&sin, sizeof(sin))) {
-		REMMINA_SSH(tunnel)->error = g_strdup(_("Could not bind server socket to local port."));
-		close(sock);
-		return FALSE;
+		/* Another connection is still opening through the same local
+		 * port, let the system pick a free one for this tunnel */
+		sin.sin_port = 0;
+		if (errno != EADDRINUSE || bind(sock, (struct sockaddr *)&sin, sizeof(sin))) {
+			REMMINA_SSH(tunnel)->error = g_strdup(_("Could not bind server socket to local port."));
+			close(sock);
+			return FALSE;
+		}
 	}
+	sinlen = sizeof(sin);
+	if (getsockname(sock, (struct sockaddr *)&sin, &sinlen) == 0)
+		tunnel->localport = ntohs(sin.sin_port);
+	else
+		tunnel->localport = local_port;
+	if (tunnel->localport != local_port)
+		REMMINA_WARNING("Local port %d is already in use, the tunnel to %s:%d listens on port %d instead",
+				local_port, host, port, tunnel->localport);
 
 	if (listen(sock, 1)) {
 		REMMINA_SSH(tunnel)->error = g_strdup(_("Could not listen to local port."));
@@ -2780,6 +3381,24 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	tunnel->server_sock = sock;
 	tunnel->running = TRUE;
 
+	if (tunnel->carrier) {
+		/* Let the thread of the shared session accept our connections */
+		RemminaSSHTunnelListener *l;
+
+		fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+		l = g_new0(RemminaSSHTunnelListener, 1);
+		l->tunnel = tunnel;
+		l->dest = g_strdup(tunnel->dest);
+		l->port = tunnel->port;
+		l->sock = sock;
+		LOCK_SSH(tunnel->carrier)
+		tunnel->listener = l;
+		g_ptr_array_add(tunnel->carrier->listeners, l);
+		UNLOCK_SSH(tunnel->carrier)
+		remmina_ssh_tunnel_wakeup(tunnel->carrier);
+		return TRUE;
+	}
+
 	if (pthread_create(&tunnel->thread, NULL, remmina_ssh_tunnel_main_thread, tunnel)) {
 		// TRANSLATORS: Do not translate pthread
 		remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("Could not start pthread."));
@@ -2828,6 +3447,14 @@ gboolean
 remmina_ssh_tunnel_terminated(RemminaSSHTunnel *tunnel)
 {
 	TRACE_CALL(__func__);
+	gboolean terminated;
+
+	if (tunnel->carrier) {
+		LOCK_SSH(tunnel->carrier)
+		terminated = tunnel->listener == NULL;
+		UNLOCK_SSH(tunnel->carrier)
+		return terminated;
+	}
 	return tunnel->thread == 0;
 }
 
@@ -2839,13 +3466,43 @@ remmina_ssh_tunnel_free(RemminaSSHTunnel *tunnel)
 
 	REMMINA_DEBUG("tunnel->thread = %lX\n", tunnel->thread);
 
+	if (tunnel->carrier) {
+		/* Borrowed session: detach from the carrier, which closes our
+		 * listening socket and connections, and give the session back */
+		LOCK_SSH(tunnel->carrier)
+		if (tunnel->listener) {
+			tunnel->listener->tunnel = NULL;
+			tunnel->listener->cancel = TRUE;
+			tunnel->listener = NULL;
+		}
+		UNLOCK_SSH(tunnel->carrier)
+		remmina_ssh_tunnel_wakeup(tunnel->carrier);
+		REMMINA_SSH(tunnel)->session = NULL;
+		remmina_ssh_tunnel_pool_release(tunnel->carrier);
+		tunnel->carrier = NULL;
+
+		remmina_ssh_wakeup_pipe_free(tunnel->wakeup);
+		g_free(tunnel->dest);
+		g_free(tunnel->localdisplay);
+		remmina_ssh_free((RemminaSSH *)tunnel);
+		return;
+	}
+
 	thread = tunnel->thread;
 	if (thread != 0) {
+		/* No cancellation: the thread may be holding the session or the
+		 * carrier lock. It checks running each time it is woken up. */
 		tunnel->running = FALSE;
-		pthread_cancel(thread);
+		remmina_ssh_tunnel_wakeup(tunnel);
 		pthread_join(thread, NULL);
 		tunnel->thread = 0;
 	}
+	LOCK_SSH(tunnel)
+	if (tunnel->destroy_source) {
+		g_source_remove(tunnel->destroy_source);
+		tunnel->destroy_source = 0;
+	}
+	UNLOCK_SSH(tunnel)
 
 	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT && tunnel->remotedisplay > 0) {
 #if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
@@ -2861,14 +3518,282 @@ remmina_ssh_tunnel_free(RemminaSSHTunnel *tunnel)
 
 	remmina_ssh_tunnel_close_all_channels(tunnel);
 
-	g_free(tunnel->buffer);
-	g_free(tunnel->channels_out);
+	if (tunnel->event) {
+		/* The tunnel thread ended before its own cleanup */
+		ssh_event_remove_session(tunnel->event, REMMINA_SSH(tunnel)->session);
+		ssh_event_free(tunnel->event);
+		tunnel->event = NULL;
+	}
+
+	if (tunnel->listeners) {
+		while (tunnel->listeners->len > 0) {
+			RemminaSSHTunnelListener *l = g_ptr_array_remove_index_fast(tunnel->listeners, 0);
+			if (l->sock >= 0)
+				close(l->sock);
+			if (l->tunnel)
+				l->tunnel->listener = NULL;
+			g_free(l->dest);
+			g_free(l);
+		}
+		g_ptr_array_free(tunnel->listeners, TRUE);
+	}
+	if (tunnel->requests) {
+		/* Only freed once no borrower is left to wait */
+		g_queue_free(tunnel->requests);
+		pthread_cond_destroy(&tunnel->requests_done);
+	}
+	remmina_ssh_wakeup_pipe_free(tunnel->wakeup);
+
+	g_free(tunnel->pool_key);
 	g_free(tunnel->dest);
 	g_free(tunnel->localdisplay);
 
 	remmina_ssh_free((RemminaSSH *)tunnel);
 }
 
+/*-----------------------------------------------------------------------------*
+*                           SSH tunnel sharing                                *
+*-----------------------------------------------------------------------------*/
+/* Connections to the same SSH server with the same identity can share a
+ * single authenticated session: the first tunnel to authenticate hands its
+ * session over to a carrier, and the following tunnels only open their
+ * local listening socket and let the carrier thread forward connections.
+ * This avoids a TCP connect, key exchange and authentication per tunnel. */
+static gchar *
+remmina_ssh_tunnel_pool_key(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	static guchar salt[32];
+	static gsize salt_init = 0;
+	gchar *secret, *digest, *key;
+	guint i;
+
+	/* The password and passphrase are part of the identity, only kept
+	 * as a keyed digest so that they never show in the key or the logs */
+	if (g_once_init_enter(&salt_init)) {
+		for (i = 0; i < sizeof(salt); i++)
+			salt[i] = g_random_int_range(0, 256);
+		g_once_init_leave(&salt_init, 1);
+	}
+	secret = g_strdup_printf("%s\n%s", ssh->password ? ssh->password : "", ssh->passphrase ? ssh->passphrase : "");
+	digest = g_compute_hmac_for_string(G_CHECKSUM_SHA256, salt, sizeof(salt), secret, -1);
+	memset(secret, 0, strlen(secret));
+	g_free(secret);
+
+	key = g_strdup_printf("%s@%s:%d/%d/%s/%s/%s/%s",
+			      ssh->user ? ssh->user : "",
+			      ssh->server ? ssh->server : "",
+			      ssh->port,
+			      ssh->auth,
+			      ssh->privkeyfile ? ssh->privkeyfile : "",
+			      ssh->certfile ? ssh->certfile : "",
+			      ssh->proxycommand ? ssh->proxycommand : "",
+			      digest);
+	g_free(digest);
+	return key;
+}
+
+static gboolean
+remmina_ssh_tunnel_pool_healthy(RemminaSSHTunnel *carrier)
+{
+	TRACE_CALL(__func__);
+	return carrier->running && carrier->thread != 0 &&
+	       ssh_is_connected(REMMINA_SSH(carrier)->session);
+}
+
+static void
+remmina_ssh_tunnel_pool_lease(RemminaSSHTunnel *tunnel, RemminaSSHTunnel *carrier)
+{
+	TRACE_CALL(__func__);
+	carrier->refcount++;
+	tunnel->carrier = carrier;
+	/* The session is driven by the carrier thread only, never alias it */
+	REMMINA_SSH(tunnel)->session = NULL;
+	REMMINA_SSH(tunnel)->authenticated = TRUE;
+}
+
+/* Hand a request over to the carrier thread and wait for its result */
+static gboolean
+remmina_ssh_tunnel_request(RemminaSSHTunnel *carrier, RemminaSSHTunnelRequest *req)
+{
+	TRACE_CALL(__func__);
+	LOCK_SSH(carrier)
+	if (!carrier->running) {
+		UNLOCK_SSH(carrier)
+		return FALSE;
+	}
+	g_queue_push_tail(carrier->requests, req);
+	remmina_ssh_tunnel_wakeup(carrier);
+	while (!req->done)
+		pthread_cond_wait(&carrier->requests_done, &REMMINA_SSH(carrier)->ssh_mutex);
+	UNLOCK_SSH(carrier)
+	return req->result;
+}
+
+/* Drop a dead carrier from the pool, its borrowers still hold it */
+static void
+remmina_ssh_tunnel_pool_forget(RemminaSSHTunnel *carrier)
+{
+	TRACE_CALL(__func__);
+	pthread_mutex_lock(&remmina_ssh_tunnel_pool_mutex);
+	if (remmina_ssh_tunnel_pool &&
+	    g_hash_table_lookup(remmina_ssh_tunnel_pool, carrier->pool_key) == carrier)
+		g_hash_table_remove(remmina_ssh_tunnel_pool, carrier->pool_key);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+}
+
+static void
+remmina_ssh_tunnel_pool_release(RemminaSSHTunnel *carrier)
+{
+	TRACE_CALL(__func__);
+	gboolean last;
+
+	pthread_mutex_lock(&remmina_ssh_tunnel_pool_mutex);
+	last = --carrier->refcount == 0;
+	if (last && remmina_ssh_tunnel_pool &&
+	    g_hash_table_lookup(remmina_ssh_tunnel_pool, carrier->pool_key) == carrier)
+		g_hash_table_remove(remmina_ssh_tunnel_pool, carrier->pool_key);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+
+	if (last) {
+		REMMINA_DEBUG("Closing shared SSH session %s", carrier->pool_key);
+		remmina_ssh_tunnel_free(carrier);
+	}
+}
+
+/* Borrow the session of a live carrier matching the tunnel settings.
+ * Returns FALSE when the tunnel must connect and authenticate by itself. */
+gboolean
+remmina_ssh_tunnel_pool_attach(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnelRequest probe = { 0 };
+	RemminaSSHTunnel *carrier = NULL;
+	gchar *key;
+
+	key = remmina_ssh_tunnel_pool_key(REMMINA_SSH(tunnel));
+	pthread_mutex_lock(&remmina_ssh_tunnel_pool_mutex);
+	if (remmina_ssh_tunnel_pool)
+		carrier = g_hash_table_lookup(remmina_ssh_tunnel_pool, key);
+	if (carrier && !remmina_ssh_tunnel_pool_healthy(carrier)) {
+		/* Forget it, the last borrower will free it */
+		g_hash_table_remove(remmina_ssh_tunnel_pool, key);
+		carrier = NULL;
+	}
+	if (carrier)
+		remmina_ssh_tunnel_pool_lease(tunnel, carrier);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+
+	probe.ssh = REMMINA_SSH(tunnel);
+	if (carrier && !remmina_ssh_tunnel_request(carrier, &probe)) {
+		REMMINA_DEBUG("Shared SSH session %s is not alive any more", key);
+		remmina_ssh_tunnel_pool_forget(carrier);
+		tunnel->carrier = NULL;
+		REMMINA_SSH(tunnel)->authenticated = FALSE;
+		remmina_ssh_tunnel_pool_release(carrier);
+		carrier = NULL;
+	}
+
+	if (carrier)
+		REMMINA_DEBUG("Reusing shared SSH session %s", key);
+	g_free(key);
+
+	return carrier != NULL;
+}
+
+/* Hand the authenticated session of a tunnel over to a new carrier, so that
+ * later tunnels can attach to it. The tunnel then borrows the session like
+ * any other. */
+gboolean
+remmina_ssh_tunnel_pool_share(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnel *carrier;
+	RemminaSSHTunnel *existing;
+	ssh_session session;
+
+	if (tunnel->carrier || !REMMINA_SSH(tunnel)->authenticated)
+		return FALSE;
+
+	carrier = g_new0(RemminaSSHTunnel, 1);
+	remmina_ssh_init_from_ssh(REMMINA_SSH(carrier), REMMINA_SSH(tunnel));
+	carrier->tunnel_type = REMMINA_SSH_TUNNEL_SHARED;
+	carrier->server_sock = -1;
+	carrier->listeners = g_ptr_array_new();
+	carrier->requests = g_queue_new();
+	pthread_cond_init(&carrier->requests_done, NULL);
+	carrier->pool_key = remmina_ssh_tunnel_pool_key(REMMINA_SSH(tunnel));
+
+	if (!remmina_ssh_wakeup_pipe_new(carrier->wakeup)) {
+		remmina_ssh_tunnel_free(carrier);
+		return FALSE;
+	}
+
+	pthread_mutex_lock(&remmina_ssh_tunnel_pool_mutex);
+	if (!remmina_ssh_tunnel_pool)
+		remmina_ssh_tunnel_pool = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	existing = g_hash_table_lookup(remmina_ssh_tunnel_pool, carrier->pool_key);
+	if (existing && remmina_ssh_tunnel_pool_healthy(existing)) {
+		/* Another connection won the race, use its session and drop ours */
+		session = REMMINA_SSH(tunnel)->session;
+		remmina_ssh_tunnel_pool_lease(tunnel, existing);
+		pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+		remmina_ssh_tunnel_free(carrier);
+		ssh_disconnect(session);
+		ssh_free(session);
+		return TRUE;
+	}
+
+	/* The carrier takes over the session, including its callbacks */
+	REMMINA_SSH(carrier)->session = REMMINA_SSH(tunnel)->session;
+	REMMINA_SSH(carrier)->callback = REMMINA_SSH(tunnel)->callback;
+	REMMINA_SSH(carrier)->authenticated = TRUE;
+	if (REMMINA_SSH(carrier)->callback)
+		REMMINA_SSH(carrier)->callback->userdata = carrier;
+	REMMINA_SSH(tunnel)->callback = NULL;
+
+	carrier->running = TRUE;
+	if (pthread_create(&carrier->thread, NULL, remmina_ssh_tunnel_main_thread, carrier)) {
+		carrier->thread = 0;
+		REMMINA_SSH(carrier)->session = NULL;
+		REMMINA_SSH(tunnel)->callback = REMMINA_SSH(carrier)->callback;
+		REMMINA_SSH(carrier)->callback = NULL;
+		if (REMMINA_SSH(tunnel)->callback)
+			REMMINA_SSH(tunnel)->callback->userdata = tunnel;
+		pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+		remmina_ssh_tunnel_free(carrier);
+		return FALSE;
+	}
+
+	g_hash_table_replace(remmina_ssh_tunnel_pool, g_strdup(carrier->pool_key), carrier);
+	remmina_ssh_tunnel_pool_lease(tunnel, carrier);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_pool_mutex);
+
+	REMMINA_DEBUG("Sharing SSH session %s", carrier->pool_key);
+
+	return TRUE;
+}
+
+gboolean
+remmina_ssh_tunnel_exec(RemminaSSHTunnel *tunnel, const gchar *command, gboolean wait)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnelRequest req = { 0 };
+
+	if (!tunnel->carrier)
+		return remmina_ssh_session_exec(REMMINA_SSH(tunnel)->session, REMMINA_SSH(tunnel), command, wait);
+
+	req.ssh = REMMINA_SSH(tunnel);
+	req.command = command;
+	req.wait = wait;
+	if (!remmina_ssh_tunnel_request(tunnel->carrier, &req) && !req.ran) {
+		// TRANSLATORS: %s is a placeholder for an error message
+		remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("Could not run command. %s"),
+						  _("The shared SSH connection was closed."));
+	}
+	return req.result;
+}
+
 /*-----------------------------------------------------------------------------*
 *                           SSH SFTP                                          *
 *-----------------------------------------------------------------------------*/
@@ -2946,6 +3871,10 @@ remmina_ssh_shell_new_from_file(RemminaFile *remminafile)
 
 	shell->master = -1;
 	shell->slave = -1;
+	shell->columns = 80;
+	shell->rows = 24;
+	shell->channels = g_ptr_array_new_with_free_func(remmina_ssh_free_item);
+	remmina_ssh_wakeup_pipe_new(shell->wakeup);
 	shell->exec = g_strdup(remmina_file_get_string(remminafile, "exec"));
 	shell->run_line = g_strdup(remmina_file_get_string(remminafile, "run_line"));
 
@@ -2964,6 +3893,10 @@ remmina_ssh_shell_new_from_ssh(RemminaSSH *ssh)
 
 	shell->master = -1;
 	shell->slave = -1;
+	shell->columns = 80;
+	shell->rows = 24;
+	shell->channels = g_ptr_array_new_with_free_func(remmina_ssh_free_item);
+	remmina_ssh_wakeup_pipe_new(shell->wakeup);
 
 	return shell;
 }
@@ -2974,6 +3907,10 @@ remmina_ssh_call_exit_callback_on_main_thread(gpointer data)
 	TRACE_CALL(__func__);
 
 	RemminaSSHShell *shell = (RemminaSSHShell *)data;
+
+	LOCK_SSH(shell)
+	shell->exit_source = 0;
+	UNLOCK_SSH(shell)
 	if (shell->exit_callback)
 		shell->exit_callback(shell->user_data);
 	if (shell) {
@@ -2983,6 +3920,117 @@ remmina_ssh_call_exit_callback_on_main_thread(gpointer data)
 	return FALSE;
 }
 
+gboolean
+remmina_ssh_shell_request_x11(RemminaSSHShell *shell, ssh_channel channel)
+{
+	TRACE_CALL(__func__);
+	const char *display;
+	char *proto = NULL, *cookie = NULL;
+
+	if (!shell->x11_callbacks) {
+		shell->x11_callbacks = g_new0(struct ssh_callbacks_struct, 1);
+		shell->x11_callbacks->channel_open_request_x11_function = remmina_ssh_x11_open_request_cb;
+		shell->x11_callbacks->userdata = shell;
+		ssh_callbacks_init(shell->x11_callbacks);
+	}
+	ssh_set_callbacks(REMMINA_SSH(shell)->session, shell->x11_callbacks);
+
+	display = getenv("DISPLAY");
+	if (remmina_ssh_x11_get_proto(display, &proto, &cookie) != 0) {
+		REMMINA_DEBUG("Using fake authentication data for X11 forwarding");
+		proto = NULL;
+		cookie = NULL;
+	}
+
+	REMMINA_DEBUG("proto: %s - cookie: %s", proto, cookie);
+	if (ssh_channel_request_x11(channel, 0, proto, cookie, 0) != SSH_OK) {
+		REMMINA_WARNING("ssh_channel_request_x11 failed.");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+gboolean
+remmina_ssh_shell_relay(RemminaSSHShell *shell)
+{
+	TRACE_CALL(__func__);
+	node_t *relay;
+	gint ret;
+
+	LOCK_SSH(shell)
+
+	// Create new event context.
+	shell->event = ssh_event_new();
+	if (shell->event == NULL) {
+		UNLOCK_SSH(shell)
+		REMMINA_WARNING("Internal error in %s: Couldn't get a event.", __func__);
+		return FALSE;
+	}
+
+	REMMINA_DEBUG("shell->slave: %d", shell->slave);
+
+	relay = remmina_ssh_insert_item(shell, shell->channel, shell->slave, shell->slave, TRUE);
+
+	// Add the fd to the event and assign it the callback.
+	if (ssh_event_add_fd(shell->event, shell->slave, events, remmina_ssh_cp_to_ch_cb, relay) != SSH_OK) {
+		UNLOCK_SSH(shell)
+		REMMINA_WARNING("Internal error in %s: Couldn't add an fd to the event.", __func__);
+		return FALSE;
+	}
+
+	// Leave the loop below as soon as remmina_ssh_shell_free() is called.
+	if (shell->wakeup[0] >= 0 &&
+	    ssh_event_add_fd(shell->event, shell->wakeup[0], POLLIN, remmina_ssh_wakeup_cb, NULL) != SSH_OK) {
+		UNLOCK_SSH(shell)
+		REMMINA_WARNING("Internal error in %s: Couldn't add an fd to the event.", __func__);
+		return FALSE;
+	}
+
+	// Remove the poll handle from session and assign them to the event.
+	if (ssh_event_add_session(shell->event, REMMINA_SSH(shell)->session) != SSH_OK) {
+		UNLOCK_SSH(shell)
+		REMMINA_WARNING("Internal error in %s: Couldn't add the session to the event.", __func__);
+		return FALSE;
+	}
+
+	// Set the channel callback functions.
+	ssh_set_channel_callbacks(shell->channel, &relay->cb);
+	UNLOCK_SSH(shell)
+
+	do {
+		ssh_event_dopoll(shell->event, 1000);
+	} while(!shell->closed && !ssh_channel_is_closed(shell->channel));
+
+	// Close all OPENED X11 channel
+	remmina_ssh_close_all_x11_ch(shell);
+
+	LOCK_SSH(shell)
+
+	// Remove socket fd from event context.
+	ret = ssh_event_remove_fd(shell->event, shell->slave);
+	REMMINA_DEBUG("Remove socket fd from event context: %d", ret);
+	if (shell->wakeup[0] >= 0)
+		ssh_event_remove_fd(shell->event, shell->wakeup[0]);
+
+	// Remove session object from event context.
+	ret = ssh_event_remove_session(shell->event, REMMINA_SSH(shell)->session);
+	REMMINA_DEBUG("Remove session object from event context: %d", ret);
+
+	// Free event context.
+	ssh_event_free(shell->event);
+	shell->event = NULL;
+	REMMINA_DEBUG("Free event context");
+
+	// Remove channel callback.
+	ret = ssh_remove_channel_callbacks(shell->channel, &relay->cb);
+	REMMINA_DEBUG("Remove channel callback: %d", ret);
+	g_ptr_array_remove_fast(shell->channels, relay);
+
+	UNLOCK_SSH(shell)
+
+	return TRUE;
+}
+
 static gpointer
 remmina_ssh_shell_thread(gpointer data)
 {
@@ -2996,7 +4044,6 @@ remmina_ssh_shell_thread(gpointer data)
 	gchar *filename;
 	const gchar *dir;
 	const gchar *sshlogname;
-	FILE *fp = NULL;
 
 	//gint screen;
 
@@ -3012,33 +4059,12 @@ remmina_ssh_shell_thread(gpointer data)
 		return NULL;
 	}
 
-	ssh_channel_request_pty(channel);
-
-	// SSH Callbacks
-	struct ssh_callbacks_struct cb =
-	{
-		.channel_open_request_x11_function = remmina_ssh_x11_open_request_cb,
-		.userdata = shell,
-	};
-
-	if (remmina_file_get_int(remminafile, "ssh_forward_x11", FALSE)) {
-		ssh_callbacks_init(&cb);
-		ssh_set_callbacks(REMMINA_SSH(shell)->session, &cb);
-
-		const char *display = getenv("DISPLAY");
-		char *proto = NULL, *cookie = NULL;
-		if (remmina_ssh_x11_get_proto(display, &proto, &cookie) != 0) {
-			REMMINA_DEBUG("Using fake authentication data for X11 forwarding");
-			proto = NULL;
-			cookie = NULL;
-		}
+	ssh_channel_request_pty_size(channel, "xterm", shell->columns, shell->rows);
 
-		REMMINA_DEBUG("proto: %s - cookie: %s", proto, cookie);
-		ret = ssh_channel_request_x11(channel, 0, proto, cookie, 0);
-		if (ret != SSH_OK) {
-			REMMINA_WARNING("ssh_channel_request_x11 failed.");
-			return NULL;
-		}
+	if (remmina_file_get_int(remminafile, "ssh_forward_x11", FALSE) &&
+	    !remmina_ssh_shell_request_x11(shell, channel)) {
+		UNLOCK_SSH(shell)
+		return NULL;
 	}
 
 	if (shell->exec && shell->exec[0]) {
@@ -3078,9 +4104,13 @@ remmina_ssh_shell_thread(gpointer data)
 	sshlogname = remmina_file_format_properties(remminafile, sshlogname);
 	filename = g_strconcat(dir, "/", sshlogname, NULL);
 
+	/* The plugin saves the terminal contents to filename when the session
+	 * ends, the recording goes next to it with its own extensions */
 	if (remmina_file_get_int (remminafile, "sshsavesession", FALSE)) {
-		REMMINA_DEBUG("Saving session log to %s", filename);
-		fp = fopen(filename, "w");
+		/* Locked, so that no resize falls between the size and the recorder */
+		LOCK_SSH(shell)
+		shell->recorder = remmina_ssh_recorder_new(filename, shell->columns, shell->rows);
+		UNLOCK_SSH(shell)
 	}
 
 	g_free(filename);
@@ -3095,77 +4125,27 @@ remmina_ssh_shell_thread(gpointer data)
 		REMMINA_DEBUG("Run_line written to channel");
 	}
 
-	LOCK_SSH(shell)
-
-	// Create new event context.
-	shell->event = ssh_event_new();
-	if (shell->event == NULL) {
-		REMMINA_WARNING("Internal error in %s: Couldn't get a event.", __func__);
+	if (!remmina_ssh_shell_relay(shell))
 		return NULL;
-	}
-
-	REMMINA_DEBUG("shell->slave: %d", shell->slave);
-
-	// Add the fd to the event and assign it the callback.
-	if (ssh_event_add_fd(shell->event, shell->slave, events, remmina_ssh_cp_to_ch_cb, channel) != SSH_OK) {
-		REMMINA_WARNING("Internal error in %s: Couldn't add an fd to the event.", __func__);
-		return NULL;
-	}
-
-	// Remove the poll handle from session and assign them to the event.
-	if (ssh_event_add_session(shell->event, REMMINA_SSH(shell)->session) != SSH_OK) {
-		REMMINA_WARNING("Internal error in %s: Couldn't add the session to the event.", __func__);
-		return NULL;
-	}
-
-	remmina_ssh_insert_item(shell->channel, shell->slave, shell->slave, TRUE, shell->thread);
-
-	// Initializes the ssh_callbacks_struct.
-	channel_cb.userdata = &shell;
-	ssh_callbacks_init(&channel_cb);
-	// Set the channel callback functions.
-	ssh_set_channel_callbacks(shell->channel, &channel_cb);
-	UNLOCK_SSH(shell)
-
-	do {
-		ssh_event_dopoll(shell->event, 1000);
-	} while(!ssh_channel_is_closed(shell->channel));
-
-	// Close all OPENED X11 channel
-	remmina_ssh_close_all_x11_ch(shell->thread);
 
 	shell->closed = TRUE;
 
 	LOCK_SSH(shell)
-
-	// Remove socket fd from event context.
-	ret = ssh_event_remove_fd(shell->event, shell->slave);
-	REMMINA_DEBUG("Remove socket fd from event context: %d", ret);
-
-	// Remove session object from event context.
-	ret = ssh_event_remove_session(shell->event, REMMINA_SSH(shell)->session);
-	REMMINA_DEBUG("Remove session object from event context: %d", ret);
-
-	// Free event context.
-	ssh_event_free(shell->event);
-	REMMINA_DEBUG("Free event context");
-
-	// Remove channel callback.
-	ret = ssh_remove_channel_callbacks(shell->channel, &channel_cb);
-	REMMINA_DEBUG("Remove channel callback: %d", ret);
-
-	if (remmina_file_get_int (remminafile, "sshsavesession", FALSE))
-		fclose(fp);
+	remmina_ssh_recorder_free(shell->recorder);
+	shell->recorder = NULL;
 	shell->channel = NULL;
 	ssh_channel_close(channel);
 	ssh_channel_send_eof(channel);
 	ssh_channel_free(channel);
 	UNLOCK_SSH(shell)
 
-	shell->thread = 0;
-
+	/* remmina_ssh_shell_free() drops it when it comes first */
+	LOCK_SSH(shell)
 	if (shell->exit_callback)
-		IDLE_ADD((GSourceFunc)remmina_ssh_call_exit_callback_on_main_thread, (gpointer)shell);
+		shell->exit_source = IDLE_ADD((GSourceFunc)remmina_ssh_call_exit_callback_on_main_thread, (gpointer)shell);
+	UNLOCK_SSH(shell)
+
+	shell->thread = 0;
 	return NULL;
 }
 
@@ -3209,8 +4189,11 @@ remmina_ssh_shell_set_size(RemminaSSHShell *shell, gint columns, gint rows)
 {
 	TRACE_CALL(__func__);
 	LOCK_SSH(shell)
+	shell->columns = columns;
+	shell->rows = rows;
 	if (shell->channel)
 		ssh_channel_change_pty_size(shell->channel, columns, rows);
+	remmina_ssh_recorder_resize(shell->recorder, columns, rows);
 	UNLOCK_SSH(shell)
 }
 
@@ -3218,17 +4201,36 @@ void
 remmina_ssh_shell_free(RemminaSSHShell *shell)
 {
 	TRACE_CALL(__func__);
+	struct ssh_callbacks_struct *x11_callbacks;
+	pthread_t thread;
 
 	// Close all OPENED X11 channel
-	remmina_ssh_close_all_x11_ch(shell->thread);
+	remmina_ssh_close_all_x11_ch(shell);
 
 	shell->exit_callback = NULL;
 	shell->closed = TRUE;
-	REMMINA_DEBUG("Cancelling the shell thread if needed");
-	if (shell->thread) {
-		pthread_cancel(shell->thread);
-		if (shell->thread) pthread_join(shell->thread, NULL);
+	thread = shell->thread;
+	if (thread) {
+		/* No cancellation: the thread may be holding the session lock */
+		REMMINA_DEBUG("Stopping the shell thread");
+		if (shell->wakeup[1] >= 0 && write(shell->wakeup[1], "", 1) < 0)
+			REMMINA_DEBUG("Could not wake up the SSH shell: %s", strerror(errno));
+		pthread_join(thread, NULL);
+		shell->thread = 0;
 	}
+	LOCK_SSH(shell)
+	if (shell->exit_source) {
+		g_source_remove(shell->exit_source);
+		shell->exit_source = 0;
+	}
+	UNLOCK_SSH(shell)
+	remmina_ssh_wakeup_pipe_free(shell->wakeup);
+	g_ptr_array_free(shell->channels, TRUE);
+	shell->channels = NULL;
+	remmina_ssh_recorder_free(shell->recorder);
+	shell->recorder = NULL;
+	remmina_ssh_search_index_unref(shell->search_index);
+	shell->search_index = NULL;
 	close(shell->slave);
 	if (shell->exec) {
 		g_free(shell->exec);
@@ -3239,7 +4241,9 @@ remmina_ssh_shell_free(RemminaSSHShell *shell)
 		shell->run_line = NULL;
 	}
 	/* It’s not necessary to close shell->slave since the other end (vte) will close it */
+	x11_callbacks = shell->x11_callbacks;
 	remmina_ssh_free(REMMINA_SSH(shell));
+	g_free(x11_callbacks);
 }
 
 #endif /* HAVE_LIBSSH */
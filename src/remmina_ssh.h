@@ -46,6 +46,8 @@
 #include <libssh/sftp.h>
 #include <pthread.h>
 #include "remmina_file.h"
+#include "remmina_ssh_recorder.h"
+#include "remmina_ssh_search_index.h"
 #include "rcw.h"
 
 G_BEGIN_DECLS
@@ -138,13 +140,34 @@ void remmina_ssh_free(RemminaSSH *ssh);
 *-----------------------------------------------------------------------------*/
 typedef struct _RemminaSSHTunnel RemminaSSHTunnel;
 typedef struct _RemminaSSHTunnelBuffer RemminaSSHTunnelBuffer;
+typedef struct _RemminaSSHTunnelChannel RemminaSSHTunnelChannel;
+typedef struct _RemminaSSHTunnelListener RemminaSSHTunnelListener;
 
 typedef gboolean (*RemminaSSHTunnelCallback) (RemminaSSHTunnel *, gpointer);
 
+/* Ring buffer the tunnel relays data through, one per direction. tail()
+ * returns the contiguous free region and commit() queues what was stored
+ * there, head() returns the contiguous queued region and consume() drops
+ * what was sent from it. */
+RemminaSSHTunnelBuffer *remmina_ssh_tunnel_buffer_new(gsize size);
+void remmina_ssh_tunnel_buffer_free(RemminaSSHTunnelBuffer *buffer);
+gchar *remmina_ssh_tunnel_buffer_tail(RemminaSSHTunnelBuffer *buffer, gsize *avail);
+gchar *remmina_ssh_tunnel_buffer_head(RemminaSSHTunnelBuffer *buffer, gsize *avail);
+void remmina_ssh_tunnel_buffer_commit(RemminaSSHTunnelBuffer *buffer, gsize len);
+void remmina_ssh_tunnel_buffer_consume(RemminaSSHTunnelBuffer *buffer, gsize len);
+/* The socket side of a tunnel channel, for a non blocking fd. fill() reads
+ * until the buffer is full or the socket is drained, flush() writes until
+ * the buffer is empty or the socket is full. Both add the bytes moved to
+ * *count when it is not NULL, and return FALSE once the socket is closed
+ * or failed. */
+gboolean remmina_ssh_tunnel_buffer_fill(RemminaSSHTunnelBuffer *buffer, gint fd, gsize *count);
+gboolean remmina_ssh_tunnel_buffer_flush(RemminaSSHTunnelBuffer *buffer, gint fd, gsize *count);
+
 enum {
 	REMMINA_SSH_TUNNEL_OPEN,
 	REMMINA_SSH_TUNNEL_XPORT,
-	REMMINA_SSH_TUNNEL_REVERSE
+	REMMINA_SSH_TUNNEL_REVERSE,
+	REMMINA_SSH_TUNNEL_SHARED
 };
 
 
@@ -153,18 +176,16 @@ struct _RemminaSSHTunnel {
 
 	gint				tunnel_type;
 
-	ssh_channel *			channels;
-	gint *				sockets;
-	RemminaSSHTunnelBuffer **	socketbuffers;
+	RemminaSSHTunnelChannel **	channels;
 	gint				num_channels;
 	gint				max_channels;
+	ssh_event			event;
 
 	pthread_t			thread;
 	gboolean			running;
-
-	gchar *				buffer;
-	gint				buffer_len;
-	ssh_channel *			channels_out;
+	/* Written to after clearing running, so that the thread leaves its
+	 * poll and ends by itself, see remmina_ssh_tunnel_free() */
+	gint				wakeup[2];
 
 	gint				server_sock;
 	gchar *				dest;
@@ -182,7 +203,20 @@ struct _RemminaSSHTunnel {
 
 	RemminaSSHTunnelCallback	destroy_func;
 	gpointer	destroy_func_callback_data;
-
+	/* Idle source calling destroy_func once the thread ended, under the tunnel lock */
+	guint				destroy_source;
+
+	/* Connection sharing. A tunnel attached to the pool uses the session
+	 * of a shared tunnel (the carrier) without touching it: the carrier
+	 * thread serves the local listeners of all its borrowers and runs
+	 * their requests, see remmina_ssh_tunnel_exec(). */
+	RemminaSSHTunnel *		carrier;
+	RemminaSSHTunnelListener *	listener;
+	GPtrArray *			listeners;
+	GQueue *			requests;
+	pthread_cond_t			requests_done;
+	gchar *				pool_key;
+	gint				refcount;
 };
 
 /* Create a new SSH Tunnel session and connects to the SSH server */
@@ -190,7 +224,10 @@ RemminaSSHTunnel *remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile);
 
 /* Open the tunnel. A new thread will be started and listen on a local port.
  * dest: The host:port of the remote destination
- * local_port: The listening local port for the tunnel
+ * local_port: The listening local port for the tunnel. When it is already
+ *             in use, a free port is picked and a warning is logged. The
+ *             port actually used is stored in localport, callers must
+ *             connect there and tell the user when it differs.
  */
 gboolean remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port, gint local_port);
 
@@ -216,6 +253,24 @@ gboolean remmina_ssh_tunnel_terminated(RemminaSSHTunnel *tunnel);
 /* Free the tunnel */
 void remmina_ssh_tunnel_free(RemminaSSHTunnel *tunnel);
 
+/* Run a command on the SSH server of the tunnel. With wait, returns TRUE
+ * only if it exits with status 0. On a borrowed session the command is run
+ * by the carrier thread, the only one driving that session. */
+gboolean remmina_ssh_tunnel_exec(RemminaSSHTunnel *tunnel, const gchar *command, gboolean wait);
+
+/* Borrow an already authenticated session to the same SSH server, with the
+ * same user, authentication method and credentials, from the process-wide
+ * pool. The server is asked whether the session is still alive first.
+ * Returns FALSE if there is no live one, the tunnel must then be connected
+ * and authenticated.
+ */
+gboolean remmina_ssh_tunnel_pool_attach(RemminaSSHTunnel *tunnel);
+
+/* Put the session of a newly authenticated tunnel in the pool, so other
+ * tunnels can attach to it. The tunnel itself becomes its first borrower.
+ */
+gboolean remmina_ssh_tunnel_pool_share(RemminaSSHTunnel *tunnel);
+
 /*-----------------------------------------------------------------------------*
 *                           SSH sFTP                                          *
 *-----------------------------------------------------------------------------*/
@@ -251,11 +306,22 @@ typedef struct _RemminaSSHShell {
 	gchar *			exec;
 	gchar *			run_line;
 	pthread_t		thread;
+	/* Wakes up the relay once closed is set, see remmina_ssh_shell_free() */
+	gint			wakeup[2];
 	ssh_channel		channel;
+	/* Terminal size, kept for the pty and the recording made when the channel opens */
+	gint			columns;
+	gint			rows;
 	gboolean		closed;
 	RemminaSSHExitFunc	exit_callback;
 	gpointer		user_data;
+	/* Idle source calling exit_callback once the thread ended, under the shell lock */
+	guint			exit_source;
 	ssh_event		event;
+	GPtrArray *		channels;
+	RemminaSSHRecorder *	recorder;
+	RemminaSSHSearchIndex *	search_index;
+	struct ssh_callbacks_struct *	x11_callbacks;
 } RemminaSSHShell;
 
 /* Create a new SSH Shell session object from RemminaFile */
@@ -267,6 +333,14 @@ RemminaSSHShell *remmina_ssh_shell_new_from_ssh(RemminaSSH *ssh);
 /* open the SSH Shell, assuming the session already authenticated */
 gboolean remmina_ssh_shell_open(RemminaSSHShell *shell, RemminaSSHExitFunc exit_callback, gpointer data);
 
+/* Have the X11 connections of the session on channel forwarded to the
+ * local display. Called with the shell locked, before the shell or exec request */
+gboolean remmina_ssh_shell_request_x11(RemminaSSHShell *shell, ssh_channel channel);
+
+/* Relay shell->slave and the forwarded X11 connections to shell->channel
+ * until the channel closes. Runs on the thread driving the session */
+gboolean remmina_ssh_shell_relay(RemminaSSHShell *shell);
+
 /* Change the SSH Shell terminal size */
 void remmina_ssh_shell_set_size(RemminaSSHShell *shell, gint columns, gint rows);
 
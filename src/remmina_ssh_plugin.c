@@ -222,6 +222,13 @@ typedef struct _RemminaSshSearch {
 	gboolean		regex_caseless;
 	gboolean		has_regex;
 	gchar *			regex_pattern;
+
+	/* Search through the scrollback index, see remmina_ssh_search_index.h */
+	GRegex *		index_regex;
+	gchar *			index_literal;
+	GArray *		index_rows;
+	guint			index_generation;
+	gint64			index_row;
 } RemminaSshSearch;
 
 typedef struct _RemminaPluginSshData {
@@ -236,6 +243,11 @@ typedef struct _RemminaPluginSshData {
 	gboolean		closed;
 
 	RemminaSshSearch *	search_widget;
+	RemminaSSHSearchIndex *	search_index;
+
+	/* Last terminal size seen in size-allocate, used for the pty before the shell exists */
+	gint			columns;
+	gint			rows;
 } RemminaPluginSshData;
 
 
@@ -296,6 +308,9 @@ remmina_plugin_ssh_main_thread(gpointer data)
 	if (ssh) {
 		REMMINA_DEBUG("Creating SSH shell based on existing SSH session");
 		shell = remmina_ssh_shell_new_from_ssh(ssh);
+		shell->search_index = remmina_ssh_search_index_ref(gpdata->search_index);
+		if (gpdata->columns > 0 && gpdata->rows > 0)
+			remmina_ssh_shell_set_size(shell, gpdata->columns, gpdata->rows);
 		REMMINA_DEBUG("Calling remmina_public_get_server_port");
 		remmina_plugin_service->get_server_port(hostport, 22, &ssh->tunnel_entrance_host, &ssh->tunnel_entrance_port);
 		REMMINA_DEBUG("tunnel_entrance_host: %s, tunnel_entrance_port: %d", ssh->tunnel_entrance_host, ssh->tunnel_entrance_port);
@@ -309,6 +324,9 @@ remmina_plugin_ssh_main_thread(gpointer data)
 		/* New SSH Shell connection */
 		REMMINA_DEBUG("Creating SSH shell based on a new SSH session");
 		shell = remmina_ssh_shell_new_from_file(remminafile);
+		shell->search_index = remmina_ssh_search_index_ref(gpdata->search_index);
+		if (gpdata->columns > 0 && gpdata->rows > 0)
+			remmina_ssh_shell_set_size(shell, gpdata->columns, gpdata->rows);
 		ssh = REMMINA_SSH(shell);
 		REMMINA_DEBUG("Calling remmina_public_get_server_port");
 		remmina_plugin_service->get_server_port(hostport, 22, &ssh->tunnel_entrance_host, &ssh->tunnel_entrance_port);
@@ -457,8 +475,12 @@ remmina_plugin_ssh_on_size_allocate(GtkWidget *widget, GtkAllocation *alloc, Rem
 	cols = vte_terminal_get_column_count(VTE_TERMINAL(widget));
 	rows = vte_terminal_get_row_count(VTE_TERMINAL(widget));
 
+	gpdata->columns = cols;
+	gpdata->rows = rows;
 	if (gpdata->shell)
 		remmina_ssh_shell_set_size(gpdata->shell, cols, rows);
+	if (gpdata->search_index)
+		remmina_ssh_search_index_set_size(gpdata->search_index, cols, rows);
 
 	return FALSE;
 }
@@ -493,6 +515,14 @@ remmina_plugin_ssh_set_vte_pref(RemminaProtocolWidget *gp)
 #endif
 	if (remmina_pref.vte_lines > 0)
 		vte_terminal_set_scrollback_lines(VTE_TERMINAL(gpdata->vte), remmina_pref.vte_lines);
+
+	/* The index does not need to remember more than VTE */
+	if (gpdata->search_index) {
+		guint scrollback;
+
+		g_object_get(gpdata->vte, "scrollback-lines", &scrollback, NULL);
+		remmina_ssh_search_index_set_scrollback(gpdata->search_index, scrollback);
+	}
 }
 
 void
@@ -624,6 +654,89 @@ remmina_search_widget_update_sensitivity(RemminaSshSearch *search_widget)
 	gtk_widget_set_sensitive(search_widget->search_prev_button, can_search);
 }
 
+static void
+remmina_search_widget_index_reset(RemminaSshSearch *search_widget)
+{
+	TRACE_CALL(__func__);
+
+	if (search_widget->index_regex)
+		g_regex_unref(search_widget->index_regex);
+	search_widget->index_regex = NULL;
+	g_free(search_widget->index_literal);
+	search_widget->index_literal = NULL;
+	if (search_widget->index_rows)
+		g_array_unref(search_widget->index_rows);
+	search_widget->index_rows = NULL;
+	search_widget->index_row = -1;
+}
+
+/* Move to the next or previous match found in the scrollback index, then
+ * let VTE highlight it. With no selection VTE searches from the visible
+ * rows, so once the match is in view it does not rescan the scrollback.
+ * Rows in the index are estimated from the output, VTE corrects small
+ * differences. Returns FALSE when the index cannot be used or has no
+ * match, so that VTE searches its own buffer instead. */
+static gboolean
+remmina_search_widget_index_step(RemminaPluginSshData *gpdata, gboolean forward)
+{
+	TRACE_CALL(__func__);
+	RemminaSshSearch *search_widget = gpdata->search_widget;
+	GtkAdjustment *vadjustment;
+	guint generation, lo, hi, mid;
+	gint64 from, row;
+
+	if (!gpdata->search_index || !search_widget->index_regex)
+		return FALSE;
+
+	generation = remmina_ssh_search_index_get_generation(gpdata->search_index);
+	if (!search_widget->index_rows || generation != search_widget->index_generation) {
+		if (search_widget->index_rows)
+			g_array_unref(search_widget->index_rows);
+		search_widget->index_rows = remmina_ssh_search_index_find(gpdata->search_index,
+									  search_widget->index_literal,
+									  search_widget->index_regex);
+		search_widget->index_generation = generation;
+	}
+	if (search_widget->index_rows->len == 0)
+		return FALSE;
+
+#if VTE_CHECK_VERSION(0, 28, 0)
+	vadjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(gpdata->vte));
+#else
+	vadjustment = vte_terminal_get_adjustment(VTE_TERMINAL(gpdata->vte));
+#endif
+	from = search_widget->index_row >= 0 ? search_widget->index_row : (gint64)gtk_adjustment_get_value(vadjustment);
+
+	/* First row after from, or last row before it */
+	lo = 0;
+	hi = search_widget->index_rows->len;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (forward ? g_array_index(search_widget->index_rows, gint64, mid) <= from
+		    : g_array_index(search_widget->index_rows, gint64, mid) < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (forward ? lo == search_widget->index_rows->len : lo == 0) {
+		if (!gtk_toggle_button_get_active(search_widget->wrap_around_checkbutton))
+			return TRUE;
+		lo = forward ? 0 : search_widget->index_rows->len;
+	}
+	row = g_array_index(search_widget->index_rows, gint64, forward ? lo : lo - 1);
+	search_widget->index_row = row;
+
+	vte_terminal_unselect_all(VTE_TERMINAL(gpdata->vte));
+	if (forward) {
+		gtk_adjustment_set_value(vadjustment, row);
+		vte_terminal_search_find_next(VTE_TERMINAL(gpdata->vte));
+	} else {
+		gtk_adjustment_set_value(vadjustment, row - gtk_adjustment_get_page_size(vadjustment) + 1);
+		vte_terminal_search_find_previous(VTE_TERMINAL(gpdata->vte));
+	}
+	return TRUE;
+}
+
 static void
 remmina_search_widget_update_regex(RemminaPluginSshData *gpdata)
 {
@@ -641,7 +754,7 @@ remmina_search_widget_update_regex(RemminaPluginSshData *gpdata)
 	else
 		pattern = g_regex_escape_string(search_text, -1);
 
-	if (gtk_toggle_button_get_active(search_widget->regex_checkbutton)) {
+	if (gtk_toggle_button_get_active(search_widget->entire_word_checkbutton)) {
 		char *tmp = g_strdup_printf("\\b%s\\b", pattern);
 		g_free(pattern);
 		pattern = tmp;
@@ -654,6 +767,7 @@ remmina_search_widget_update_regex(RemminaPluginSshData *gpdata)
 	search_widget->regex_caseless = caseless;
 	g_free(search_widget->regex_pattern);
 	search_widget->regex_pattern = NULL;
+	remmina_search_widget_index_reset(search_widget);
 
 	if (search_text[0] != '\0') {
 		REMMINA_DEBUG("Search text is: %s", search_text);
@@ -664,6 +778,11 @@ remmina_search_widget_update_regex(RemminaPluginSshData *gpdata)
 
 		if (!error) {
 			search_widget->has_regex = TRUE;
+			if (gpdata->search_index) {
+				search_widget->index_regex = g_regex_new(pattern, (caseless ? G_REGEX_CASELESS : 0) | G_REGEX_OPTIMIZE, 0, NULL);
+				if (!gtk_toggle_button_get_active(search_widget->regex_checkbutton))
+					search_widget->index_literal = g_strdup(search_text);
+			}
 			search_widget->regex_pattern = pattern; /* adopt */
 			pattern = NULL;                         /* adopted */
 			gtk_widget_set_tooltip_text(search_widget->search_entry, NULL);
@@ -697,6 +816,8 @@ remmina_search_widget_search_forward(RemminaPluginSshData *gpdata)
 
 	if (!search_sidget->has_regex)
 		return;
+	if (remmina_search_widget_index_step(gpdata, TRUE))
+		return;
 	vte_terminal_search_find_next(VTE_TERMINAL(gpdata->vte));
 }
 
@@ -709,6 +830,8 @@ remmina_search_widget_search_backward(RemminaPluginSshData *gpdata)
 
 	if (!search_sidget->has_regex)
 		return;
+	if (remmina_search_widget_index_step(gpdata, FALSE))
+		return;
 	vte_terminal_search_find_previous(VTE_TERMINAL(gpdata->vte));
 }
 
@@ -723,6 +846,7 @@ static GtkWidget *remmina_plugin_pop_search_new(GtkWidget *relative_to, RemminaP
 	search_widget->regex_caseless = FALSE;
 	search_widget->has_regex = FALSE;
 	search_widget->regex_pattern = NULL;
+	search_widget->index_row = -1;
 
 	search_widget->builder = remmina_public_gtk_builder_new_from_resource("/org/remmina/Remmina/src/../data/ui/remmina_search.glade");
 	search_widget->window = GTK_WIDGET(GET_OBJECT("RemminaSearchWidget"));
@@ -949,6 +1073,8 @@ remmina_plugin_ssh_close_connection(RemminaProtocolWidget *gp)
 		remmina_ssh_shell_free(gpdata->shell);
 		gpdata->shell = NULL;
 	}
+	remmina_ssh_search_index_unref(gpdata->search_index);
+	gpdata->search_index = NULL;
 
 	remmina_plugin_service->protocol_plugin_signal_connection_closed(gp);
 	return FALSE;
@@ -1007,6 +1133,8 @@ remmina_plugin_ssh_terminal_init(RemminaProtocolWidget *gp, gboolean is_terminal
 	g_object_set_data_full(G_OBJECT(gp), "plugin-data", gpdata, g_free);
 
 	gpdata->closed = FALSE;
+	if (!is_terminal)
+		gpdata->search_index = remmina_ssh_search_index_new();
 
 	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
 	gtk_widget_show(hbox);
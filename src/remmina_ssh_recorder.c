@@ -0,0 +1,359 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <gio/gio.h>
+#include "remmina_log.h"
+#include "remmina_ssh_recorder.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Output waiting for the writer above this size is dropped */
+#define REMMINA_SSH_RECORDER_QUEUE_MAX (16 * 1024 * 1024)
+/* A gzip member is closed once it holds this much data, or this much time */
+#define REMMINA_SSH_RECORDER_MEMBER_SIZE (256 * 1024)
+#define REMMINA_SSH_RECORDER_MEMBER_TIME (10 * G_USEC_PER_SEC)
+
+enum {
+	REMMINA_SSH_RECORDER_OUTPUT,
+	REMMINA_SSH_RECORDER_RESIZE,
+	REMMINA_SSH_RECORDER_STOP
+};
+
+typedef struct _RemminaSSHRecorderEvent {
+	gint	type;
+	gint64	time;
+	gint	columns;
+	gint	rows;
+	gsize	len;
+	gchar	data[];
+} RemminaSSHRecorderEvent;
+
+struct _RemminaSSHRecorder {
+	GAsyncQueue *		queue;
+	GThread *		thread;
+	gint			queued;         /* Bytes waiting in the queue */
+	gint			dropped;        /* Bytes dropped since the last marker */
+	gint64			start;
+
+	/* Owned by the writer thread */
+	GOutputStream *		cast;
+	GOutputStream *		index;
+	GString *		member;         /* Events of the gzip member being built */
+	gint64			member_time;    /* Time of its first event */
+	gchar			carry[4];       /* Incomplete UTF-8 sequence of the last output */
+	gsize			carry_len;
+};
+
+static RemminaSSHRecorderEvent *
+remmina_ssh_recorder_event_new(gint type, const gchar *data, gsize len)
+{
+	RemminaSSHRecorderEvent *event;
+
+	event = g_malloc(sizeof(RemminaSSHRecorderEvent) + len);
+	event->type = type;
+	event->time = g_get_monotonic_time();
+	event->columns = event->rows = 0;
+	event->len = len;
+	if (len)
+		memcpy(event->data, data, len);
+	return event;
+}
+
+static void
+remmina_ssh_recorder_flush(RemminaSSHRecorder *recorder)
+{
+	TRACE_CALL(__func__);
+	GZlibCompressor *compressor;
+	GOutputStream *out;
+	GError *error = NULL;
+	goffset offset;
+	gchar *line;
+
+	if (recorder->member->len == 0)
+		return;
+
+	/* Each member is a complete gzip stream of whole events, so a player
+	 * can start decoding at any offset listed in the index */
+	offset = g_seekable_tell(G_SEEKABLE(recorder->cast));
+	compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+	out = g_converter_output_stream_new(recorder->cast, G_CONVERTER(compressor));
+	g_filter_output_stream_set_close_base_stream(G_FILTER_OUTPUT_STREAM(out), FALSE);
+
+	if (g_output_stream_write_all(out, recorder->member->str, recorder->member->len, NULL, NULL, &error) &&
+	    g_output_stream_close(out, NULL, &error)) {
+		line = g_strdup_printf("%.6f %" G_GOFFSET_FORMAT " %" G_GOFFSET_FORMAT "\n",
+				       (gdouble)(recorder->member_time - recorder->start) / G_USEC_PER_SEC,
+				       offset, g_seekable_tell(G_SEEKABLE(recorder->cast)) - offset);
+		g_output_stream_write_all(recorder->index, line, strlen(line), NULL, NULL, NULL);
+		g_output_stream_flush(recorder->index, NULL, NULL);
+		g_free(line);
+	} else {
+		REMMINA_WARNING("Could not write the SSH session recording: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_object_unref(out);
+	g_object_unref(compressor);
+	g_string_truncate(recorder->member, 0);
+}
+
+/* asciicast strings are JSON, so the output has to be valid UTF-8 */
+static void
+remmina_ssh_recorder_append_output(RemminaSSHRecorder *recorder, const gchar *data, gsize len)
+{
+	GString *json = recorder->member;
+	const gchar *p = data, *end = data + len;
+	gunichar c;
+
+	while (p < end) {
+		if ((guchar)*p < 0x80) {
+			if (*p == '"' || *p == '\\')
+				g_string_append_c(json, '\\');
+			if ((guchar)*p < 0x20 || *p == 0x7f)
+				g_string_append_printf(json, "\\u%04x", (guchar)*p);
+			else
+				g_string_append_c(json, *p);
+			p++;
+			continue;
+		}
+		c = g_utf8_get_char_validated(p, end - p);
+		if (c == (gunichar)-2 && (gsize)(end - p) <= sizeof(recorder->carry)) {
+			/* Split across two reads, finish it with the next one */
+			recorder->carry_len = end - p;
+			memcpy(recorder->carry, p, recorder->carry_len);
+			return;
+		}
+		if (c == (gunichar)-1 || c == (gunichar)-2) {
+			g_string_append(json, "\\ufffd");
+			p++;
+			continue;
+		}
+		g_string_append_len(json, p, g_utf8_next_char(p) - p);
+		p = g_utf8_next_char(p);
+	}
+}
+
+static void
+remmina_ssh_recorder_append(RemminaSSHRecorder *recorder, RemminaSSHRecorderEvent *event)
+{
+	TRACE_CALL(__func__);
+	gdouble t = (gdouble)(event->time - recorder->start) / G_USEC_PER_SEC;
+	gint dropped;
+	gchar *data;
+	gsize len, before;
+
+	if (recorder->member->len == 0)
+		recorder->member_time = event->time;
+
+	dropped = g_atomic_int_get(&recorder->dropped);
+	if (dropped > 0) {
+		g_atomic_int_add(&recorder->dropped, -dropped);
+		g_string_append_printf(recorder->member, "[%.6f, \"m\", \"%d bytes not recorded\"]\n", t, dropped);
+	}
+
+	switch (event->type) {
+	case REMMINA_SSH_RECORDER_RESIZE:
+		g_string_append_printf(recorder->member, "[%.6f, \"r\", \"%dx%d\"]\n", t, event->columns, event->rows);
+		break;
+	case REMMINA_SSH_RECORDER_OUTPUT:
+		if (recorder->carry_len) {
+			len = recorder->carry_len + event->len;
+			data = g_malloc(len);
+			memcpy(data, recorder->carry, recorder->carry_len);
+			memcpy(data + recorder->carry_len, event->data, event->len);
+		} else {
+			len = event->len;
+			data = event->data;
+		}
+		recorder->carry_len = 0;
+
+		before = recorder->member->len;
+		g_string_append_printf(recorder->member, "[%.6f, \"o\", \"", t);
+		remmina_ssh_recorder_append_output(recorder, data, len);
+		if (recorder->carry_len == len)
+			g_string_truncate(recorder->member, before);
+		else
+			g_string_append(recorder->member, "\"]\n");
+
+		if (data != event->data)
+			g_free(data);
+		break;
+	}
+}
+
+static gpointer
+remmina_ssh_recorder_thread(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHRecorder *recorder = (RemminaSSHRecorder *)data;
+	RemminaSSHRecorderEvent *event;
+
+	while (TRUE) {
+		event = g_async_queue_timeout_pop(recorder->queue, REMMINA_SSH_RECORDER_MEMBER_TIME);
+		if (event == NULL) {
+			/* Idle shell, do not keep the last output in memory */
+			remmina_ssh_recorder_flush(recorder);
+			continue;
+		}
+		if (event->type == REMMINA_SSH_RECORDER_STOP) {
+			g_free(event);
+			break;
+		}
+
+		g_atomic_int_add(&recorder->queued, -(gint)event->len);
+		remmina_ssh_recorder_append(recorder, event);
+		if (recorder->member->len >= REMMINA_SSH_RECORDER_MEMBER_SIZE ||
+		    event->time - recorder->member_time >= REMMINA_SSH_RECORDER_MEMBER_TIME)
+			remmina_ssh_recorder_flush(recorder);
+		g_free(event);
+	}
+
+	remmina_ssh_recorder_flush(recorder);
+	g_output_stream_close(recorder->cast, NULL, NULL);
+	g_output_stream_close(recorder->index, NULL, NULL);
+	return NULL;
+}
+
+static GOutputStream *
+remmina_ssh_recorder_create(const gchar *filename)
+{
+	TRACE_CALL(__func__);
+	GFile *file;
+	GFileOutputStream *stream;
+	GError *error = NULL;
+
+	/* Written in place, not through g_file_replace(), so a crash keeps
+	 * everything recorded up to the last member */
+	file = g_file_new_for_path(filename);
+	g_file_delete(file, NULL, NULL);
+	stream = g_file_create(file, G_FILE_CREATE_PRIVATE, NULL, &error);
+	g_object_unref(file);
+	if (!stream) {
+		REMMINA_WARNING("Could not create %s: %s", filename, error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	return G_OUTPUT_STREAM(stream);
+}
+
+RemminaSSHRecorder *
+remmina_ssh_recorder_new(const gchar *basename, gint columns, gint rows)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHRecorder *recorder;
+	gchar *filename;
+
+	recorder = g_new0(RemminaSSHRecorder, 1);
+
+	filename = g_strconcat(basename, ".cast.gz", NULL);
+	recorder->cast = remmina_ssh_recorder_create(filename);
+	g_free(filename);
+	filename = g_strconcat(basename, ".cast.idx", NULL);
+	recorder->index = remmina_ssh_recorder_create(filename);
+	g_free(filename);
+
+	if (!recorder->cast || !recorder->index) {
+		if (recorder->cast)
+			g_object_unref(recorder->cast);
+		if (recorder->index)
+			g_object_unref(recorder->index);
+		g_free(recorder);
+		return NULL;
+	}
+
+	recorder->start = g_get_monotonic_time();
+	recorder->member = g_string_sized_new(REMMINA_SSH_RECORDER_MEMBER_SIZE + 4096);
+	recorder->member_time = recorder->start;
+	g_string_append_printf(recorder->member,
+			       "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %" G_GINT64_FORMAT "}\n",
+			       columns, rows, g_get_real_time() / G_USEC_PER_SEC);
+	g_output_stream_write_all(recorder->index, "# seconds offset length\n", 24, NULL, NULL, NULL);
+
+	recorder->queue = g_async_queue_new_full(g_free);
+	recorder->thread = g_thread_new("remmina-ssh-recorder", remmina_ssh_recorder_thread, recorder);
+
+	REMMINA_DEBUG("Recording SSH session to %s.cast.gz", basename);
+	return recorder;
+}
+
+void
+remmina_ssh_recorder_write(RemminaSSHRecorder *recorder, const gchar *data, gsize len)
+{
+	TRACE_CALL(__func__);
+
+	if (!recorder || len == 0)
+		return;
+
+	if (g_atomic_int_get(&recorder->queued) + len > REMMINA_SSH_RECORDER_QUEUE_MAX) {
+		g_atomic_int_add(&recorder->dropped, (gint)len);
+		return;
+	}
+
+	g_atomic_int_add(&recorder->queued, (gint)len);
+	g_async_queue_push(recorder->queue, remmina_ssh_recorder_event_new(REMMINA_SSH_RECORDER_OUTPUT, data, len));
+}
+
+void
+remmina_ssh_recorder_resize(RemminaSSHRecorder *recorder, gint columns, gint rows)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHRecorderEvent *event;
+
+	if (!recorder)
+		return;
+
+	event = remmina_ssh_recorder_event_new(REMMINA_SSH_RECORDER_RESIZE, NULL, 0);
+	event->columns = columns;
+	event->rows = rows;
+	g_async_queue_push(recorder->queue, event);
+}
+
+void
+remmina_ssh_recorder_free(RemminaSSHRecorder *recorder)
+{
+	TRACE_CALL(__func__);
+
+	if (!recorder)
+		return;
+
+	g_async_queue_push(recorder->queue, remmina_ssh_recorder_event_new(REMMINA_SSH_RECORDER_STOP, NULL, 0));
+	g_thread_join(recorder->thread);
+
+	g_async_queue_unref(recorder->queue);
+	g_object_unref(recorder->cast);
+	g_object_unref(recorder->index);
+	g_string_free(recorder->member, TRUE);
+	g_free(recorder);
+}
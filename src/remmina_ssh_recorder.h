@@ -0,0 +1,63 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Records the output of an SSH shell in the asciicast v2 format.
+ *
+ * The SSH event thread only timestamps the data and pushes it to a
+ * bounded queue; a background thread formats the events and writes
+ * them as a sequence of independent gzip members to <basename>.cast.gz.
+ * For every member a line "<seconds> <offset> <length>" is appended to
+ * <basename>.cast.idx, so a player can start decompressing at the member
+ * that covers a given time instead of at the beginning of the file.
+ * Concatenated gzip members are a valid gzip stream, the recording can
+ * be played as is with "zcat file.cast.gz | asciinema cat -" or similar.
+ */
+
+typedef struct _RemminaSSHRecorder RemminaSSHRecorder;
+
+RemminaSSHRecorder *remmina_ssh_recorder_new(const gchar *basename, gint columns, gint rows);
+/* Never blocks: data is dropped, and a marker recorded, when the writer is too far behind */
+void remmina_ssh_recorder_write(RemminaSSHRecorder *recorder, const gchar *data, gsize len);
+void remmina_ssh_recorder_resize(RemminaSSHRecorder *recorder, gint columns, gint rows);
+/* Flushes the pending events and waits for the writer thread */
+void remmina_ssh_recorder_free(RemminaSSHRecorder *recorder);
+
+G_END_DECLS
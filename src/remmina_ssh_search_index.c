@@ -0,0 +1,539 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <string.h>
+#include "remmina_log.h"
+#include "remmina_ssh_search_index.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Pending output is indexed from an idle callback past this size */
+#define REMMINA_SSH_SEARCH_INDEX_PENDING_MAX (1024 * 1024)
+/* Lines scrolled out of the terminal are dropped. This bounds the text
+ * too when the scrollback is unlimited. */
+#define REMMINA_SSH_SEARCH_INDEX_TEXT_MAX (256 * 1024 * 1024)
+/* Longer lines are cut, the rest of the line is still counted in rows */
+#define REMMINA_SSH_SEARCH_INDEX_LINE_MAX 4096
+
+enum {
+	REMMINA_SSH_SEARCH_INDEX_TEXT,
+	REMMINA_SSH_SEARCH_INDEX_ESC,
+	REMMINA_SSH_SEARCH_INDEX_ESC_ARG,
+	REMMINA_SSH_SEARCH_INDEX_CSI,
+	REMMINA_SSH_SEARCH_INDEX_STRING
+};
+
+typedef struct _RemminaSSHSearchLine {
+	gsize	offset; /* Into text once text_base is subtracted, the line is NUL terminated */
+	gint64	row;
+} RemminaSSHSearchLine;
+
+/* Line numbers containing a trigram, in order. Dropping the oldest lines
+ * only moves start, the array is compacted once half of it is dead. */
+typedef struct _RemminaSSHSearchPosting {
+	GArray *	lines;
+	guint		start;
+} RemminaSSHSearchPosting;
+
+struct _RemminaSSHSearchIndex {
+	gint			refcount;
+
+	pthread_mutex_t		mutex;          /* Guards pending and idle_id */
+	GByteArray *		pending;
+	guint			idle_id;
+
+	/* Main thread only */
+	GByteArray *		text;
+	gsize			text_base;      /* Bytes removed from the start of text */
+	GArray *		lines;          /* RemminaSSHSearchLine */
+	guint			first_line;     /* Number of lines[0] since the session started */
+	guint			dropped;        /* Lines at the start of lines no longer indexed */
+	GHashTable *		trigrams;       /* Trigram -> RemminaSSHSearchPosting */
+	GString *		line;
+	gint			overflow;       /* Characters cut from line */
+	gboolean		cr;
+	gint			state;
+	gchar			csi[16];
+	gsize			csi_len;
+	gboolean		alternate;
+	gint64			next_row;
+	gint			columns;
+	gint			rows;
+	glong			scrollback;
+	guint			generation;
+};
+
+#define REMMINA_SSH_SEARCH_TRIGRAM(p) \
+	((guint)g_ascii_tolower((p)[0]) << 16 | (guint)g_ascii_tolower((p)[1]) << 8 | (guint)g_ascii_tolower((p)[2]))
+
+static void
+remmina_ssh_search_posting_free(RemminaSSHSearchPosting *posting)
+{
+	g_array_unref(posting->lines);
+	g_free(posting);
+}
+
+static void
+remmina_ssh_search_index_add_trigrams(RemminaSSHSearchIndex *index, guint n, const gchar *text, gsize len)
+{
+	RemminaSSHSearchPosting *posting;
+	gpointer key;
+
+	for (gsize i = 0; i + 3 <= len; i++) {
+		key = GUINT_TO_POINTER(REMMINA_SSH_SEARCH_TRIGRAM(text + i));
+		posting = g_hash_table_lookup(index->trigrams, key);
+		if (!posting) {
+			posting = g_new0(RemminaSSHSearchPosting, 1);
+			posting->lines = g_array_new(FALSE, FALSE, sizeof(guint));
+			g_hash_table_insert(index->trigrams, key, posting);
+		}
+		/* Lines are added in order, a repeated trigram is always last */
+		if (posting->lines->len == posting->start ||
+		    g_array_index(posting->lines, guint, posting->lines->len - 1) != n)
+			g_array_append_val(posting->lines, n);
+	}
+}
+
+static const gchar *
+remmina_ssh_search_index_line_text(RemminaSSHSearchIndex *index, RemminaSSHSearchLine *line)
+{
+	return (const gchar *)index->text->data + (line->offset - index->text_base);
+}
+
+/* Forget the oldest indexed line. Lines go away in the order they were
+ * added, so the line is at the start of each posting list of its trigrams
+ * and the cost only depends on the length of the line. */
+static void
+remmina_ssh_search_index_drop_line(RemminaSSHSearchIndex *index)
+{
+	RemminaSSHSearchPosting *posting;
+	RemminaSSHSearchLine *line;
+	const gchar *text;
+	gpointer key;
+	gsize len, offset;
+	guint n;
+
+	line = &g_array_index(index->lines, RemminaSSHSearchLine, index->dropped);
+	text = remmina_ssh_search_index_line_text(index, line);
+	len = strlen(text);
+	n = index->first_line + index->dropped;
+
+	for (gsize i = 0; i + 3 <= len; i++) {
+		key = GUINT_TO_POINTER(REMMINA_SSH_SEARCH_TRIGRAM(text + i));
+		posting = g_hash_table_lookup(index->trigrams, key);
+		/* Already done for an earlier occurrence of the trigram in the line */
+		if (!posting || g_array_index(posting->lines, guint, posting->start) != n)
+			continue;
+		posting->start++;
+		if (posting->start == posting->lines->len) {
+			g_hash_table_remove(index->trigrams, key);
+		} else if (posting->start > posting->lines->len / 2) {
+			g_array_remove_range(posting->lines, 0, posting->start);
+			posting->start = 0;
+		}
+	}
+	index->dropped++;
+
+	if (index->dropped > index->lines->len / 2) {
+		offset = g_array_index(index->lines, RemminaSSHSearchLine, index->dropped).offset;
+		g_byte_array_remove_range(index->text, 0, offset - index->text_base);
+		index->text_base = offset;
+		g_array_remove_range(index->lines, 0, index->dropped);
+		index->first_line += index->dropped;
+		index->dropped = 0;
+	}
+}
+
+/* Keep what the terminal keeps: the scrollback and the screen below it */
+static void
+remmina_ssh_search_index_trim(RemminaSSHSearchIndex *index)
+{
+	RemminaSSHSearchLine *line;
+	gint64 oldest_row = G_MININT64;
+
+	if (index->scrollback > 0)
+		oldest_row = index->next_row - index->scrollback - MAX(index->rows, 1);
+
+	/* The newest line always stays */
+	while (index->dropped + 1 < index->lines->len) {
+		line = &g_array_index(index->lines, RemminaSSHSearchLine, index->dropped);
+		if (line->row >= oldest_row &&
+		    index->text->len - (line->offset - index->text_base) <= REMMINA_SSH_SEARCH_INDEX_TEXT_MAX)
+			break;
+		remmina_ssh_search_index_drop_line(index);
+	}
+}
+
+static void
+remmina_ssh_search_index_end_line(RemminaSSHSearchIndex *index)
+{
+	RemminaSSHSearchLine line;
+	gint columns = index->columns > 0 ? index->columns : 80;
+	gint width = index->overflow;
+	const gchar *p, *end;
+	gchar *valid;
+	gunichar c;
+
+	/* GRegex wants valid UTF-8 */
+	if (!g_utf8_validate(index->line->str, index->line->len, NULL)) {
+		valid = g_utf8_make_valid(index->line->str, index->line->len);
+		g_string_assign(index->line, valid);
+		g_free(valid);
+	}
+
+	for (p = index->line->str, end = p + index->line->len; p < end; p = g_utf8_next_char(p)) {
+		c = g_utf8_get_char(p);
+		width += g_unichar_iswide(c) ? 2 : 1;
+	}
+
+	line.offset = index->text_base + index->text->len;
+	line.row = index->next_row;
+	g_byte_array_append(index->text, (const guint8 *)index->line->str, index->line->len + 1);
+	g_array_append_val(index->lines, line);
+	remmina_ssh_search_index_add_trigrams(index, index->first_line + index->lines->len - 1,
+					      index->line->str, index->line->len);
+
+	/* Long lines wrap over several rows of the terminal */
+	index->next_row += MAX(1, (width + columns - 1) / columns);
+
+	g_string_truncate(index->line, 0);
+	index->overflow = 0;
+
+	remmina_ssh_search_index_trim(index);
+}
+
+static void
+remmina_ssh_search_index_add_char(RemminaSSHSearchIndex *index, gchar c)
+{
+	if (index->alternate)
+		return;
+
+	/* A carriage return not followed by a newline rewrites the line */
+	if (index->cr) {
+		g_string_truncate(index->line, 0);
+		index->overflow = 0;
+		index->cr = FALSE;
+	}
+
+	if (index->line->len < REMMINA_SSH_SEARCH_INDEX_LINE_MAX)
+		g_string_append_c(index->line, c);
+	else if (((guchar)c & 0xc0) != 0x80)
+		index->overflow++;
+}
+
+/* Private modes 47, 1047 and 1049 switch to the alternate screen, which
+ * is not part of the scrollback */
+static void
+remmina_ssh_search_index_csi(RemminaSSHSearchIndex *index, gchar final)
+{
+	gchar **params;
+
+	if ((final != 'h' && final != 'l') || index->csi_len == 0 || index->csi[0] != '?')
+		return;
+
+	index->csi[index->csi_len] = '\0';
+	params = g_strsplit(index->csi + 1, ";", -1);
+	for (gchar **p = params; *p; p++)
+		if (g_strcmp0(*p, "47") == 0 || g_strcmp0(*p, "1047") == 0 || g_strcmp0(*p, "1049") == 0)
+			index->alternate = (final == 'h');
+	g_strfreev(params);
+}
+
+static void
+remmina_ssh_search_index_parse(RemminaSSHSearchIndex *index, const guint8 *data, gsize len)
+{
+	for (gsize i = 0; i < len; i++) {
+		gchar c = (gchar)data[i];
+
+		switch (index->state) {
+		case REMMINA_SSH_SEARCH_INDEX_TEXT:
+			if (c == '\x1b') {
+				index->state = REMMINA_SSH_SEARCH_INDEX_ESC;
+			} else if (c == '\n') {
+				index->cr = FALSE;
+				if (!index->alternate)
+					remmina_ssh_search_index_end_line(index);
+			} else if (c == '\r') {
+				index->cr = TRUE;
+			} else if (c == '\t') {
+				remmina_ssh_search_index_add_char(index, ' ');
+			} else if ((guchar)c >= 0x20 && c != '\x7f') {
+				remmina_ssh_search_index_add_char(index, c);
+			}
+			break;
+		case REMMINA_SSH_SEARCH_INDEX_ESC:
+			if (c == '[') {
+				index->state = REMMINA_SSH_SEARCH_INDEX_CSI;
+				index->csi_len = 0;
+			} else if (c == ']' || c == 'P' || c == '_' || c == '^') {
+				index->state = REMMINA_SSH_SEARCH_INDEX_STRING;
+			} else if (strchr("()*+#%", c)) {
+				index->state = REMMINA_SSH_SEARCH_INDEX_ESC_ARG;
+			} else {
+				index->state = REMMINA_SSH_SEARCH_INDEX_TEXT;
+			}
+			break;
+		case REMMINA_SSH_SEARCH_INDEX_ESC_ARG:
+			index->state = REMMINA_SSH_SEARCH_INDEX_TEXT;
+			break;
+		case REMMINA_SSH_SEARCH_INDEX_CSI:
+			if ((guchar)c >= 0x40 && (guchar)c <= 0x7e) {
+				remmina_ssh_search_index_csi(index, c);
+				index->state = REMMINA_SSH_SEARCH_INDEX_TEXT;
+			} else if (index->csi_len < sizeof(index->csi) - 1) {
+				index->csi[index->csi_len++] = c;
+			}
+			break;
+		case REMMINA_SSH_SEARCH_INDEX_STRING:
+			/* Terminated by BEL or by ESC \ */
+			if (c == '\x07')
+				index->state = REMMINA_SSH_SEARCH_INDEX_TEXT;
+			else if (c == '\x1b')
+				index->state = REMMINA_SSH_SEARCH_INDEX_ESC;
+			break;
+		}
+	}
+}
+
+static void
+remmina_ssh_search_index_process(RemminaSSHSearchIndex *index)
+{
+	TRACE_CALL(__func__);
+	GByteArray *pending;
+	guint lines;
+
+	pthread_mutex_lock(&index->mutex);
+	pending = index->pending;
+	index->pending = g_byte_array_new();
+	pthread_mutex_unlock(&index->mutex);
+
+	if (pending->len > 0) {
+		lines = index->first_line + index->lines->len;
+		remmina_ssh_search_index_parse(index, pending->data, pending->len);
+		if (index->first_line + index->lines->len != lines)
+			index->generation++;
+	}
+	g_byte_array_unref(pending);
+}
+
+static gboolean
+remmina_ssh_search_index_idle(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHSearchIndex *index = (RemminaSSHSearchIndex *)data;
+
+	pthread_mutex_lock(&index->mutex);
+	index->idle_id = 0;
+	pthread_mutex_unlock(&index->mutex);
+
+	remmina_ssh_search_index_process(index);
+	remmina_ssh_search_index_unref(index);
+	return G_SOURCE_REMOVE;
+}
+
+RemminaSSHSearchIndex *
+remmina_ssh_search_index_new(void)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHSearchIndex *index;
+
+	index = g_new0(RemminaSSHSearchIndex, 1);
+	index->refcount = 1;
+	pthread_mutex_init(&index->mutex, NULL);
+	index->pending = g_byte_array_new();
+	index->text = g_byte_array_new();
+	index->lines = g_array_new(FALSE, FALSE, sizeof(RemminaSSHSearchLine));
+	index->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+						(GDestroyNotify)remmina_ssh_search_posting_free);
+	index->line = g_string_new(NULL);
+	index->state = REMMINA_SSH_SEARCH_INDEX_TEXT;
+	return index;
+}
+
+RemminaSSHSearchIndex *
+remmina_ssh_search_index_ref(RemminaSSHSearchIndex *index)
+{
+	if (index)
+		g_atomic_int_inc(&index->refcount);
+	return index;
+}
+
+void
+remmina_ssh_search_index_unref(RemminaSSHSearchIndex *index)
+{
+	TRACE_CALL(__func__);
+
+	if (!index || !g_atomic_int_dec_and_test(&index->refcount))
+		return;
+
+	pthread_mutex_destroy(&index->mutex);
+	g_byte_array_unref(index->pending);
+	g_byte_array_unref(index->text);
+	g_array_unref(index->lines);
+	g_hash_table_destroy(index->trigrams);
+	g_string_free(index->line, TRUE);
+	g_free(index);
+}
+
+void
+remmina_ssh_search_index_feed(RemminaSSHSearchIndex *index, const gchar *data, gsize len)
+{
+	if (!index || len == 0)
+		return;
+
+	pthread_mutex_lock(&index->mutex);
+	g_byte_array_append(index->pending, (const guint8 *)data, len);
+	if (index->pending->len > REMMINA_SSH_SEARCH_INDEX_PENDING_MAX && index->idle_id == 0)
+		index->idle_id = g_idle_add_full(G_PRIORITY_LOW, remmina_ssh_search_index_idle,
+						 remmina_ssh_search_index_ref(index), NULL);
+	pthread_mutex_unlock(&index->mutex);
+}
+
+void
+remmina_ssh_search_index_set_size(RemminaSSHSearchIndex *index, gint columns, gint rows)
+{
+	TRACE_CALL(__func__);
+
+	/* Lines received so far were wrapped at the previous width */
+	remmina_ssh_search_index_process(index);
+	index->columns = columns;
+	index->rows = rows;
+}
+
+void
+remmina_ssh_search_index_set_scrollback(RemminaSSHSearchIndex *index, glong lines)
+{
+	TRACE_CALL(__func__);
+
+	remmina_ssh_search_index_process(index);
+	index->scrollback = lines;
+	remmina_ssh_search_index_trim(index);
+}
+
+guint
+remmina_ssh_search_index_get_generation(RemminaSSHSearchIndex *index)
+{
+	TRACE_CALL(__func__);
+
+	remmina_ssh_search_index_process(index);
+	return index->generation;
+}
+
+/* Lines containing every trigram of literal, or NULL when there is no
+ * usable trigram and every line has to be matched */
+static GArray *
+remmina_ssh_search_index_candidates(RemminaSSHSearchIndex *index, const gchar *literal, gboolean caseless)
+{
+	GPtrArray *postings;
+	RemminaSSHSearchPosting *posting, *shortest = NULL;
+	GArray *candidates;
+	gsize len = literal ? strlen(literal) : 0;
+	guint n;
+
+	postings = g_ptr_array_new();
+	for (gsize i = 0; i + 3 <= len; i++) {
+		/* Only ASCII is case folded in the trigrams */
+		if (caseless && ((guchar)literal[i] >= 0x80 || (guchar)literal[i + 1] >= 0x80 || (guchar)literal[i + 2] >= 0x80))
+			continue;
+		posting = g_hash_table_lookup(index->trigrams, GUINT_TO_POINTER(REMMINA_SSH_SEARCH_TRIGRAM(literal + i)));
+		if (!posting) {
+			g_ptr_array_free(postings, TRUE);
+			return g_array_new(FALSE, FALSE, sizeof(guint));
+		}
+		g_ptr_array_add(postings, posting);
+		if (!shortest || posting->lines->len - posting->start < shortest->lines->len - shortest->start)
+			shortest = posting;
+	}
+
+	if (!shortest) {
+		g_ptr_array_free(postings, TRUE);
+		return NULL;
+	}
+
+	candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+	for (guint i = shortest->start; i < shortest->lines->len; i++) {
+		n = g_array_index(shortest->lines, guint, i);
+		guint j;
+		for (j = 0; j < postings->len; j++) {
+			posting = g_ptr_array_index(postings, j);
+			if (posting == shortest)
+				continue;
+			/* Posting lists are sorted, bisect */
+			guint lo = posting->start, hi = posting->lines->len;
+			while (lo < hi) {
+				guint mid = (lo + hi) / 2;
+				if (g_array_index(posting->lines, guint, mid) < n)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo == posting->lines->len || g_array_index(posting->lines, guint, lo) != n)
+				break;
+		}
+		if (j == postings->len)
+			g_array_append_val(candidates, n);
+	}
+
+	g_ptr_array_free(postings, TRUE);
+	return candidates;
+}
+
+GArray *
+remmina_ssh_search_index_find(RemminaSSHSearchIndex *index, const gchar *literal, GRegex *regex)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHSearchLine *line;
+	GArray *candidates, *rows;
+	gboolean caseless;
+	guint count;
+
+	remmina_ssh_search_index_process(index);
+
+	rows = g_array_new(FALSE, FALSE, sizeof(gint64));
+	caseless = (g_regex_get_compile_flags(regex) & G_REGEX_CASELESS) != 0;
+	candidates = remmina_ssh_search_index_candidates(index, literal, caseless);
+	count = candidates ? candidates->len : index->lines->len - index->dropped;
+
+	for (guint i = 0; i < count; i++) {
+		guint n = candidates ? g_array_index(candidates, guint, i) - index->first_line : index->dropped + i;
+		line = &g_array_index(index->lines, RemminaSSHSearchLine, n);
+		if (g_regex_match(regex, remmina_ssh_search_index_line_text(index, line), 0, NULL))
+			g_array_append_val(rows, line->row);
+	}
+
+	if (candidates)
+		g_array_unref(candidates);
+	return rows;
+}
@@ -0,0 +1,72 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Line index over the output of an SSH shell, used to search the
+ * terminal scrollback without asking VTE to rescan it.
+ *
+ * The SSH thread only appends the raw output to a pending buffer. It is
+ * parsed on the main thread, when a search needs it or from an idle
+ * callback once enough output is pending: escape sequences and the
+ * alternate screen are skipped, each line is stored with the terminal
+ * row it starts at, and every trigram of a line is added to a posting
+ * list. A search intersects the posting lists of the trigrams of the
+ * searched text and only matches the resulting lines.
+ */
+
+typedef struct _RemminaSSHSearchIndex RemminaSSHSearchIndex;
+
+RemminaSSHSearchIndex *remmina_ssh_search_index_new(void);
+RemminaSSHSearchIndex *remmina_ssh_search_index_ref(RemminaSSHSearchIndex *index);
+void remmina_ssh_search_index_unref(RemminaSSHSearchIndex *index);
+
+/* Any thread */
+void remmina_ssh_search_index_feed(RemminaSSHSearchIndex *index, const gchar *data, gsize len);
+
+/* Main thread only */
+void remmina_ssh_search_index_set_size(RemminaSSHSearchIndex *index, gint columns, gint rows);
+/* Lines the terminal keeps above the screen, 0 or less when unlimited */
+void remmina_ssh_search_index_set_scrollback(RemminaSSHSearchIndex *index, glong lines);
+guint remmina_ssh_search_index_get_generation(RemminaSSHSearchIndex *index);
+/* Sorted terminal rows of the lines matching regex. literal, when not NULL,
+ * is a substring every match contains and is used to narrow the lines down. */
+GArray *remmina_ssh_search_index_find(RemminaSSHSearchIndex *index, const gchar *literal, GRegex *regex);
+
+G_END_DECLS
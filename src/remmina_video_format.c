@@ -0,0 +1,334 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include "remmina_video_format.h"
+
+/* The reader is also built into remmina-video-transcode, it must not use the GTK side of Remmina */
+
+typedef struct _RemminaVideoKeyframe {
+	gint64	time;
+	goffset offset;
+} RemminaVideoKeyframe;
+
+struct _RemminaVideoReader {
+	GInputStream *		stream;
+	GArray *		keyframes;
+
+	RemminaVideoFrameHeader pending;
+	gboolean		has_pending;
+	gboolean		eof;
+
+	guint32 *		canvas;
+	gint			width;
+	gint			height;
+};
+
+void remmina_video_frame_header_pack(const RemminaVideoFrameHeader *header, guint8 *buf)
+{
+	guint32 v32;
+	guint64 v64;
+
+	v32 = GUINT32_TO_LE(header->tag);
+	memcpy(buf, &v32, 4);
+	v32 = GUINT32_TO_LE(header->flags);
+	memcpy(buf + 4, &v32, 4);
+	v64 = GUINT64_TO_LE((guint64)header->time);
+	memcpy(buf + 8, &v64, 8);
+	v32 = GUINT32_TO_LE(header->width);
+	memcpy(buf + 16, &v32, 4);
+	v32 = GUINT32_TO_LE(header->height);
+	memcpy(buf + 20, &v32, 4);
+	v32 = GUINT32_TO_LE(header->nrects);
+	memcpy(buf + 24, &v32, 4);
+	v32 = GUINT32_TO_LE(header->payload_size);
+	memcpy(buf + 28, &v32, 4);
+}
+
+void remmina_video_frame_header_unpack(const guint8 *buf, RemminaVideoFrameHeader *header)
+{
+	guint32 v32;
+	guint64 v64;
+
+	memcpy(&v32, buf, 4);
+	header->tag = GUINT32_FROM_LE(v32);
+	memcpy(&v32, buf + 4, 4);
+	header->flags = GUINT32_FROM_LE(v32);
+	memcpy(&v64, buf + 8, 8);
+	header->time = (gint64)GUINT64_FROM_LE(v64);
+	memcpy(&v32, buf + 16, 4);
+	header->width = GUINT32_FROM_LE(v32);
+	memcpy(&v32, buf + 20, 4);
+	header->height = GUINT32_FROM_LE(v32);
+	memcpy(&v32, buf + 24, 4);
+	header->nrects = GUINT32_FROM_LE(v32);
+	memcpy(&v32, buf + 28, 4);
+	header->payload_size = GUINT32_FROM_LE(v32);
+}
+
+/* Reads the header of the next frame, FALSE at the end of the file or on error */
+static gboolean remmina_video_reader_read_header(RemminaVideoReader *reader, GError **error)
+{
+	guint8 buf[REMMINA_VIDEO_FRAME_HEADER_SIZE];
+	gsize len;
+
+	if (reader->has_pending)
+		return TRUE;
+	if (reader->eof)
+		return FALSE;
+
+	if (!g_input_stream_read_all(reader->stream, buf, sizeof(buf), &len, NULL, error))
+		return FALSE;
+	if (len < sizeof(buf)) {
+		/* A recording cut by a crash ends with a partial frame */
+		reader->eof = TRUE;
+		return FALSE;
+	}
+	remmina_video_frame_header_unpack(buf, &reader->pending);
+	if (reader->pending.tag != REMMINA_VIDEO_FRAME_TAG ||
+	    reader->pending.width > REMMINA_VIDEO_MAX_SIZE || reader->pending.height > REMMINA_VIDEO_MAX_SIZE ||
+	    reader->pending.payload_size > REMMINA_VIDEO_MAX_PAYLOAD) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Corrupted frame at offset %" G_GOFFSET_FORMAT,
+			    g_seekable_tell(G_SEEKABLE(reader->stream)) - (goffset)sizeof(buf));
+		return FALSE;
+	}
+	reader->has_pending = TRUE;
+	return TRUE;
+}
+
+static void remmina_video_reader_load_index(RemminaVideoReader *reader, const gchar *filename)
+{
+	RemminaVideoKeyframe kf;
+	gchar *idxname, *contents, **lines, *end;
+	gint i;
+
+	idxname = g_strconcat(filename, ".idx", NULL);
+	if (g_file_get_contents(idxname, &contents, NULL, NULL)) {
+		lines = g_strsplit(contents, "\n", -1);
+		for (i = 0; lines[i]; i++) {
+			if (lines[i][0] == '#' || lines[i][0] == 0)
+				continue;
+			kf.time = (gint64)(g_ascii_strtod(lines[i], &end) * G_USEC_PER_SEC);
+			kf.offset = g_ascii_strtoll(end, NULL, 10);
+			if (kf.offset >= REMMINA_VIDEO_FILE_HEADER_SIZE)
+				g_array_append_val(reader->keyframes, kf);
+		}
+		g_strfreev(lines);
+		g_free(contents);
+	}
+	g_free(idxname);
+}
+
+/* No index: walk the frame headers, skipping the payloads */
+static gboolean remmina_video_reader_scan(RemminaVideoReader *reader, GError **error)
+{
+	RemminaVideoKeyframe kf;
+
+	while (remmina_video_reader_read_header(reader, error)) {
+		if (reader->pending.flags & REMMINA_VIDEO_FRAME_KEY) {
+			kf.time = reader->pending.time;
+			kf.offset = g_seekable_tell(G_SEEKABLE(reader->stream)) - REMMINA_VIDEO_FRAME_HEADER_SIZE;
+			g_array_append_val(reader->keyframes, kf);
+		}
+		reader->has_pending = FALSE;
+		if (!g_seekable_seek(G_SEEKABLE(reader->stream), reader->pending.payload_size, G_SEEK_CUR, NULL, error))
+			return FALSE;
+	}
+	return error == NULL || *error == NULL;
+}
+
+RemminaVideoReader *remmina_video_reader_open(const gchar *filename, GError **error)
+{
+	RemminaVideoReader *reader;
+	GFileInputStream *stream;
+	GFile *file;
+	guint8 buf[REMMINA_VIDEO_FILE_HEADER_SIZE];
+	guint32 version;
+	gsize len;
+
+	file = g_file_new_for_path(filename);
+	stream = g_file_read(file, NULL, error);
+	g_object_unref(file);
+	if (!stream)
+		return NULL;
+
+	if (!g_input_stream_read_all(G_INPUT_STREAM(stream), buf, sizeof(buf), &len, NULL, error)) {
+		g_object_unref(stream);
+		return NULL;
+	}
+	memcpy(&version, buf + 8, 4);
+	if (len < sizeof(buf) || memcmp(buf, REMMINA_VIDEO_MAGIC, 8) != 0 ||
+	    GUINT32_FROM_LE(version) != REMMINA_VIDEO_VERSION) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s is not a Remmina video recording", filename);
+		g_object_unref(stream);
+		return NULL;
+	}
+
+	reader = g_new0(RemminaVideoReader, 1);
+	reader->stream = G_INPUT_STREAM(stream);
+	reader->keyframes = g_array_new(FALSE, FALSE, sizeof(RemminaVideoKeyframe));
+
+	remmina_video_reader_load_index(reader, filename);
+	if (reader->keyframes->len == 0) {
+		if (!remmina_video_reader_scan(reader, error)) {
+			remmina_video_reader_free(reader);
+			return NULL;
+		}
+		reader->eof = FALSE;
+		g_seekable_seek(G_SEEKABLE(reader->stream), REMMINA_VIDEO_FILE_HEADER_SIZE, G_SEEK_SET, NULL, NULL);
+	}
+	return reader;
+}
+
+gboolean remmina_video_reader_seek(RemminaVideoReader *reader, gint64 time, GError **error)
+{
+	RemminaVideoKeyframe *kf;
+	goffset offset = REMMINA_VIDEO_FILE_HEADER_SIZE;
+	guint i;
+
+	for (i = 0; i < reader->keyframes->len; i++) {
+		kf = &g_array_index(reader->keyframes, RemminaVideoKeyframe, i);
+		if (kf->time > time)
+			break;
+		offset = kf->offset;
+	}
+
+	reader->has_pending = FALSE;
+	reader->eof = FALSE;
+	return g_seekable_seek(G_SEEKABLE(reader->stream), offset, G_SEEK_SET, NULL, error);
+}
+
+gint64 remmina_video_reader_peek_time(RemminaVideoReader *reader, GError **error)
+{
+	if (!remmina_video_reader_read_header(reader, error))
+		return -1;
+	return reader->pending.time;
+}
+
+gboolean remmina_video_reader_next(RemminaVideoReader *reader, GError **error)
+{
+	RemminaVideoFrameHeader *header = &reader->pending;
+	GInputStream *payload, *pixels;
+	GConverter *decompressor;
+	guint32 rect[4], *row, *dst;
+	guint32 x, y, w, h, j, k;
+	guint8 *data;
+	gsize len;
+	guint i;
+	gboolean key, ok = TRUE;
+
+	if (!remmina_video_reader_read_header(reader, error))
+		return FALSE;
+	reader->has_pending = FALSE;
+	key = (header->flags & REMMINA_VIDEO_FRAME_KEY) != 0;
+
+	if (key && ((gint)header->width != reader->width || (gint)header->height != reader->height)) {
+		g_free(reader->canvas);
+		reader->width = header->width;
+		reader->height = header->height;
+		reader->canvas = g_new0(guint32, (gsize)reader->width * reader->height);
+	}
+
+	data = g_malloc(header->payload_size);
+	if (!g_input_stream_read_all(reader->stream, data, header->payload_size, &len, NULL, error)) {
+		g_free(data);
+		return FALSE;
+	}
+	if (len < header->payload_size) {
+		reader->eof = TRUE;
+		g_free(data);
+		return FALSE;
+	}
+
+	payload = g_memory_input_stream_new_from_data(data, len, g_free);
+	decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+	pixels = g_converter_input_stream_new(payload, decompressor);
+
+	row = NULL;
+	for (i = 0; ok && i < header->nrects; i++) {
+		ok = g_input_stream_read_all(pixels, rect, sizeof(rect), &len, NULL, error) && len == sizeof(rect);
+		if (!ok)
+			break;
+		x = GUINT32_FROM_LE(rect[0]);
+		y = GUINT32_FROM_LE(rect[1]);
+		w = GUINT32_FROM_LE(rect[2]);
+		h = GUINT32_FROM_LE(rect[3]);
+		/* Rectangles are clipped by the recorder, anything else is a
+		 * damaged or crafted file. Written so that nothing can overflow. */
+		if (x > (guint32)reader->width || w > (guint32)reader->width - x ||
+		    y > (guint32)reader->height || h > (guint32)reader->height - y) {
+			g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Rectangle out of the desktop at %.3f s",
+				    (gdouble)header->time / G_USEC_PER_SEC);
+			ok = FALSE;
+			break;
+		}
+		row = g_renew(guint32, row, MAX(w, 1));
+		for (j = 0; ok && j < h; j++) {
+			ok = g_input_stream_read_all(pixels, row, (gsize)w * 4, &len, NULL, error) && len == (gsize)w * 4;
+			if (!ok)
+				break;
+			dst = reader->canvas + (gsize)(y + j) * reader->width + x;
+			for (k = 0; k < w; k++)
+				dst[k] = key ? GUINT32_FROM_LE(row[k]) : dst[k] ^ GUINT32_FROM_LE(row[k]);
+		}
+	}
+	if (!ok && error && *error == NULL)
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated frame at %.3f s",
+			    (gdouble)header->time / G_USEC_PER_SEC);
+
+	g_free(row);
+	g_object_unref(pixels);
+	g_object_unref(decompressor);
+	g_object_unref(payload);
+	return ok;
+}
+
+const guint32 *remmina_video_reader_get_pixels(RemminaVideoReader *reader, gint *width, gint *height)
+{
+	*width = reader->width;
+	*height = reader->height;
+	return reader->canvas;
+}
+
+void remmina_video_reader_free(RemminaVideoReader *reader)
+{
+	if (!reader)
+		return;
+	g_object_unref(reader->stream);
+	g_array_free(reader->keyframes, TRUE);
+	g_free(reader->canvas);
+	g_free(reader);
+}
@@ -0,0 +1,94 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Remmina video recording, "<name>.rvr", written by remmina_video_recorder.c
+ * and read back by remmina-video-transcode.
+ *
+ * All integers are little endian.
+ *   file:   "RMNAVID\0", guint32 version, guint32 reserved, then frames
+ *   frame:  RemminaVideoFrameHeader, then payload_size bytes holding a zlib
+ *           stream of nrects times (guint32 x, y, w, h; w * h xRGB32 pixels)
+ * A keyframe has a single rectangle covering the whole desktop. In the
+ * other frames each pixel is XORed with the previous frame, so unchanged
+ * pixels compress to runs of zeroes.
+ *
+ * "<name>.rvr.idx" lists the keyframes as "<seconds> <offset>" text lines,
+ * a player seeks to the last keyframe before the wanted time and decodes
+ * from there. Without the index the frame headers are scanned.
+ */
+
+#define REMMINA_VIDEO_MAGIC "RMNAVID"
+#define REMMINA_VIDEO_VERSION 1
+#define REMMINA_VIDEO_FILE_HEADER_SIZE 16
+#define REMMINA_VIDEO_FRAME_TAG 0x52465652      /* "RVFR" */
+#define REMMINA_VIDEO_FRAME_HEADER_SIZE 32
+#define REMMINA_VIDEO_FRAME_KEY 1
+/* Readers reject anything larger, a recording is not trusted input */
+#define REMMINA_VIDEO_MAX_SIZE 16384                    /* pixels, each way */
+#define REMMINA_VIDEO_MAX_PAYLOAD (256 * 1024 * 1024)  /* bytes */
+
+typedef struct _RemminaVideoFrameHeader {
+	guint32 tag;
+	guint32 flags;
+	gint64	time;           /* Microseconds since the start of the recording */
+	guint32 width;
+	guint32 height;
+	guint32 nrects;
+	guint32 payload_size;
+} RemminaVideoFrameHeader;
+
+void remmina_video_frame_header_pack(const RemminaVideoFrameHeader *header, guint8 *buf);
+void remmina_video_frame_header_unpack(const guint8 *buf, RemminaVideoFrameHeader *header);
+
+typedef struct _RemminaVideoReader RemminaVideoReader;
+
+RemminaVideoReader *remmina_video_reader_open(const gchar *filename, GError **error);
+/* Position on the last keyframe at or before time, in microseconds */
+gboolean remmina_video_reader_seek(RemminaVideoReader *reader, gint64 time, GError **error);
+/* Time of the frame remmina_video_reader_next() would decode, -1 at the end */
+gint64 remmina_video_reader_peek_time(RemminaVideoReader *reader, GError **error);
+/* Decode the next frame into the canvas */
+gboolean remmina_video_reader_next(RemminaVideoReader *reader, GError **error);
+/* xRGB32 pixels of the last decoded frame, in host order */
+const guint32 *remmina_video_reader_get_pixels(RemminaVideoReader *reader, gint *width, gint *height);
+void remmina_video_reader_free(RemminaVideoReader *reader);
+
+G_END_DECLS
@@ -0,0 +1,463 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include "remmina_log.h"
+#include "remmina_video_format.h"
+#include "remmina_video_recorder.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Pixels waiting for the writer above this size make the capture skip frames */
+#define REMMINA_VIDEO_RECORDER_QUEUE_MAX (64 * 1024 * 1024)
+/* Share of one core the writer thread may use, in percent */
+#define REMMINA_VIDEO_RECORDER_CPU 25
+/* Distance between keyframes, the granularity of seeking */
+#define REMMINA_VIDEO_RECORDER_KEYFRAME_TIME (10 * G_USEC_PER_SEC)
+
+typedef struct _RemminaVideoRecorderFrame {
+	gboolean		stop;
+	gboolean		key;
+	gint64			time;
+	gint			width;
+	gint			height;
+	gint			nrects;
+	cairo_rectangle_int_t * rects;
+	guint32 *		pixels;         /* The rectangles one after the other, packed */
+	gsize			len;            /* Bytes of pixels */
+} RemminaVideoRecorderFrame;
+
+/* Writer threads still finishing a recording that has been freed */
+static GMutex remmina_video_recorder_writers_mutex;
+static GCond remmina_video_recorder_writers_cond;
+static gint remmina_video_recorder_writers = 0;
+
+struct _RemminaVideoRecorder {
+	GAsyncQueue *			queue;
+	GThread *			thread;
+	gint				queued;         /* Bytes waiting in the queue */
+	gint				busy_until;     /* Milliseconds since start, set by the writer */
+	gint64				start;
+
+	/* Main thread */
+	RemminaVideoRecorderSource	source;
+	gpointer			source_data;
+	guint				capture_source;
+	cairo_region_t *		damage;
+	gint				width;
+	gint				height;
+	gint64				last_key;
+
+	/* Owned by the writer thread */
+	GOutputStream *			video;
+	GOutputStream *			index;
+	guint32 *			shadow;         /* Previous frame, what the delta is taken against */
+	gint				shadow_width;
+	gint				shadow_height;
+	GByteArray *			raw;
+};
+
+static void remmina_video_recorder_frame_free(gpointer data)
+{
+	RemminaVideoRecorderFrame *frame = (RemminaVideoRecorderFrame *)data;
+
+	g_free(frame->rects);
+	g_free(frame->pixels);
+	g_free(frame);
+}
+
+static void remmina_video_recorder_encode(RemminaVideoRecorder *recorder, RemminaVideoRecorderFrame *frame)
+{
+	TRACE_CALL(__func__);
+	guint32 *src, *shadow, rect[4], v;
+	gint i, j, k;
+
+	if (frame->key && (frame->width != recorder->shadow_width || frame->height != recorder->shadow_height)) {
+		g_free(recorder->shadow);
+		recorder->shadow_width = frame->width;
+		recorder->shadow_height = frame->height;
+		recorder->shadow = g_new0(guint32, (gsize)frame->width * frame->height);
+	}
+
+	g_byte_array_set_size(recorder->raw, 0);
+	src = frame->pixels;
+	for (i = 0; i < frame->nrects; i++) {
+		cairo_rectangle_int_t *r = &frame->rects[i];
+
+		rect[0] = GUINT32_TO_LE(r->x);
+		rect[1] = GUINT32_TO_LE(r->y);
+		rect[2] = GUINT32_TO_LE(r->width);
+		rect[3] = GUINT32_TO_LE(r->height);
+		g_byte_array_append(recorder->raw, (guint8 *)rect, sizeof(rect));
+
+		for (j = 0; j < r->height; j++) {
+			shadow = recorder->shadow + (gsize)(r->y + j) * recorder->shadow_width + r->x;
+			for (k = 0; k < r->width; k++) {
+				/* The top byte is undefined in RGB24, keep it out of the delta */
+				v = src[k] & 0x00ffffff;
+				src[k] = GUINT32_TO_LE(frame->key ? v : v ^ shadow[k]);
+				shadow[k] = v;
+			}
+			g_byte_array_append(recorder->raw, (guint8 *)src, r->width * 4);
+			src += r->width;
+		}
+	}
+}
+
+static void remmina_video_recorder_write_frame(RemminaVideoRecorder *recorder, RemminaVideoRecorderFrame *frame)
+{
+	TRACE_CALL(__func__);
+	RemminaVideoFrameHeader header;
+	GZlibCompressor *compressor;
+	GOutputStream *mem, *out;
+	GError *error = NULL;
+	guint8 buf[REMMINA_VIDEO_FRAME_HEADER_SIZE];
+	goffset offset;
+	gchar *line;
+
+	remmina_video_recorder_encode(recorder, frame);
+
+	/* Speed matters more than size here, XORed frames are mostly zeroes anyway */
+	mem = g_memory_output_stream_new_resizable();
+	compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, 1);
+	out = g_converter_output_stream_new(mem, G_CONVERTER(compressor));
+	g_output_stream_write_all(out, recorder->raw->data, recorder->raw->len, NULL, NULL, NULL);
+	g_output_stream_close(out, NULL, NULL);
+
+	header.tag = REMMINA_VIDEO_FRAME_TAG;
+	header.flags = frame->key ? REMMINA_VIDEO_FRAME_KEY : 0;
+	header.time = frame->time - recorder->start;
+	header.width = frame->width;
+	header.height = frame->height;
+	header.nrects = frame->nrects;
+	header.payload_size = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(mem));
+	remmina_video_frame_header_pack(&header, buf);
+
+	offset = g_seekable_tell(G_SEEKABLE(recorder->video));
+	if (g_output_stream_write_all(recorder->video, buf, sizeof(buf), NULL, NULL, &error) &&
+	    g_output_stream_write_all(recorder->video, g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(mem)),
+				      header.payload_size, NULL, NULL, &error)) {
+		if (frame->key) {
+			line = g_strdup_printf("%.6f %" G_GOFFSET_FORMAT "\n", (gdouble)header.time / G_USEC_PER_SEC, offset);
+			g_output_stream_write_all(recorder->index, line, strlen(line), NULL, NULL, NULL);
+			g_output_stream_flush(recorder->index, NULL, NULL);
+			g_free(line);
+		}
+	} else {
+		REMMINA_WARNING("Could not write the session recording: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_object_unref(out);
+	g_object_unref(compressor);
+	g_object_unref(mem);
+}
+
+static gpointer remmina_video_recorder_thread(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaVideoRecorder *recorder = (RemminaVideoRecorder *)data;
+	RemminaVideoRecorderFrame *frame;
+	gint64 begin, spent;
+
+	while (TRUE) {
+		frame = g_async_queue_pop(recorder->queue);
+		if (frame->stop) {
+			remmina_video_recorder_frame_free(frame);
+			break;
+		}
+
+		begin = g_get_monotonic_time();
+		remmina_video_recorder_write_frame(recorder, frame);
+		g_atomic_int_add(&recorder->queued, -(gint)frame->len);
+		remmina_video_recorder_frame_free(frame);
+
+		/* Rest long enough to stay within the CPU share, the capture
+		 * side skips frames until then */
+		spent = g_get_monotonic_time() - begin;
+		g_atomic_int_set(&recorder->busy_until,
+				 (gint)((g_get_monotonic_time() - recorder->start +
+					 spent * (100 - REMMINA_VIDEO_RECORDER_CPU) / REMMINA_VIDEO_RECORDER_CPU) / 1000));
+	}
+
+	g_output_stream_close(recorder->video, NULL, NULL);
+	g_output_stream_close(recorder->index, NULL, NULL);
+
+	/* remmina_video_recorder_free() left the rest to us */
+	g_async_queue_unref(recorder->queue);
+	g_object_unref(recorder->video);
+	g_object_unref(recorder->index);
+	g_byte_array_free(recorder->raw, TRUE);
+	g_free(recorder->shadow);
+	g_free(recorder);
+
+	g_mutex_lock(&remmina_video_recorder_writers_mutex);
+	if (--remmina_video_recorder_writers == 0)
+		g_cond_broadcast(&remmina_video_recorder_writers_cond);
+	g_mutex_unlock(&remmina_video_recorder_writers_mutex);
+	return NULL;
+}
+
+static gboolean remmina_video_recorder_capture(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaVideoRecorder *recorder = (RemminaVideoRecorder *)data;
+	RemminaVideoRecorderFrame *frame;
+	cairo_rectangle_int_t full;
+	cairo_surface_t *fb, *dst;
+	cairo_t *cr;
+	guint32 *p;
+	gint64 now;
+	gint i, width, height;
+	gsize len;
+
+	now = g_get_monotonic_time();
+	if ((now - recorder->start) / 1000 < g_atomic_int_get(&recorder->busy_until) ||
+	    g_atomic_int_get(&recorder->queued) > REMMINA_VIDEO_RECORDER_QUEUE_MAX)
+		return G_SOURCE_CONTINUE;
+
+	fb = recorder->source(recorder->source_data);
+	if (!fb)
+		return G_SOURCE_CONTINUE;
+	width = cairo_image_surface_get_width(fb);
+	height = cairo_image_surface_get_height(fb);
+
+	frame = g_new0(RemminaVideoRecorderFrame, 1);
+	frame->time = now;
+	frame->width = width;
+	frame->height = height;
+
+	full.x = full.y = 0;
+	full.width = width;
+	full.height = height;
+	if (width != recorder->width || height != recorder->height ||
+	    now - recorder->last_key >= REMMINA_VIDEO_RECORDER_KEYFRAME_TIME) {
+		frame->key = TRUE;
+		recorder->width = width;
+		recorder->height = height;
+		recorder->last_key = now;
+		cairo_region_destroy(recorder->damage);
+		recorder->damage = cairo_region_create_rectangle(&full);
+	} else {
+		cairo_region_intersect_rectangle(recorder->damage, &full);
+		if (cairo_region_is_empty(recorder->damage)) {
+			cairo_surface_destroy(fb);
+			g_free(frame);
+			return G_SOURCE_CONTINUE;
+		}
+	}
+
+	frame->nrects = cairo_region_num_rectangles(recorder->damage);
+	frame->rects = g_new(cairo_rectangle_int_t, frame->nrects);
+	len = 0;
+	for (i = 0; i < frame->nrects; i++) {
+		cairo_region_get_rectangle(recorder->damage, i, &frame->rects[i]);
+		len += (gsize)frame->rects[i].width * frame->rects[i].height;
+	}
+	frame->len = len * 4;
+	frame->pixels = g_malloc(frame->len);
+
+	/* Let cairo convert whatever the plugin uses into packed RGB24 */
+	cairo_surface_flush(fb);
+	p = frame->pixels;
+	for (i = 0; i < frame->nrects; i++) {
+		cairo_rectangle_int_t *r = &frame->rects[i];
+
+		dst = cairo_image_surface_create_for_data((guchar *)p, CAIRO_FORMAT_RGB24, r->width, r->height, r->width * 4);
+		cr = cairo_create(dst);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(cr, fb, -r->x, -r->y);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_surface_destroy(dst);
+		p += (gsize)r->width * r->height;
+	}
+	cairo_surface_destroy(fb);
+
+	cairo_region_destroy(recorder->damage);
+	recorder->damage = cairo_region_create();
+
+	g_atomic_int_add(&recorder->queued, (gint)frame->len);
+	g_async_queue_push(recorder->queue, frame);
+	return G_SOURCE_CONTINUE;
+}
+
+static GOutputStream *remmina_video_recorder_create(const gchar *filename, GError **error)
+{
+	TRACE_CALL(__func__);
+	GFile *file;
+	GFileOutputStream *stream;
+
+	/* Written in place, a crash keeps everything up to the last frame.
+	 * Never over an existing file: g_file_create() fails with G_IO_ERROR_EXISTS */
+	file = g_file_new_for_path(filename);
+	stream = g_file_create(file, G_FILE_CREATE_PRIVATE, NULL, error);
+	g_object_unref(file);
+	return stream ? G_OUTPUT_STREAM(stream) : NULL;
+}
+
+/* Creates "<basename>.rvr" and its index, or "<basename>-<n>.rvr" when taken */
+static gboolean remmina_video_recorder_create_files(RemminaVideoRecorder *recorder, const gchar *basename)
+{
+	TRACE_CALL(__func__);
+	GError *error = NULL;
+	gchar *name, *filename, *filename_idx;
+	gint n;
+
+	for (n = 0; n < 100; n++) {
+		name = n ? g_strdup_printf("%s-%d", basename, n) : g_strdup(basename);
+		filename = g_strconcat(name, ".rvr", NULL);
+		recorder->video = remmina_video_recorder_create(filename, &error);
+		if (recorder->video) {
+			filename_idx = g_strconcat(name, ".rvr.idx", NULL);
+			recorder->index = remmina_video_recorder_create(filename_idx, &error);
+			if (!recorder->index) {
+				/* Ours and still empty: give up the name along with its index */
+				g_object_unref(recorder->video);
+				recorder->video = NULL;
+				g_unlink(filename);
+				g_free(filename);
+				filename = filename_idx;
+			} else {
+				g_free(filename_idx);
+			}
+		}
+		if (recorder->video) {
+			REMMINA_DEBUG("Recording session to %s.rvr", name);
+			g_free(filename);
+			g_free(name);
+			return TRUE;
+		}
+		g_free(name);
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_EXISTS)) {
+			REMMINA_WARNING("Could not create %s: %s", filename, error->message);
+			g_error_free(error);
+			g_free(filename);
+			return FALSE;
+		}
+		g_clear_error(&error);
+		g_free(filename);
+	}
+	REMMINA_WARNING("Could not find a free name for the recording %s.rvr", basename);
+	return FALSE;
+}
+
+RemminaVideoRecorder *remmina_video_recorder_new(const gchar *basename, gint fps, RemminaVideoRecorderSource source, gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaVideoRecorder *recorder;
+	guint8 header[REMMINA_VIDEO_FILE_HEADER_SIZE] = { 0 };
+	guint32 version = GUINT32_TO_LE(REMMINA_VIDEO_VERSION);
+
+	recorder = g_new0(RemminaVideoRecorder, 1);
+
+	if (!remmina_video_recorder_create_files(recorder, basename)) {
+		g_free(recorder);
+		return NULL;
+	}
+
+	memcpy(header, REMMINA_VIDEO_MAGIC, 8);
+	memcpy(header + 8, &version, 4);
+	g_output_stream_write_all(recorder->video, header, sizeof(header), NULL, NULL, NULL);
+	g_output_stream_write_all(recorder->index, "# seconds offset\n", 17, NULL, NULL, NULL);
+
+	recorder->start = g_get_monotonic_time();
+	recorder->source = source;
+	recorder->source_data = data;
+	recorder->damage = cairo_region_create();
+	recorder->raw = g_byte_array_new();
+
+	recorder->queue = g_async_queue_new_full(remmina_video_recorder_frame_free);
+	g_mutex_lock(&remmina_video_recorder_writers_mutex);
+	remmina_video_recorder_writers++;
+	g_mutex_unlock(&remmina_video_recorder_writers_mutex);
+	recorder->thread = g_thread_new("remmina-video-recorder", remmina_video_recorder_thread, recorder);
+	recorder->capture_source = g_timeout_add(1000 / CLAMP(fps, 1, 30), remmina_video_recorder_capture, recorder);
+
+	REMMINA_DEBUG("Recording at %d fps", CLAMP(fps, 1, 30));
+	return recorder;
+}
+
+void remmina_video_recorder_damage(RemminaVideoRecorder *recorder, gint x, gint y, gint w, gint h)
+{
+	TRACE_CALL(__func__);
+	cairo_rectangle_int_t rect;
+
+	if (!recorder || w <= 0 || h <= 0)
+		return;
+
+	rect.x = MAX(x, 0);
+	rect.y = MAX(y, 0);
+	rect.width = x + w - rect.x;
+	rect.height = y + h - rect.y;
+	if (rect.width > 0 && rect.height > 0)
+		cairo_region_union_rectangle(recorder->damage, &rect);
+}
+
+void remmina_video_recorder_free(RemminaVideoRecorder *recorder)
+{
+	TRACE_CALL(__func__);
+	RemminaVideoRecorderFrame *stop;
+	GThread *thread;
+
+	if (!recorder)
+		return;
+
+	g_source_remove(recorder->capture_source);
+	/* Catch up with the damage since the last capture */
+	g_atomic_int_set(&recorder->busy_until, 0);
+	remmina_video_recorder_capture(recorder);
+	cairo_region_destroy(recorder->damage);
+	recorder->damage = NULL;
+
+	/* The writer may have many frames to go, it frees the recorder itself
+	 * once they are written, without blocking the main thread meanwhile */
+	thread = recorder->thread;
+	stop = g_new0(RemminaVideoRecorderFrame, 1);
+	stop->stop = TRUE;
+	g_async_queue_push(recorder->queue, stop);
+	g_thread_unref(thread);
+}
+
+void remmina_video_recorder_wait_all(void)
+{
+	TRACE_CALL(__func__);
+
+	g_mutex_lock(&remmina_video_recorder_writers_mutex);
+	while (remmina_video_recorder_writers > 0)
+		g_cond_wait(&remmina_video_recorder_writers_cond, &remmina_video_recorder_writers_mutex);
+	g_mutex_unlock(&remmina_video_recorder_writers_mutex);
+}
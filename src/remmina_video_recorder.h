@@ -0,0 +1,68 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <cairo.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Records a graphical session from the decoded framebuffer, see
+ * remmina_video_format.h for the file layout.
+ *
+ * The main thread only accumulates the damage reported by the protocol
+ * plugin and, at the recording frame rate, copies the damaged rectangles
+ * out of the framebuffer. Delta coding, compression and writing happen
+ * on a background thread. When that thread is over its CPU share, or too
+ * far behind, captures are skipped and their damage is merged into the
+ * next frame, so the recording drops frames but never pixels.
+ */
+
+typedef struct _RemminaVideoRecorder RemminaVideoRecorder;
+
+/* Returns a new reference to the current framebuffer, or NULL if there is none yet */
+typedef cairo_surface_t *(*RemminaVideoRecorderSource)(gpointer data);
+
+RemminaVideoRecorder *remmina_video_recorder_new(const gchar *basename, gint fps, RemminaVideoRecorderSource source, gpointer data);
+/* Main thread only, coordinates are in framebuffer pixels */
+void remmina_video_recorder_damage(RemminaVideoRecorder *recorder, gint x, gint y, gint w, gint h);
+/* Queues the pending damage and returns, the writer thread finishes the
+ * file and frees the recorder on its own */
+void remmina_video_recorder_free(RemminaVideoRecorder *recorder);
+/* Waits for the writer threads of the freed recorders, before exiting */
+void remmina_video_recorder_wait_all(void);
+
+G_END_DECLS
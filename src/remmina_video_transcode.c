@@ -0,0 +1,179 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2023 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/*
+ * remmina-video-transcode: turns a Remmina session recording (.rvr) into a
+ * YUV4MPEG2 stream, which any encoder reads, e.g.
+ *   remmina-video-transcode session.rvr | ffmpeg -i - session.mp4
+ * It does not need a display, so recordings can be converted on a server.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "remmina_video_format.h"
+
+static gdouble opt_start = 0;
+static gdouble opt_duration = 0;
+static gint opt_fps = 10;
+
+static GOptionEntry entries[] = {
+	{ "start",    's', 0, G_OPTION_ARG_DOUBLE, &opt_start,	  "Start at this many seconds into the recording", "SECONDS" },
+	{ "duration", 'd', 0, G_OPTION_ARG_DOUBLE, &opt_duration, "Stop after this many seconds",		   "SECONDS" },
+	{ "fps",      'r', 0, G_OPTION_ARG_INT,	   &opt_fps,	  "Output frame rate (default 10)",		   "FPS"     },
+	{ NULL }
+};
+
+/* BT.601, limited range, one sample of each plane per pixel (C444) */
+static void write_frame(FILE *out, const guint32 *pixels, gint width, gint height, gint out_width, gint out_height, guint8 *planes)
+{
+	guint8 *py = planes, *pu = planes + (gsize)out_width * out_height, *pv = pu + (gsize)out_width * out_height;
+	gint x, y, r, g, b;
+	guint32 p;
+
+	for (y = 0; y < out_height; y++) {
+		for (x = 0; x < out_width; x++) {
+			/* A resolution change keeps the first size, crop or pad with black */
+			p = (x < width && y < height) ? pixels[(gsize)y * width + x] : 0;
+			r = (p >> 16) & 0xff;
+			g = (p >> 8) & 0xff;
+			b = p & 0xff;
+			*py++ = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+			*pu++ = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			*pv++ = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+		}
+	}
+	fputs("FRAME\n", out);
+	fwrite(planes, 1, (gsize)out_width * out_height * 3, out);
+}
+
+int main(int argc, char **argv)
+{
+	RemminaVideoReader *reader;
+	GOptionContext *context;
+	GError *error = NULL;
+	const guint32 *pixels;
+	guint8 *planes = NULL;
+	gint64 t, step, end, next;
+	gint width, height, out_width = 0, out_height = 0, frames = 0;
+	gboolean decoded = FALSE;
+	FILE *out;
+
+	context = g_option_context_new("RECORDING.rvr [OUTPUT.y4m]");
+	g_option_context_set_summary(context, "Convert a Remmina session recording to a YUV4MPEG2 video stream.");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error) || argc < 2 || argc > 3 || opt_fps < 1) {
+		if (error) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+		} else {
+			gchar *help = g_option_context_get_help(context, TRUE, NULL);
+			g_printerr("%s", help);
+			g_free(help);
+		}
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	reader = remmina_video_reader_open(argv[1], &error);
+	if (!reader) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+
+	if (argc < 3 || g_strcmp0(argv[2], "-") == 0) {
+		out = stdout;
+	} else {
+		out = g_fopen(argv[2], "wb");
+		if (!out) {
+			g_printerr("Could not create %s\n", argv[2]);
+			remmina_video_reader_free(reader);
+			return EXIT_FAILURE;
+		}
+	}
+
+	t = (gint64)(opt_start * G_USEC_PER_SEC);
+	end = opt_duration > 0 ? t + (gint64)(opt_duration * G_USEC_PER_SEC) : G_MAXINT64;
+	step = G_USEC_PER_SEC / opt_fps;
+
+	if (!remmina_video_reader_seek(reader, t, &error))
+		goto done;
+
+	while (t < end) {
+		/* Apply every change up to the time of this output frame */
+		while ((next = remmina_video_reader_peek_time(reader, &error)) >= 0 && next <= t) {
+			if (!remmina_video_reader_next(reader, &error))
+				goto done;
+			decoded = TRUE;
+		}
+		if (error)
+			goto done;
+		if (next < 0 && (!decoded || frames > 0))
+			break;
+		if (decoded) {
+			pixels = remmina_video_reader_get_pixels(reader, &width, &height);
+			if (frames == 0) {
+				out_width = width;
+				out_height = height;
+				planes = g_malloc((gsize)out_width * out_height * 3);
+				fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", out_width, out_height, opt_fps);
+			}
+			write_frame(out, pixels, width, height, out_width, out_height, planes);
+			frames++;
+			/* The recording has ended, the last frame was shown once */
+			if (next < 0)
+				break;
+		}
+		t += step;
+	}
+
+done:
+	if (error) {
+		/* Keep what was converted, an interrupted recording is still useful */
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+	}
+	if (out != stdout)
+		fclose(out);
+	else
+		fflush(out);
+	g_free(planes);
+	remmina_video_reader_free(reader);
+	g_printerr("%d frames written\n", frames);
+	return frames > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}